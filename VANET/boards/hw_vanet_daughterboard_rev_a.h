@@ -48,6 +48,37 @@
  */
 #define CONFIG_BSP_RTC_CLOCK_HZ                 BOARD_OSC32_HZ
 #define CONFIG_BSP_RTC_TICK_HZ                  32					// must be CONFIG_BSP_RTC_CLOCK_HZ / 2^n
+#define CONFIG_BSP_RTC_TICKLESS_MIN_TICKS       2					// stop the tick for idle periods this long or more
+#define CONFIG_BSP_RTC_TICKLESS_MAX_TICKS       (60 * CONFIG_BSP_RTC_TICK_HZ)	// well inside a cycle counter wrap
+
+/*
+ * Interrupt levels - a higher level preempts a lower one.  Only handlers at or
+ * below CONFIG_BSP_INTC_SHARED_LEVEL may touch what the tasks share (buffers,
+ * circular buffers, TKVS, uC/OS); the BSP's short critical sections leave the
+ * levels above it running.  The buzzer is at CONFIG_BSP_BUZZER_REP_IRQ_PRI,
+ * below; the GPS time pulse has the top level
+ */
+#define CONFIG_BSP_INTC_SHARED_LEVEL            0					// AVR32_INTC_INTn, as a number for #if
+#define CONFIG_BSP_RTC_IRQ_PRI                  AVR32_INTC_INT0
+#define CONFIG_BSP_TERMIOS_IRQ_PRI              AVR32_INTC_INT0
+#define CONFIG_BSP_PIN_IRQ_PRI                  AVR32_INTC_INT0
+#define CONFIG_BSP_I2C_IRQ_PRI                  AVR32_INTC_INT0		// completions post TKVS events
+
+/*
+ * Pin debounce - a one-shot on OSC32K for the nearest deadline, at CONFIG_BSP_PIN_IRQ_PRI
+ */
+#define CONFIG_BSP_PIN_TIMER                    &AVR32_TC0
+#define CONFIG_BSP_PIN_TIMER_CHANNEL            2
+#define CONFIG_BSP_PIN_TIMER_IRQ                AVR32_TC0_IRQ2
+
+/*
+ * I2C - TWIM0, its data through two PDCA channels
+ */
+#define CONFIG_BSP_I2C_PDCA_RX                  0
+#define CONFIG_BSP_I2C_PDCA_TX                  1
+#define CONFIG_BSP_I2C_SPEED_HZ                 50000				// devices that haven't asked for more
+#define CONFIG_BSP_I2C_SPEEDS                   4					// devices that can ask
+#define CONFIG_BSP_I2C_TIMEOUT_MS               250					// blocking transfers, queueing included
 
 /*
  * Indicator LEDs
@@ -71,15 +102,17 @@
 #define GPS_USART_TX_PIN        AVR32_USART0_TXD_PIN
 #define GPS_USART_TX_FUNCTION   AVR32_USART0_TXD_FUNCTION
 #define GPS_USART_IRQ           AVR32_USART0_IRQ
-#define GPS_USART_BAUDRATE      9600
+#define GPS_USART_BAUDRATE      9600                // receiver default, NMEA
+#define GPS_USART_UBX_BAUDRATE  115200              // UBX at 10 Hz
 #define GPS_USART_CLOCK_MASK    AVR32_USART0_CLK_PBA
 #define GPS_USART_RX_BUF_SIZE	512
-#define GPS_USART_TX_BUF_SIZE	16
+#define GPS_USART_TX_BUF_SIZE	64					// a UBX configuration frame
 
 /*
  * GPS TimePulse
  */
 #define GPS_TIMEPULSE_PIN		AVR32_PIN_PC19
+#define GPS_TIMEPULSE_IRQ_PRI	AVR32_INTC_INT3		// nothing may delay the capture - alone on its GPIO line
 
 /*
  * Accelerometer
@@ -144,7 +177,7 @@
 #define CONFIG_BSP_BUZZER_REP_TIMER             &AVR32_TC0
 #define CONFIG_BSP_BUZZER_REP_CHANNEL           1
 #define CONFIG_BSP_BUZZER_REP_IRQ               AVR32_TC0_IRQ1
-#define CONFIG_BSP_BUZZER_REP_IRQ_PRI           AVR32_INTC_INT3
+#define CONFIG_BSP_BUZZER_REP_IRQ_PRI           AVR32_INTC_INT2
 
 #define CONFIG_BSP_BUZZER_COUNT                 1
 
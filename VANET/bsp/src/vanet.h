@@ -38,6 +38,7 @@
 #endif
 
 // Utilities
+#include "bench.h"
 #include "circ.h"
 #include "delay.h"
 #include "dlib.h"
@@ -62,11 +63,13 @@
 #include "sleepmgr_ext.h"
 
 // Services
+#include "rtc_servo.h"
 #include "rtc.h"
 #include "i2c.h"
 #include "logcat.h"
 #include "mux.h"
 #include "termios.h"
+#include "termios_capture.h"
 #include "tkvs.h"
 #include "tkvs_tmr.h"
 #include "codeplug.h"
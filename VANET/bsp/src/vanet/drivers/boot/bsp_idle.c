@@ -27,6 +27,8 @@ static uint8_t s_per_tick_cnt = 0;
 static bsp_idle_callback_t s_general_callbacks[BSP_IDLE_MAX_GENERAL_CALLBACKS];
 static uint8_t s_general_cnt = 0;
 
+static volatile uint8_t s_tick_holds = 0;
+
 void bsp_idle_register_idle_function(bsp_idle_callback_t func, bsp_idle_callback_type type)
 {
 	if (type == BSP_IDLE_ONCE_PER_TICK)
@@ -45,6 +47,23 @@ void bsp_idle_register_idle_function(bsp_idle_callback_t func, bsp_idle_callback
 	}
 }
 
+void bsp_idle_hold_tick(bsp_idle_hold_t hold, bool held)
+{
+	irqflags_t flags = cpu_irq_save();
+	
+	if (held)
+		s_tick_holds |= hold;
+	else
+		s_tick_holds &= ~hold;
+		
+	cpu_irq_restore(flags);
+}
+
+bool bsp_idle_tick_held(void)
+{
+	return s_tick_holds != 0;
+}
+
 void bsp_idle_loop(void)
 {
     static uint32_t s_last_check = 0;
@@ -66,5 +85,9 @@ void bsp_idle_loop(void)
 		s_general_callbacks[i]();
 	}	
 
+#ifdef CONFIG_BSP_ENABLE_RTC
+	bsp_rtc_sleep();
+#else
 	sleepmgr_enter_sleep();
+#endif
 }
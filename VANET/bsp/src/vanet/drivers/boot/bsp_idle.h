@@ -34,4 +34,20 @@ typedef enum
 /// Register an idle function to be called
 void bsp_idle_register_idle_function(bsp_idle_callback_t func, bsp_idle_callback_type type);
 
+/// Idle work that counts ticks, so the tick can't stop (see bsp_rtc_sleep)
+typedef enum
+{
+	BSP_IDLE_HOLD_TERMIOS = 0x02,	///< Buffered receive data or a port idle handler
+	BSP_IDLE_HOLD_LOGCAT = 0x04,	///< Log entries still to display
+	BSP_IDLE_HOLD_CLCD = 0x08,		///< Character LCD text still to send
+	BSP_IDLE_HOLD_REPLAY = 0x10,	///< A termios replay waiting for its next record
+	BSP_IDLE_HOLD_APP = 0x80,		///< Application
+} bsp_idle_hold_t;
+
+/// Keep the tick running while idle, or let it stop - callable from an ISR
+void bsp_idle_hold_tick(bsp_idle_hold_t hold, bool held);
+
+/// Whether anything holds the tick
+bool bsp_idle_tick_held(void);
+
 #endif // BSP_IDLE_H
\ No newline at end of file
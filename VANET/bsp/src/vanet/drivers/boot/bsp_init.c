@@ -81,6 +81,11 @@ void bsp_init(void)
 	#ifdef CONFIG_BSP_ENABLE_LOGCAT
 	bsp_logcat_init();
 	#endif
+	
+	// Benchmarks - the services register theirs as they come up below
+	#ifdef CONFIG_BSP_ENABLE_BENCH
+	bsp_bench_init();
+	#endif
 		
 	
 	//
@@ -107,6 +112,11 @@ void bsp_init(void)
 	bsp_mux_init();
 	#endif
 	
+	// Termios capture / replay - over the mux
+	#ifdef CONFIG_BSP_ENABLE_TERMIOS_CAPTURE
+	bsp_termios_capture_init();
+	#endif
+	
 	// Initialize Pin Driver
 	#ifdef CONFIG_BSP_ENABLE_PIN
 	bsp_pin_init();
@@ -351,7 +351,11 @@ void bsp_reset_init(void)
 void bsp_reset(bsp_reset_reason_t reason)
 {
     uint32_t addr = 0;
+#ifdef VANET_SIM
+    addr = (uint32_t)(uintptr_t)__builtin_return_address(0);
+#else
     asm ("mov %0, lr" : "+r"(addr));
+#endif
     addr -= 4; // we don't know where we came from, but assume it was a 4-byte rcall
     
     cpu_exception((uint16_t)reason, addr);
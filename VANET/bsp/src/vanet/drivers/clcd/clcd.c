@@ -83,6 +83,12 @@ void bsp_clcd_trace_2(const char *s, unsigned long p1, unsigned long p2)
 /************************************************************************/
 /* HD44780 SPECIFIC                                                     */
 /************************************************************************/
+/*
+ *	Text goes into a shadow of the display (want) and the idle loop sends what
+ *	differs from what it last sent (shown), a run of changed cells at a time,
+ *	moving the cursor only when the address counter isn't already there.
+ *	Rewriting a line that hasn't changed costs nothing on the bus.
+ */
 #define OP_CLEAR_DISPLAY                            0x01
 #define OP_RETURN_HOME                              0x02
 #define OP_ENTRY_MODE_SET(ID,S)                     (0x04 | ((ID) << 1) | (S))
@@ -96,6 +102,9 @@ void bsp_clcd_trace_2(const char *s, unsigned long p1, unsigned long p2)
 #define BSP_CLCD_HD44780_MAX_ROWS 4
 #define BSP_CLCD_HD44780_MAX_COLS 20
 static uint8_t bsp_clcd_hd44780_line_address[BSP_CLCD_HD44780_MAX_ROWS];
+static uint8_t bsp_clcd_hd44780_line_order[BSP_CLCD_HD44780_MAX_ROWS];		// rows by address
+
+#define BSP_CLCD_HD44780_CURSOR_UNKNOWN		0xff
 
 typedef struct {
 	void (*init)(void *p);
@@ -103,14 +112,46 @@ typedef struct {
 	void (*command)(void *p, uint8_t command);
 	void (*data)(void *p, char *data);
 	void (*datab)(void *p, uint8_t value);
+	
+	// the shadow - text is never '\0', so that's a cell the display may not be showing
+	char want[BSP_CLCD_HD44780_MAX_ROWS][BSP_CLCD_HD44780_MAX_COLS];
+	char shown[BSP_CLCD_HD44780_MAX_ROWS][BSP_CLCD_HD44780_MAX_COLS];
+	uint8_t cursor;					// DDRAM address counter
+	volatile bool dirty;			// want has changed since the last flush started
+	volatile bool clear;			// clear the display before the next flush
+	volatile bool flushing;			// the idle loop is talking to the display
+	volatile bool hold;				// a task is - the idle loop keeps off
+	bsp_clcd_private_t *next;
 } bsp_clcd_hd44780_t;
 
+static bsp_clcd_private_t *s_clcd_hd44780_list;
+
+/// Keep the idle loop's flush off the display while a task talks to it
+static void bsp_clcd_hd44780_lock(bsp_clcd_hd44780_t *hd44780)
+{
+	// the idle loop can't run until we block - then it finishes its run and sees hold
+	hd44780->hold = true;
+	while (hd44780->flushing)
+		bsp_delay(1);
+}
+
+static void bsp_clcd_hd44780_unlock(bsp_clcd_hd44780_t *hd44780)
+{
+	hd44780->hold = false;
+}
+
+static void bsp_clcd_hd44780_changed(bsp_clcd_hd44780_t *hd44780)
+{
+	hd44780->dirty = true;
+	bsp_idle_hold_tick(BSP_IDLE_HOLD_CLCD, true);
+}
+
 static void bsp_clcd_hd44780_setup(bsp_clcd_private_t *p, uint8_t cols, uint8_t rows)
 {
 	bsp_clcd_trace_2("hd44780 setup", cols, rows);
 	
-	p->cols = cols;
-	p->rows = rows;
+	p->cols = min(cols, BSP_CLCD_HD44780_MAX_COLS);
+	p->rows = min(rows, BSP_CLCD_HD44780_MAX_ROWS);
 	
 	if (p->rows == 4)
 	{
@@ -118,11 +159,19 @@ static void bsp_clcd_hd44780_setup(bsp_clcd_private_t *p, uint8_t cols, uint8_t
 		bsp_clcd_hd44780_line_address[1] = 0x40;
 		bsp_clcd_hd44780_line_address[2] = 0 + cols;
 		bsp_clcd_hd44780_line_address[3] = 0x40 + cols;
+		
+		// 0 runs into 2 and 2 into 1 on a 20x4, so a flush in this order needs no cursor moves between them
+		bsp_clcd_hd44780_line_order[0] = 0;
+		bsp_clcd_hd44780_line_order[1] = 2;
+		bsp_clcd_hd44780_line_order[2] = 1;
+		bsp_clcd_hd44780_line_order[3] = 3;
 	}	
 	else if (p->rows == 2)
 	{
 		bsp_clcd_hd44780_line_address[0] = 0;
 		bsp_clcd_hd44780_line_address[1] = 0x40;
+		bsp_clcd_hd44780_line_order[0] = 0;
+		bsp_clcd_hd44780_line_order[1] = 1;
 	}
 }
 
@@ -131,7 +180,9 @@ static void bsp_clcd_hd44780_backlight(bsp_clcd_private_t *p, bool on_off)
 	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
 	bsp_clcd_trace_ul("hd44780 backlight", on_off);
 	
+	bsp_clcd_hd44780_lock(hd44780);
 	hd44780->backlight(p->interface_params, on_off);
+	bsp_clcd_hd44780_unlock(hd44780);
 }
 
 static void bsp_clcd_hd44780_display(bsp_clcd_private_t *p, bool on_off)
@@ -139,7 +190,9 @@ static void bsp_clcd_hd44780_display(bsp_clcd_private_t *p, bool on_off)
 	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
 	bsp_clcd_trace_ul("hd44780 display", on_off);
 	
+	bsp_clcd_hd44780_lock(hd44780);
 	hd44780->command(p->interface_params, OP_DISPLAY_ON(on_off, 0, 0));	// display, no cursor, no blink
+	bsp_clcd_hd44780_unlock(hd44780);
 }
 
 
@@ -150,7 +203,6 @@ static bool bsp_clcd_hd44780_write_line(bsp_clcd_private_t *p, uint32_t line, bs
 	
 	uint8_t offset = 0;
 	int len = strlen(text);
-	char data[BSP_CLCD_HD44780_MAX_COLS+1];
 	
 	if (len > p->cols) len = p->cols;
 	
@@ -169,12 +221,9 @@ static bool bsp_clcd_hd44780_write_line(bsp_clcd_private_t *p, uint32_t line, bs
 		break;
 	}
 	
-	memset(data,' ',p->cols);
-	memcpy(data+offset,text,len);
-	data[p->cols] = '\0';
-	
-	hd44780->command(p->interface_params, OP_DDRAM_ADDR(bsp_clcd_hd44780_line_address[line]));
-	hd44780->data(p->interface_params, data);
+	memset(hd44780->want[line], ' ', p->cols);
+	memcpy(hd44780->want[line] + offset, text, len);
+	bsp_clcd_hd44780_changed(hd44780);
 	
 	return true;
 }
@@ -184,17 +233,11 @@ static bool bsp_clcd_hd44780_write_pos(bsp_clcd_private_t *p, uint32_t line, uin
 	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
 	if (line >= p->rows || column >= p->cols) return false;
 	
-	char data[BSP_CLCD_HD44780_MAX_COLS+1];
-	memset(data, '\0', sizeof(data));
-	
-	uint8_t addr = bsp_clcd_hd44780_line_address[line] + column;
 	int len = strlen(text);
 	
 	if (column + len > p->cols) len = p->cols - column;
-	strncpy(data, text, len);
-	
-	hd44780->command(p->interface_params, OP_DDRAM_ADDR(addr));
-	hd44780->data(p->interface_params, data);
+	memcpy(hd44780->want[line] + column, text, len);
+	bsp_clcd_hd44780_changed(hd44780);
 	
 	return true;
 }
@@ -204,8 +247,108 @@ static void bsp_clcd_hd44780_clear(bsp_clcd_private_t *p)
 	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
 	bsp_clcd_trace("hd44780 clear");
 	
-	hd44780->command(p->interface_params, OP_CLEAR_DISPLAY);
-	bsp_clcd_delay_us(3000);
+	// one command beats writing every cell with a space - the flush does it first
+	memset(hd44780->want, ' ', sizeof(hd44780->want));
+	hd44780->clear = true;
+	bsp_clcd_hd44780_changed(hd44780);
+}
+
+/// Where the address counter goes after a write at addr - the second line follows the first
+static uint8_t bsp_clcd_hd44780_next_addr(uint8_t addr)
+{
+	addr++;
+	if (addr == 0x28)
+		return 0x40;
+	if (addr == 0x68)
+		return 0x00;
+	return addr;
+}
+
+/// Send what's changed (idle loop)
+static void bsp_clcd_hd44780_flush(bsp_clcd_private_t *p)
+{
+	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
+	char run[BSP_CLCD_HD44780_MAX_COLS+1];
+	uint8_t row, col, addr, n;
+	
+	hd44780->flushing = true;
+	if (hd44780->hold)
+	{
+		hd44780->flushing = false;
+		return;
+	}
+	
+	// a write from here on comes round again
+	hd44780->dirty = false;
+	
+	if (hd44780->clear)
+	{
+		hd44780->clear = false;
+		hd44780->command(p->interface_params, OP_CLEAR_DISPLAY);		// the interface covers its 1.52ms
+		memset(hd44780->shown, ' ', sizeof(hd44780->shown));
+		hd44780->cursor = 0;
+	}
+	
+	for (int i=0; i<p->rows; i++)
+	{
+		row = bsp_clcd_hd44780_line_order[i];
+		col = 0;
+		while (col < p->cols)
+		{
+			if (hd44780->want[row][col] == hd44780->shown[row][col])
+			{
+				col++;
+				continue;
+			}
+			
+			// a task wants the display - what's left waits for the next flush
+			if (hd44780->hold)
+			{
+				hd44780->dirty = true;
+				i = p->rows;
+				break;
+			}
+			
+			addr = bsp_clcd_hd44780_line_address[row] + col;
+			for (n=0; col < p->cols && hd44780->want[row][col] != hd44780->shown[row][col]; n++, col++)
+			{
+				run[n] = hd44780->want[row][col];
+				hd44780->shown[row][col] = run[n];
+			}
+			run[n] = '\0';
+			
+			if (hd44780->cursor != addr)
+				hd44780->command(p->interface_params, OP_DDRAM_ADDR(addr));
+			hd44780->data(p->interface_params, run);
+			for (hd44780->cursor = addr; n; n--)
+				hd44780->cursor = bsp_clcd_hd44780_next_addr(hd44780->cursor);
+		}
+	}
+	
+	hd44780->flushing = false;
+}
+
+static void bsp_clcd_hd44780_idle(void)
+{
+	bsp_clcd_private_t *p;
+	bool dirty = false;
+	irqflags_t flags;
+	
+	for (p = s_clcd_hd44780_list; p; p = ((bsp_clcd_hd44780_t *)p->driver_params)->next)
+	{
+		if (((bsp_clcd_hd44780_t *)p->driver_params)->dirty)
+			bsp_clcd_hd44780_flush(p);
+	}
+	
+	// let the tick stop once all are flushed - with interrupts off, so a change
+	// made after the flush can't lose its hold
+	flags = cpu_irq_save();
+	for (p = s_clcd_hd44780_list; p; p = ((bsp_clcd_hd44780_t *)p->driver_params)->next)
+	{
+		dirty |= ((bsp_clcd_hd44780_t *)p->driver_params)->dirty;
+	}
+	bsp_idle_hold_tick(BSP_IDLE_HOLD_CLCD, dirty);
+	cpu_irq_restore(flags);
 }
 
 static void bsp_clcd_hd44780_create_char(bsp_clcd_private_t *p, uint8_t cgram_loc, uint8_t charmap[])
@@ -213,11 +356,16 @@ static void bsp_clcd_hd44780_create_char(bsp_clcd_private_t *p, uint8_t cgram_lo
 	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
 	cgram_loc &= 0x07;		// only 8 locations
 	
+	bsp_clcd_hd44780_lock(hd44780);
 	hd44780->command(p->interface_params, OP_CGRAM_ADDR(cgram_loc << 3));
 	for (int i=0; i<8; i++)
 	{
 		hd44780->datab(p->interface_params, charmap[i]);
 	}
+	
+	// the address counter is in CGRAM now
+	hd44780->cursor = BSP_CLCD_HD44780_CURSOR_UNKNOWN;
+	bsp_clcd_hd44780_unlock(hd44780);
 }
 
 static void bsp_clcd_hd44780_selftest(bsp_clcd_private_t *p)
@@ -256,6 +404,21 @@ static void bsp_clcd_hd44780_init(bsp_clcd_private_t *p)
 	
 	bsp_clcd_hd44780_t *hd44780 = (bsp_clcd_hd44780_t *)p->driver_params;
 	hd44780->init(p->interface_params);
+	
+	// nothing on it is known yet
+	memset(hd44780->want, ' ', sizeof(hd44780->want));
+	memset(hd44780->shown, '\0', sizeof(hd44780->shown));
+	hd44780->cursor = BSP_CLCD_HD44780_CURSOR_UNKNOWN;
+	hd44780->dirty = false;
+	hd44780->clear = false;
+	hd44780->flushing = false;
+	hd44780->hold = false;
+	
+	// the first display starts the idle loop flushing
+	if (!s_clcd_hd44780_list)
+		bsp_idle_register_idle_function(bsp_clcd_hd44780_idle, BSP_IDLE_ONCE_PER_TICK);
+	hd44780->next = s_clcd_hd44780_list;
+	s_clcd_hd44780_list = p;
 }
 
 /************************************************************************/
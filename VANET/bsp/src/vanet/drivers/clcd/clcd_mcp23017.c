@@ -29,12 +29,49 @@
 /************************************************************************/
 /* MCP23017 LCD SPECIFIC                                                */
 /************************************************************************/
+/*
+ *	As for the PCF8574: nibbles collect in a burst that goes out as one I2C
+ *	write, padded with idle values after the slow commands.
+ */
+static void bsp_clcd_mcp23017_flush(bsp_clcd_interface_i2c_mcp23017_t *params)
+{
+	if (params->burst_len)
+	{
+		bsp_i2c_gpio_writeBurst(params->gpio, params->burst, params->burst_len);
+		params->burst_len = 0;
+	}
+}
+
+/// The port as the burst leaves it
+static uint16_t bsp_clcd_mcp23017_port(bsp_clcd_interface_i2c_mcp23017_t *params)
+{
+	if (params->burst_len)
+		return params->burst[params->burst_len - 1];
+	return bsp_i2c_gpio_readOutputs(params->gpio);
+}
+
+static void bsp_clcd_mcp23017_put(bsp_clcd_interface_i2c_mcp23017_t *params, uint16_t out)
+{
+	if (params->burst_len == MCP23017_BURST_MAX)
+		bsp_clcd_mcp23017_flush(params);
+	params->burst[params->burst_len++] = out;
+}
+
+/// Hold the port as it is for at least us
+static void bsp_clcd_mcp23017_pad(bsp_clcd_interface_i2c_mcp23017_t *params, uint32_t us)
+{
+	uint16_t out = bsp_clcd_mcp23017_port(params);
+	
+	for (uint16_t n = bsp_i2c_gpio_burst_pad(params->gpio, us); n; n--)
+		bsp_clcd_mcp23017_put(params, out);
+}
+
 static void bsp_clcd_mcp23017_write4bits(bsp_clcd_interface_i2c_mcp23017_t *params, uint8_t value, uint8_t mode)
 {
 	uint16_t out;
 	
-	// current output
-	out = bsp_i2c_gpio_readOutputs(params->gpio);
+	// output as the burst leaves it
+	out = bsp_clcd_mcp23017_port(params);
 	
 	// get the 4 bit value in value into the output bits
 	 for (int i = 0; i < 4; i++) {
@@ -53,10 +90,10 @@ static void bsp_clcd_mcp23017_write4bits(bsp_clcd_interface_i2c_mcp23017_t *para
 		out &= ~(1 << params->rs);
 	
 	out |= (1 << params->en); 
-	bsp_i2c_gpio_writePort(params->gpio, out);
+	bsp_clcd_mcp23017_put(params, out);
 	
 	out &= ~(1 << params->en);
-	bsp_i2c_gpio_writePort(params->gpio, out);
+	bsp_clcd_mcp23017_put(params, out);
 }
 
 static void bsp_clcd_mcp23017_send(bsp_clcd_interface_i2c_mcp23017_t *params, uint8_t value, uint8_t mode)
@@ -91,6 +128,8 @@ void bsp_clcd_mcp23017_init(void *p)
 	
 	// initialize i2c
 	params->gpio = bsp_i2c_gpio(BSP_I2C_MCP23017, params->i2c_addr);
+	params->burst = malloc(MCP23017_BURST_MAX * sizeof(uint16_t));
+	params->burst_len = 0;
 	
 	// set output pins 
 	bsp_i2c_gpio_pinMode(params->gpio, params->bl, GPIO_DIR_OUTPUT, 1);		// backlight OFF!
@@ -110,14 +149,18 @@ void bsp_clcd_mcp23017_init(void *p)
   #endif
 #endif
 	
-	// set lcd to 4 bit mode
+	// set lcd to 4 bit mode - the 4.1 ms waits are off the bus but must not
+	// come up short, which a one tick OSTimeDly() can
 	bsp_clcd_mcp23017_send(params, 0x03, MCP23017_SEND_FOUR_BITS);
+	bsp_clcd_mcp23017_flush(params);
 	bsp_clcd_delay_us(4500);
 	bsp_clcd_mcp23017_send(params, 0x03, MCP23017_SEND_FOUR_BITS);
+	bsp_clcd_mcp23017_flush(params);
 	bsp_clcd_delay_us(4500);
 	bsp_clcd_mcp23017_send(params, 0x03, MCP23017_SEND_FOUR_BITS);
-	bsp_clcd_delay_us(150);
+	bsp_clcd_mcp23017_pad(params, 150);
 	bsp_clcd_mcp23017_send(params, 0x02, MCP23017_SEND_FOUR_BITS);
+	bsp_clcd_mcp23017_flush(params);
 }
 
 void bsp_clcd_mcp23017_backlight(void *p, bool on_off)
@@ -138,6 +181,11 @@ void bsp_clcd_mcp23017_command(void *p, uint8_t command)
 	bsp_clcd_trace_hex("clcd_mcp23017 command", command);
 #endif
 	bsp_clcd_mcp23017_send(params, command, MCP23017_SEND_COMMAND);
+	
+	// clear and home take 1.52ms
+	if (command < 0x04)
+		bsp_clcd_mcp23017_pad(params, 1600);
+	bsp_clcd_mcp23017_flush(params);
 }
 
 void bsp_clcd_mcp23017_data(void *p, char *data)
@@ -154,6 +202,7 @@ void bsp_clcd_mcp23017_data(void *p, char *data)
 #endif
 	while (*data != '\0')
 		bsp_clcd_mcp23017_send(params, *data++, MCP23017_SEND_DATA);
+	bsp_clcd_mcp23017_flush(params);
 }
 
 
@@ -161,6 +210,7 @@ void bsp_clcd_mcp23017_datab(void *p, uint8_t value)
 {
 	bsp_clcd_interface_i2c_mcp23017_t *params = (bsp_clcd_interface_i2c_mcp23017_t *)p;
 	bsp_clcd_mcp23017_send(params, value, MCP23017_SEND_DATA);
+	bsp_clcd_mcp23017_flush(params);
 }
 
 #endif // CONFIG_BSP_ENABLE_LCD_I2C_PCF8574
\ No newline at end of file
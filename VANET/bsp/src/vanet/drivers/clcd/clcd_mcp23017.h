@@ -26,6 +26,8 @@
 #define MCP23017_SEND_DATA		1
 #define MCP23017_SEND_FOUR_BITS	2		// used to force write just 4 bits!
 
+#define MCP23017_BURST_MAX		64		// port values a burst collects before it goes - 16 characters
+
 typedef struct
 {
 	uint8_t i2c_addr;
@@ -37,6 +39,8 @@ typedef struct
 	uint8_t data[4];
 	
 	bsp_i2c_gpio_t *gpio;
+	uint16_t *burst;		// port values on their way out, with every EN edge
+	uint16_t burst_len;
 } bsp_clcd_interface_i2c_mcp23017_t;
 
 
@@ -29,10 +29,49 @@
 /************************************************************************/
 /* PCF8574 SPECIFIC                                                     */
 /************************************************************************/
+/*
+ *	Nibbles collect as port values in a burst that goes out as one I2C write
+ *	at the end of each call.  Every byte of it takes longer on the bus than
+ *	the HD44780's 37us to execute, so nothing waits between characters; the
+ *	slow commands are followed by enough idle values to cover them.
+ */
+
+static void bsp_clcd_pcf8574_flush(bsp_clcd_interface_i2c_pcf8574_t *params)
+{
+	if (params->burst_len)
+	{
+		bsp_i2c_gpio_writeBurst(params->gpio, params->burst, params->burst_len);
+		params->burst_len = 0;
+	}
+}
+
+/// The port as the burst leaves it
+static uint8_t bsp_clcd_pcf8574_port(bsp_clcd_interface_i2c_pcf8574_t *params)
+{
+	if (params->burst_len)
+		return params->burst[params->burst_len - 1];
+	return bsp_i2c_gpio_readOutputs(params->gpio);
+}
+
+static void bsp_clcd_pcf8574_put(bsp_clcd_interface_i2c_pcf8574_t *params, uint8_t portval)
+{
+	if (params->burst_len == PCF8574_BURST_MAX)
+		bsp_clcd_pcf8574_flush(params);
+	params->burst[params->burst_len++] = portval;
+}
+
+/// Hold the port as it is for at least us
+static void bsp_clcd_pcf8574_pad(bsp_clcd_interface_i2c_pcf8574_t *params, uint32_t us)
+{
+	uint8_t portval = bsp_clcd_pcf8574_port(params);
+	
+	for (uint16_t n = bsp_i2c_gpio_burst_pad(params->gpio, us); n; n--)
+		bsp_clcd_pcf8574_put(params, portval);
+}
 
 static void bsp_clcd_pcf8574_write4bits(bsp_clcd_interface_i2c_pcf8574_t *params, uint8_t value, uint8_t mode)
 {
-	uint8_t portval = bsp_i2c_gpio_readOutputs(params->gpio);
+	uint8_t portval = bsp_clcd_pcf8574_port(params);
 	
 	// move to D7-D4
 	portval &= 0xf;						// clear old data4
@@ -45,10 +84,10 @@ static void bsp_clcd_pcf8574_write4bits(bsp_clcd_interface_i2c_pcf8574_t *params
 		portval &= ~(params->rs);
 
 	portval |= params->en;
-	bsp_i2c_gpio_writePort(params->gpio, portval);
+	bsp_clcd_pcf8574_put(params, portval);
 	
 	portval &= ~(params->en);
-	bsp_i2c_gpio_writePort(params->gpio, portval);
+	bsp_clcd_pcf8574_put(params, portval);
 }
 
 static void bsp_clcd_pcf8574_send(bsp_clcd_interface_i2c_pcf8574_t *params, uint8_t value, uint8_t mode)
@@ -90,6 +129,8 @@ void bsp_clcd_pcf8574_init(void *p)
 
 	// initialize i2c
 	params->gpio = bsp_i2c_gpio(BSP_I2C_PCF8574, params->i2c_addr);
+	params->burst = malloc(PCF8574_BURST_MAX * sizeof(uint16_t));
+	params->burst_len = 0;
 
 	// all outputs low
 	bsp_i2c_gpio_writePort(params->gpio, 0);
@@ -99,14 +140,18 @@ void bsp_clcd_pcf8574_init(void *p)
 	params->en = (1 << params->en);
 	params->rs = (1 << params->rs);
 	
-	// set lcd to 4 bit mode
+	// set lcd to 4 bit mode - the 4.1 ms waits are off the bus but must not
+	// come up short, which a one tick OSTimeDly() can
 	bsp_clcd_pcf8574_send(params, 0x03, PCF8574_SEND_FOUR_BITS);
+	bsp_clcd_pcf8574_flush(params);
 	bsp_clcd_delay_us(4500);
 	bsp_clcd_pcf8574_send(params, 0x03, PCF8574_SEND_FOUR_BITS);
+	bsp_clcd_pcf8574_flush(params);
 	bsp_clcd_delay_us(4500);
 	bsp_clcd_pcf8574_send(params, 0x03, PCF8574_SEND_FOUR_BITS);
-	bsp_clcd_delay_us(150);
+	bsp_clcd_pcf8574_pad(params, 150);
 	bsp_clcd_pcf8574_send(params, 0x02, PCF8574_SEND_FOUR_BITS);
+	bsp_clcd_pcf8574_flush(params);
 }
 
 void bsp_clcd_pcf8574_backlight(void *p, bool on_off)
@@ -131,6 +176,11 @@ void bsp_clcd_pcf8574_command(void *p, uint8_t command)
 	bsp_clcd_trace_hex("pcf8574 command", command);
 #endif
 	bsp_clcd_pcf8574_send(params, command, PCF8574_SEND_COMMAND);
+	
+	// clear and home take 1.52ms
+	if (command < 0x04)
+		bsp_clcd_pcf8574_pad(params, 1600);
+	bsp_clcd_pcf8574_flush(params);
 }
 
 void bsp_clcd_pcf8574_data(void *p, char *data)
@@ -148,6 +198,7 @@ void bsp_clcd_pcf8574_data(void *p, char *data)
 
 	while (*data != '\0')
 		bsp_clcd_pcf8574_send(params, *data++, PCF8574_SEND_DATA);
+	bsp_clcd_pcf8574_flush(params);
 }
 
 void bsp_clcd_pcf8574_datab(void *p, uint8_t value)
@@ -155,6 +206,7 @@ void bsp_clcd_pcf8574_datab(void *p, uint8_t value)
 	bsp_clcd_interface_i2c_pcf8574_t *params = (bsp_clcd_interface_i2c_pcf8574_t *)p;
 	
 	bsp_clcd_pcf8574_send(params, value, PCF8574_SEND_DATA);
+	bsp_clcd_pcf8574_flush(params);
 }
 
 #endif // CONFIG_BSP_ENABLE_LCD_I2C_PCF8574
\ No newline at end of file
@@ -46,6 +46,7 @@ bsp_i2c_gpio_t * bsp_i2c_gpio(bsp_i2c_gpio_type_t type, uint8_t i2c_addr)
 			gpio->writePin = &pcf8574_writePin;
 			gpio->writePort = &pcf8574_writePort;
 			gpio->readOutputs = &pcf8574_readOutputs;
+			gpio->writeBurst = &pcf8574_writeBurst;
 		break;
 		#endif
 		#ifdef CONFIG_BSP_ENABLE_I2C_GPIO_MCP23017
@@ -55,6 +56,7 @@ bsp_i2c_gpio_t * bsp_i2c_gpio(bsp_i2c_gpio_type_t type, uint8_t i2c_addr)
 			gpio->writePin = &mcp23017_writePin;
 			gpio->writePort = &mcp23017_writePort;
 			gpio->readOutputs = &mcp23017_readOutputs;
+			gpio->writeBurst = &mcp23017_writeBurst;
 			break;
 		#endif
 		default:
@@ -74,4 +76,15 @@ bsp_i2c_gpio_t * bsp_i2c_gpio(bsp_i2c_gpio_type_t type, uint8_t i2c_addr)
 	return gpio;
 }
 
+uint16_t bsp_i2c_gpio_burst_pad(bsp_i2c_gpio_t *gpio, uint32_t us)
+{
+	// 9 clocks a byte, and the MCP23017 takes two a value (A then B)
+	uint32_t clocks = (gpio->p.i2c_type == BSP_I2C_MCP23017) ? 18 : 9;
+	uint32_t each = clocks * 1000000UL / bsp_i2c_get_speed(gpio->p.i2c_addr);	// us a value, rounded down
+	
+	if (!each)
+		each = 1;
+	return us / each + 1;
+}
+
 #endif
\ No newline at end of file
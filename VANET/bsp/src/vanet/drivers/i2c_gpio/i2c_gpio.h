@@ -44,6 +44,7 @@ typedef struct
 	uint8_t (*readPin)(bsp_i2c_gpio_private_t *p, uint8_t pin);
 	void (*writePin)(bsp_i2c_gpio_private_t *p, uint8_t pin, uint8_t value);
 	uint16_t (*readOutputs)(bsp_i2c_gpio_private_t *p);
+	void (*writeBurst)(bsp_i2c_gpio_private_t *p, const uint16_t *values, uint16_t count);
 
 	// private info
 	bsp_i2c_gpio_private_t	p;
@@ -76,6 +77,15 @@ static inline uint16_t bsp_i2c_gpio_readOutputs(bsp_i2c_gpio_t *gpio)
 	return gpio->readOutputs(&gpio->p);
 }
 
+/// Write the port count times, back to back in as few transactions as it takes - for strobing things
+static inline void bsp_i2c_gpio_writeBurst(bsp_i2c_gpio_t *gpio, const uint16_t *values, uint16_t count)
+{
+	gpio->writeBurst(&gpio->p, values, count);
+}
+
+/// How many burst values it takes for at least us to go by on the bus
+extern uint16_t bsp_i2c_gpio_burst_pad(bsp_i2c_gpio_t *gpio, uint32_t us);
+
 
 #ifdef CONFIG_BSP_ENABLE_I2C_GPIO_MCP23017
 void mcp23017_init(bsp_i2c_gpio_private_t* p);
@@ -83,6 +93,7 @@ void mcp23017_writePort(bsp_i2c_gpio_private_t *p, uint16_t val);
 void mcp23017_writePin(bsp_i2c_gpio_private_t* p, uint8_t pin, uint8_t val);
 void mcp23017_pinMode(bsp_i2c_gpio_private_t* p, uint8_t pin, uint8_t direction, uint8_t initial_value);
 uint16_t mcp23017_readOutputs(bsp_i2c_gpio_private_t *p);
+void mcp23017_writeBurst(bsp_i2c_gpio_private_t *p, const uint16_t *values, uint16_t count);
 #endif
 
 #ifdef CONFIG_BSP_ENABLE_I2C_GPIO_PCF8574
@@ -91,4 +102,5 @@ void pcf8574_writePort(bsp_i2c_gpio_private_t *p, uint16_t val);
 void pcf8574_writePin(bsp_i2c_gpio_private_t* p, uint8_t pin, uint8_t val);
 void pcf8574_pinMode(bsp_i2c_gpio_private_t* p, uint8_t pin, uint8_t direction, uint8_t initial_value);
 uint16_t pcf8574_readOutputs(bsp_i2c_gpio_private_t *p);
+void pcf8574_writeBurst(bsp_i2c_gpio_private_t *p, const uint16_t *values, uint16_t count);
 #endif
\ No newline at end of file
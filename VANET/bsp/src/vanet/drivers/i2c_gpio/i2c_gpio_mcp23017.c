@@ -44,6 +44,11 @@
 #define MCP23017_GPIOB 0x13
 #define MCP23017_OLATB 0x15
 
+#define MCP23017_IOCON_SEQOP	0x20	// BANK=0: the address toggles between A and B
+
+// port values a burst transaction carries - two bytes each
+#define MCP23017_BURST_CHUNK	16
+
 void mcp23017_init(bsp_i2c_gpio_private_t* p)
 {
 #ifdef CONFIG_BSP_ENABLE_LOGCAT
@@ -58,6 +63,10 @@ void mcp23017_init(bsp_i2c_gpio_private_t* p)
 	p->ddr = 0xffff;			// 1==input!
 	p->data = 0;
 	
+	bsp_i2c_set_speed(p->i2c_addr, BSP_I2C_SPEED_MAX_HZ);
+	
+	// writes to a register pair go A, B, A, B... so a burst is a run of port values
+	bsp_i2c_write_byte(p->i2c_addr, MCP23017_IOCONA, MCP23017_IOCON_SEQOP);
 	bsp_i2c_write_bytes(p->i2c_addr, MCP23017_IODIRA, (uint8_t *)&p->ddr, 2);	// IODIRB is next addr
 }
 
@@ -145,5 +154,26 @@ uint16_t mcp23017_readOutputs(bsp_i2c_gpio_private_t *p)
 	return p->data;
 }
 
+void mcp23017_writeBurst(bsp_i2c_gpio_private_t *p, const uint16_t *values, uint16_t count)
+{
+	uint8_t buf[MCP23017_BURST_CHUNK * 2];
+	uint16_t n;
+	
+	bsp_i2c_trace("mcp23017 writeBurst");
+	
+	while (count)
+	{
+		for (n=0; n < count && n < MCP23017_BURST_CHUNK; n++)
+		{
+			buf[2*n] = values[n] & 0xff;			// low byte is A
+			buf[2*n+1] = values[n] >> 8;			// high byte is B
+		}
+		bsp_i2c_write_bytes(p->i2c_addr, MCP23017_GPIOA, buf, 2*n);
+		p->data = values[n-1];
+		values += n;
+		count -= n;
+	}
+}
+
 
 #endif // CONFIG_BSP_ENBALE_I2C_GPIO_MCP23017
\ No newline at end of file
@@ -21,6 +21,9 @@
 
 #ifdef CONFIG_BSP_ENABLE_I2C_GPIO_PCF8574
 
+// bytes a burst transaction carries - each one is a port write
+#define PCF8574_BURST_CHUNK		32
+
 void pcf8574_init(bsp_i2c_gpio_private_t* p)
 {
 	#ifdef CONFIG_BSP_ENABLE_LOGCAT
@@ -35,6 +38,9 @@ void pcf8574_init(bsp_i2c_gpio_private_t* p)
 	p->ddr = 0xff;				// 1==input!
 	p->data = 0;
 	
+	// as fast as it goes, for bursts
+	bsp_i2c_set_speed(p->i2c_addr, BSP_I2C_SPEED_STANDARD_HZ);
+	
 	bsp_i2c_write_byte_raw(p->i2c_addr, p->ddr & 0xff);
 }
 
@@ -78,4 +84,23 @@ uint16_t pcf8574_readOutputs(bsp_i2c_gpio_private_t *p)
 	return p->data;
 }
 
+void pcf8574_writeBurst(bsp_i2c_gpio_private_t *p, const uint16_t *values, uint16_t count)
+{
+	uint8_t buf[PCF8574_BURST_CHUNK];
+	uint16_t n;
+	
+	bsp_i2c_trace_ul("pcf8574 writeBurst", count);
+	
+	// every byte after the address goes straight out on the port
+	while (count)
+	{
+		for (n=0; n < count && n < sizeof(buf); n++)
+			buf[n] = values[n] & 0xff;
+		bsp_i2c_write_bytes_raw(p->i2c_addr, buf, n);
+		p->data = values[n-1];
+		values += n;
+		count -= n;
+	}
+}
+
 #endif // CONFIG_BSP_ENABLE_I2C_GPIO_PCF8574
\ No newline at end of file
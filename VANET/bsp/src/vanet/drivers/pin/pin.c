@@ -38,16 +38,60 @@ static struct io_pin_config s_io_pin[] = {
 
 struct io_pin_state
 {
-    bool        changed;
+    bool        armed;              // settling - the timer publishes it at deadline
     int8_t      last_state;
-    uint8_t     required_count;
-    uint8_t     current_count;
+    uint32_t    settle;             // cycles it must stay quiet for
+    uint64_t    deadline;           // bsp_rtc_get_cycles()
+    uint64_t    edge;               // bsp_rtc_get_cycles() at the edge that started the change
 };
 
 static struct io_pin_state s_io_pin_states[BSP_PIN_COUNT];
+
+// cycles a timer count takes - a deadline that close is as good as reached
+static uint32_t s_timer_count_cycles;
+
+static void pin_publish(int i, bool active)
+{
+    bsp_pin_event_t data;
+    
+    data.edge_us = bsp_rtc_get_time_us_at(s_io_pin_states[i].edge);
+    bsp_tkvs_publish_immed_with_data(BSP_TKVS_SRC_PIN, s_io_pin[i].event, active, &data, sizeof(data));
+    s_io_pin_states[i].last_state = active;
+}
+
+/// Run the timer to the nearest deadline, or stop it when nothing is settling - interrupts off
+static void pin_timer_arm(uint64_t now)
+{
+    uint64_t next = UINT64_MAX;
+    uint64_t counts = 1;
+    
+    for (int i=0; i<BSP_PIN_COUNT; i++)
+    {
+        if (s_io_pin_states[i].armed && s_io_pin_states[i].deadline < next)
+            next = s_io_pin_states[i].deadline;
+    }
     
+    if (next == UINT64_MAX)
+    {
+        tc_stop(CONFIG_BSP_PIN_TIMER, CONFIG_BSP_PIN_TIMER_CHANNEL);
+        return;
+    }
+    
+    // round up - early would only mean coming round again
+    if (next > now)
+        counts = ((next - now) * BOARD_OSC32_HZ + sysclk_get_cpu_hz() - 1) / sysclk_get_cpu_hz();
+    
+    // further off than the counter goes - it comes round at 2s and looks again
+    tc_write_rc(CONFIG_BSP_PIN_TIMER, CONFIG_BSP_PIN_TIMER_CHANNEL, max(1, min(0xffff, counts)));
+    tc_start(CONFIG_BSP_PIN_TIMER, CONFIG_BSP_PIN_TIMER_CHANNEL);
+}
+
 static void pin_int_handler(void)
 {    
+    // the edge time first - nothing below may move it
+    uint64_t now = bsp_rtc_get_cycles();
+    bool active, rearm = false;
+    
     // check for each pin and send event if changed
     for (int i=0; i<BSP_PIN_COUNT; i++)
     {
@@ -56,53 +100,101 @@ static void pin_int_handler(void)
         {
             gpio_clear_pin_interrupt_flag(s_io_pin[i].pin);
             
-            // reset our pin state
-            s_io_pin_states[i].changed = true;
-            s_io_pin_states[i].current_count = 0;
+            // nothing to debounce (another part's interrupt output) - report it now
+            if (s_io_pin_states[i].settle == 0 && !s_io_pin_states[i].armed)
+            {
+                active = gpio_get_pin_value(s_io_pin[i].pin) == s_io_pin[i].active_level;
+                s_io_pin_states[i].edge = now;
+                pin_publish(i, active);
+                continue;
+            }
+            
+            // the first edge is when it changed - the bounces after it only push the deadline out
+            if (!s_io_pin_states[i].armed)
+                s_io_pin_states[i].edge = now;
+            s_io_pin_states[i].armed = true;
+            s_io_pin_states[i].deadline = now + s_io_pin_states[i].settle;
+            rearm = true;
         }
     }
+    
+    if (rearm)
+        pin_timer_arm(now);
 }
 
-void bsp_pin_check(void)
+static void pin_timer_handler(void)
 {
+    uint64_t now = bsp_rtc_get_cycles();
     bool active;
     
+    // clear the interrupt flag by reading the status register
+    tc_read_sr(CONFIG_BSP_PIN_TIMER, CONFIG_BSP_PIN_TIMER_CHANNEL);
+    
     for (int i=0; i<BSP_PIN_COUNT; i++)
     {
-        if (s_io_pin_states[i].changed)
+        if (s_io_pin_states[i].armed && s_io_pin_states[i].deadline <= now + s_timer_count_cycles)
         {
-            ++s_io_pin_states[i].current_count;
-            if (s_io_pin_states[i].current_count > s_io_pin_states[i].required_count)
-            {
-                s_io_pin_states[i].changed = false;
-                
-                // publish!
-                if (gpio_get_pin_value(s_io_pin[i].pin) == s_io_pin[i].active_level)
-                    active = true;
-                else
-                    active = false;
-                    
-                //DBG if (s_io_pin_states[i].last_state != active)
-                {
-                    bsp_logcat_printf(BSP_LOGCAT_DEBUG, "PIN: %04x = %d", s_io_pin[i].event, active);
-                    bsp_tkvs_publish_immed(BSP_TKVS_SRC_PIN, s_io_pin[i].event, active);
-                    s_io_pin_states[i].last_state = active;
-                }
-                //DBG else
-                //DBG {
-                //DBG     bsp_logcat_printf(BSP_LOGCAT_DEBUG, "PIN: %04x Glitched - Ignoring", s_io_pin[i].event);
-                //DBG }
-            }
+            s_io_pin_states[i].armed = false;
+            
+            // publish!
+            active = gpio_get_pin_value(s_io_pin[i].pin) == s_io_pin[i].active_level;
+            if (s_io_pin_states[i].settle)
+                bsp_logcat_printf(BSP_LOGCAT_DEBUG, "PIN: %04x = %d", s_io_pin[i].event, active);
+            pin_publish(i, active);
         }
     }
+    
+    pin_timer_arm(now);
+}
+
+static void pin_timer_init(void)
+{
+    // Waveform generation options - a one shot, for the nearest deadline
+    tc_waveform_opt_t waveform_opt =
+    {
+        .channel  = CONFIG_BSP_PIN_TIMER_CHANNEL,
+        .wavsel   = TC_WAVEFORM_SEL_UP_MODE_RC_TRIGGER,     // Count up, reset when counter hits RC
+        .tcclks   = TC_CLOCK_SOURCE_TC1,                    // Internal source clock 1 = OSC32K
+        .aswtrg   = TC_EVT_EFFECT_NOOP,
+        .aeevt    = TC_EVT_EFFECT_NOOP,
+        .acpc     = TC_EVT_EFFECT_NOOP,
+        .acpa     = TC_EVT_EFFECT_NOOP,
+        .bswtrg   = TC_EVT_EFFECT_NOOP,
+        .beevt    = TC_EVT_EFFECT_NOOP,
+        .bcpc     = TC_EVT_EFFECT_NOOP,
+        .bcpb     = TC_EVT_EFFECT_NOOP,
+        .enetrg   = false,                                  // No external trigger
+        .eevt     = TC_EXT_EVENT_SEL_XC0_OUTPUT,            // No external trigger
+        .eevtedg  = TC_SEL_NO_EDGE,                         // No external trigger
+        .cpcdis   = false,                                  // Do not disable counter when it hits RC
+        .cpcstop  = true,                                   // Stop counter when it hits RC
+        .burst    = TC_BURST_NOT_GATED,                     // No burst clock
+        .clki     = TC_CLOCK_RISING_EDGE,                   // No clock inversion
+    };
+    
+    // Timer interrupt options
+    tc_interrupt_t tc_interrupt = { 0 };
+    tc_interrupt.cpcs = 1; // interrupt on RC compare
+    
+    s_timer_count_cycles = sysclk_get_cpu_hz() / BOARD_OSC32_HZ;
+    
+    sysclk_enable_peripheral_clock(CONFIG_BSP_PIN_TIMER);
+    tc_init_waveform(CONFIG_BSP_PIN_TIMER, &waveform_opt);
+    tc_configure_interrupts(CONFIG_BSP_PIN_TIMER, CONFIG_BSP_PIN_TIMER_CHANNEL, &tc_interrupt);
+    INTC_register_interrupt(&pin_timer_handler, CONFIG_BSP_PIN_TIMER_IRQ, CONFIG_BSP_PIN_IRQ_PRI);
 }
 
 void bsp_pin_init(void)
 {
+    irqflags_t flags;
+    uint64_t now;
+    
+    pin_timer_init();
+    
     // initialize all pins used as buttons and attach the keypad ISR to them
     for (int i=0; i<BSP_PIN_COUNT; i++)
     {
-        INTC_register_GPIO_interrupt(&pin_int_handler, s_io_pin[i].pin);
+        INTC_register_GPIO_interrupt(&pin_int_handler, s_io_pin[i].pin, CONFIG_BSP_PIN_IRQ_PRI);
         gpio_enable_gpio_pin(s_io_pin[i].pin);
         gpio_enable_pin_glitch_filter(s_io_pin[i].pin);
         if (s_io_pin[i].enable_pull_up_down)
@@ -112,35 +204,40 @@ void bsp_pin_init(void)
             else
                 gpio_enable_pin_pull_up(s_io_pin[i].pin);
         }
-        gpio_enable_pin_interrupt(s_io_pin[i].pin, GPIO_PIN_CHANGE);
         
-        // set pin state
-        s_io_pin_states[i].changed = true;      // force the initial state to be published
-        s_io_pin_states[i].current_count = 0;
+        // convert ms to cycles
+        s_io_pin_states[i].settle = (uint64_t) s_io_pin[i].active_time * sysclk_get_cpu_hz() / 1000;
         s_io_pin_states[i].last_state = -1;     // impossible last state
-        // convert ms to ticks
-        s_io_pin_states[i].required_count = s_io_pin[i].active_time * CONFIG_BSP_RTC_TICK_HZ / 1000;
     }
-	
-	// register my idle function
-	bsp_idle_register_idle_function(bsp_pin_check, BSP_IDLE_ONCE_PER_TICK);
+    
+    // force the initial states to be published, once they've settled
+    flags = cpu_irq_save();
+    now = bsp_rtc_get_cycles();
+    for (int i=0; i<BSP_PIN_COUNT; i++)
+    {
+        s_io_pin_states[i].armed = true;
+        s_io_pin_states[i].edge = now;
+        s_io_pin_states[i].deadline = now + s_io_pin_states[i].settle;
+        gpio_enable_pin_interrupt(s_io_pin[i].pin, GPIO_PIN_CHANGE);
+    }
+    pin_timer_arm(now);
+    cpu_irq_restore(flags);
 }
 
 
 void bsp_pin_read(enum bsp_pin_events event)
 {
-    // for the pin requested send event with current state
+    irqflags_t flags;
+    
+    // for the pin requested send event with current state - and the edge it came from
+    flags = cpu_irq_save();
     for (int i=0; i<BSP_PIN_COUNT; i++)
     {
-        // changed == false makes us only report the debounced state!
-        if (event == s_io_pin[i].event && s_io_pin_states[i].changed == false)
-        {
-            if (gpio_get_pin_value(s_io_pin[i].pin) == s_io_pin[i].active_level)
-                bsp_tkvs_publish_immed(BSP_TKVS_SRC_PIN, s_io_pin[i].event, 1);
-            else
-                bsp_tkvs_publish_immed(BSP_TKVS_SRC_PIN, s_io_pin[i].event, 0);
-        }
+        // armed == false makes us only report the debounced state!
+        if (event == s_io_pin[i].event && s_io_pin_states[i].armed == false)
+            pin_publish(i, gpio_get_pin_value(s_io_pin[i].pin) == s_io_pin[i].active_level);
     }
+    cpu_irq_restore(flags);
 }
 
 #endif // CONFIG_BSP_ENABLE_PIN
\ No newline at end of file
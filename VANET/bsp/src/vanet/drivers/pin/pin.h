@@ -27,18 +27,26 @@
  *
  * Driver reports changes to I/O pins as events
  *
+ * A change is published once the pin has been quiet for its active time,
+ * timed from the last edge by a one-shot timer; pins with no active time are
+ * published from the interrupt.  The event's immed_data is the level (1 is
+ * active) and its data a bsp_pin_event_t.
+ *
  * @{
  */
 
+/// Pin event data - msg->data isn't aligned for it, so memcpy it out
+typedef struct
+{
+    uint64_t    edge_us;        ///< bsp_rtc_get_time_us() at the edge that started the change
+} bsp_pin_event_t;
+
 /// Initialize PIN Driver
 void bsp_pin_init(void);
 
 /// Read current PIN event state - Generates the TKVS Pin Event Again
 void bsp_pin_read(enum bsp_pin_events event);
 
-/// Generate Pin Events
-void bsp_pin_check(void);
-
 /// @}
 
 #endif // CONFIG_BSP_ENABLE_PIN
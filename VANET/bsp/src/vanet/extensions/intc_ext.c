@@ -100,7 +100,18 @@ BSP_INT_ATTR static void gpio_15_handler(void)
     gpio_interrupt_jump_handler(3, 0xff000000);
 }
 
-bool INTC_register_GPIO_interrupt(bsp_gpio_handler handler, uint32_t pin)
+static const __int_handler s_gpio_line_handlers[] =
+{
+    gpio_0_handler,  gpio_1_handler,  gpio_2_handler,  gpio_3_handler,
+    gpio_4_handler,  gpio_5_handler,  gpio_6_handler,  gpio_7_handler,
+    gpio_8_handler,  gpio_9_handler,  gpio_10_handler, gpio_11_handler,
+    gpio_12_handler, gpio_13_handler, gpio_14_handler, gpio_15_handler,
+};
+
+// the level each GPIO line is registered at, + 1 (0 is not registered)
+static uint8_t          s_gpio_line_level[sizeof(s_gpio_line_handlers) / sizeof(s_gpio_line_handlers[0])];
+
+bool INTC_register_GPIO_interrupt(bsp_gpio_handler handler, uint32_t pin, uint32_t int_level)
 {
     uint32_t irq;               // actual INTC IRQ number for the GPIO
     uint32_t ifr_bitmask;       // bitmask of the GPIO in the GPIO[port]->ifr register
@@ -112,71 +123,25 @@ bool INTC_register_GPIO_interrupt(bsp_gpio_handler handler, uint32_t pin)
     port = pin >> 5;
     ifr_bitmask = 1 << (pin & 0x1f);
     
-	/*
-    print_dbg("Register GPIO: ");
-    print_dbg_int(irq); 
-    print_dbg(" ");
-    print_dbg_int(port);
-    print_dbg(" ");
-    print_dbg_hex(ifr_bitmask);
-    print_dbg("\r\n");
-	*/
+    if (offset >= sizeof(s_gpio_line_handlers) / sizeof(s_gpio_line_handlers[0]))
+    {
+        print_dbg("Unsupported GPIO Signal Map ");
+        print_dbg_int(offset);
+        print_dbg("\r\n");
+        return false;
+    }
     
-    switch (offset)
+    // the 8 pins of a block share a line, and so a level - the highest asked for wins
+    if (s_gpio_line_level[offset] && s_gpio_line_level[offset] != int_level + 1)
+    {
+        print_dbg("GPIO Signal Map ");
+        print_dbg_int(offset);
+        print_dbg(" registered at two levels\r\n");
+    }
+    if (s_gpio_line_level[offset] < int_level + 1)
     {
-	    case 0:
-			INTC_register_interrupt(gpio_0_handler, irq, AVR32_INTC_INT0);
-			break;
-        case 1:
-            INTC_register_interrupt(gpio_1_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 2:
-            INTC_register_interrupt(gpio_2_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 3:
-            INTC_register_interrupt(gpio_3_handler, irq, AVR32_INTC_INT0);
-            break;
-		case 4:
-            INTC_register_interrupt(gpio_4_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 5:
-            INTC_register_interrupt(gpio_5_handler, irq, AVR32_INTC_INT0);
-            break;
-		case 6:
-			INTC_register_interrupt(gpio_6_handler, irq, AVR32_INTC_INT0);
-			break;
-		case 7:
-			INTC_register_interrupt(gpio_7_handler, irq, AVR32_INTC_INT0);
-			break;
-		case 8:
-			INTC_register_interrupt(gpio_8_handler, irq, AVR32_INTC_INT0);
-			break;								
-        case 9:
-            INTC_register_interrupt(gpio_9_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 10:
-            INTC_register_interrupt(gpio_10_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 11:
-            INTC_register_interrupt(gpio_11_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 12:
-            INTC_register_interrupt(gpio_12_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 13:
-            INTC_register_interrupt(gpio_13_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 14:
-            INTC_register_interrupt(gpio_14_handler, irq, AVR32_INTC_INT0);
-            break;
-        case 15:
-            INTC_register_interrupt(gpio_15_handler, irq, AVR32_INTC_INT0);
-            break;
-        default:
-            print_dbg("Unsupported GPIO Signal Map ");
-            print_dbg_int(offset);
-            print_dbg("\r\n");
-            break;
+        s_gpio_line_level[offset] = int_level + 1;
+        INTC_register_interrupt(s_gpio_line_handlers[offset], irq, int_level);
     }
     
     s_gpio_irq_info[s_gpio_irq_cnt].handler = handler;
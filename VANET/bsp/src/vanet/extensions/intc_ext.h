@@ -39,6 +39,9 @@ typedef void (*bsp_gpio_handler)(void);
  *
  * @param   handler - Your handler for this GPIO pin
  * @param   pin     - GPIO pin you are registering a handler on
+ * @param   int_level - AVR32_INTC_INTn to run it at.  The 8 pins of a GPIO
+ *                    signal map block share a line, which runs at the highest
+ *                    level any of them asked for
  * @retval            true if registered OK
  * @retval            false if no room to register
  *
@@ -47,7 +50,36 @@ typedef void (*bsp_gpio_handler)(void);
  *
  * @warning     Your interrupt handlers should NOT use %__attribute__((__interrupt__))
  */
-bool INTC_register_GPIO_interrupt(bsp_gpio_handler handler, uint32_t pin);
+bool INTC_register_GPIO_interrupt(bsp_gpio_handler handler, uint32_t pin, uint32_t int_level);
+
+/// The SR mask bits for the interrupt levels at or below CONFIG_BSP_INTC_SHARED_LEVEL
+#define BSP_INTC_SHARED_MASK    (((1UL << (CONFIG_BSP_INTC_SHARED_LEVEL + 1)) - 1) << AVR32_SR_I0M_OFFSET)
+
+/**
+ * Mask the interrupt levels that share data with the tasks
+ *
+ * For short critical sections on what the tasks and the lower level handlers
+ * share (buffers, circular buffers).  Unlike cpu_irq_save() the levels above
+ * CONFIG_BSP_INTC_SHARED_LEVEL keep running, so the time pulse capture isn't
+ * held off.  The whole SR is saved, so it nests - in a handler, or inside
+ * cpu_irq_save() - and bsp_intc_shared_restore() puts back exactly what was.
+ *
+ * @return  The SR to pass to bsp_intc_shared_restore()
+ */
+static inline irqflags_t bsp_intc_shared_save(void)
+{
+    irqflags_t flags = sysreg_read(AVR32_SR);
+    
+    sysreg_write(AVR32_SR, flags | BSP_INTC_SHARED_MASK);
+    barrier();
+    return flags;
+}
+
+/// Undo bsp_intc_shared_save()
+static inline void bsp_intc_shared_restore(irqflags_t flags)
+{
+    cpu_irq_restore(flags);
+}
 
 /// @}
 
@@ -42,7 +42,7 @@ enum sleep_subsystems {
     SYS_DEFAULT = 0x01,     ///< Default Sleep Mode of Device
     SYS_DBG_CONS = 0x02,    ///< Sleep Mode When Debug Console is Used
     SYS_BUZZER = 0x04,      ///< Buzzer vote
-    SYS_UNUSED08 = 0x08,    ///< Unused #2
+    SYS_REPLAY = 0x08,      ///< Termios replay (accelerated)
     SYS_UNUSED10 = 0x10,    ///< Unused #3
     SYS_UNUSED20 = 0x20,    ///< Unused #4
     SYS_UNUSED40 = 0x40,    ///< Unused #5
@@ -155,7 +155,8 @@ void* bsp_malloc(size_t bytes)
     if (bytes == 0) bsp_reset(BSP_RESET_ALLOC_NULL);
     //print_dbg("malloc "); print_dbg_ulong(bytes); print_dbg("\r\n");
 
-    flags = cpu_irq_save();
+    // the pools are walked with only the levels that allocate masked, so the time pulse capture isn't held off
+    flags = bsp_intc_shared_save();
     for (int i=0; i<CONFIG_BSP_BUFFERS_NUM_POOLS && buf == 0; i++)
     {
         pool_t* pool = &s_pools[i];
@@ -199,12 +200,12 @@ void* bsp_malloc(size_t bytes)
             }
         }
     }
-    cpu_irq_restore(flags);
+    bsp_intc_shared_restore(flags);
     
     if (buf == 0)
     {
         print_dbg("malloc failed "); print_dbg_int(bytes); print_dbg("\r\n");
-        bsp_logcat_printf(BSP_LOGCAT_CRITICAL, "malloc failed %d", bytes);
+        bsp_logcat_print(BSP_LOGCAT_CRITICAL, "malloc failed");      // printf would allocate, and fail again
         bsp_reset(BSP_RESET_ALLOC_FAIL);
     }
     return buf;
@@ -237,10 +238,10 @@ void bsp_free(void* ptr)
     }
     #endif
     
-    flags = cpu_irq_save();
+    flags = bsp_intc_shared_save();
     hdr->used = 0;
     pool->frees++;
-    cpu_irq_restore(flags);
+    bsp_intc_shared_restore(flags);
 }
 
 void bsp_buffer_dump(uint8_t port)
@@ -22,6 +22,29 @@
 
 #ifdef CONFIG_BSP_ENABLE_CODEPLUG
 
+/*
+ * The codeplug lives in a journal in main flash: two banks of
+ * BSP_CP_BANK_PAGES pages, each a run of records.  A record is a whole
+ * codeplug image with a sequence number and its checksum, and a commit
+ * programs the next erased record - one page program, never an erase of a
+ * page holding the current image.  When a bank is full the other bank is
+ * erased and written from its start, so every page is erased once per
+ * 2 * records per bank commits.  At power up the valid record with the
+ * highest sequence number is the codeplug; a commit that didn't finish
+ * fails its checksum and the one before it is still there.
+ *
+ * The user page holds the old single copy codeplug.  It is migrated into
+ * the journal when the journal is empty, and is the target of "cp backup"
+ * and the source of "cp restore" after that.
+ *
+ * A chip erase takes the journal with it but not the user page, and
+ * refreshing the user page on every commit would bring back the erase per
+ * commit the journal is there to avoid.  So deploy/program.bat reads the
+ * journal out before it programs and writes it back after - only
+ * deploy/factory.bat leaves a part with the user page codeplug or the
+ * defaults.
+ */
+
 __attribute__((__section__(".userpage")))
 codeplug_t g_codeplug;
 
@@ -31,8 +54,156 @@ static const volatile uint16_t s_cp_xsum;
 bsp_codeplug_t *p_bsp_codeplug;
 extern const bsp_codeplug_t bsp_defaults;
 
-/// temporary storage to hold factory codeplug when we update defaults
-bsp_factory_codeplug_t non_volatile;
+/// A journal record
+typedef struct
+{
+	uint32_t	seq;							///< Commit number - erased flash (0xffffffff) is no record
+	uint32_t	seq_inv;						///< ~seq
+	uint16_t	size;							///< sizeof(codeplug_t) when it was written
+	uint16_t	xsum;							///< bsp_util_fletcher16() of image
+	uint8_t		image[sizeof(codeplug_t)];		///< The codeplug
+} cp_record_t;
+
+/// Records are double word aligned and never cross a page
+#define CP_RECORD_SIZE				((sizeof(cp_record_t) + 7) & ~7)
+#define CP_RECORDS_PER_PAGE			(AVR32_FLASHC_PAGE_SIZE / CP_RECORD_SIZE)
+#define CP_RECORDS_PER_BANK			(BSP_CP_BANK_PAGES * CP_RECORDS_PER_PAGE)
+
+/// A codeplug grown past a page leaves no records per page - fails to compile here
+typedef char cp_record_fits_a_page[(CP_RECORD_SIZE <= AVR32_FLASHC_PAGE_SIZE) ? 1 : -1];
+
+/// The current record, NULL if the journal has none
+static const cp_record_t* s_cp_current;
+static uint8_t s_cp_bank;
+static uint8_t s_cp_record;
+
+/// The next record, built up by bsp_cp_write() between bsp_cp_begin() and bsp_cp_commit()
+static cp_record_t s_cp_stage;
+static uint8_t s_cp_depth;
+static bool s_cp_dirty;
+
+static const cp_record_t* cp_record(int bank, int record)
+{
+	return (const cp_record_t*)(BSP_CP_JOURNAL_ADDRESS + bank * BSP_CP_BANK_SIZE +
+		(record / CP_RECORDS_PER_PAGE) * AVR32_FLASHC_PAGE_SIZE + (record % CP_RECORDS_PER_PAGE) * CP_RECORD_SIZE);
+}
+
+static bool cp_record_valid(const cp_record_t* rec)
+{
+	return rec->seq != 0xffffffff && rec->seq_inv == ~rec->seq && rec->size == sizeof(codeplug_t) &&
+		bsp_util_fletcher16(rec->image, sizeof(codeplug_t)) == rec->xsum;
+}
+
+static bool cp_record_erased(const cp_record_t* rec)
+{
+	const uint8_t* p = (const uint8_t*)rec;
+	
+	for (int i=0; i<sizeof(cp_record_t); i++)
+	{
+		if (p[i] != 0xff) return false;
+	}
+	return true;
+}
+
+/// Find the current record
+static void cp_journal_scan(void)
+{
+	const cp_record_t* rec;
+	
+	s_cp_current = NULL;
+	for (int bank=0; bank<2; bank++)
+	{
+		for (int record=0; record<CP_RECORDS_PER_BANK; record++)
+		{
+			rec = cp_record(bank, record);
+			if (cp_record_valid(rec) && (s_cp_current == NULL || rec->seq > s_cp_current->seq))
+			{
+				s_cp_current = rec;
+				s_cp_bank = bank;
+				s_cp_record = record;
+			}
+		}
+	}
+}
+
+/// Program s_cp_stage into the journal.  Returns the record, or NULL if flash is failing
+static const cp_record_t* cp_journal_append(void)
+{
+	const cp_record_t* rec;
+	int bank, record;
+	bool switched = false;
+	
+	// start from the current record - a new journal starts by erasing bank 0
+	if (s_cp_current)
+	{
+		bank = s_cp_bank;
+		record = s_cp_record;
+	}
+	else
+	{
+		bank = 1;
+		record = CP_RECORDS_PER_BANK - 1;
+	}
+	
+	// a record that doesn't read back is skipped, it fails its checksum
+	for (int tries=0; tries<CP_RECORDS_PER_BANK * 2; tries++)
+	{
+		// the next erased record, in this bank or at the start of the other one
+		do
+		{
+			record++;
+		} while (record < CP_RECORDS_PER_BANK && !cp_record_erased(cp_record(bank, record)));
+		
+		if (record == CP_RECORDS_PER_BANK)
+		{
+			// the other bank used up too - going back would erase the current record
+			if (switched)
+				break;
+			switched = true;
+			bank ^= 1;
+			record = 0;
+			flashc_memset8((void *)cp_record(bank, 0), 0xff, BSP_CP_BANK_SIZE, true);
+		}
+		
+		rec = cp_record(bank, record);
+		flashc_memcpy((void *)rec, &s_cp_stage, sizeof(cp_record_t), false);
+		if (!memcmp(rec, &s_cp_stage, sizeof(cp_record_t)))
+		{
+			s_cp_bank = bank;
+			s_cp_record = record;
+			return rec;
+		}
+	}
+	
+	return NULL;
+}
+
+/// Change bytes of the staged image, keeping its checksum
+static void cp_stage(int offset, const void* src, size_t size)
+{
+	if (memcmp(s_cp_stage.image + offset, src, size))
+	{
+		s_cp_stage.xsum = bsp_util_fletcher16_update(s_cp_stage.xsum, sizeof(codeplug_t), offset,
+			s_cp_stage.image + offset, src, size);
+		memcpy(s_cp_stage.image + offset, src, size);
+		s_cp_dirty = true;
+	}
+}
+
+/// Start a transaction on an image other than the current one - the commit is forced
+static void cp_begin_from(const void* image)
+{
+	bsp_cp_begin();
+	cp_stage(0, image, sizeof(codeplug_t));
+	s_cp_dirty = true;
+}
+
+/// The user page codeplug's signature and checksum are good
+static bool cp_user_page_valid(void)
+{
+	return g_codeplug.bsp_codeplug.cp_signature == BSP_CP_SIGNATURE &&
+		bsp_util_fletcher16((const uint8_t*)&g_codeplug, sizeof(g_codeplug)) == s_cp_xsum;
+}
 
 static void update_checksum(void)
 {
@@ -40,26 +211,32 @@ static void update_checksum(void)
 	flashc_memcpy((void *)&s_cp_xsum,&xsum,2,true);
 }
 
-static void backup_codeplug(void)
+static bool backup_codeplug(void)
 {
-	// TODO
+	if (!bsp_cp_valid())
+		return false;
+	
+	flashc_memcpy((void *)&g_codeplug, s_cp_current->image, sizeof(codeplug_t), true);
+	update_checksum();
+	return cp_user_page_valid();
 }
 
-static void restore_codeplug(void)
+static bool restore_codeplug(void)
 {
 	// check backup codeplug
+	if (!cp_user_page_valid())
+		return false;
 	
 	// restore backup codeplug
-	
-	// correct the checksum
-	update_checksum();
+	cp_begin_from(&g_codeplug);
+	return bsp_cp_commit();
 }
 
 static void init_codeplug_from_defaults(void)
 {
-	bsp_cp_write((void *)&g_codeplug.bsp_codeplug, (void *)&bsp_defaults, sizeof(bsp_codeplug_t));
-	//bsp_cp_write((void *)&g_codeplug.user_codeplug, (void *)appinfo_defaults(), sizeof(user_codeplug_t));
-	update_checksum(); // force this in case it wasn't done before
+	cp_begin_from(&bsp_defaults);
+	//cp_stage(STRUCT_OFFSET(codeplug_t, user_codeplug), appinfo_defaults(), sizeof(user_codeplug_t));
+	bsp_cp_commit();
 }
 
 bool bsp_cp_verify(void)
@@ -67,26 +244,35 @@ bool bsp_cp_verify(void)
 	// flag an invalid codeplug unless we find a valid one
 	p_bsp_codeplug = NULL;
 	
-	// verify codeplug signature
-	if (g_codeplug.bsp_codeplug.cp_signature == BSP_CP_SIGNATURE)
+	cp_journal_scan();
+	if (s_cp_current == NULL)
 	{
-		// Verify the checksum
-		uint16_t xsum;
-		xsum = bsp_util_fletcher16((const uint8_t*)&g_codeplug, sizeof(g_codeplug));
-		if (xsum == s_cp_xsum)
+		// nothing in the journal - take the user page codeplug the first time
+		if (cp_user_page_valid())
 		{
-			p_bsp_codeplug = &g_codeplug.bsp_codeplug;
-			//p_user_codeplug = &g_codeplug.user_codeplug;
+			print_dbg("Codeplug moved to journal\r\n");
+			cp_begin_from(&g_codeplug);
+			bsp_cp_commit();
 		}
 		else
 		{
-			print_dbg("Checksum Error");
+			print_dbg("Journal empty\r\n");
 		}
 	}
-	else
+	
+	if (s_cp_current)
 	{
-		print_dbg("Signature Error ");
-		print_dbg_hex(g_codeplug.bsp_codeplug.cp_signature);
+		if (((const codeplug_t*)s_cp_current->image)->bsp_codeplug.cp_signature == BSP_CP_SIGNATURE)
+		{
+			p_bsp_codeplug = &((const codeplug_t*)s_cp_current->image)->bsp_codeplug;
+			//p_user_codeplug = &((const codeplug_t*)s_cp_current->image)->user_codeplug;
+		}
+		else
+		{
+			print_dbg("Signature Error ");
+			print_dbg_hex(((const codeplug_t*)s_cp_current->image)->bsp_codeplug.cp_signature);
+			s_cp_current = NULL;
+		}
 	}
 	
 	if (p_bsp_codeplug == NULL)     // codeplug was bad
@@ -103,29 +289,78 @@ bool bsp_cp_verify(void)
 	return bsp_cp_valid();
 }
 
-void bsp_cp_write(void* dst, const void* src, size_t size)
+void bsp_cp_begin(void)
 {
-	// allow directed writes to user page - writes via macros when codeplug is bad will not happen
-	if (bsp_util_address_in_user_page(dst))
+	if (s_cp_depth++ == 0)
 	{
-		if (memcmp(dst,src,size))
+		if (s_cp_current)
 		{
-			flashc_memcpy(dst,src,size,true);
-			update_checksum();
+			memcpy(&s_cp_stage, s_cp_current, sizeof(cp_record_t));
 		}
+		else
+		{
+			// only a forced commit (cp nuke / defaults / restore) gets out of here
+			memset(&s_cp_stage, 0xff, sizeof(cp_record_t));
+			s_cp_stage.xsum = bsp_util_fletcher16(s_cp_stage.image, sizeof(codeplug_t));
+		}
+		s_cp_dirty = false;
+	}
+}
+
+bool bsp_cp_commit(void)
+{
+	const cp_record_t* rec;
+	
+	if (s_cp_depth == 0 || --s_cp_depth > 0 || !s_cp_dirty)
+		return true;
+	
+	s_cp_stage.seq = s_cp_current ? s_cp_current->seq + 1 : 1;
+	s_cp_stage.seq_inv = ~s_cp_stage.seq;
+	s_cp_stage.size = sizeof(codeplug_t);
+	
+	rec = cp_journal_append();
+	if (rec == NULL)
+	{
+		print_dbg("Codeplug commit failed\r\n");
+		return false;
 	}
+	
+	// the new image takes effect here - readers of the old one see the old one whole
+	s_cp_current = rec;
+	p_bsp_codeplug = &((const codeplug_t*)rec->image)->bsp_codeplug;
+	s_cp_dirty = false;
+	return true;
+}
+
+void bsp_cp_abort(void)
+{
+	s_cp_depth = 0;
+	s_cp_dirty = false;
+}
+
+void bsp_cp_write(void* dst, const void* src, size_t size)
+{
+	int offset = (const uint8_t*)dst - (const uint8_t*)p_bsp_codeplug;
+	
+	// writes via macros when codeplug is bad will not happen
+	if (!bsp_cp_valid() || offset < 0 || offset + size > sizeof(codeplug_t))
+		return;
+	
+	bsp_cp_begin();
+	cp_stage(offset, src, size);
+	bsp_cp_commit();
 }
 
 bool bsp_cp_valid(void)
 {
-	return (p_bsp_codeplug == &g_codeplug.bsp_codeplug);
+	return (s_cp_current != NULL);
 }
 
 bool bsp_cp_verify_version()
 {
 	if ( bsp_cp_valid() &&
-		(g_codeplug.bsp_codeplug.factory.factory_version == bsp_defaults.factory.factory_version) &&
-		(g_codeplug.bsp_codeplug.defaults_version == bsp_defaults.defaults_version)
+		(p_bsp_codeplug->factory.factory_version == bsp_defaults.factory.factory_version) &&
+		(p_bsp_codeplug->defaults_version == bsp_defaults.defaults_version)
 		)
 	{
 		return true;
@@ -153,15 +388,19 @@ static void cp_handler(int argc, char** argv, uint8_t port)
 	uint8_t         *p_cp;
 	bool			partial_match = false;
 	char			factory_name[32];
+	bsp_codeplug_t	*p_found;
 	
 	if (!strcasecmp(argv[1],"backup"))
 	{
-		backup_codeplug();
+		if (!backup_codeplug())
+			bsp_termios_write_str(port, "Codeplug backup failed\r\n");
 	}
 	else if (!strcasecmp(argv[1],"restore"))
 	{
-		restore_codeplug();
-		reboot = true;
+		if (restore_codeplug())
+			reboot = true;
+		else
+			bsp_termios_write_str(port, "No valid codeplug backup\r\n");
 	}
 	else if (!strcasecmp(argv[1], "nuke"))
 	{
@@ -172,20 +411,10 @@ static void cp_handler(int argc, char** argv, uint8_t port)
 	{
 		if (bsp_cp_valid())
 		{
-			// make a copy of the stuff we want to save!
-			memcpy((uint8_t *)&non_volatile, &g_codeplug, sizeof(bsp_factory_codeplug_t));
-			//print_dbg_array((uint8_t *)&non_volatile, sizeof(bsp_factory_codeplug_t));
-			
-			// write new data from current build
-			init_codeplug_from_defaults();
-			//print_dbg_array((uint8_t *)&g_codeplug, sizeof(bsp_factory_codeplug_t));
-			
-			// overwrite the saved data
-			bsp_cp_write((void *)&g_codeplug.bsp_codeplug, (void *)&non_volatile, sizeof(bsp_factory_codeplug_t));
-			//print_dbg_array((uint8_t *)&g_codeplug, sizeof(bsp_factory_codeplug_t));
-			
-			// and mark it good!
-			update_checksum();
+			// new data from current build, keeping the factory data - one commit
+			cp_begin_from(&bsp_defaults);
+			cp_stage(0, &p_bsp_codeplug->factory, sizeof(bsp_factory_codeplug_t));
+			bsp_cp_commit();
 			reboot = true;
 		}
 		else
@@ -205,10 +434,17 @@ static void cp_handler(int argc, char** argv, uint8_t port)
 		else
 			bsp_termios_write_str(port, "Codeplug Version Mismatch!\r\n");
 		
+		// an invalid codeplug shows what the backup has
+		p_found = bsp_cp_valid() ? p_bsp_codeplug : &g_codeplug.bsp_codeplug;
 		bsp_termios_printf(port, "  Factory Version: Found %d Expected %d\r\n", 
-			g_codeplug.bsp_codeplug.factory.factory_version, bsp_defaults.factory.factory_version);
+			p_found->factory.factory_version, bsp_defaults.factory.factory_version);
 		bsp_termios_printf(port, "  Default Version: Found %d Expected %d\r\n",
-			g_codeplug.bsp_codeplug.defaults_version, bsp_defaults.defaults_version);
+			p_found->defaults_version, bsp_defaults.defaults_version);
+		
+		if (bsp_cp_valid())
+			bsp_termios_printf(port, "  Journal: Bank %d Record %d of %d Commit %u\r\n",
+				s_cp_bank, s_cp_record, CP_RECORDS_PER_BANK, s_cp_current->seq);
+		bsp_termios_printf(port, "  Backup: %s\r\n", cp_user_page_valid() ? "Valid" : "None");
 		
 		if (argc == 3 && !strncasecmp(argv[2], "verbose", 1))
 		{
@@ -329,7 +565,7 @@ static bsp_sti_command_t cp_command =
 	.maxArgs = 3,
 	STI_HELP(
 	"cp status                             Show codeplug status\r\n"
-	"cp backup                             Backup the codeplug\r\n"
+	"cp backup                             Backup the codeplug to the user page\r\n"
 	"cp restore                            Restore codeplug from backup\r\n"
 	"cp defaults                           Set codeplug to defaults\r\n"
 	"\r\n"
@@ -28,6 +28,12 @@
 #define BSP_CP_SIGNATURE_1	0xba5eba11
 #define BSP_CP_SIGNATURE	0xdecafbad
 
+/// Main flash for the codeplug journal, two banks (the CODEPLUG region in link_uc3c0512c.lds) -
+/// deploy/program.bat saves and restores it around its chip erase, so keep the two in step
+#define BSP_CP_JOURNAL_ADDRESS	0x80076A00
+#define BSP_CP_BANK_PAGES		4
+#define BSP_CP_BANK_SIZE		(BSP_CP_BANK_PAGES * AVR32_FLASHC_PAGE_SIZE)
+
 // Used in conf_codeplug.h to define application fields for debug printing
 #define DEFINE_APP_CP_FIELD(_field, _type, _desc) { #_field, \
                                                     STRUCT_OFFSET(user_codeplug_t, _field), \
@@ -75,6 +81,21 @@ extern bsp_codeplug_t *p_bsp_codeplug;
 /// Write data into the codeplug.  Use cp_set_field() instead
 extern void bsp_cp_write(void* dst, const void* src, size_t size);
 
+/**
+ * Start a batch of codeplug writes.  bsp_cp_set_field() / bsp_cp_write()
+ * until bsp_cp_commit() are held back and go to flash together, as one
+ * journal record - the codeplug has all of them or none of them, even
+ * across a power failure.  Reads see the old values until the commit.
+ * Batches nest; the outermost commit writes.  One task at a time.
+ */
+extern void bsp_cp_begin(void);
+
+/// Write the batch.  Returns false if flash couldn't be written (the codeplug is unchanged)
+extern bool bsp_cp_commit(void);
+
+/// Drop the batch
+extern void bsp_cp_abort(void);
+
 /// Returns the validity of the codeplug
 extern bool bsp_cp_valid(void);
 
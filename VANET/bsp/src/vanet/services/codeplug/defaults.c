@@ -55,8 +55,14 @@ const bsp_codeplug_t bsp_defaults = {
 	/* fan_speed */						{ 20,		50,		75,		100 },	
 	/* fan_control_period */			5000,
     
-	/* pad[10] */						{ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
-	/* defaults_version */				3
+	/* rec_pre_ms */					1000,
+	/* rec_post_ms */					250,
+	
+	/* accel_offset_x */				0,
+	/* accel_offset_y */				0,
+	/* accel_offset_z */				0,
+	
+	/* defaults_version */				5
 };
 
 #define STRUCT_OFFSET(structure, object)    ((unsigned int) &(((structure *)NULL)->object))
@@ -77,12 +83,19 @@ cp_field_t cp_fields[] =
 	
 	// accelerometer threshold
 	DEFINE_CP_FIELD(accel_thresh,				CP_FIELD_UINT,	"Accelerometer Threshold (1000=1G)"),
+	DEFINE_CP_FIELD(accel_offset_x,				CP_FIELD_INT,	"Accelerometer X Offset (mg)"),
+	DEFINE_CP_FIELD(accel_offset_y,				CP_FIELD_INT,	"Accelerometer Y Offset (mg)"),
+	DEFINE_CP_FIELD(accel_offset_z,				CP_FIELD_INT,	"Accelerometer Z Offset (mg)"),
 	
 	// fan control
 	DEFINE_CP_FIELD(fan_control_period,			CP_FIELD_UINT,	"Fan Control Period (ms)"),
 	DEFINE_CP_FIELD(ambient_temp,				CP_FIELD_HEX,	"Fan Control Ambient Temperature Table"),
 	DEFINE_CP_FIELD(fan_speed,					CP_FIELD_HEX,	"Fan Control Fan Speed Table"),
 	
+	// event recorder
+	DEFINE_CP_FIELD(rec_pre_ms,					CP_FIELD_UINT,	"Event Recorder Pre-Trigger (ms)"),
+	DEFINE_CP_FIELD(rec_post_ms,				CP_FIELD_UINT,	"Event Recorder Post-Trigger (ms)"),
+	
 	// adc
 	DEFINE_CP_FIELD(factory.adc0_offset_cal,	CP_FIELD_INT,   "ADC0 offset calibration"),
 	DEFINE_CP_FIELD(factory.adc0_gain_cal_num,  CP_FIELD_INT,   "ADC0 gain calibration numerator"),
@@ -81,8 +81,15 @@ typedef const struct
 	uint8_t		fan_speed[4];							// 46-49
 	uint16_t	fan_control_period;						// 50-51
 	
-	// unused pad
-	uint8_t		pad[10];								// 52-61
+	// event recorder window, 0xffff for the built in one
+	uint16_t	rec_pre_ms;								// 52-53
+	uint16_t	rec_post_ms;							// 54-55
+	
+	// accelerometer calibration, mg at rest subtracted from the features
+	int16_t		accel_offset_x;							// 56-57
+	int16_t		accel_offset_y;							// 58-59
+	int16_t		accel_offset_z;							// 60-61
+	
 	// defaults version
 	uint16_t	defaults_version;						// 62-63
 
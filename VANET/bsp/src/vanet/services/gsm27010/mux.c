@@ -92,6 +92,96 @@ static bsp_sti_command_t mux_command =
 };
 #endif // CONFIG_STI_CMD_MUX
 
+#ifdef CONFIG_BSP_ENABLE_BENCH
+/* -----------
+ *  Benchmarks
+ * ----------*/
+static mux_frame_t s_bench_frame;
+static uint8_t s_bench_info[64];
+static uint8_t s_bench_wire[64 + 6];
+static bsp_circ_buffer_t s_bench_circ;
+static uint8_t s_bench_circ_buf[128];
+static uint8_t s_bench_find_buf[128];
+static mux_state_t s_bench_mux_state;
+static int s_bench_data_len;
+static uint32_t s_bench_rx_index;
+
+static void mux_bench_fcs_header(void)
+{
+	mux_calc_fcs(&s_bench_wire[1], 3, 0xff);
+}
+
+static void mux_bench_fcs_64(void)
+{
+	mux_calc_fcs(s_bench_info, sizeof(s_bench_info), 0xff);
+}
+
+static void mux_bench_build_frame(void)
+{
+	// mux_write_frame() without the termios write, which is the UART's time
+	mux_build_frame(BSP_TKVS_MUX_ECHO_DLCI, FRAME_UIH, s_bench_info, sizeof(s_bench_info), &s_bench_frame);
+}
+
+static bool mux_bench_find_setup(void)
+{
+	// the parser state is shared with the mux task, which may have been
+	// preempted part way through a frame - put it aside for the round
+	s_bench_mux_state = mux_state;
+	s_bench_data_len = data_len;
+	s_bench_rx_index = mux_rx_index;
+	memcpy(s_bench_find_buf, find_buf, sizeof(find_buf));
+	mux_state = OPEN_FLAG;
+	data_len = 0;
+	
+	bsp_circ_init(&s_bench_circ, s_bench_circ_buf, sizeof(s_bench_circ_buf));
+	return true;
+}
+
+static void mux_bench_find_teardown(void)
+{
+	mux_state = s_bench_mux_state;
+	data_len = s_bench_data_len;
+	mux_rx_index = s_bench_rx_index;
+	memcpy(find_buf, s_bench_find_buf, sizeof(find_buf));
+}
+
+static void mux_bench_find_frame(void)
+{
+	s_bench_frame.complete = 0;
+	bsp_circ_write(&s_bench_circ, s_bench_wire, sizeof(s_bench_wire));
+	mux_find_frame(&s_bench_circ, &s_bench_frame);
+}
+
+static bsp_bench_t s_mux_bench[] =
+{
+	{ .name = "mux_fcs_header",     .run = mux_bench_fcs_header,    .iterations = 1024, .bytes = 3 },
+	{ .name = "mux_fcs_64",         .run = mux_bench_fcs_64,        .iterations = 256,  .bytes = 64 },
+	{ .name = "mux_build_frame_64", .run = mux_bench_build_frame,   .iterations = 256,  .bytes = 64 },
+	{ .name = "mux_find_frame_64",  .run = mux_bench_find_frame,    .iterations = 256,  .bytes = 64,
+	  .setup = mux_bench_find_setup, .teardown = mux_bench_find_teardown },
+};
+
+static void mux_bench_init(void)
+{
+	for (int i=0; i<sizeof(s_bench_info); i++)
+	{
+		s_bench_info[i] = (uint8_t) i;
+	}
+	
+	// a UIH frame on the wire for the parser
+	mux_build_frame(BSP_TKVS_MUX_ECHO_DLCI, FRAME_UIH, s_bench_info, sizeof(s_bench_info), &s_bench_frame);
+	memcpy(s_bench_wire, &s_bench_frame.start, 4);
+	memcpy(&s_bench_wire[4], s_bench_frame.rx_data, sizeof(s_bench_info));
+	s_bench_wire[sizeof(s_bench_wire) - 2] = s_bench_frame.fcs;
+	s_bench_wire[sizeof(s_bench_wire) - 1] = s_bench_frame.end;
+	
+	for (int i=0; i<sizeof(s_mux_bench)/sizeof(s_mux_bench[0]); i++)
+	{
+		bsp_bench_register(&s_mux_bench[i]);
+	}
+}
+#endif // CONFIG_BSP_ENABLE_BENCH
+
 void bsp_mux_init(void)
 {
 	// initialize buffers
@@ -146,6 +236,21 @@ void bsp_mux_init(void)
 #ifdef CONFIG_STI_CMD_MUX
 	bsp_sti_register_command(&mux_command);
 #endif
+
+#ifdef CONFIG_BSP_ENABLE_BENCH
+	mux_bench_init();
+#endif
+}
+
+/// The UTC time the start flag of a frame written now will have gone out
+static void mux_stamp(uint8_t* stamp)
+{
+	uint64_t ns = bsp_rtc_get_utc_ns_at(bsp_rtc_get_cycles() + bsp_termios_tx_cycles(s_termios_mux));
+	uint32_t t[2];
+	
+	t[0] = cpu_to_be32((uint32_t) (ns / 1000000000));
+	t[1] = cpu_to_be32((uint32_t) (ns % 1000000000));
+	memcpy(stamp, t, sizeof(t));
 }
 
 void app_mux_task(void* p_arg)
@@ -167,6 +272,16 @@ void app_mux_task(void* p_arg)
 					// To-do - handle writes > 64 bytes!
 					mux_write_frame(msg->immed_data, FRAME_UIH, msg->data, msg->data_len);
 				}
+				else if (msg->event == BSP_MUX_EVENT_DLCI_SEND_STAMPED)
+				{
+					// nothing else may get into the UART between the stamp and the frame, and a
+					// locked scheduler can't wait for it to drain - so make room for all of it first
+					bsp_termios_drain(s_termios_mux, MUX_FRAME_WIRE_LEN(msg->data_len));
+					OSSchedLock();
+					mux_stamp(msg->data + msg->data_len - BSP_MUX_STAMP_SIZE);
+					mux_write_frame(msg->immed_data, FRAME_UIH, msg->data, msg->data_len);
+					OSSchedUnlock();
+				}
 			}
 			else if (msg->source == BSP_MUX_DLCI_TO_TKVS_SOURCE(0))
 			{
@@ -187,10 +302,14 @@ void app_mux_task(void* p_arg)
 			}
 			else if (msg->source == BSP_TERMIOS_PORT_TO_TKVS_SOURCE(s_termios_mux))
 			{
-				// RX data from UART via Termios
+				// RX data from UART via Termios - all of it, a ring's worth at a time, as
+				// mux_rx_index has to count the same bytes as the termios receive stamps
 				//print_dbg_char('M');
-				bsp_circ_write(&mux_rx, msg->data, msg->data_len);
-				mux_recv_data(&mux_rx);
+				for (uint16_t n = 0; n < msg->data_len; )
+				{
+					n += bsp_circ_write(&mux_rx, msg->data + n, msg->data_len - n);
+					mux_recv_data(&mux_rx);
+				}
 			}
 			
 			bsp_tkvs_free(msg);
@@ -208,4 +327,28 @@ void bsp_mux_send(uint8_t dlci, const void* data, uint16_t data_length)
 	}
 }
 
+void bsp_mux_send_stamped(uint8_t dlci, const void* data, uint16_t data_length)
+{
+	if (dlci < BSP_TKVS_SRC_MUX_DLCI_NUM && data_length >= BSP_MUX_STAMP_SIZE &&
+		bsp_tkvs_is_subscribed(BSP_MUX_DLCI_TO_TKVS_SOURCE(dlci), BSP_TKVS_ALL_EVENTS) &&
+		mux_stat[dlci].opened == MUX_OPENED)
+	{
+		bsp_tkvs_publish_immed_with_data(BSP_TKVS_SRC_MUX_INTERNAL, BSP_MUX_EVENT_DLCI_SEND_STAMPED, dlci, data, data_length);
+	}
+}
+
+uint32_t bsp_mux_rx_cycles(uint8_t dlci)
+{
+	return dlci < BSP_TKVS_SRC_MUX_DLCI_NUM ? mux_stat[dlci].rx_cycles : 0;
+}
+
+uint16_t bsp_mux_backlog(void)
+{
+	OS_Q_DATA q;
+	
+	if (OSQQuery(s_msg_flag, &q) != OS_ERR_NONE)
+		return 0;
+	return q.OSNMsgs;
+}
+
 #endif // CONFIG_BSP_ENABLE_MUX
\ No newline at end of file
@@ -28,11 +28,40 @@ void bsp_mux_idle_loop(void);
 /// Send Data via Mux
 void bsp_mux_send(uint8_t dlci, const void* data, uint16_t data_length);
 
+/// Size of the transmit time bsp_mux_send_stamped() fills in
+#define BSP_MUX_STAMP_SIZE			8
+
+/**
+ * Send Data via Mux, with the time it is sent
+ *
+ * The last BSP_MUX_STAMP_SIZE bytes of data are overwritten with the UTC time
+ * the frame's start flag will have gone out on the UART - seconds since 1970
+ * then nanoseconds, 32 bits each and big-endian - taken as the frame is queued.
+ */
+void bsp_mux_send_stamped(uint8_t dlci, const void* data, uint16_t data_length);
+
+/**
+ * When the last frame received on a channel started arriving
+ *
+ * @return The low 32 bits of the cycle count when the UART received the
+ *         frame's start flag (see bsp_rtc_extend_cycles()), or 0 if unknown
+ */
+uint32_t bsp_mux_rx_cycles(uint8_t dlci);
+
+/**
+ * How far behind the mux task is
+ *
+ * @return Messages waiting for the mux task - frames to send and data received.
+ *         A sender that can lose data sheds it while this grows, rather than
+ *         queueing more than the UART can carry.
+ */
+uint16_t bsp_mux_backlog(void);
+
 /// Maximum number of MUX channels supported (Including DLCI 0 !)
-#define BSP_TKVS_SRC_MUX_DLCI_NUM	6
+#define BSP_TKVS_SRC_MUX_DLCI_NUM	7
 
 /// Mux Echo Channel
-#define BSP_TKVS_MUX_ECHO_DLCI		(BSP_TKVS_SRC_MUX_DLCI_NUM - 1)
+#define BSP_TKVS_MUX_ECHO_DLCI		5
 
 /// Source BSP_TKVS_SRC_MUX_DLCI* Events
 enum
@@ -138,6 +138,7 @@ void mux_recv_data(bsp_circ_buffer_t *mux_buf)
 							bsp_tkvs_is_subscribed(BSP_MUX_DLCI_TO_TKVS_SOURCE(dlci), BSP_TKVS_ALL_EVENTS) &&
 							mux_stat[dlci].opened == MUX_OPENED)
 						{
+							mux_stat[dlci].rx_cycles = bsp_termios_rx_cycles(s_termios_mux, partial_frame.rx_index);
 							bsp_tkvs_publish_data(BSP_MUX_DLCI_TO_TKVS_SOURCE(dlci), BSP_MUX_EVENT_DATA_RCVD,
 												  partial_frame.rx_data, partial_frame.len1 >> 1);
 						}
@@ -162,41 +163,48 @@ void mux_recv_data(bsp_circ_buffer_t *mux_buf)
 	}
 }
 
-void mux_write_frame(int channel, int frame, uint8_t *inbuf, int len)
+void mux_build_frame(int channel, int frame, const uint8_t *inbuf, int len, mux_frame_t *mux_frame)
 {
 	int frame_start_len = 4;
-	mux_frame_t mux_frame;
 	
 	// Debug
-	memset(&mux_frame, 0xaa, sizeof(mux_frame_t));
+	memset(mux_frame, 0xaa, sizeof(mux_frame_t));
 
 	// Flag, Addr, Control
-	mux_frame.start = BOUND_BASIC;
-	mux_frame.addr = ((channel & 0x3f) << 2) | EA_BIT | CR_BIT;
-	mux_frame.control = frame;
+	mux_frame->start = BOUND_BASIC;
+	mux_frame->addr = ((channel & 0x3f) << 2) | EA_BIT | CR_BIT;
+	mux_frame->control = frame;
 
 	// Length
-	mux_frame.info_len = len;
+	mux_frame->info_len = len;
 	if (len > 127)
 	{
 		frame_start_len = 5;
-		mux_frame.len1 = ((0x7f & len) << 1);
-		mux_frame.len2 = (0x7f80 & len) >> 7;  // Forces EA_BIT=0
+		mux_frame->len1 = ((0x7f & len) << 1);
+		mux_frame->len2 = (0x7f80 & len) >> 7;  // Forces EA_BIT=0
 	}
 	else
 	{
-		mux_frame.len1 = EA_BIT | (len << 1);
-		mux_frame.len2 = 0;
+		mux_frame->len1 = EA_BIT | (len << 1);
+		mux_frame->len2 = 0;
 	}
 
 	// Copy the info
-	memcpy(mux_frame.rx_data, inbuf, len);
+	memcpy(mux_frame->rx_data, inbuf, len);
 
 	// FCS - Skip the Boundary Flag
-	mux_frame.fcs = 0xff - mux_calc_fcs(&mux_frame.addr, frame_start_len - 1, 0xff);
+	mux_frame->fcs = 0xff - mux_calc_fcs(&mux_frame->addr, frame_start_len - 1, 0xff);
 
 	// End Flag
-	mux_frame.end = BOUND_BASIC;
+	mux_frame->end = BOUND_BASIC;
+}
+
+void mux_write_frame(int channel, int frame, uint8_t *inbuf, int len)
+{
+	int frame_start_len;
+	mux_frame_t mux_frame;
+	
+	mux_build_frame(channel, frame, inbuf, len, &mux_frame);
 
 	// Dump Frame
 	dump_frame(FRAME_TX, &mux_frame);
@@ -218,6 +226,7 @@ void mux_write_frame(int channel, int frame, uint8_t *inbuf, int len)
 uint8_t find_buf[128];
 mux_state_t mux_state = OPEN_FLAG;
 int data_len = 0;
+uint32_t mux_rx_index = 0;          // termios receive stream index of the next byte to find a frame in
 
 int mux_find_frame(bsp_circ_buffer_t *buf, mux_frame_t *frame)
 {
@@ -226,6 +235,10 @@ int mux_find_frame(bsp_circ_buffer_t *buf, mux_frame_t *frame)
 	int len = bsp_circ_size(buf);
 	uint8_t *dptr = find_buf;
 	
+	// the rest waits for the next call - the receive ring is bigger than find_buf
+	if (len > sizeof(find_buf))
+		len = sizeof(find_buf);
+	
 	DBGF("mux_find_frame state=%d len=%d", mux_state, len);
     
 	bytes_peeked = bsp_circ_peek(buf, bsp_circ_begin(buf), find_buf, len);
@@ -250,6 +263,7 @@ int mux_find_frame(bsp_circ_buffer_t *buf, mux_frame_t *frame)
 				{
 					frame->start = *dptr;
                     frame->start_tick = bsp_rtc_get_ticks();
+                    frame->rx_index = mux_rx_index + bytes_processed;
 					mux_state = ADDRESS_FIELD;
 				}
 				break;
@@ -315,6 +329,7 @@ int mux_find_frame(bsp_circ_buffer_t *buf, mux_frame_t *frame)
 	
 	// now actually dequeue the # of bytes we have already processed above
 	bsp_circ_read(buf, find_buf, bytes_processed);
+	mux_rx_index += bytes_processed;
 	
 	return bytes_processed;
 }
@@ -25,6 +25,7 @@ enum
 	BSP_MUX_EVENT_UART_RX			= 0x1000,	///< Data available in our circular buffer to be de-mux'd
 	BSP_MUX_EVENT_UART_TX			= 0x2000,	///< Data available in our circular buffer to be sent
 	BSP_MUX_EVENT_DLCI_SEND			= 0x4000,	///< Data to be mux'd and sent
+	BSP_MUX_EVENT_DLCI_SEND_STAMPED	= 0x8000,	///< Same, with the transmit time in the last 8 bytes
 };
 
 /// Determines open mode for MUX DLCI channels
@@ -125,6 +126,7 @@ typedef struct mux_frame_t
     unsigned char   status;         /**< Status Flag, 0=Frame Valid */
     int             info_len;       /**< Information field length */
     uint32_t        start_tick;     /**< The tick when the frame started */
+    uint32_t        rx_index;       /**< Receive stream index of the start flag */
         
     mux_state_t     mux_state;      /**< Parser state for this frame */
     int             data_len;       /**< Parser data length for this frame */
@@ -135,8 +137,15 @@ typedef struct mux_frame_t
 typedef struct mux_stat_t
 {
     mux_chan_state opened;    /**< Mux Channel Opened Flag */
+    uint32_t rx_cycles;       /**< When the last frame received started arriving */
 } mux_stat_t;
 	
+/// Bytes a frame with len information octets takes on the wire
+#define MUX_FRAME_WIRE_LEN(len)     ((len) + ((len) > 127 ? 5 : 4) + 2)
+
+/// Build a frame, ready to write
+void mux_build_frame(int channel, int frame, const uint8_t *inbuf, int len, mux_frame_t *mux_frame);
+
 /// Write a frame to the mux
 void mux_write_frame(int channel, int frame, uint8_t *inbuf, int len);
 
@@ -162,5 +171,9 @@ void dump_frame(frame_type dir, const mux_frame_t *);
 extern mux_frame_t partial_frame;
 extern mux_stat_t mux_stat[16];
 extern uint8_t s_termios_mux;
+extern uint8_t find_buf[128];
+extern mux_state_t mux_state;
+extern int data_len;
+extern uint32_t mux_rx_index;
 
 #endif // _MUX_P_H
\ No newline at end of file
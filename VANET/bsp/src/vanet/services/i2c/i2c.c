@@ -22,10 +22,45 @@
 
 #ifdef CONFIG_BSP_ENABLE_I2C
 
+/*
+ *	One transaction on the bus at a time, the rest queued behind it.  The PDCA
+ *	moves the bytes between the TWIM and the caller's buffers - the address
+ *	bytes then tx on one channel (load and reload), rx on the other - and the
+ *	interrupt handler only feeds the TWIM its commands, 255 bytes at most
+ *	each, and finishes the transaction.
+ */
+
+#define I2C_TWIM				(&AVR32_TWIM0)
+#define I2C_CMD_BYTES_MAX		255
+#define I2C_SR_ERROR			(AVR32_TWIM_SR_ANAK_MASK | AVR32_TWIM_SR_DNAK_MASK | AVR32_TWIM_SR_ARBLST_MASK)
+
 static bool s_twim_inititialized = false;
+static uint32_t s_pba_hz;
+
+// s_i2c_head is on the bus
+static bsp_i2c_xfer_t *s_i2c_head;
+static bsp_i2c_xfer_t *s_i2c_tail;
+
+// bytes of s_i2c_head's phases not yet in a command, -1 once a phase is all commanded (or there's none)
+static int32_t s_i2c_write_left;
+static int32_t s_i2c_read_left;
+static bool s_i2c_write_first;
+static bool s_i2c_read_first;
+
+typedef struct
+{
+	uint8_t chip;
+	uint32_t hz;							// 0 - a free entry
+} i2c_speed_t;
+
+static i2c_speed_t s_i2c_speeds[CONFIG_BSP_I2C_SPEEDS];
 
 #ifdef CONFIG_BSP_UCOS
-static OS_EVENT *s_i2c_mutex;
+#define I2C_TIMEOUT_TICKS		((CONFIG_BSP_I2C_TIMEOUT_MS * OS_TICKS_PER_SEC + 999) / 1000)
+
+// a blocked caller waits on a bit of its own
+static OS_FLAG_GRP *s_i2c_flags;
+static OS_FLAGS s_i2c_waiters;
 #endif // CONFIG_BSP_UCOS
 
 const gpio_map_t TWIM_GPIO_MAP = {
@@ -33,20 +68,13 @@ const gpio_map_t TWIM_GPIO_MAP = {
 {AVR32_TWIMS0_TWD_0_0_PIN, AVR32_TWIMS0_TWD_0_0_FUNCTION}
 };
 
-twi_options_t TWIM_OPTIONS = {
-	.pba_hz = 0,					/* set @ runtime */
-	.speed = 50000,
-	.chip = 0,						/* this can be ignored - init() probes this address? */
-	.smbus = false,
-};
-
 #ifdef CONFIG_STI_CMD_I2C
 static void i2c_handler(int argc, char** argv, uint8_t port)
 {
 	bsp_termios_write_str(port, "Slaves found: ");
 	for (int i=1; i<127; i++)
 	{
-		status_code_t status = twim_probe(&AVR32_TWIM0, i);
+		status_code_t status = bsp_i2c_probe(i);
 		if (status == STATUS_OK)
 		{
 			bsp_termios_printf(port, "%02X ", i);
@@ -69,21 +97,346 @@ bsp_sti_command_t i2c_command =
 #endif // CONFIG_STI_CMD_I2C
 
 /************************************************************************/
-/* I2C Service Arbitration                                              */
+/* Transaction Engine                                                   */
 /************************************************************************/
-static inline void i2c_lock(void)
+static uint32_t i2c_speed(uint8_t chip)
+{
+	for (int i=0; i<CONFIG_BSP_I2C_SPEEDS; i++)
+	{
+		if (s_i2c_speeds[i].hz && s_i2c_speeds[i].chip == chip)
+			return s_i2c_speeds[i].hz;
+	}
+	return CONFIG_BSP_I2C_SPEED_HZ;
+}
+
+static inline bool i2c_more_cmds(void)
+{
+	return s_i2c_write_left >= 0 || s_i2c_read_left >= 0;
+}
+
+/// The next TWIM command for s_i2c_head, 0 if there are no more
+static uint32_t i2c_next_cmd(void)
+{
+	uint32_t cmd = (s_i2c_head->chip << AVR32_TWIM_CMDR_SADR_OFFSET) | AVR32_TWIM_CMDR_VALID_MASK;
+	uint32_t n;
+	
+	if (s_i2c_write_left >= 0)
+	{
+		n = min(s_i2c_write_left, I2C_CMD_BYTES_MAX);
+		s_i2c_write_left -= n;
+		cmd |= n << AVR32_TWIM_CMDR_NBYTES_OFFSET;
+		if (s_i2c_write_first)
+			cmd |= AVR32_TWIM_CMDR_START_MASK;
+		s_i2c_write_first = false;
+		if (s_i2c_write_left == 0)
+		{
+			s_i2c_write_left = -1;
+			if (s_i2c_read_left < 0)
+				cmd |= AVR32_TWIM_CMDR_STOP_MASK;
+		}
+		return cmd;
+	}
+	
+	if (s_i2c_read_left >= 0)
+	{
+		n = min(s_i2c_read_left, I2C_CMD_BYTES_MAX);
+		s_i2c_read_left -= n;
+		cmd |= (n << AVR32_TWIM_CMDR_NBYTES_OFFSET) | AVR32_TWIM_CMDR_READ_MASK;
+		// a repeated start if there was a write
+		if (s_i2c_read_first)
+			cmd |= AVR32_TWIM_CMDR_START_MASK;
+		s_i2c_read_first = false;
+		if (s_i2c_read_left == 0)
+		{
+			s_i2c_read_left = -1;
+			cmd |= AVR32_TWIM_CMDR_STOP_MASK;
+		}
+		return cmd;
+	}
+	
+	return 0;
+}
+
+/// Put s_i2c_head on the bus (interrupts off)
+static void i2c_start(void)
+{
+	volatile avr32_twim_t *twim = I2C_TWIM;
+	bsp_i2c_xfer_t *xfer = s_i2c_head;
+	uint16_t write_len = xfer->addr_len + xfer->tx_len;
+	
+	// as the ASF does - a reset clears anything a failed transaction left behind
+	twim->cr = AVR32_TWIM_CR_MEN_MASK;
+	twim->cr = AVR32_TWIM_CR_SWRST_MASK;
+	twim->cr = AVR32_TWIM_CR_MDIS_MASK;
+	twim->idr = ~0U;
+	twim->scr = ~0U;
+	twim_set_speed(twim, i2c_speed(xfer->chip), s_pba_hz);
+	
+	pdca_disable(CONFIG_BSP_I2C_PDCA_TX);
+	pdca_disable(CONFIG_BSP_I2C_PDCA_RX);
+	if (xfer->addr_len)
+	{
+		pdca_load_channel(CONFIG_BSP_I2C_PDCA_TX, xfer->addr, xfer->addr_len);
+		pdca_reload_channel(CONFIG_BSP_I2C_PDCA_TX, (void*) xfer->tx, xfer->tx_len);
+	}
+	else
+	{
+		pdca_load_channel(CONFIG_BSP_I2C_PDCA_TX, (void*) xfer->tx, xfer->tx_len);
+	}
+	pdca_load_channel(CONFIG_BSP_I2C_PDCA_RX, xfer->rx, xfer->rx_len);
+	pdca_enable(CONFIG_BSP_I2C_PDCA_TX);
+	pdca_enable(CONFIG_BSP_I2C_PDCA_RX);
+	
+	// a write phase if there's anything to write - or nothing to read, a probe
+	s_i2c_write_left = (write_len || !xfer->rx_len) ? write_len : -1;
+	s_i2c_read_left = xfer->rx_len ? xfer->rx_len : -1;
+	s_i2c_write_first = true;
+	s_i2c_read_first = true;
+	
+	twim->cmdr = i2c_next_cmd();
+	twim->ncmdr = i2c_next_cmd();
+	twim->ier = AVR32_TWIM_IER_CCOMP_MASK | I2C_SR_ERROR | (i2c_more_cmds() ? AVR32_TWIM_IER_CRDY_MASK : 0);
+	twim->cr = AVR32_TWIM_CR_MEN_MASK;
+}
+
+/// Take s_i2c_head off the bus, tell its owner and start the next (interrupts off)
+static void i2c_finish(status_code_t status)
+{
+	volatile avr32_twim_t *twim = I2C_TWIM;
+	bsp_i2c_xfer_t *xfer = s_i2c_head;
+	void (*done)(bsp_i2c_xfer_t *xfer) = xfer->done;
+	uint8_t source = xfer->tkvs_source;
+	uint16_t event = xfer->tkvs_event;
+	
+	twim->idr = ~0U;
+	twim->cmdr = 0;
+	twim->ncmdr = 0;
+	twim->scr = ~0U;
+	twim->cr = AVR32_TWIM_CR_MDIS_MASK;
+	pdca_disable(CONFIG_BSP_I2C_PDCA_TX);
+	pdca_disable(CONFIG_BSP_I2C_PDCA_RX);
+	
+	s_i2c_head = xfer->next;
+	if (!s_i2c_head)
+		s_i2c_tail = NULL;
+	
+	// without a done, it may be gone as soon as the status is set
+	xfer->status = status;
+	if (done)
+		done(xfer);
+#ifdef CONFIG_BSP_ENABLE_TKVS
+	if (event)
+		bsp_tkvs_publish_immed(source, event, -status);
+#endif // CONFIG_BSP_ENABLE_TKVS
+	
+	if (s_i2c_head)
+		i2c_start();
+}
+
+static void i2c_int_handler(void)
+{
+	volatile avr32_twim_t *twim = I2C_TWIM;
+	uint32_t status = twim->sr & twim->imr;
+	
+	if (!s_i2c_head)
+	{
+		twim->idr = ~0U;
+		return;
+	}
+	
+	if (status & I2C_SR_ERROR)
+	{
+		i2c_finish(ERR_IO_ERROR);
+		return;
+	}
+	
+	// room for another command
+	if (status & AVR32_TWIM_SR_CRDY_MASK)
+	{
+		if (i2c_more_cmds())
+			twim->ncmdr = i2c_next_cmd();
+		if (!i2c_more_cmds())
+			twim->idr = AVR32_TWIM_IDR_CRDY_MASK;
+	}
+	
+	if (status & AVR32_TWIM_SR_CCOMP_MASK)
+	{
+		twim->scr = AVR32_TWIM_SCR_CCOMP_MASK;
+		if (!i2c_more_cmds() && !(twim->cmdr & AVR32_TWIM_CMDR_VALID_MASK) &&
+			!(twim->ncmdr & AVR32_TWIM_CMDR_VALID_MASK))
+		{
+			i2c_finish(STATUS_OK);
+		}
+	}
+}
+
+/// Take a transaction that ran out of time back from the engine
+static void i2c_cancel(bsp_i2c_xfer_t *xfer)
 {
+	bsp_i2c_xfer_t **p;
+	irqflags_t flags = cpu_irq_save();
+	
+	if (xfer->status == OPERATION_IN_PROGRESS)
+	{
+		if (xfer == s_i2c_head)
+		{
+			i2c_finish(ERR_TIMEOUT);
+		}
+		else
+		{
+			for (p = &s_i2c_head->next; *p != xfer; p = &(*p)->next)
+				;
+			*p = xfer->next;
+			if (s_i2c_tail == xfer)
+			{
+				for (s_i2c_tail = s_i2c_head; s_i2c_tail->next; s_i2c_tail = s_i2c_tail->next)
+					;
+			}
+			xfer->status = ERR_TIMEOUT;
+		}
+	}
+	cpu_irq_restore(flags);
+}
+
 #ifdef CONFIG_BSP_UCOS
-	uint8_t perr;
-	OSMutexPend(s_i2c_mutex, 0, &perr);
+static void i2c_wake(bsp_i2c_xfer_t *xfer)
+{
+	INT8U perr;
+	
+	OSFlagPost(s_i2c_flags, (OS_FLAGS) (uint32_t) xfer->arg, OS_FLAG_SET, &perr);
+}
 #endif // CONFIG_BSP_UCOS
+
+status_code_t bsp_i2c_submit(bsp_i2c_xfer_t *xfer)
+{
+	irqflags_t flags;
+	
+	if (!s_twim_inititialized || xfer->addr_len > sizeof(xfer->addr) ||
+		(xfer->tx_len && !xfer->tx) || (xfer->rx_len && !xfer->rx))
+	{
+		return ERR_INVALID_ARG;
+	}
+	
+	xfer->status = OPERATION_IN_PROGRESS;
+	xfer->next = NULL;
+	
+	flags = cpu_irq_save();
+	if (s_i2c_tail)
+	{
+		s_i2c_tail->next = xfer;
+		s_i2c_tail = xfer;
+	}
+	else
+	{
+		s_i2c_head = s_i2c_tail = xfer;
+		i2c_start();
+	}
+	cpu_irq_restore(flags);
+	
+	return STATUS_OK;
 }
 
-static inline void i2c_unlock(void)
+status_code_t bsp_i2c_transfer(bsp_i2c_xfer_t *xfer)
 {
+	status_code_t status;
+	t_cpu_time timeout;
+	
 #ifdef CONFIG_BSP_UCOS
-	OSMutexPost(s_i2c_mutex);
+	if (OSRunning && OSPrioCur != OS_TASK_IDLE_PRIO)
+	{
+		OS_FLAGS bit;
+		INT8U perr;
+		irqflags_t flags = cpu_irq_save();
+		
+		for (bit = 1; bit && (s_i2c_waiters & bit); bit <<= 1)
+			;
+		s_i2c_waiters |= bit;
+		cpu_irq_restore(flags);
+		
+		if (bit)
+		{
+			xfer->done = i2c_wake;
+			xfer->arg = (void*) (uint32_t) bit;
+			status = bsp_i2c_submit(xfer);
+			if (status == STATUS_OK)
+			{
+				OSFlagPend(s_i2c_flags, bit, OS_FLAG_WAIT_SET_ALL + OS_FLAG_CONSUME, I2C_TIMEOUT_TICKS, &perr);
+				if (perr != OS_ERR_NONE)
+				{
+					// it may finish on its way out - the bit mustn't be left set for the next owner
+					i2c_cancel(xfer);
+					OSFlagPost(s_i2c_flags, bit, OS_FLAG_CLR, &perr);
+				}
+				status = xfer->status;
+			}
+			
+			flags = cpu_irq_save();
+			s_i2c_waiters &= ~bit;
+			cpu_irq_restore(flags);
+			return status;
+		}
+	}
 #endif // CONFIG_BSP_UCOS
+	
+	// before the OS, or every bit taken - spin
+	xfer->done = NULL;
+	status = bsp_i2c_submit(xfer);
+	if (status != STATUS_OK)
+		return status;
+	cpu_set_timeout(cpu_ms_2_cy(CONFIG_BSP_I2C_TIMEOUT_MS, sysclk_get_cpu_hz()), &timeout);
+	while (xfer->status == OPERATION_IN_PROGRESS && !cpu_is_timeout(&timeout))
+		;
+	i2c_cancel(xfer);
+	
+	return xfer->status;
+}
+
+status_code_t bsp_i2c_set_speed(uint8_t i2c_addr, uint32_t hz)
+{
+	i2c_speed_t *entry = NULL;
+	status_code_t status = STATUS_OK;
+	irqflags_t flags;
+	
+	if (hz > BSP_I2C_SPEED_MAX_HZ)
+		return ERR_INVALID_ARG;
+	
+	flags = cpu_irq_save();
+	for (int i=0; i<CONFIG_BSP_I2C_SPEEDS; i++)
+	{
+		if (s_i2c_speeds[i].hz && s_i2c_speeds[i].chip == i2c_addr)
+		{
+			entry = &s_i2c_speeds[i];
+			break;
+		}
+		if (!s_i2c_speeds[i].hz && !entry)
+			entry = &s_i2c_speeds[i];
+	}
+	if (entry)
+	{
+		entry->chip = i2c_addr;
+		entry->hz = hz;
+	}
+	else if (hz)
+	{
+		status = ERR_NO_MEMORY;
+	}
+	cpu_irq_restore(flags);
+	
+	return status;
+}
+
+uint32_t bsp_i2c_get_speed(uint8_t i2c_addr)
+{
+	return i2c_speed(i2c_addr);
+}
+
+status_code_t bsp_i2c_probe(uint8_t i2c_addr)
+{
+	bsp_i2c_xfer_t xfer = {
+		.chip = i2c_addr,
+	};
+	
+	return bsp_i2c_transfer(&xfer);
 }
 
 void bsp_i2c_init()
@@ -91,6 +444,14 @@ void bsp_i2c_init()
 #ifdef CONFIG_BSP_UCOS
 	INT8U perr;
 #endif // CONFIG_BSP_UCOS
+	pdca_channel_options_t pdca_opt = {
+		.addr = NULL,
+		.size = 0,
+		.r_addr = NULL,
+		.r_size = 0,
+		.pid = AVR32_PDCA_PID_TWIM0_RX,
+		.transfer_size = PDCA_TRANSFER_SIZE_BYTE,
+	};
 	
 	print_dbg("Initializing I2C\r\n");
 	if (!s_twim_inititialized)
@@ -98,12 +459,21 @@ void bsp_i2c_init()
 		gpio_enable_module (TWIM_GPIO_MAP,
 			sizeof (TWIM_GPIO_MAP) / sizeof (TWIM_GPIO_MAP[0]));
 		
-		TWIM_OPTIONS.pba_hz = sysclk_get_pba_hz();
-		twim_master_init (&AVR32_TWIM0, &TWIM_OPTIONS);
+		s_pba_hz = sysclk_get_pba_hz();
+		pdca_init_channel(CONFIG_BSP_I2C_PDCA_RX, &pdca_opt);
+		pdca_opt.pid = AVR32_PDCA_PID_TWIM0_TX;
+		pdca_init_channel(CONFIG_BSP_I2C_PDCA_TX, &pdca_opt);
+		
+		I2C_TWIM->idr = ~0U;
+		I2C_TWIM->cr = AVR32_TWIM_CR_MEN_MASK;
+		I2C_TWIM->cr = AVR32_TWIM_CR_SWRST_MASK;
+		I2C_TWIM->cr = AVR32_TWIM_CR_MDIS_MASK;
+		I2C_TWIM->scr = ~0U;
+		INTC_register_interrupt(&i2c_int_handler, AVR32_TWIM0_IRQ, CONFIG_BSP_I2C_IRQ_PRI);
 	
 #ifdef CONFIG_BSP_UCOS
-		s_i2c_mutex = OSMutexCreate(OS_PRIO_MUTEX_CEIL_DIS, &perr);
-		OS_CHECK_PERR(perr, "bsp_i2c_init: OSMutexCreate");
+		s_i2c_flags = OSFlagCreate(0, &perr);
+		OS_CHECK_PERR(perr, "bsp_i2c_init: OSFlagCreate");
 #endif // CONFIG_BSP_UCOS
 		
 		s_twim_inititialized = true;
@@ -117,32 +487,18 @@ void bsp_i2c_init()
 /************************************************************************/
 /* Generic I2C Access                                                   */
 /************************************************************************/
-status_code_t bsp_i2c_read_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint8_t len)
+status_code_t bsp_i2c_read_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint16_t len)
 {
-	status_code_t status;
-	uint8_t i2c_data[16];
-	twim_package_t i2c_pkt = {
-		.chip = 0,
-		.addr[0] = 0,
-		.addr_length = 1,
-		.buffer = i2c_data,
-		.length = 0,
+	// straight into the caller's buffer - a FIFO burst is longer than any bounce buffer we'd want on the stack
+	bsp_i2c_xfer_t xfer = {
+		.chip = i2c_addr,
+		.addr_len = 1,
+		.addr[0] = dev_addr,
+		.rx = bytes,
+		.rx_len = len,
 	};
 	
-	if (len > 16)
-		return ERR_INVALID_ARG;
-		
-	i2c_pkt.chip = i2c_addr;
-	i2c_pkt.addr[0] = dev_addr;
-	i2c_pkt.length = len;
-	i2c_lock();
-	status = twim_read_packet(&AVR32_TWIM0, &i2c_pkt);
-	i2c_unlock();
-	
-	for (int i=0; i<len; i++)
-		bytes[i] = i2c_data[i];
-	
-	return status;
+	return bsp_i2c_transfer(&xfer);
 }
 
 status_code_t bsp_i2c_read_byte(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *value)
@@ -170,44 +526,38 @@ status_code_t bsp_i2c_read_2bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *v
 
 status_code_t bsp_i2c_write_byte_raw(uint8_t i2c_addr, uint8_t value)
 {
-	status_code_t status;
-	uint8_t data[1] = {value};
-	
-	i2c_lock();
-	status = twim_write(&AVR32_TWIM0, data, 1, i2c_addr, false);
-	i2c_unlock();
+	bsp_i2c_xfer_t xfer = {
+		.chip = i2c_addr,
+		.tx = &value,
+		.tx_len = 1,
+	};
 	
-	return status;
+	return bsp_i2c_transfer(&xfer);
 }
 
-status_code_t bsp_i2c_write_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint8_t len)
+status_code_t bsp_i2c_write_bytes_raw(uint8_t i2c_addr, const uint8_t *bytes, uint16_t len)
 {
-	status_code_t status;
-	uint8_t i2c_data[16];
-	twim_package_t i2c_pkt = {
-		.chip = 0,
-		.addr[0] = 0,
-		.addr_length = 1,
-		.buffer = i2c_data,
-		.length = 0,
+	bsp_i2c_xfer_t xfer = {
+		.chip = i2c_addr,
+		.tx = bytes,
+		.tx_len = len,
 	};
 	
-	if (len > 16)
-		return ERR_INVALID_ARG;
-	
-	// set up write packet
-	i2c_pkt.chip = i2c_addr;
-	i2c_pkt.addr[0] = dev_addr;
-	i2c_pkt.length = len;
-	for (int i=0; i<len; i++)
-		i2c_data[i] = bytes[i];
-		
-	i2c_lock();
-	status = twim_write_packet(&AVR32_TWIM0, &i2c_pkt);
-	i2c_unlock();
-	
+	return bsp_i2c_transfer(&xfer);
+}
+
+status_code_t bsp_i2c_write_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint16_t len)
+{
+	// the register address then the caller's bytes, where they are
+	bsp_i2c_xfer_t xfer = {
+		.chip = i2c_addr,
+		.addr_len = 1,
+		.addr[0] = dev_addr,
+		.tx = bytes,
+		.tx_len = len,
+	};
 	
-	return status;
+	return bsp_i2c_transfer(&xfer);
 }
 
 
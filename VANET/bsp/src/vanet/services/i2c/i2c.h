@@ -38,22 +38,71 @@ extern void bsp_i2c_trace_2(const char *s, unsigned long p1, unsigned long p2);
 #define bsp_i2c_trace_2(s, p1, p2)
 #endif // BSP_I2C_TRACE
 
+/// Fast mode - the most any device may ask for
+#define BSP_I2C_SPEED_MAX_HZ	400000
+
+/// Standard mode - what the slow parts (PCF8574) top out at
+#define BSP_I2C_SPEED_STANDARD_HZ	100000
+
 /// Initialize I2C
 extern void bsp_i2c_init(void);
 
+/************************************************************************/
+/* Transactions                                                         */
+/************************************************************************/
+typedef struct bsp_i2c_xfer bsp_i2c_xfer_t;
+
+/**
+ *	A transaction: the internal address bytes and tx written, then - after a
+ *	repeated start if anything was written - rx read.  Any length of either;
+ *	nothing at all is a probe.  It belongs to the engine from submit until
+ *	done has returned, or until status changes if there's no done.
+ */
+struct bsp_i2c_xfer
+{
+	uint8_t chip;							///< 7 bit slave address
+	uint8_t addr_len;						///< Internal address bytes, 0 - 3
+	uint8_t addr[3];
+	const uint8_t *tx;						///< Written after the address, straight from here
+	uint16_t tx_len;
+	uint8_t *rx;							///< Read into here
+	uint16_t rx_len;
+	void (*done)(bsp_i2c_xfer_t *xfer);		///< Called at CONFIG_BSP_I2C_IRQ_PRI, status set
+	void *arg;								///< For done
+	uint8_t tkvs_source;					///< If tkvs_event isn't 0, published at completion
+	uint16_t tkvs_event;					///< with -status as the immediate data
+	volatile status_code_t status;			///< OPERATION_IN_PROGRESS until it's over
+	bsp_i2c_xfer_t *next;					///< The engine's
+};
+
+/// Queue a transaction and return - it runs when the ones before it have
+status_code_t bsp_i2c_submit(bsp_i2c_xfer_t *xfer);
+
+/// Queue a transaction and wait for it, up to CONFIG_BSP_I2C_TIMEOUT_MS.  Takes over done and arg
+status_code_t bsp_i2c_transfer(bsp_i2c_xfer_t *xfer);
+
+/// Bus speed for one device, up to BSP_I2C_SPEED_MAX_HZ; 0 puts it back to CONFIG_BSP_I2C_SPEED_HZ
+status_code_t bsp_i2c_set_speed(uint8_t i2c_addr, uint32_t hz);
+
+/// The bus speed a device's transactions run at
+uint32_t bsp_i2c_get_speed(uint8_t i2c_addr);
+
+/// Is anyone there
+status_code_t bsp_i2c_probe(uint8_t i2c_addr);
 
 /************************************************************************/
 /* Generic I2C Read/Write Byte                                          */
 /************************************************************************/
-status_code_t bsp_i2c_write_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint8_t len);
+status_code_t bsp_i2c_write_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint16_t len);
 status_code_t bsp_i2c_write_byte(uint8_t i2c_addr, uint8_t dev_addr, uint8_t value);
 status_code_t bsp_i2c_write_byte_verbose(uint8_t i2c_addr, uint8_t dev_addr, uint8_t value);
 status_code_t bsp_i2c_write_2bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t value1, uint8_t value2);
 status_code_t bsp_i2c_write_2bytes_verbose(uint8_t i2c_addr, uint8_t dev_addr, uint8_t value1, uint8_t value2);
 
-status_code_t bsp_i2c_read_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint8_t len);
+status_code_t bsp_i2c_read_bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *bytes, uint16_t len);
 status_code_t bsp_i2c_read_byte(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *value);
 status_code_t bsp_i2c_read_2bytes(uint8_t i2c_addr, uint8_t dev_addr, uint8_t *value1, uint8_t *value2);
 
 status_code_t bsp_i2c_write_byte_raw(uint8_t i2c_addr, uint8_t value);
+status_code_t bsp_i2c_write_bytes_raw(uint8_t i2c_addr, const uint8_t *bytes, uint16_t len);
 #endif  // _I2C_H
@@ -38,7 +38,7 @@ static uint8_t s_logcat_termios = 0xff;
 // header in queue for logcat entries... followed by 'size' bytes of text
 typedef struct
 {
-	uint32_t uptime;
+	uint64_t time_us;					// bsp_rtc_get_time_us() when logged
 	uint16_t mask;
 	uint8_t size;
 } entry_t;
@@ -94,7 +94,8 @@ static void logcat_idle_display(void)
                     // should we display it?
                     if (entry.mask & s_logcat_cat_mask)
                     {
-                        bsp_termios_printf(s_logcat_termios, "%08u %04X %s\r\n", entry.uptime, entry.mask, buf);
+                        bsp_termios_printf(s_logcat_termios, "%6u.%06u %04X %s\r\n",
+                            (uint32_t) (entry.time_us / 1000000), (uint32_t) (entry.time_us % 1000000), entry.mask, buf);
                         bsp_termios_flush(s_logcat_termios);
                         i--;
                     }
@@ -104,6 +105,9 @@ static void logcat_idle_display(void)
         
         bsp_free(buf);
     }
+    
+    // 10 a pass, one pass a tick
+    bsp_idle_hold_tick(BSP_IDLE_HOLD_LOGCAT, s_logcat_termios != 0xff && !bsp_circ_eof(&s_logcatq,s_current_positon));
 }
 
 void bsp_logcat_init(void)
@@ -160,7 +164,7 @@ static void logprint(uint16_t mask, const char *msg, uint32_t msglen)
 		}
 		    
 		entry.mask = mask;
-		entry.uptime = OSTimeGet() * CONFIG_BSP_RTC_TICK_HZ; // bsp_rtc_get_uptime();
+		entry.time_us = bsp_rtc_get_time_us();
 		entry.size = msglen;
 		bsp_circ_write(&s_logcatq, &entry, sizeof(entry));
 		bsp_circ_write(&s_logcatq, (const uint8_t*)msg, msglen);
@@ -243,7 +247,8 @@ void bsp_logcat_reset_dump(void)
         if (bsp_circ_peek(&s_logcatq,i,buf,entry.size) < entry.size) break;
         i = bsp_circ_adv(&s_logcatq,i,entry.size);
             
-		bsp_termios_printf(BSP_TERMIOS_RAW_DEBUG_PORT, "%08u %04X %s\r\n", entry.uptime, entry.mask, buf);
+		bsp_termios_printf(BSP_TERMIOS_RAW_DEBUG_PORT, "%6u.%06u %04X %s\r\n",
+			(uint32_t) (entry.time_us / 1000000), (uint32_t) (entry.time_us % 1000000), entry.mask, buf);
     }
     
     bsp_free(buf);
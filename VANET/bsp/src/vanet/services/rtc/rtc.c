@@ -25,27 +25,54 @@
 
 #ifdef CONFIG_BSP_ENABLE_RTC
 
-// The AST prescaler
-#define AST_PSEL                    (ilog2(CONFIG_BSP_RTC_CLOCK_HZ / CONFIG_BSP_RTC_TICK_HZ) - 1)
+// The AST counts at half the clock, fine enough to set an alarm by and to time a sleep with,
+// and the periodic interrupt is the tick
+#define AST_PSEL                    0
+#define AST_COUNTER_HZ              (CONFIG_BSP_RTC_CLOCK_HZ / 2)
+#define AST_TICK_INSEL              (ilog2(CONFIG_BSP_RTC_CLOCK_HZ / CONFIG_BSP_RTC_TICK_HZ) - 1)
+#define AST_COUNTS_PER_TICK         (AST_COUNTER_HZ / CONFIG_BSP_RTC_TICK_HZ)
 
 #define US_PER_TICK                 (1000000 / CONFIG_BSP_RTC_TICK_HZ)
 
+// an AST edge is only taken if the cycle count was read within this of the count before it
+#define AST_EDGE_SLACK_US           2
+#define AST_EDGE_TRIES              3
+
 static uint32_t s_uptime;           // the amount of time we've been up, in seconds
 static uint32_t s_up_ticks;         // the number of ticks we've been up
 static uint32_t s_tick_cycle;       // the intra-tick cycle counter
 static uint32_t s_clock;            // the unix clock time
 static uint32_t s_clock_us;         // the microsecond part of the uptime and clock time
 static uint32_t s_tick_count;       // how many ticks into the current second we are
+static uint32_t s_cycle_hi;         // the upper half of the 64 bit cycle count
+static uint32_t s_cycle_last;       // the cycle count at the last extension
+static bsp_rtc_servo_t s_servo;     // disciplines the cycle count to the GPS time pulse
+static uint64_t s_last_ns;          // the last monotonic time handed out
+static uint32_t s_tick_cv;          // the AST count at the last tick taken (a count early)
+static uint64_t s_cycle_adj;        // cycles the cycle counter missed while the CPU slept
+#ifdef CONFIG_BSP_RTC_TICKLESS
+static bool s_tickless;             // the tick is off and alarm 0 is set for the next deadline
+static bool s_asleep;               // the cycle count hasn't been checked since a timed sleep
+static bool s_count_stops;          // the cycle counter has been seen to stop in sleep, so every sleep is timed
+static uint32_t s_sleep_cv;         // the AST count at the edge a tickless sleep began on
+static uint32_t s_sleep_count;      // and the cycle counter
+static uint32_t s_tickless_sleeps;  // tickless sleeps taken
+static uint32_t s_tickless_ticks;   // ticks slept through
+#endif
 #ifdef CONFIG_BSP_RTC_PSEUDO_DOG_US
 static uint32_t s_rtc_dog;          // the rtc watchdog ticker
 #endif
 
 #ifdef CONFIG_STI_CMD_CLOCK
 
+static const char* s_servo_names[] = { "free", "acquire", "locked", "holdover" };
+
 static void clock_handler(int argc, char** argv, uint8_t port)
 {
     calendar_date_t cal;
     uint32_t clock_ms;
+    bsp_rtc_servo_t servo;
+    uint64_t utc_ns;
     
     if (argc > 6)
     {
@@ -68,6 +95,17 @@ static void clock_handler(int argc, char** argv, uint8_t port)
         cal.year, cal.month+1, cal.date+1, cal.hour, cal.minute, cal.second, clock_ms);
     bsp_termios_printf(port, "Uptime: %d:%02d:%02d.%03d\r\n", 
         s_uptime / (60 * 60), (s_uptime % (60 * 60)) / 60, s_uptime % 60, clock_ms);
+
+    utc_ns = bsp_rtc_get_utc_ns();
+    bsp_rtc_get_servo(&servo);
+    bsp_termios_printf(port, "UTC: %u.%09u\r\n", (uint32_t) (utc_ns / 1000000000), (uint32_t) (utc_ns % 1000000000));
+    bsp_termios_printf(port, "Servo: %s, error %d ns, drift %d ppb, %u pulses, %u steps\r\n",
+        s_servo_names[servo.state], servo.error_ns, bsp_rtc_servo_drift_ppb(&servo), servo.pulses, servo.steps);
+    bsp_termios_printf(port, "Pulse jitter: %u ns, max %u ns\r\n", servo.jitter_ns, servo.jitter_max_ns);
+    #ifdef CONFIG_BSP_RTC_TICKLESS
+    bsp_termios_printf(port, "Tickless: %u sleeps, %u of %u ticks slept through\r\n",
+        s_tickless_sleeps, s_tickless_ticks, s_up_ticks);
+    #endif
 }
 
 static bsp_sti_command_t clock_command =
@@ -88,6 +126,190 @@ static bsp_sti_command_t clock_command =
 };
 #endif // CONFIG_STI_CMD_CLOCK
 
+/// AST counts in CPU cycles
+static inline uint64_t ast_to_cycles(uint32_t counts)
+{
+    return (uint64_t) counts * sysclk_get_cpu_hz() / AST_COUNTER_HZ;
+}
+
+#ifdef CONFIG_BSP_RTC_TICKLESS
+/**
+ * The next AST edge and the cycle count on it.  The wait is up to an AST
+ * period, so only the shared levels are masked for it and the time pulse
+ * comes in - each read is a short critical section, and an edge one was held
+ * off around is passed up for the next.  Returns the AST count
+ */
+static uint32_t rtc_ast_edge(uint32_t* count)
+{
+    irqflags_t flags = bsp_intc_shared_save(), gm;
+    uint32_t slack = AST_EDGE_SLACK_US * (sysclk_get_cpu_hz() / 1000000);
+    uint32_t cv, now_cv, last, now;
+    int tries = 0;
+    
+    cpu_irq_enable();
+    gm = cpu_irq_save();
+    cv = ast_get_counter_value(&AVR32_AST);
+    last = Get_sys_count();
+    cpu_irq_restore(gm);
+    
+    for (;;)
+    {
+        gm = cpu_irq_save();
+        now_cv = ast_get_counter_value(&AVR32_AST);
+        now = Get_sys_count();
+        cpu_irq_restore(gm);
+        
+        // a pulse comes once a second, so it can't be at every edge
+        if (now_cv != cv && (now - last < slack || ++tries >= AST_EDGE_TRIES))
+        {
+            break;
+        }
+        cv = now_cv;
+        last = now;
+    }
+    
+    bsp_intc_shared_restore(flags);
+    *count = now;
+    return now_cv;
+}
+
+/// Time a sleep from an AST edge, since the cycle counter runs on the CPU clock and may stop - interrupts off
+static void rtc_sleep_begin(void)
+{
+    // nothing has looked at the cycle count since the last sleep, so that one's still being timed
+    if (s_asleep)
+    {
+        return;
+    }
+    
+    s_sleep_cv = rtc_ast_edge(&s_sleep_count);
+    s_asleep = true;
+}
+
+/// Settle a timed sleep before the cycle count is used - if it stopped, add what it missed.  Interrupts on
+static void rtc_wake(void)
+{
+    uint32_t now_cv, count;
+    uint64_t slept;
+    irqflags_t flags;
+    
+    // to an AST edge, as rtc_sleep_begin() did
+    now_cv = rtc_ast_edge(&count);
+    
+    flags = cpu_irq_save();
+    
+    // the time pulse may have settled it while we waited
+    if (s_asleep)
+    {
+        s_asleep = false;
+        
+        // it either ran or it didn't - once it's been seen to stop, even the
+        // short sleeps between characters are made up
+        slept = ast_to_cycles(now_cv - s_sleep_cv);
+        if (count - s_sleep_count < slept / 2)
+        {
+            s_count_stops = true;
+        }
+        if (s_count_stops && count - s_sleep_count < slept)
+        {
+            s_cycle_adj += slept - (count - s_sleep_count);
+        }
+    }
+    cpu_irq_restore(flags);
+}
+#endif
+
+/// Interrupts off to use the clock - a timed sleep is settled first, with them on (see rtc_ast_edge())
+static irqflags_t rtc_lock(void)
+{
+    #ifdef CONFIG_BSP_RTC_TICKLESS
+    if (s_asleep)
+    {
+        rtc_wake();
+    }
+    #endif
+    
+    return cpu_irq_save();
+}
+
+/// The 64 bit cycle count - under rtc_lock(), and extended at least once a wrap (134 s at 32 MHz)
+static uint64_t rtc_cycles(void)
+{
+    uint32_t now = Get_sys_count();
+    
+    if (now < s_cycle_last)
+    {
+        s_cycle_hi++;
+    }
+    s_cycle_last = now;
+    return (((uint64_t) s_cycle_hi << 32) | now) + s_cycle_adj;
+}
+
+/// Take every tick the AST has counted since the last one - interrupts off.  Returns how many, for OSTimeTick()
+static uint32_t rtc_tick(uint64_t cycles)
+{
+    uint32_t cv = ast_get_counter_value(&AVR32_AST);
+    uint32_t ticks, late, n;
+    
+    if (s_up_ticks == 0)
+    {
+        // the first tick lines us up with the periodic interrupt
+        s_tick_cv = cv - AST_COUNTS_PER_TICK - 1;
+    }
+    ticks = (cv - s_tick_cv) / AST_COUNTS_PER_TICK;
+    s_tick_cv += ticks * AST_COUNTS_PER_TICK;
+    #ifdef CONFIG_BSP_RTC_TICKLESS
+    if (ticks > 1)
+    {
+        s_tickless_ticks += ticks - 1;
+    }
+    #endif
+    
+    // the cycle count at the tick's edge - which is now, unless the interrupt
+    // was held off while the tick was (see bsp_rtc_tick_resume())
+    late = cv - s_tick_cv;
+    s_tick_cycle = (uint32_t) (late > 2 ? cycles - ast_to_cycles(late - 1) : cycles);
+    
+    for (n = 0; n < ticks; n++)
+    {
+        // update the clock
+        s_clock_us += US_PER_TICK;    
+        if (++s_tick_count >= CONFIG_BSP_RTC_TICK_HZ)
+        {
+            gpio_toggle_pin(BSP_RTC_LED);
+            s_clock++;
+            s_uptime++;
+            s_clock_us = 0;
+            s_tick_count = 0;
+            bsp_rtc_servo_check(&s_servo, cycles);
+        }
+        s_up_ticks++;
+        
+        #ifdef CONFIG_BSP_RTC_PSEUDO_DOG_US
+        if (s_rtc_dog < US_PER_TICK)
+        {
+            bsp_reset(BSP_RESET_RTC_DOG);
+        }
+        s_rtc_dog -= US_PER_TICK;
+        #endif
+    }
+    
+    return ticks;
+}
+
+/// The system tick, once per tick taken - with interrupts back on, as the time pulse can't wait for it
+static void rtc_os_tick(uint32_t ticks)
+{
+    #ifdef CONFIG_BSP_UCOS
+    while (ticks--)
+    {
+        OSTimeTick();
+    }
+    #else
+    (void) ticks;
+    #endif
+}
+
 #ifdef CONFIG_BSP_UCOS
 static void ast_int_handler(void)
 #else
@@ -95,38 +317,159 @@ __attribute__((__interrupt__))
 static void ast_int_handler(void)
 #endif
 {
+    irqflags_t flags;
+    uint64_t cycles;
+    uint32_t ticks;
+    
+    // the time pulse capture preempts us and reads the clock, so keep it out while it changes
+    flags = rtc_lock();
+    
     // capture the cycle count at the beginning of the tick
-    s_tick_cycle = Get_sys_count();
+    cycles = rtc_cycles();
 
     // clear the interrupt.  don't call ast_clear_periodic_status_flag because it waits for the value to actually
     // latch in, which takes about 90us.
     //ast_clear_periodic_status_flag(&AVR32_AST,0);
     while (AVR32_AST.sr & AVR32_AST_SR_BUSY_MASK) {}        // should always be not busy
     AVR32_AST.scr = AVR32_AST_SCR_PER0_MASK;
-        
-    // update the clock
-    s_clock_us += US_PER_TICK;    
-    if (++s_tick_count >= CONFIG_BSP_RTC_TICK_HZ)
+    
+    ticks = rtc_tick(cycles);
+    cpu_irq_restore(flags);
+    
+    rtc_os_tick(ticks);
+}
+
+#ifdef CONFIG_BSP_RTC_TICKLESS
+#ifdef CONFIG_BSP_UCOS
+static void ast_alarm_handler(void)
+#else
+__attribute__((__interrupt__))
+static void ast_alarm_handler(void)
+#endif
+{
+    irqflags_t flags;
+    uint64_t cycles;
+    uint32_t ticks;
+    
+    flags = rtc_lock();
+    cycles = rtc_cycles();
+    
+    // the alarm is on a tick's edge, so the periodic flag went up with it
+    while (AVR32_AST.sr & AVR32_AST_SR_BUSY_MASK) {}
+    AVR32_AST.scr = AVR32_AST_SCR_ALARM0_MASK | AVR32_AST_SCR_PER0_MASK;
+    
+    bsp_rtc_tick_resume();
+    ticks = rtc_tick(cycles);
+    cpu_irq_restore(flags);
+    
+    rtc_os_tick(ticks);
+}
+
+/// Ticks until something is due: a task's delay or timeout, or an OS timer (TKVS timers are OS timers) - interrupts off
+static uint32_t rtc_idle_ticks(void)
+{
+    uint32_t ticks = CONFIG_BSP_RTC_TICKLESS_MAX_TICKS, t;
+    OS_TCB* tcb;
+    
+    for (tcb = OSTCBList; tcb != NULL; tcb = tcb->OSTCBNext)
     {
-        gpio_toggle_pin(BSP_RTC_LED);
-        s_clock++;
-        s_uptime++;
-        s_clock_us = 0;
-        s_tick_count = 0;
+        if (tcb->OSTCBDly != 0 && tcb->OSTCBDly < ticks)
+        {
+            ticks = tcb->OSTCBDly;
+        }
     }
-    s_up_ticks++;
     
-    #ifdef CONFIG_BSP_RTC_PSEUDO_DOG_US
-    if (s_rtc_dog < US_PER_TICK)
+    #if OS_TMR_EN > 0
+    for (int i=0; i<OS_TMR_CFG_MAX; i++)
     {
-        bsp_reset(BSP_RESET_RTC_DOG);
+        if (OSTmrTbl[i].OSTmrState == OS_TMR_STATE_RUNNING)
+        {
+            // the timer task counts every (OS_TICKS_PER_SEC / OS_TMR_CFG_TICKS_PER_SEC) ticks, and may be part way there
+            t = (OSTmrTbl[i].OSTmrMatch - OSTmrTime - 1) * (OS_TICKS_PER_SEC / OS_TMR_CFG_TICKS_PER_SEC) + 1;
+            if (t < ticks)
+            {
+                ticks = t;
+            }
+        }
     }
-    s_rtc_dog -= US_PER_TICK;
     #endif
     
-    #ifdef CONFIG_BSP_UCOS
-    // call the system tick
-    OSTimeTick();
+    return ticks;
+}
+
+/// Stop the tick until the next deadline, if it is far enough off - interrupts off
+static void rtc_tickless_begin(void)
+{
+    uint32_t ticks = rtc_idle_ticks(), alarm, cv;
+    
+    if (ticks < CONFIG_BSP_RTC_TICKLESS_MIN_TICKS)
+    {
+        return;
+    }
+    
+    // the deadline is counted from the last tick taken, even if another is
+    // pending, and the alarm goes off on its edge
+    alarm = s_tick_cv + ticks * AST_COUNTS_PER_TICK + 1;
+    ast_set_alarm0_value(&AVR32_AST, alarm);
+    AVR32_AST.scr = AVR32_AST_SCR_ALARM0_MASK;
+    
+    cv = ast_get_counter_value(&AVR32_AST);
+    if ((int32_t) (alarm - cv) < 4)
+    {
+        return;
+    }
+    
+    AVR32_AST.idr = AVR32_AST_IDR_PER0_MASK;
+    AVR32_AST.ier = AVR32_AST_IER_ALARM0_MASK;
+    s_tickless = true;
+    s_tickless_sleeps++;
+}
+#endif // CONFIG_BSP_RTC_TICKLESS
+
+void bsp_rtc_sleep(void)
+{
+    enum sleepmgr_mode mode;
+    
+    cpu_irq_disable();
+    
+    mode = sleepmgr_get_sleep_mode();
+    if (mode == SLEEPMGR_ACTIVE)
+    {
+        cpu_irq_enable();
+        return;
+    }
+    
+    #ifdef CONFIG_BSP_RTC_TICKLESS
+    if (!bsp_idle_tick_held())
+    {
+        rtc_tickless_begin();
+    }
+    if (s_tickless || s_count_stops)
+    {
+        rtc_sleep_begin();
+    }
+    #endif
+    
+    // enables interrupts as it sleeps
+    sleepmgr_sleep(mode);
+    
+    bsp_rtc_tick_resume();
+}
+
+void bsp_rtc_tick_resume(void)
+{
+    #ifdef CONFIG_BSP_RTC_TICKLESS
+    irqflags_t flags = cpu_irq_save();
+    
+    if (s_tickless)
+    {
+        // a tick that went by is still flagged, so it interrupts right away
+        // and rtc_tick() takes all the ticks missed
+        s_tickless = false;
+        AVR32_AST.idr = AVR32_AST_IDR_ALARM0_MASK;
+        AVR32_AST.ier = AVR32_AST_IER_PER0_MASK;
+    }
+    cpu_irq_restore(flags);
     #endif
 }
 
@@ -139,6 +482,12 @@ void bsp_rtc_init(void)
     s_clock_us = 0;
     s_tick_count = 0;
     s_up_ticks = 0;
+    s_cycle_hi = 0;
+    s_cycle_last = Get_sys_count();
+    s_last_ns = 0;
+    s_tick_cv = 0;
+    s_cycle_adj = 0;
+    bsp_rtc_servo_init(&s_servo, sysclk_get_cpu_hz());
 
     #ifdef CONFIG_BSP_RTC_PSEUDO_DOG_US
     s_rtc_dog = CONFIG_BSP_RTC_PSEUDO_DOG_US;
@@ -157,15 +506,22 @@ void bsp_rtc_init(void)
     ast_init_counter(&AVR32_AST, AST_OSC_32KHZ, AST_PSEL, 0);
     
     // Register the interrupt
-    INTC_register_interrupt(&ast_int_handler, AVR32_AST_PER_IRQ, AVR32_INTC_INT0);
+    INTC_register_interrupt(&ast_int_handler, AVR32_AST_PER_IRQ, CONFIG_BSP_RTC_IRQ_PRI);
     
     // set up periodic alarm
-    avr32_ast_pir0_t pir = { .insel = AST_PSEL };
+    avr32_ast_pir0_t pir = { .insel = AST_TICK_INSEL };
     ast_set_periodic0_value(&AVR32_AST, pir);
     ast_enable_periodic_interrupt(&AVR32_AST,0);
 	ast_enable_async_wakeup(&AVR32_AST, AVR32_AST_PER0_MASK);
     ast_enable_periodic0(&AVR32_AST);
     
+    #ifdef CONFIG_BSP_RTC_TICKLESS
+    // alarm 0 ends a tickless sleep - it only interrupts while the tick is off
+    INTC_register_interrupt(&ast_alarm_handler, AVR32_AST_ALARM_IRQ, CONFIG_BSP_RTC_IRQ_PRI);
+    ast_enable_async_wakeup(&AVR32_AST, AVR32_AST_ALARM0_MASK);
+    ast_enable_alarm0(&AVR32_AST);
+    #endif
+    
     #ifdef CONFIG_STI_CMD_CLOCK
     // Register the pti command
     bsp_sti_register_command(&clock_command);
@@ -175,22 +531,43 @@ void bsp_rtc_init(void)
     ast_enable(&AVR32_AST);
 }
 
+/// us into the second of the last tick taken - more than a second's worth while the tick is off.  Interrupts off
+static uint32_t rtc_clock_us(void)
+{
+    return s_clock_us + cpu_cy_2_us((uint32_t) rtc_cycles() - s_tick_cycle, sysclk_get_cpu_hz());
+}
+
 uint32_t bsp_rtc_get_clock(void)
 {
-    return s_clock;
+    irqflags_t flags = rtc_lock();
+    uint32_t clock = s_clock + rtc_clock_us() / 1000000;
+    cpu_irq_restore(flags);
+    
+    return clock;
 }
 
 uint32_t bsp_rtc_get_clock_us(void)
 {
-    return s_clock_us + cpu_cy_2_us(Get_sys_count() - s_tick_cycle, sysclk_get_cpu_hz());
+    irqflags_t flags = rtc_lock();
+    uint32_t us = rtc_clock_us() % 1000000;
+    cpu_irq_restore(flags);
+    
+    return us;
 }
 
 void bsp_rtc_set_clock(uint32_t val)
 {
+    irqflags_t flags;
+    
     if (s_clock != val)
     {
         s_clock = val;
         
+        // UTC follows until the servo has a time pulse
+        flags = rtc_lock();
+        bsp_rtc_servo_set_utc(&s_servo, rtc_cycles(), val * 1000000000ULL + s_clock_us * 1000ULL);
+        cpu_irq_restore(flags);
+        
         #ifdef CONFIG_BSP_ENABLE_TKVS
         bsp_tkvs_publish_immed(BSP_TKVS_SRC_CLOCK, BSP_CLOCK_EVENT_UPDATE, 0);
         #endif
@@ -199,7 +576,11 @@ void bsp_rtc_set_clock(uint32_t val)
 
 uint32_t bsp_rtc_get_uptime(void)
 {
-    return 1000 * s_uptime + bsp_rtc_get_clock_us() / 1000;
+    irqflags_t flags = rtc_lock();
+    uint32_t ms = 1000 * s_uptime + rtc_clock_us() / 1000;
+    cpu_irq_restore(flags);
+    
+    return ms;
 }
 
 uint32_t bsp_rtc_get_ticks(void)
@@ -207,6 +588,93 @@ uint32_t bsp_rtc_get_ticks(void)
     return s_up_ticks;
 }
 
+uint64_t bsp_rtc_get_cycles(void)
+{
+    uint32_t now = Get_sys_count();
+    irqflags_t flags = rtc_lock();
+    uint64_t cycles = rtc_cycles();
+    
+    // the count when called, not after rtc_lock() waited out a sleep - an edge's stamp
+    cycles -= (uint32_t) (s_cycle_last - now);
+    cpu_irq_restore(flags);
+    
+    return cycles;
+}
+
+/// The monotonic time, interrupts off - never less than the last one handed out
+static uint64_t rtc_time_ns(void)
+{
+    uint64_t ns = bsp_rtc_servo_time_ns(&s_servo, rtc_cycles());
+    
+    // a pulse re-anchors at its capture, a few us back, so a rate change can
+    // pull the time back a few ns
+    if (ns < s_last_ns)
+    {
+        ns = s_last_ns;
+    }
+    s_last_ns = ns;
+    return ns;
+}
+
+uint64_t bsp_rtc_get_time_ns(void)
+{
+    irqflags_t flags = rtc_lock();
+    uint64_t ns = rtc_time_ns();
+    cpu_irq_restore(flags);
+    
+    return ns;
+}
+
+uint64_t bsp_rtc_get_time_us(void)
+{
+    irqflags_t flags = rtc_lock();
+    uint64_t ns = rtc_time_ns();
+    cpu_irq_restore(flags);
+    
+    return ns / 1000;
+}
+
+uint64_t bsp_rtc_get_time_us_at(uint64_t cycles)
+{
+    irqflags_t flags = cpu_irq_save();
+    uint64_t ns = bsp_rtc_servo_time_ns(&s_servo, cycles);
+    cpu_irq_restore(flags);
+    
+    return ns / 1000;
+}
+
+uint64_t bsp_rtc_get_utc_ns(void)
+{
+    irqflags_t flags = rtc_lock();
+    uint64_t ns = rtc_time_ns() + s_servo.utc_offset_ns;
+    cpu_irq_restore(flags);
+    
+    return ns;
+}
+
+uint64_t bsp_rtc_get_utc_ns_at(uint64_t cycles)
+{
+    irqflags_t flags = cpu_irq_save();
+    uint64_t ns = bsp_rtc_servo_utc_ns(&s_servo, cycles);
+    cpu_irq_restore(flags);
+    
+    return ns;
+}
+
+void bsp_rtc_pps(uint64_t cycles, uint32_t second)
+{
+    irqflags_t flags = cpu_irq_save();
+    bsp_rtc_servo_pps(&s_servo, cycles, second);
+    cpu_irq_restore(flags);
+}
+
+void bsp_rtc_get_servo(bsp_rtc_servo_t* servo)
+{
+    irqflags_t flags = cpu_irq_save();
+    *servo = s_servo;
+    cpu_irq_restore(flags);
+}
+
 void bsp_rtc_idle_kick(void)
 {
     #ifdef CONFIG_BSP_RTC_PSEUDO_DOG_US
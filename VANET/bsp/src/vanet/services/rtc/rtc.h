@@ -56,6 +56,50 @@ extern uint32_t bsp_rtc_get_uptime(void);
 /// The number of ticks since powerup
 extern uint32_t bsp_rtc_get_ticks(void);
 
+/// The CPU cycle count, extended to 64 bits
+extern uint64_t bsp_rtc_get_cycles(void);
+
+/// Monotonic ns since powerup, disciplined to the GPS time pulse - slewed, never stepped
+extern uint64_t bsp_rtc_get_time_ns(void);
+
+/**
+ * Monotonic us since powerup - the timestamp for logs, traces and samples
+ *
+ * bsp_rtc_get_time_ns() scaled down, so it has the cycle counter's resolution
+ * between ticks and never goes back.  Safe from ISRs.  Where even that is too
+ * much, capture bsp_rtc_get_cycles() and convert it later with
+ * bsp_rtc_get_time_us_at().
+ */
+extern uint64_t bsp_rtc_get_time_us(void);
+
+/// Monotonic us at a cycle count captured earlier
+extern uint64_t bsp_rtc_get_time_us_at(uint64_t cycles);
+
+/// UTC in ns since 1970-01-01 00:00:00 - bsp_rtc_get_time_ns() plus the servo's offset
+extern uint64_t bsp_rtc_get_utc_ns(void);
+
+/// UTC in ns at another cycle count, past or (near) future
+extern uint64_t bsp_rtc_get_utc_ns_at(uint64_t cycles);
+
+/// A 32 bit cycle count from the last wrap (134 s at 32 MHz), extended to 64 bits
+static inline uint64_t bsp_rtc_extend_cycles(uint32_t cycles)
+{
+    uint64_t now = bsp_rtc_get_cycles();
+    
+    return now - (uint32_t) ((uint32_t) now - cycles);
+}
+
+/**
+ * A time pulse
+ *
+ * @param cycles bsp_rtc_get_cycles() at the edge - capture it first thing in the ISR
+ * @param second The UTC second the pulse starts, or 0 if not known yet
+ */
+extern void bsp_rtc_pps(uint64_t cycles, uint32_t second);
+
+/// A copy of the servo's state
+extern void bsp_rtc_get_servo(bsp_rtc_servo_t* servo);
+
 /// Grab the current calendar
 static inline void bsp_rtc_get_calendar(calendar_date_t* date_out)
 {
@@ -68,6 +112,19 @@ static inline void bsp_rtc_set_calendar(calendar_date_t* date)
     return bsp_rtc_set_clock(calendar_date_to_timestamp(date));
 }
 
+/**
+ * Sleep in the deepest mode the sleep manager allows, until an interrupt
+ *
+ * With CONFIG_BSP_RTC_TICKLESS the tick stops until the next task delay or
+ * timeout or OS timer is due, unless the idle loop holds it (bsp_idle_hold_tick),
+ * and the ticks slept through are all taken when it starts again.  The cycle
+ * count (and so the clock) is kept across the sleep from the AST.
+ */
+extern void bsp_rtc_sleep(void);
+
+/// Start the tick again after a tickless sleep - call on every task switch, since the interrupt that ends the sleep may wake a task
+extern void bsp_rtc_tick_resume(void);
+
 /// Kick the RTC psuedo-watchdog
 extern void bsp_rtc_idle_kick(void);
 
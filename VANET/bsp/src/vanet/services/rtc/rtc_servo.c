@@ -0,0 +1,302 @@
+/**
+ *	@file	rtc_servo.c
+ *
+ *	@brief	PPS disciplined clock servo
+ *
+ *  A PI loop on the phase error at each time pulse.  The first pulse after a
+ *  step measures the frequency outright (FLL), from the cycles between two
+ *  edges; after that the integral term tracks the drift and the proportional
+ *  term slews out the phase (PLL).  Nothing here touches the hardware, so the
+ *  UNIT_TEST build runs it against a simulated oscillator.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rtc_servo.h"
+#else
+#include <string.h>
+#include <asf.h>
+#include "vanet.h"
+#endif
+
+#define NS_PER_S                    1000000000LL
+
+#define SERVO_STEP_NS               1000000         // phase errors beyond 1 ms are stepped, not slewed
+#define SERVO_MAX_PPM               500             // a measured frequency further off than this is a bad pulse
+#define SERVO_KP                    2               // slew 1/KP of the phase error over the next second
+#define SERVO_KI                    8               // and fold 1/KI of it into the frequency
+#define SERVO_JITTER_AVG            16              // pulses the jitter is averaged over
+
+/// dc * rate_q24 >> 24, without overflowing for any realistic dc
+static inline uint64_t servo_scale(uint64_t dc, uint32_t rate_q24)
+{
+    return (((dc >> 32) * rate_q24) << 8) + (((dc & 0xffffffff) * rate_q24) >> 24);
+}
+
+/// ns per cycle * 2^24, running slew_ns fast (negative) or slow over a second
+static uint32_t servo_rate(const bsp_rtc_servo_t* s, int32_t slew_ns)
+{
+    return (uint32_t) (((uint64_t) (NS_PER_S - slew_ns) << 32) / s->freq_q8);
+}
+
+static void servo_anchor(bsp_rtc_servo_t* s, uint64_t cycles, int32_t slew_ns)
+{
+    s->base_ns = bsp_rtc_servo_time_ns(s, cycles);
+    s->base_cycles = cycles;
+    s->rate_q24 = servo_rate(s, slew_ns);
+}
+
+void bsp_rtc_servo_init(bsp_rtc_servo_t* s, uint32_t hz)
+{
+    memset(s, 0, sizeof(*s));
+    s->nominal_hz = hz;
+    s->freq_q8 = (uint64_t) hz << 8;
+    s->rate_q24 = servo_rate(s, 0);
+    s->state = BSP_RTC_SERVO_FREE;
+}
+
+uint64_t bsp_rtc_servo_time_ns(const bsp_rtc_servo_t* s, uint64_t cycles)
+{
+    // a pulse can be captured just before a holdover check re-anchors
+    if (cycles < s->base_cycles)
+        return s->base_ns - servo_scale(s->base_cycles - cycles, s->rate_q24);
+
+    return s->base_ns + servo_scale(cycles - s->base_cycles, s->rate_q24);
+}
+
+void bsp_rtc_servo_pps(bsp_rtc_servo_t* s, uint64_t cycles, uint32_t second)
+{
+    uint64_t gap = 0, freq;
+    int64_t t, e, d;
+    uint32_t sec;
+
+    // a pulse is no use until we know which second it starts
+    if (s->state == BSP_RTC_SERVO_FREE && !second)
+        return;
+
+    if (s->state != BSP_RTC_SERVO_FREE)
+    {
+        // whole seconds since the last pulse - none means a glitch on the pin
+        if (cycles <= s->pps_cycles)
+            return;
+        gap = ((cycles - s->pps_cycles) * 256 + s->freq_q8 / 2) / s->freq_q8;
+        if (gap == 0)
+            return;
+    }
+
+    // the phase error is against the nearest second
+    t = bsp_rtc_servo_utc_ns(s, cycles);
+    sec = (uint32_t) ((t + NS_PER_S / 2) / NS_PER_S);
+    e = t - (int64_t) sec * NS_PER_S;
+
+    if (second && second != sec)
+    {
+        if (s->state == BSP_RTC_SERVO_FREE || ++s->mislabels >= 2)
+        {
+            s->utc_offset_ns += ((int64_t) second - sec) * NS_PER_S;
+            s->mislabels = 0;
+            s->steps++;
+        }
+    }
+    else
+    {
+        s->mislabels = 0;
+    }
+
+    s->pulses++;
+    s->error_ns = (int32_t) e;
+
+    if (s->state == BSP_RTC_SERVO_FREE || e > SERVO_STEP_NS || e < -SERVO_STEP_NS)
+    {
+        // too far to slew - step UTC onto the pulse and measure the frequency again
+        servo_anchor(s, cycles, 0);
+        s->utc_offset_ns -= e;
+        s->pps_cycles = cycles;
+        s->state = BSP_RTC_SERVO_ACQUIRE;
+        s->steps++;
+        s->jitter_max_ns = 0;
+        return;
+    }
+
+    if (s->state == BSP_RTC_SERVO_ACQUIRE)
+    {
+        freq = ((cycles - s->pps_cycles) << 8) / gap;
+        if (freq > ((uint64_t) s->nominal_hz << 8) / 1000000 * (1000000 - SERVO_MAX_PPM) &&
+            freq < ((uint64_t) s->nominal_hz << 8) / 1000000 * (1000000 + SERVO_MAX_PPM))
+        {
+            s->freq_q8 = freq;
+            s->state = BSP_RTC_SERVO_LOCKED;
+        }
+    }
+    else
+    {
+        // the loop takes out the mean, so what's left is the capture's jitter
+        d = e < 0 ? -e : e;
+        s->jitter_ns += ((int32_t) d - (int32_t) s->jitter_ns) / SERVO_JITTER_AVG;
+        if (d > s->jitter_max_ns)
+            s->jitter_max_ns = (uint32_t) d;
+        
+        // ahead means more cycles in a second than we thought
+        s->freq_q8 += (int64_t) s->freq_q8 * e / (NS_PER_S * (int64_t) gap) / SERVO_KI;
+        s->state = BSP_RTC_SERVO_LOCKED;
+    }
+
+    servo_anchor(s, cycles, (int32_t) (e / SERVO_KP));
+    s->pps_cycles = cycles;
+}
+
+void bsp_rtc_servo_check(bsp_rtc_servo_t* s, uint64_t cycles)
+{
+    // the slew was only for a second, so stop it along with the phase tracking
+    if (s->state == BSP_RTC_SERVO_LOCKED && cycles > s->pps_cycles + (s->freq_q8 * 3 / 2 >> 8))
+    {
+        servo_anchor(s, cycles, 0);
+        s->state = BSP_RTC_SERVO_HOLDOVER;
+    }
+}
+
+void bsp_rtc_servo_set_utc(bsp_rtc_servo_t* s, uint64_t cycles, uint64_t utc_ns)
+{
+    if (s->state == BSP_RTC_SERVO_FREE)
+    {
+        s->utc_offset_ns = utc_ns - bsp_rtc_servo_time_ns(s, cycles);
+    }
+}
+
+int32_t bsp_rtc_servo_drift_ppb(const bsp_rtc_servo_t* s)
+{
+    int64_t nominal = (int64_t) s->nominal_hz << 8;
+
+    return (int32_t) (((int64_t) s->freq_q8 - nominal) * NS_PER_S / nominal);
+}
+
+#ifdef UNIT_TEST
+/* -----------
+ *  A 32 MHz oscillator 30 ppm fast, and a pulse seen 0..3 us late by the ISR
+ * ----------*/
+#define TEST_HZ             32000000
+#define TEST_DRIFT_PPB      30000
+#define TEST_UTC            1400000000u
+#define TEST_CYCLE_START    0xfffff000ull       // just short of a 32 bit wrap
+
+static bsp_rtc_servo_t s;
+static uint64_t s_last_ns;
+static int s_failed;
+
+/// Cycle count at a true time (ns since the test started)
+static uint64_t test_cycles(double ns)
+{
+    return TEST_CYCLE_START + (uint64_t) (ns * TEST_HZ * (1.0 + TEST_DRIFT_PPB * 1e-9) / 1e9);
+}
+
+/// The servo's UTC error at a true time, in ns
+static int64_t test_error(double ns)
+{
+    return (int64_t) (bsp_rtc_servo_utc_ns(&s, test_cycles(ns)) - (TEST_UTC * 1000000000ull + (uint64_t) ns));
+}
+
+/// Sample the monotonic time over a second, starting at true time ns
+static void test_monotonic(double ns)
+{
+    for (int i=0; i<8; i++)
+    {
+        uint64_t t = bsp_rtc_servo_time_ns(&s, test_cycles(ns + i * 125e6));
+        if (t < s_last_ns)
+        {
+            printf("FAIL: time went back %llu ns at %.0f\n", (unsigned long long) (s_last_ns - t), ns);
+            s_failed = 1;
+        }
+        s_last_ns = t;
+    }
+}
+
+/// Pulse k (true time k seconds), sampling the second after it
+static void test_pulse(int k, uint32_t label)
+{
+    double ns = k * 1e9;
+
+    bsp_rtc_servo_pps(&s, test_cycles(ns + (rand() % 3000)), label);
+    bsp_rtc_servo_check(&s, test_cycles(ns + 2e6));
+    test_monotonic(ns);
+}
+
+static void expect(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "pass" : "FAIL", what);
+    if (!ok) s_failed = 1;
+}
+
+int main(int argc, char** argv)
+{
+    int64_t worst = 0, e;
+    uint32_t steps;
+    int k;
+
+    srand(1);
+    bsp_rtc_servo_init(&s, TEST_HZ);
+    bsp_rtc_servo_set_utc(&s, test_cycles(0), 12345);
+
+    // lock, then the worst error mid-second once it's settled
+    for (k=0; k<120; k++)
+    {
+        test_pulse(k, TEST_UTC + k);
+        e = test_error(k * 1e9 + 5e8);
+        if (k >= 30 && llabs(e) > worst) worst = llabs(e);
+    }
+    printf("locked: worst %lld ns, drift %d ppb, %u steps\n", (long long) worst, bsp_rtc_servo_drift_ppb(&s), s.steps);
+    expect(s.state == BSP_RTC_SERVO_LOCKED, "locked");
+    expect(worst < 5000, "within 5 us once settled");
+    expect(abs(bsp_rtc_servo_drift_ppb(&s) - TEST_DRIFT_PPB) < 500, "drift within 0.5 ppm");
+    printf("jitter: %u ns, max %u ns\n", s.jitter_ns, s.jitter_max_ns);
+    expect(s.jitter_ns > 300 && s.jitter_ns < 1500, "jitter measures the 0..3 us capture latency");
+
+    // one stale label doesn't step
+    steps = s.steps;
+    test_pulse(k, TEST_UTC + k - 1); k++;
+    test_pulse(k, TEST_UTC + k); k++;
+    expect(s.steps == steps, "one stale label ignored");
+
+    // a minute without pulses
+    for (int i=0; i<60; i++, k++)
+    {
+        bsp_rtc_servo_check(&s, test_cycles(k * 1e9));
+        test_monotonic(k * 1e9);
+    }
+    e = test_error(k * 1e9);
+    printf("holdover: %lld ns after 60 s\n", (long long) e);
+    expect(s.state == BSP_RTC_SERVO_HOLDOVER, "holdover");
+    expect(llabs(e) < 100000, "within 100 us after 60 s of holdover");
+
+    // and back without a step
+    for (int i=0; i<10; i++, k++)
+    {
+        test_pulse(k, TEST_UTC + k);
+    }
+    e = test_error(k * 1e9 - 5e8);
+    expect(s.state == BSP_RTC_SERVO_LOCKED && s.steps == steps, "relocked without a step");
+    expect(llabs(e) < 5000, "within 5 us again");
+
+    // the label moves for real (a leap second, say) - stepped on the second pulse
+    test_pulse(k, TEST_UTC + k + 1); k++;
+    test_pulse(k, TEST_UTC + k + 1); k++;
+    expect(s.steps == steps + 1 && llabs(test_error(k * 1e9 - 5e8) - 1000000000) < 5000, "label change stepped");
+
+    return s_failed;
+}
+#endif // UNIT_TEST
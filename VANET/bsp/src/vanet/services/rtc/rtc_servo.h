@@ -0,0 +1,113 @@
+/**
+ *	@file	rtc_servo.h
+ *
+ *	@brief	PPS disciplined clock servo
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef _RTC_SERVO_H
+#define _RTC_SERVO_H
+
+/**
+ * @addtogroup group_bsp_axamio_services_rtc
+ *
+ * @{
+ */
+
+/** @name Clock servo
+ *
+ *  Time is the CPU cycle counter (extended to 64 bits) scaled by a rate:
+ *
+ *      time_ns = base_ns + (cycles - base_cycles) * rate
+ *
+ *  The rate is re-anchored at every time pulse so the clock never jumps.  It
+ *  is the estimated oscillator frequency (the integral term, which also carries
+ *  the clock through holdover) plus a slew that takes out part of the phase
+ *  error over the next second (the proportional term).  That time is monotonic;
+ *  UTC is it plus an offset, which is stepped on the first pulse and when the
+ *  phase error gets too big to slew.
+ *
+ *  The servo itself does no locking and keeps no globals - rtc.c owns the
+ *  instance and calls it with interrupts off.
+ *
+ *  @{
+ */
+
+/// Servo states
+typedef enum
+{
+    BSP_RTC_SERVO_FREE = 0,         ///< No pulse yet - nominal frequency, UTC from bsp_rtc_set_clock()
+    BSP_RTC_SERVO_ACQUIRE,          ///< Phase set, measuring the frequency
+    BSP_RTC_SERVO_LOCKED,           ///< Tracking the pulses
+    BSP_RTC_SERVO_HOLDOVER,         ///< Lost the pulses - running on the last frequency estimate
+} bsp_rtc_servo_state_t;
+
+/// Servo state
+typedef struct
+{
+    uint64_t    base_cycles;        ///< Cycle count at the anchor
+    uint64_t    base_ns;            ///< Monotonic time at the anchor
+    uint32_t    rate_q24;           ///< ns per cycle * 2^24, until the next anchor
+    int64_t     utc_offset_ns;      ///< UTC minus monotonic time
+    uint64_t    freq_q8;            ///< Estimated cycles per second * 2^8
+    uint32_t    nominal_hz;         ///< The cycle counter's nominal frequency
+    uint64_t    pps_cycles;         ///< Cycle count of the last pulse
+    bsp_rtc_servo_state_t state;
+    int32_t     error_ns;           ///< Phase error at the last pulse (positive is ahead)
+    uint32_t    jitter_ns;          ///< Average size of the phase error while locked - once the loop has
+                                    ///< settled, that is the jitter in capturing the pulse
+    uint32_t    jitter_max_ns;      ///< The largest phase error since the last step
+    uint8_t     mislabels;          ///< Pulses in a row whose second disagreed with ours
+    uint32_t    pulses;             ///< Pulses taken
+    uint32_t    steps;              ///< Times UTC was stepped
+} bsp_rtc_servo_t;
+
+/// Start free running at hz (above 4 MHz, so the rate fits)
+extern void bsp_rtc_servo_init(bsp_rtc_servo_t* s, uint32_t hz);
+
+/// Monotonic time, in ns, at a cycle count
+extern uint64_t bsp_rtc_servo_time_ns(const bsp_rtc_servo_t* s, uint64_t cycles);
+
+/// UTC, in ns since 1970-01-01 00:00:00, at a cycle count
+static inline uint64_t bsp_rtc_servo_utc_ns(const bsp_rtc_servo_t* s, uint64_t cycles)
+{
+    return bsp_rtc_servo_time_ns(s, cycles) + s->utc_offset_ns;
+}
+
+/**
+ * Take a time pulse
+ *
+ * @param s The servo
+ * @param cycles The cycle count at the pulse's edge
+ * @param second The UTC second the pulse starts, or 0 if unknown.  A label
+ *        that disagrees with the servo's count is only believed twice in a row,
+ *        so one stale label doesn't step the clock.  Unlabeled pulses are
+ *        ignored until a labeled one has set UTC.
+ */
+extern void bsp_rtc_servo_pps(bsp_rtc_servo_t* s, uint64_t cycles, uint32_t second);
+
+/// Go into holdover if the pulses have stopped - call at least once a second
+extern void bsp_rtc_servo_check(bsp_rtc_servo_t* s, uint64_t cycles);
+
+/// Set UTC - ignored once the servo has had a pulse
+extern void bsp_rtc_servo_set_utc(bsp_rtc_servo_t* s, uint64_t cycles, uint64_t utc_ns);
+
+/// The estimated oscillator error, in parts per billion (positive is fast)
+extern int32_t bsp_rtc_servo_drift_ppb(const bsp_rtc_servo_t* s);
+
+/// @}
+
+/// @}
+
+#endif  // _RTC_SERVO_H
@@ -46,15 +46,33 @@ struct termios_config
 	uint8_t					tx_function;
 };
 
+/// Receive bursts remembered per port, for bsp_termios_rx_cycles()
+#define TERMIOS_RX_STAMPS		4
+
+/// Bytes after a burst's first that bsp_termios_rx_cycles() will time from it
+#define TERMIOS_RX_STAMP_REACH	1024
+
+struct termios_stamp
+{
+	uint32_t				index;			// receive stream index of the burst's first byte
+	uint32_t				cycle;			// cycle count when it arrived
+};
+
 struct termios_state
 {
 	bsp_termios_mode		mode;			// canonical, raw, ???
 	bsp_termios_buffer		buffer;			// none or ???	
 	bool					echo;			// echo
 	bool					escapeNext;		// handle VT100 escape sequences
+	bool					rxMute;			// drop what the USART receives (replay)
 	uint8_t					cmdLen;			// length of current command
 	char					cmd[128];		// command
 	bsp_termios_idle_handler_t handler;		// idle handler
+	uint32_t				charCycles;		// cycles to send or receive a character at the current baud
+	uint32_t				rxCount;		// bytes put in the receive buffer, ever
+	uint32_t				rxLastCycle;	// cycle count of the last byte received
+	uint8_t					rxStampNext;	// next rxStamp to overwrite
+	struct termios_stamp	rxStamp[TERMIOS_RX_STAMPS];	// the starts of the last few bursts
 };
 
 // Termios Port Configuration
@@ -71,6 +89,9 @@ static bsp_circ_buffer_t s_termios_tx[BSP_TERMIOS_COUNT];
 // PTI-Lite Termios
 uint8_t s_termios_lite;
 
+// Receive tap (capture)
+static bsp_termios_rx_tap_t s_termios_rx_tap;
+
 // Termios Interrupt Handlers
 static void bsp_termios_port_isr(uint8_t port)
 {
@@ -82,9 +103,24 @@ static void bsp_termios_port_isr(uint8_t port)
 			usart_reset_status(s_termios[port].usart); 
 			return; 
 		} 
-		else 
+		else if (!s_termios_state[port].rxMute)
 		{ 
-			bsp_circ_writeb(&s_termios_rx[port], c); 
+			struct termios_state *state = &s_termios_state[port];
+			uint32_t now = (uint32_t) bsp_rtc_get_cycles();
+			
+			// stamp the first byte after the line has been idle - the rest of the
+			// burst follows it a character time apart
+			if (now - state->rxLastCycle > 2 * state->charCycles)
+			{
+				state->rxStamp[state->rxStampNext].index = state->rxCount;
+				state->rxStamp[state->rxStampNext].cycle = now;
+				state->rxStampNext = (state->rxStampNext + 1) % TERMIOS_RX_STAMPS;
+			}
+			state->rxLastCycle = now;
+			state->rxCount += bsp_circ_writeb(&s_termios_rx[port], c); 
+			
+			// until the idle loop has seen it
+			bsp_idle_hold_tick(BSP_IDLE_HOLD_TERMIOS, true);
 		} 
 	} 
 	if (s_termios[port].usart->csr & AVR32_USART_CSR_TXRDY_MASK) 
@@ -131,6 +167,12 @@ static void bsp_termios_enable_tx(uint8_t port)
 	}
 }
 
+/// 8N1 is ten bits a character
+static uint32_t termios_char_cycles(uint32_t baud)
+{
+	return sysclk_get_cpu_hz() / baud * 10;
+}
+
 void bsp_termios_init(void)
 {	
 	void *buf;
@@ -167,7 +209,7 @@ void bsp_termios_init(void)
         }            
 		
 		// register interrupt handler
-		INTC_register_interrupt(s_termios_isr_ptrs[i], s_termios[i].irq, AVR32_INTC_INT0);
+		INTC_register_interrupt(s_termios_isr_ptrs[i], s_termios[i].irq, CONFIG_BSP_TERMIOS_IRQ_PRI);
 
 		// enable receive interrupts
 		s_termios[i].usart->ier = AVR32_USART_IER_RXRDY_MASK;
@@ -177,9 +219,19 @@ void bsp_termios_init(void)
 		s_termios_state[i].echo = s_termios[i].echo;
 		s_termios_state[i].buffer = s_termios[i].buffer;
 		s_termios_state[i].escapeNext = false;
+		s_termios_state[i].rxMute = false;
 		s_termios_state[i].cmdLen = 0;
 		s_termios_state[i].cmd[0] = '\0';
 		s_termios_state[i].handler = NULL;
+		s_termios_state[i].charCycles = termios_char_cycles(s_termios[i].initial_baud);
+		s_termios_state[i].rxCount = 0;
+		s_termios_state[i].rxLastCycle = (uint32_t) bsp_rtc_get_cycles();
+		s_termios_state[i].rxStampNext = 0;
+		for (int j=0; j<TERMIOS_RX_STAMPS; j++)
+		{
+			// far enough back that nothing is timed from them
+			s_termios_state[i].rxStamp[j].index = -TERMIOS_RX_STAMP_REACH;
+		}
 	}
 	
 	// Create our Task
@@ -219,6 +271,23 @@ void bsp_termios_init(void)
 
 void bsp_pti_lite(bsp_tkvs_msg_t *msg);
 
+/// Hand the next len bytes of a port's receive buffer to the tap, without consuming them
+static void bsp_termios_tap_rx(uint8_t port, uint16_t len)
+{
+	uint8_t buf[32];
+	bsp_circ_iter_t i = bsp_circ_begin(&s_termios_rx[port]);
+	uint16_t n;
+	
+	while (len > 0)
+	{
+		n = bsp_circ_peek(&s_termios_rx[port], i, buf, min(len, sizeof(buf)));
+		if (n == 0) break;
+		s_termios_rx_tap(port, buf, n);
+		i = bsp_circ_adv(&s_termios_rx[port], i, n);
+		len -= n;
+	}
+}
+
 void bsp_termios_task(void* p_arg)
 {
 	(void) p_arg;
@@ -263,10 +332,21 @@ void bsp_termios_task(void* p_arg)
 					if (s_termios_state[port].mode == BSP_TERMIOS_MODE_CANONICAL)
 					{
 						//print_dbg_char('C');
+						// only what's here now, so the tap sees exactly the bytes parsed
+						int num_bytes = bsp_circ_size(&s_termios_rx[port]);
+						if (s_termios_rx_tap && num_bytes > 0)
+						{
+							bsp_termios_tap_rx(port, num_bytes);
+						}
+						
 						// In Canonical Mode - Byte at a time!
-						while ((c = bsp_circ_readb(&s_termios_rx[port])) > 0)
+						while (num_bytes-- > 0 && (c = bsp_circ_readb(&s_termios_rx[port])) >= 0)
 						{
-							if (c == 0x1b)	// VT100 processing
+							if (c == 0)
+							{
+								// NUL is dropped
+							}
+							else if (c == 0x1b)	// VT100 processing
 							{
 								s_termios_state[port].escapeNext = true;
 							}
@@ -327,8 +407,10 @@ void bsp_termios_task(void* p_arg)
 							{
 								// just ignore these characters in canonical mode
 							}
-							else
+							else if (s_termios_state[port].cmdLen < sizeof(s_termios_state[port].cmd) - 1)
 							{
+								// past the end of the line (and its NUL) is dropped - noise on a port
+								// would otherwise run over the next port's state
 								s_termios_state[port].cmd[s_termios_state[port].cmdLen++] = c;
 								
 								if (s_termios_state[port].echo)
@@ -352,6 +434,10 @@ void bsp_termios_task(void* p_arg)
 							bsp_tkvs_msg_t* msg = bsp_tkvs_alloc(num_bytes);
 							bsp_circ_read(&s_termios_rx[port], msg->data, num_bytes);
 							msg->data_len = num_bytes;
+							if (s_termios_rx_tap)
+							{
+								s_termios_rx_tap(port, msg->data, num_bytes);
+							}
 							//print_dbg_char('R');
 							bsp_tkvs_publish(BSP_TERMIOS_PORT_TO_TKVS_SOURCE(port), BSP_TERMIOS_INPUT_RX, msg);
 						}
@@ -389,7 +475,8 @@ void bsp_termios_idle_loop(void)
 {
 	uint16_t size, watermark;
 	INT32U current_tick = OSTimeGet();
-	bool bufferTimeout = false;
+	bool bufferTimeout = false, hold = false;
+	irqflags_t flags;
 	
 	if ((current_tick - s_last_tick) > BSP_TERMIOS_BUFFER_MIN_TICKS)
 	{
@@ -434,6 +521,19 @@ void bsp_termios_idle_loop(void)
 		}
 		s_idle_task_tick = current_tick;
 	}	
+	
+	// the buffer timeout and the idle handlers count ticks.  interrupts off, since the ISR takes the hold
+	flags = cpu_irq_save();
+	for (int i=0; i<BSP_TERMIOS_COUNT; i++)
+	{
+		if (s_termios_state[i].handler != NULL ||
+			(s_termios_state[i].buffer != BSP_TERMIOS_BUFFER_NONE && bsp_circ_size(&s_termios_rx[i]) > 0))
+		{
+			hold = true;
+		}
+	}
+	bsp_idle_hold_tick(BSP_IDLE_HOLD_TERMIOS, hold);
+	cpu_irq_restore(flags);
 }
 
 /*
@@ -481,6 +581,99 @@ void bsp_termios_register_idle_handler(uint8_t port, bsp_termios_idle_handler_t
 	s_termios_state[port].handler = handler;
 }
 
+const char *bsp_termios_port_name(uint8_t port)
+{
+	return s_termios[port].name;
+}
+
+uint16_t bsp_termios_inject(uint8_t port, const void *data, uint16_t len)
+{
+	// the ISR writes the same buffer and counts what it writes
+	irqflags_t flags = cpu_irq_save();
+	len = bsp_circ_write(&s_termios_rx[port], data, len);
+	s_termios_state[port].rxCount += len;
+	cpu_irq_restore(flags);
+	return len;
+}
+
+uint32_t bsp_termios_rx_cycles(uint8_t port, uint32_t index)
+{
+	struct termios_state *state = &s_termios_state[port];
+	uint32_t best = TERMIOS_RX_STAMP_REACH, cycle = 0, d;
+	irqflags_t flags = cpu_irq_save();
+	
+	// the latest burst that started at or before the byte
+	for (int i=0; i<TERMIOS_RX_STAMPS; i++)
+	{
+		d = index - state->rxStamp[i].index;
+		if (d < best && (int32_t) (index - state->rxCount) < 0)
+		{
+			best = d;
+			cycle = state->rxStamp[i].cycle + d * state->charCycles;
+		}
+	}
+	cpu_irq_restore(flags);
+	
+	return cycle;
+}
+
+uint32_t bsp_termios_tx_cycles(uint8_t port)
+{
+	// what's queued, then the byte itself
+	return (bsp_circ_size(&s_termios_tx[port]) + 1) * s_termios_state[port].charCycles;
+}
+
+void bsp_termios_set_rx_mute(uint8_t port, bool mute)
+{
+	s_termios_state[port].rxMute = mute;
+}
+
+void bsp_termios_set_rx_tap(bsp_termios_rx_tap_t tap)
+{
+	s_termios_rx_tap = tap;
+}
+
+void bsp_termios_set_mode(uint8_t port, bsp_termios_mode mode, bool echo)
+{
+	// the termios task mustn't see half a change
+	OSSchedLock();
+	s_termios_state[port].mode = mode;
+	s_termios_state[port].echo = echo;
+	s_termios_state[port].escapeNext = false;
+	s_termios_state[port].cmdLen = 0;
+	s_termios_state[port].cmd[0] = '\0';
+	OSSchedUnlock();
+}
+
+void bsp_termios_set_baud(uint8_t port, uint32_t baud)
+{
+	usart_options_t usart_options =
+	{
+		.baudrate = baud,
+		.charlength = 8,
+		.paritytype = USART_NO_PARITY,
+		.stopbits = USART_1_STOPBIT,
+		.channelmode = USART_NORMAL_CHMODE
+	};
+	volatile avr32_usart_t *usart = s_termios[port].usart;
+	irqflags_t flags;
+	
+	// let the queue and the shift register empty at the old rate
+	bsp_termios_flush(port);
+	bsp_termios_drain(port, BSP_TERMIOS_DRAIN_UNTIL_EMPTY);
+	while (!usart_tx_empty(usart))
+	{
+		bsp_delay(1);
+	}
+	
+	// re-initializing the USART disables its interrupts
+	flags = cpu_irq_save();
+	usart_init_rs232(usart, &usart_options, sysclk_get_peripheral_bus_hz((void *)usart));
+	usart->ier = AVR32_USART_IER_RXRDY_MASK;
+	s_termios_state[port].charCycles = termios_char_cycles(baud);
+	cpu_irq_restore(flags);
+}
+
 void bsp_termios_set_buffer(uint8_t port, bsp_termios_buffer buffer)
 {
 	s_termios_state[port].buffer = buffer;
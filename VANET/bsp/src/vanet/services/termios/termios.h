@@ -57,6 +57,9 @@ bool bsp_termios_find_port(const char *name, uint8_t *port);
 
 void bsp_termios_set_mode(uint8_t port, bsp_termios_mode mode, bool echo);
 
+/// Change a port's baud rate.  Waits for what's queued to go out at the old rate first
+void bsp_termios_set_baud(uint8_t port, uint32_t baud);
+
 void bsp_termios_set_buffer(uint8_t port, bsp_termios_buffer buffer);
 
 void bsp_termios_flush(uint8_t port);
@@ -79,6 +82,38 @@ typedef void (*bsp_termios_idle_handler_t)(uint8_t port);
 /// Register an idle handler
 void bsp_termios_register_idle_handler(uint8_t port, bsp_termios_idle_handler_t handler);
 
+/// The name of a port (see bsp_termios_find_port)
+const char *bsp_termios_port_name(uint8_t port);
+
+/// Queue bytes on a port as if the USART received them.  Returns the number that fit
+uint16_t bsp_termios_inject(uint8_t port, const void *data, uint16_t len);
+
+/// Drop what the USART receives on a port.  Injected bytes still go through
+void bsp_termios_set_rx_mute(uint8_t port, bool mute);
+
+/**
+ * When a received byte arrived, from the USART interrupt
+ *
+ * The receive stream is every byte the port has received or been injected,
+ * in the order it hands them out, the first being index 0.  The interrupt stamps the first byte of each burst;
+ * the bytes after it are timed a character apart.
+ *
+ * @param port The port
+ * @param index The byte's index in the receive stream
+ * @return The low 32 bits of the cycle count, or 0 if the byte isn't one of
+ *         the last few bursts
+ */
+uint32_t bsp_termios_rx_cycles(uint8_t port, uint32_t index);
+
+/// Cycles until a byte written now has been sent, at the current baud
+uint32_t bsp_termios_tx_cycles(uint8_t port);
+
+/// Receive tap - called from the termios task with every received byte, in order, before it is parsed
+typedef void (*bsp_termios_rx_tap_t)(uint8_t port, const uint8_t *data, uint16_t len);
+
+/// Set the receive tap (NULL to remove it)
+void bsp_termios_set_rx_tap(bsp_termios_rx_tap_t tap);
+
 /// Map Termios Port to TKVS Source
 #define BSP_TERMIOS_PORT_TO_TKVS_SOURCE(_port)		(BSP_TKVS_SRC_TERMIOS_PORT_START + _port)
 
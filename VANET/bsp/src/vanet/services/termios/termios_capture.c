@@ -0,0 +1,669 @@
+/**
+ *	@file	termios_capture.c
+ *
+ *	@brief	Record and replay of the bytes termios receives
+ *
+ *  Capture hangs off the termios receive tap.  Replay runs from the idle loop:
+ *  it only injects when every task above it has finished with what it was
+ *  given, so the GPS and mux tasks set the pace of an accelerated replay
+ *  instead of losing messages off the ends of their queues.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#ifdef VANET_SIM
+#include <stdio.h>
+#endif
+#include "asf.h"
+#include "vanet.h"
+
+#ifdef CONFIG_BSP_ENABLE_TERMIOS_CAPTURE
+
+#define CAPTURE_MAX_DATA            (BSP_CAPTURE_MAX_RECORD - BSP_CAPTURE_HDR_SIZE)
+#define CAPTURE_COUNT_WRAP_MS       100000          // COUNT wraps every 134 s at 32 MHz
+
+#define REPLAY_BUF_SIZE             1024
+#define REPLAY_MAX_PORTS            8               // recorded port numbers we can map
+#define REPLAY_MAX_SPEED            1000
+#define REPLAY_UNMAPPED             0xff
+
+// vanet-sim can use files as well as the mux
+#ifdef VANET_SIM
+#define CAPTURE_HELP_FILE           "capture file <path> <port> [<port>...]  Record ports to a file\r\n"
+#define REPLAY_HELP_FILE            "replay file <path> [speed]            Replay a capture file\r\n"
+#else
+#define CAPTURE_HELP_FILE           ""
+#define REPLAY_HELP_FILE            ""
+#endif
+
+/// Microsecond clock off the cycle counter, carried past its wrap by the uptime
+typedef struct
+{
+	uint64_t us;
+	uint32_t count;
+	uint32_t uptime;
+} capture_clock_t;
+
+/// Where capture records go
+typedef enum
+{
+	CAPTURE_SINK_MUX,
+	CAPTURE_SINK_FILE,                              ///< vanet-sim only
+} capture_sink_t;
+
+typedef enum
+{
+	REPLAY_IDLE,
+	REPLAY_RUNNING,
+	REPLAY_DONE,
+} replay_state_t;
+
+static const char *s_replay_state_names[] = { "idle", "running", "done" };
+
+// capture
+static uint8_t s_capture_ports;                     // bit per termios port, 0 when stopped
+static capture_sink_t s_capture_sink;
+static capture_clock_t s_capture_clock;
+static uint64_t s_capture_last_us;
+static uint32_t s_capture_records;
+static uint32_t s_capture_bytes;
+
+// replay - the idle loop owns it once it's running
+static volatile replay_state_t s_replay_state;
+static volatile bool s_replay_stop;
+static bool s_replay_from_mux;
+static bool s_replay_eof;                           // the source has nothing more to give
+static uint16_t s_replay_speed;                     // 0 - as fast as it will go
+static bsp_circ_buffer_t s_replay_buf;
+static uint8_t s_replay_mem[REPLAY_BUF_SIZE];
+static uint8_t s_replay_map[REPLAY_MAX_PORTS];      // recorded port -> termios port
+static uint8_t s_replay_muted;                      // bit per termios port
+static capture_clock_t s_replay_clock;
+static bool s_replay_clock_running;
+static uint64_t s_replay_due_us;                    // recorded time of the current record
+static uint64_t s_replay_wall_us;
+static bool s_replay_in_record;
+static uint8_t s_replay_type;
+static uint8_t s_replay_port;
+static uint16_t s_replay_left;
+static bool s_replay_stalled;
+static const char *s_replay_error;
+
+static uint32_t s_replay_records;
+static uint32_t s_replay_bytes;
+static uint32_t s_replay_stalls;
+static uint32_t s_replay_drops;
+static uint32_t s_replay_late_ms;
+
+static OS_EVENT* s_replay_queue;
+static void *s_replay_queue_msgs[8];
+
+#ifdef VANET_SIM
+static FILE *s_capture_file;
+static FILE *s_replay_file;
+#endif
+
+/* -----------
+ *  Clock
+ * ----------*/
+static void capture_clock_start(capture_clock_t *clk)
+{
+	clk->us = 0;
+	clk->count = Get_sys_count();
+	clk->uptime = bsp_rtc_get_uptime();
+}
+
+static uint64_t capture_clock_us(capture_clock_t *clk)
+{
+	uint32_t count = Get_sys_count();
+	uint32_t uptime = bsp_rtc_get_uptime();
+	uint32_t cy_per_us = sysclk_get_cpu_hz() / 1000000;
+	uint64_t us;
+
+	// signed - the uptime's millisecond part can step back a little at a second boundary
+	if ((int32_t) (uptime - clk->uptime) > CAPTURE_COUNT_WRAP_MS)
+	{
+		// the counter may have wrapped - milliseconds will do for a gap this long
+		us = (uint64_t) (uptime - clk->uptime) * 1000;
+		clk->count = count;
+	}
+	else
+	{
+		// whole microseconds, the remainder carries to the next call
+		us = (count - clk->count) / cy_per_us;
+		clk->count += (uint32_t) us * cy_per_us;
+	}
+	clk->uptime = uptime;
+	clk->us += us;
+
+	return clk->us;
+}
+
+/* -----------
+ *  Capture
+ * ----------*/
+static void capture_record(uint8_t type, uint8_t port, const void *data, uint16_t len)
+{
+	uint8_t rec[BSP_CAPTURE_MAX_RECORD];
+	uint64_t now = capture_clock_us(&s_capture_clock);
+	uint32_t delta = (uint32_t) min(now - s_capture_last_us, UINT32_MAX);
+
+	s_capture_last_us = now;
+
+	rec[0] = type;
+	rec[1] = port;
+	rec[2] = len >> 8;
+	rec[3] = len;
+	rec[4] = delta >> 24;
+	rec[5] = delta >> 16;
+	rec[6] = delta >> 8;
+	rec[7] = delta;
+	if (len) memcpy(&rec[BSP_CAPTURE_HDR_SIZE], data, len);
+
+	if (s_capture_sink == CAPTURE_SINK_MUX)
+	{
+		bsp_mux_send(CONFIG_BSP_TERMIOS_CAPTURE_DLCI, rec, BSP_CAPTURE_HDR_SIZE + len);
+	}
+	#ifdef VANET_SIM
+	else
+	{
+		fwrite(rec, 1, BSP_CAPTURE_HDR_SIZE + len, s_capture_file);
+	}
+	#endif
+
+	s_capture_records++;
+}
+
+/// Receive tap, in the termios task
+static void capture_tap(uint8_t port, const uint8_t *data, uint16_t len)
+{
+	uint16_t n;
+
+	if (!(s_capture_ports & (1 << port)))
+		return;
+
+	s_capture_bytes += len;
+	while (len > 0)
+	{
+		n = min(len, CAPTURE_MAX_DATA);
+		capture_record(BSP_CAPTURE_DATA, port, data, n);
+		data += n;
+		len -= n;
+	}
+}
+
+static void capture_start(int argc, char **argv, uint8_t port)
+{
+	uint8_t ports = 0, p;
+	uint8_t version = BSP_CAPTURE_FORMAT;
+	const char *name;
+
+	for (int i=0; i<argc; i++)
+	{
+		if (!bsp_termios_find_port(argv[i], &p))
+		{
+			bsp_termios_printf(port, "Unknown port %s\r\n", argv[i]);
+			return;
+		}
+		ports |= 1 << p;
+	}
+
+	capture_clock_start(&s_capture_clock);
+	s_capture_last_us = 0;
+	s_capture_records = 0;
+	s_capture_bytes = 0;
+
+	capture_record(BSP_CAPTURE_VERSION, 0, &version, 1);
+	for (p=0; p<BSP_TERMIOS_COUNT; p++)
+	{
+		if (ports & (1 << p))
+		{
+			name = bsp_termios_port_name(p);
+			capture_record(BSP_CAPTURE_NAME, p, name, strlen(name));
+		}
+	}
+
+	// the names are out before the first data
+	s_capture_ports = ports;
+	bsp_termios_set_rx_tap(capture_tap);
+}
+
+static void capture_stop(void)
+{
+	// the termios task outranks us, so it isn't part way through the tap
+	bsp_termios_set_rx_tap(NULL);
+	s_capture_ports = 0;
+
+	capture_record(BSP_CAPTURE_END, 0, NULL, 0);
+
+	#ifdef VANET_SIM
+	if (s_capture_file)
+	{
+		fclose(s_capture_file);
+		s_capture_file = NULL;
+	}
+	#endif
+}
+
+/* -----------
+ *  Replay
+ * ----------*/
+static uint64_t replay_now(void)
+{
+	if (s_replay_speed == 0)
+		return UINT64_MAX;
+
+	return capture_clock_us(&s_replay_clock) * s_replay_speed;
+}
+
+static void replay_finish(const char *error)
+{
+	s_replay_error = error;
+	s_replay_wall_us = s_replay_clock_running ? capture_clock_us(&s_replay_clock) : 0;
+
+	for (int i=0; i<BSP_TERMIOS_COUNT; i++)
+	{
+		if (s_replay_muted & (1 << i))
+		{
+			bsp_termios_set_rx_mute(i, false);
+		}
+	}
+	s_replay_muted = 0;
+
+	#ifdef VANET_SIM
+	if (s_replay_file)
+	{
+		fclose(s_replay_file);
+		s_replay_file = NULL;
+	}
+	#endif
+
+	sleepmgr_abstain_preferred_sleep(SYS_REPLAY);
+	bsp_idle_hold_tick(BSP_IDLE_HOLD_REPLAY, false);
+	s_replay_state = REPLAY_DONE;
+}
+
+/// Top up the replay buffer from the mux channel or the file
+static void replay_fill(void)
+{
+	bsp_tkvs_msg_t *msg;
+	INT8U perr;
+	uint16_t n;
+
+	// drained whether or not we're replaying, so the queue can't back up
+	while ((msg = (bsp_tkvs_msg_t*) OSQAccept(s_replay_queue, &perr)) != NULL)
+	{
+		if (s_replay_state == REPLAY_RUNNING && s_replay_from_mux &&
+			msg->event == BSP_MUX_EVENT_DATA_RCVD && BSP_TKVS_MSG_HAS_DATA(msg))
+		{
+			n = bsp_circ_write(&s_replay_buf, msg->data, msg->data_len);
+			s_replay_drops += msg->data_len - n;
+		}
+		bsp_tkvs_free(msg);
+	}
+
+	#ifdef VANET_SIM
+	if (s_replay_state == REPLAY_RUNNING && s_replay_file && !s_replay_eof)
+	{
+		uint8_t buf[256];
+
+		n = min(bsp_circ_free(&s_replay_buf), sizeof(buf));
+		if (n > 0)
+		{
+			n = fread(buf, 1, n, s_replay_file);
+			if (n == 0) s_replay_eof = true;
+			bsp_circ_write(&s_replay_buf, buf, n);
+		}
+	}
+	#endif
+}
+
+/// Move the replay along by one header or one piece of data.  False when it has to wait
+static bool replay_step(void)
+{
+	uint8_t buf[BSP_CAPTURE_MAX_RECORD];
+	uint64_t now;
+	uint16_t n, len;
+	uint8_t port;
+
+	if (!s_replay_in_record)
+	{
+		if (bsp_circ_size(&s_replay_buf) < BSP_CAPTURE_HDR_SIZE)
+		{
+			if (s_replay_eof) replay_finish(bsp_circ_size(&s_replay_buf) ? "truncated" : NULL);
+			return false;
+		}
+
+		bsp_circ_read(&s_replay_buf, buf, BSP_CAPTURE_HDR_SIZE);
+		s_replay_type = buf[0];
+		s_replay_port = buf[1];
+		s_replay_left = ((uint16_t) buf[2] << 8) | buf[3];
+		s_replay_due_us += ((uint32_t) buf[4] << 24) | ((uint32_t) buf[5] << 16) | ((uint32_t) buf[6] << 8) | buf[7];
+		s_replay_in_record = true;
+		s_replay_stalled = false;
+
+		// the recording's clock starts at its first record, not at "replay start"
+		if (!s_replay_clock_running)
+		{
+			capture_clock_start(&s_replay_clock);
+			s_replay_clock_running = true;
+		}
+	}
+
+	now = replay_now();
+	if (s_replay_due_us > now)
+		return false;
+
+	switch (s_replay_type)
+	{
+		case BSP_CAPTURE_DATA:
+			n = bsp_circ_peek(&s_replay_buf, bsp_circ_begin(&s_replay_buf), buf, min(s_replay_left, sizeof(buf)));
+			if (n == 0)
+			{
+				if (s_replay_eof) replay_finish("truncated");
+				return false;
+			}
+
+			if (s_replay_speed && !s_replay_stalled && (now - s_replay_due_us) / 1000 > s_replay_late_ms)
+			{
+				s_replay_late_ms = (now - s_replay_due_us) / 1000;
+			}
+
+			port = s_replay_port < REPLAY_MAX_PORTS ? s_replay_map[s_replay_port] : REPLAY_UNMAPPED;
+			len = (port == REPLAY_UNMAPPED) ? n : bsp_termios_inject(port, buf, n);
+			bsp_circ_read(&s_replay_buf, buf, len);
+			s_replay_left -= len;
+			s_replay_bytes += len;
+
+			if (len < n)
+			{
+				// the port's receive buffer is full - wait for termios to parse it
+				if (!s_replay_stalled) s_replay_stalls++;
+				s_replay_stalled = true;
+				return false;
+			}
+			break;
+
+		case BSP_CAPTURE_VERSION:
+		case BSP_CAPTURE_NAME:
+			if (s_replay_left > CAPTURE_MAX_DATA)
+			{
+				replay_finish("bad record");
+				return false;
+			}
+			if (bsp_circ_size(&s_replay_buf) < s_replay_left)
+			{
+				if (s_replay_eof) replay_finish("truncated");
+				return false;
+			}
+
+			bsp_circ_read(&s_replay_buf, buf, s_replay_left);
+			buf[s_replay_left] = '\0';
+
+			if (s_replay_type == BSP_CAPTURE_VERSION)
+			{
+				if (s_replay_left != 1 || buf[0] != BSP_CAPTURE_FORMAT)
+				{
+					replay_finish("bad version");
+					return false;
+				}
+			}
+			else if (s_replay_port < REPLAY_MAX_PORTS && bsp_termios_find_port((const char *)buf, &port))
+			{
+				s_replay_map[s_replay_port] = port;
+				s_replay_muted |= 1 << port;
+				bsp_termios_set_rx_mute(port, true);
+			}
+			s_replay_left = 0;
+			break;
+
+		case BSP_CAPTURE_END:
+			s_replay_records++;
+			replay_finish(NULL);
+			return false;
+
+		default:
+			replay_finish("bad record");
+			return false;
+	}
+
+	if (s_replay_left == 0)
+	{
+		s_replay_in_record = false;
+		s_replay_records++;
+	}
+	return true;
+}
+
+static void replay_idle(void)
+{
+	replay_fill();
+
+	if (s_replay_state != REPLAY_RUNNING)
+		return;
+
+	if (s_replay_stop)
+	{
+		replay_finish("stopped");
+		return;
+	}
+
+	// until it has to wait for a full port to be parsed or a record to come due
+	while (s_replay_state == REPLAY_RUNNING && replay_step())
+		;
+}
+
+static void replay_start(uint16_t speed, bool from_mux)
+{
+	bsp_circ_clear(&s_replay_buf);
+	memset(s_replay_map, REPLAY_UNMAPPED, sizeof(s_replay_map));
+	s_replay_muted = 0;
+	s_replay_speed = speed;
+	s_replay_from_mux = from_mux;
+	s_replay_eof = false;
+	s_replay_stop = false;
+	s_replay_clock_running = false;
+	s_replay_due_us = 0;
+	s_replay_wall_us = 0;
+	s_replay_in_record = false;
+	s_replay_error = NULL;
+	s_replay_records = 0;
+	s_replay_bytes = 0;
+	s_replay_stalls = 0;
+	s_replay_drops = 0;
+	s_replay_late_ms = 0;
+
+	// an accelerated replay can't wait for the next tick to wake the idle loop,
+	// and a paced one's next record is no OS deadline, so the tick can't stop
+	if (speed != 1)
+	{
+		sleepmgr_vote_preferred_sleep(SYS_REPLAY, SLEEPMGR_ACTIVE);
+	}
+	bsp_idle_hold_tick(BSP_IDLE_HOLD_REPLAY, true);
+
+	s_replay_state = REPLAY_RUNNING;
+}
+
+static void replay_status(uint8_t port)
+{
+	// the idle loop owns the clock - while it's running, this is as of its last look
+	uint64_t wall_us = s_replay_state == REPLAY_RUNNING ? s_replay_clock.us : s_replay_wall_us;
+	uint32_t recorded_ms = (uint32_t) (s_replay_due_us / 1000);
+	uint32_t wall_ms = (uint32_t) (wall_us / 1000);
+	uint32_t speed = wall_us ? (uint32_t) (s_replay_due_us * 100 / wall_us) : 0;
+
+	bsp_termios_printf(port, "replay state=%s records=%u bytes=%u recorded_ms=%u wall_ms=%u speed=%u.%02u "
+		"stalls=%u drops=%u late_ms=%u error=%s\r\n",
+		s_replay_state_names[s_replay_state], s_replay_records, s_replay_bytes, recorded_ms, wall_ms,
+		speed / 100, speed % 100, s_replay_stalls, s_replay_drops, s_replay_late_ms,
+		s_replay_error ? s_replay_error : "none");
+}
+
+/* -----------
+ *  CAPTURE
+ * ----------*/
+static void capture_handler(int argc, char** argv, uint8_t port)
+{
+	if (argc == 1)
+	{
+		bsp_termios_printf(port, "capture state=%s ports=%02x records=%u bytes=%u\r\n",
+			s_capture_ports ? "on" : "off", s_capture_ports, s_capture_records, s_capture_bytes);
+	}
+	else if (!strcasecmp(argv[1], "stop"))
+	{
+		if (s_capture_ports) capture_stop();
+	}
+	else if (s_capture_ports)
+	{
+		bsp_termios_write_str(port, "Already capturing\r\n");
+	}
+	else if (!strcasecmp(argv[1], "start") && argc > 2)
+	{
+		s_capture_sink = CAPTURE_SINK_MUX;
+		capture_start(argc - 2, &argv[2], port);
+	}
+	#ifdef VANET_SIM
+	else if (!strcasecmp(argv[1], "file") && argc > 3)
+	{
+		s_capture_file = fopen(argv[2], "wb");
+		if (!s_capture_file)
+		{
+			bsp_termios_printf(port, "Can't create %s\r\n", argv[2]);
+			return;
+		}
+		s_capture_sink = CAPTURE_SINK_FILE;
+		capture_start(argc - 3, &argv[3], port);
+		if (!s_capture_ports)
+		{
+			fclose(s_capture_file);
+			s_capture_file = NULL;
+		}
+	}
+	#endif
+	else
+	{
+		bsp_termios_write_str(port, "Invalid arguments\r\n");
+	}
+}
+
+static bsp_sti_command_t capture_command =
+{
+	.name = "capture",
+	.handler = &capture_handler,
+	.minArgs = 0,
+	.maxArgs = 2 + BSP_TERMIOS_COUNT,
+	STI_HELP("capture                               Show the capture state\r\n"
+	         "capture start <port> [<port>...]      Record ports to the capture mux channel\r\n"
+	         CAPTURE_HELP_FILE
+	         "capture stop                          Stop recording\r\n"
+	         "\r\n"
+	         "The mux drops what's sent on a channel nobody has open - start \"vcap rec\" first.\r\n"
+	         "\r\n"
+	         "Examples:\r\n"
+	         "    capture start GPS MUX             Record the GPS and the mux link")
+};
+
+/* -----------
+ *  REPLAY
+ * ----------*/
+static void replay_handler(int argc, char** argv, uint8_t port)
+{
+	int speed = 1;
+
+	if (argc == 1)
+	{
+		replay_status(port);
+	}
+	else if (!strcasecmp(argv[1], "stop") || !strcasecmp(argv[1], "wait"))
+	{
+		if (!strcasecmp(argv[1], "stop")) s_replay_stop = true;
+
+		// the idle loop finishes it
+		while (s_replay_state == REPLAY_RUNNING)
+		{
+			bsp_delay(50);
+		}
+		replay_status(port);
+	}
+	else if (s_replay_state == REPLAY_RUNNING)
+	{
+		bsp_termios_write_str(port, "Already replaying\r\n");
+	}
+	else if (!strcasecmp(argv[1], "start"))
+	{
+		if (argc > 2) speed = atoi(argv[2]);
+		if (speed < 0 || speed > REPLAY_MAX_SPEED)
+		{
+			bsp_termios_printf(port, "speed must be 0..%d\r\n", REPLAY_MAX_SPEED);
+			return;
+		}
+		replay_start(speed, true);
+	}
+	#ifdef VANET_SIM
+	else if (!strcasecmp(argv[1], "file") && argc > 2)
+	{
+		if (argc > 3) speed = atoi(argv[3]);
+		if (speed < 0 || speed > REPLAY_MAX_SPEED)
+		{
+			bsp_termios_printf(port, "speed must be 0..%d\r\n", REPLAY_MAX_SPEED);
+			return;
+		}
+		s_replay_file = fopen(argv[2], "rb");
+		if (!s_replay_file)
+		{
+			bsp_termios_printf(port, "Can't open %s\r\n", argv[2]);
+			return;
+		}
+		replay_start(speed, false);
+	}
+	#endif
+	else
+	{
+		bsp_termios_write_str(port, "Invalid arguments\r\n");
+	}
+}
+
+static bsp_sti_command_t replay_command =
+{
+	.name = "replay",
+	.handler = &replay_handler,
+	.minArgs = 0,
+	.maxArgs = 3,
+	STI_HELP("replay                                Show the replay state and results\r\n"
+	         "replay start [speed]                  Replay what arrives on the capture mux channel\r\n"
+	         REPLAY_HELP_FILE
+	         "replay wait                           Wait for the replay to finish\r\n"
+	         "replay stop                           Stop replaying\r\n"
+	         "\r\n"
+	         "Options:\r\n"
+	         "    speed                             Times the recorded pace, 0 as fast as it goes (1)")
+};
+
+void bsp_termios_capture_init(void)
+{
+	bsp_circ_init(&s_replay_buf, s_replay_mem, sizeof(s_replay_mem));
+
+	// the mux only opens a channel somebody is subscribed to - this is also the capture sink's
+	s_replay_queue = OSQCreate(&s_replay_queue_msgs[0], sizeof(s_replay_queue_msgs)/sizeof(s_replay_queue_msgs[0]));
+	OS_CHECK_NULL(s_replay_queue, "capture: OSQCreate");
+	bsp_tkvs_subscribe(BSP_MUX_DLCI_TO_TKVS_SOURCE(CONFIG_BSP_TERMIOS_CAPTURE_DLCI), BSP_TKVS_ALL_EVENTS,
+		s_replay_queue, OS_TASK_IDLE_PRIO);
+
+	bsp_idle_register_idle_function(replay_idle, BSP_IDLE_ALWAYS);
+
+	bsp_sti_register_command(&capture_command);
+	bsp_sti_register_command(&replay_command);
+}
+
+#endif // CONFIG_BSP_ENABLE_TERMIOS_CAPTURE
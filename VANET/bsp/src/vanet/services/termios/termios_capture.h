@@ -0,0 +1,69 @@
+/**
+ *	@file	termios_capture.h
+ *
+ *	@brief	Record and replay of the bytes termios receives
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef BSP_TERMIOS_CAPTURE_H
+#define BSP_TERMIOS_CAPTURE_H
+
+/**
+ * "capture" records what the termios task parses on the chosen ports as a
+ * stream of records on the capture mux channel (or to a file in vanet-sim).
+ * "replay" feeds a stream like that back into the same ports, by name, at the
+ * recorded pace times a speed factor - or as fast as the consumers keep up
+ * (speed 0).  While a port is being replayed its USART input is dropped.
+ *
+ * Every record is an 8 byte header and its data, all big-endian:
+ *
+ *      +-- Type (8 bits)
+ *      |   +-- Port (8 bits)
+ *      |   |   +-- Data length (16 bits)
+ *      |   |   |       +-- Microseconds since the previous record (32 bits)
+ *      |   |   |       |               +-- Data ...
+ *      |   |   |       |               |
+ *    | 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | ...
+ *
+ * A stream starts with a version record and one name record per port, and
+ * ends with an end record.  Data is timed when the termios task parses it,
+ * so buffered ports (GPS) are stamped per batch, not per byte.
+ *
+ * @{
+ */
+
+/// Record types
+enum
+{
+	BSP_CAPTURE_VERSION			= 'V',		///< Data is the format version (1 byte)
+	BSP_CAPTURE_NAME			= 'N',		///< Data is the port's termios name
+	BSP_CAPTURE_DATA			= 'D',		///< Data is bytes received on the port
+	BSP_CAPTURE_END				= 'E',		///< No data, end of the stream
+};
+
+/// Format version
+#define BSP_CAPTURE_FORMAT			1
+
+/// Record header size
+#define BSP_CAPTURE_HDR_SIZE		8
+
+/// Largest record sent - one mux frame
+#define BSP_CAPTURE_MAX_RECORD		64
+
+/// Initialization - after the mux
+extern void bsp_termios_capture_init(void);
+
+/// @}
+
+#endif // BSP_TERMIOS_CAPTURE_H
@@ -38,6 +38,12 @@ static subscription_t s_subscriptions[CONFIG_BSP_TKVS_MAX_SUBSCRIPTIONS];
 
 static uint32_t s_alloc_cnt, s_free_cnt;
 
+#ifdef CONFIG_BSP_ENABLE_RTC
+// publish to last free - how long the slowest subscriber took to get to it
+static uint32_t s_latency_cnt, s_latency_max_us;
+static uint64_t s_latency_total_us;
+#endif
+
 #ifdef CONFIG_BSP_TKVS_ENABLE_1STICK
 static bsp_tkvs_timer_t tkvs_1s_tick;
 #endif // CONFIG_BSP_TKVS_ENABLE_1STICK
@@ -106,6 +112,12 @@ static void tkvs_handler(int argc, char** argv, uint8_t port)
     }
 	// Note the +1 hackery - we are responding to a TKVS message so we have not freed it yet
 	bsp_termios_printf(port, "Allocs: %u\r\nFree: %u\r\n", s_alloc_cnt, s_free_cnt+1);
+    #ifdef CONFIG_BSP_ENABLE_RTC
+    if (s_latency_cnt)
+    {
+        bsp_termios_printf(port, "Latency: avg %u us, max %u us\r\n", (uint32_t) (s_latency_total_us / s_latency_cnt), s_latency_max_us);
+    }
+    #endif
 }
 
 static bsp_sti_command_t tkvs_command =
@@ -124,6 +136,11 @@ void bsp_tkvs_init(void)
 	print_dbg("Initializing TKVS\r\n");
     s_alloc_cnt = 0;
     s_free_cnt = 0;
+    #ifdef CONFIG_BSP_ENABLE_RTC
+    s_latency_cnt = 0;
+    s_latency_max_us = 0;
+    s_latency_total_us = 0;
+    #endif
     memset(s_subscriptions, 0, sizeof(s_subscriptions));
     
     #ifdef CONFIG_BSP_TKVS_ENABLE_1STICK
@@ -156,11 +173,22 @@ bsp_tkvs_msg_t* bsp_tkvs_alloc(uint16_t data_length)
 void bsp_tkvs_free(bsp_tkvs_msg_t* msg)
 {
     irqflags_t flags;
+    #ifdef CONFIG_BSP_ENABLE_RTC
+    uint32_t latency_us;
+    #endif
         
     if (msg->int_hdr.ref > 0 && --msg->int_hdr.ref == 0)
     {
+        #ifdef CONFIG_BSP_ENABLE_RTC
+        latency_us = (uint32_t) bsp_rtc_get_time_us() - msg->int_hdr.time_us;
+        #endif
         flags = cpu_irq_save();
         s_free_cnt++;
+        #ifdef CONFIG_BSP_ENABLE_RTC
+        s_latency_cnt++;
+        s_latency_total_us += latency_us;
+        if (latency_us > s_latency_max_us) s_latency_max_us = latency_us;
+        #endif
         cpu_irq_restore(flags);
 		
 		/*{		
@@ -199,6 +227,28 @@ bool bsp_tkvs_subscribe(uint8_t source, uint16_t event_mask, OS_EVENT* queue, IN
     return false;
 }
 
+void bsp_tkvs_unsubscribe(uint8_t source, OS_EVENT* queue)
+{
+    irqflags_t flags;
+    int i, j;
+    
+    // publish walks the table until the first empty entry, so close the gap.
+    // ISRs publish too - keep them out while the table moves
+    flags = cpu_irq_save();
+    for (i=0, j=0; i<CONFIG_BSP_TKVS_MAX_SUBSCRIPTIONS && s_subscriptions[i].queue; i++)
+    {
+        if (s_subscriptions[i].source != source || s_subscriptions[i].queue != queue)
+        {
+            s_subscriptions[j++] = s_subscriptions[i];
+        }
+    }
+    for (; j<i; j++)
+    {
+        memset(&s_subscriptions[j], 0, sizeof(subscription_t));
+    }
+    cpu_irq_restore(flags);
+}
+
 void bsp_tkvs_publish(uint8_t source, uint16_t event, bsp_tkvs_msg_t* msg)
 {
 	INT8U *task_name_ptr;
@@ -208,6 +258,9 @@ void bsp_tkvs_publish(uint8_t source, uint16_t event, bsp_tkvs_msg_t* msg)
     
     msg->source = source;
     msg->event = event;
+    #ifdef CONFIG_BSP_ENABLE_RTC
+    msg->int_hdr.time_us = (uint32_t) bsp_rtc_get_time_us();
+    #endif
     
     // Lock the scheduler so that we queue up all the messages before allowing
     // another task to run
@@ -223,6 +276,8 @@ void bsp_tkvs_publish(uint8_t source, uint16_t event, bsp_tkvs_msg_t* msg)
             OS_CHECK_PERR(perr, "TKVS Publish: OSQPost");
 			if (perr != OS_ERR_NONE)
 			{
+				// the subscriber never gets it, so it won't free it either
+				msg->int_hdr.ref--;
 				OSTaskNameGet(s->subscribed_os_pri, &task_name_ptr, &perr);
 				OS_CHECK_PERR(perr, "TKVS Subscribers: OSTaskNameGet");
 				print_dbgn((const char *)task_name_ptr, 16);
@@ -73,6 +73,10 @@ enum
 #ifdef CONFIG_BSP_ENABLE_PIN
 	BSP_TKVS_SRC_PIN,
 #endif // CONFIG_BSP_ENABLE_PIN
+
+#ifdef CONFIG_BSP_ENABLE_BENCH
+	BSP_TKVS_SRC_BENCH,					///< Benchmarks - see bench.h
+#endif // CONFIG_BSP_ENABLE_BENCH
 	
     BSP_TKVS_SRC_APP_START              ///< Start of application specific sources, see conf_tkvs.h
 };
@@ -84,6 +88,7 @@ typedef struct
     {
         uint8_t ref;
         uint8_t unused[3];
+        uint32_t time_us;           // when published, for the delivery latency
     } int_hdr;
     
     uint8_t source;                 ///< The publisher
@@ -116,6 +121,15 @@ extern void bsp_tkvs_free(bsp_tkvs_msg_t* msg);
  */
 extern bool bsp_tkvs_subscribe(uint8_t source, uint16_t event_mask, OS_EVENT* queue, INT8U task_prio);
 
+/**
+ * Remove every subscription of a queue to a source.  Messages already posted to
+ * the queue are still delivered.
+ *
+ * @param source            The message source
+ * @param queue             The OS queue given to bsp_tkvs_subscribe
+ */
+extern void bsp_tkvs_unsubscribe(uint8_t source, OS_EVENT* queue);
+
 /**
  * Publish a message using a pre-allocated message buffer
  *
@@ -0,0 +1,293 @@
+/**
+ *	@file	bench.c
+ *
+ *	@brief	Microbenchmarks of the BSP primitives
+ *
+ *  The services with private state (mux) and the application (gps) register
+ *  their own benchmarks with bsp_bench_register().
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asf.h"
+#include "vanet.h"
+
+#ifdef CONFIG_BSP_ENABLE_BENCH
+
+#define BENCH_DEFAULT_ROUNDS        8
+#define BENCH_MAX_ROUNDS            64
+#define BENCH_TKVS_MAX_FANOUT       4
+
+static bsp_bench_t *s_bench_head;
+
+static uint8_t s_data[512];
+static char s_text[128];
+
+static bsp_circ_buffer_t s_circ;
+static uint8_t s_circ_buf[256];
+
+static OS_EVENT* s_tkvs_queue;
+static void *s_tkvs_queue_msgs[BENCH_TKVS_MAX_FANOUT];
+static int s_tkvs_fanout;
+
+/* -----------
+ *  Benchmarks
+ * ----------*/
+static void bench_null(void)
+{
+}
+
+static bool bench_circ_setup(void)
+{
+	bsp_circ_init(&s_circ, s_circ_buf, sizeof(s_circ_buf));
+	return true;
+}
+
+static void bench_circ_byte(void)
+{
+	bsp_circ_writeb(&s_circ, 0x5a);
+	bsp_circ_readb(&s_circ);
+}
+
+static void bench_circ_block64(void)
+{
+	bsp_circ_write(&s_circ, s_data, 64);
+	bsp_circ_read(&s_circ, s_data, 64);
+}
+
+static void bench_malloc_free_64(void)
+{
+	bsp_free(bsp_malloc(64));
+}
+
+static void bench_malloc_free_512(void)
+{
+	bsp_free(bsp_malloc(512));
+}
+
+static bool bench_tkvs_setup(int fanout)
+{
+	if (!s_tkvs_queue)
+	{
+		s_tkvs_queue = OSQCreate(&s_tkvs_queue_msgs[0], BENCH_TKVS_MAX_FANOUT);
+		OS_CHECK_NULL(s_tkvs_queue, "bench: OSQCreate");
+		if (!s_tkvs_queue) return false;
+	}
+
+	// the same queue subscribed once per subscriber
+	for (s_tkvs_fanout = 0; s_tkvs_fanout < fanout; s_tkvs_fanout++)
+	{
+		bsp_tkvs_subscribe(BSP_TKVS_SRC_BENCH, BSP_TKVS_ALL_EVENTS, s_tkvs_queue, OSPrioCur);
+	}
+	return true;
+}
+
+static bool bench_tkvs_setup_1(void)
+{
+	return bench_tkvs_setup(1);
+}
+
+static bool bench_tkvs_setup_4(void)
+{
+	return bench_tkvs_setup(4);
+}
+
+static void bench_tkvs_teardown(void)
+{
+	bsp_tkvs_unsubscribe(BSP_TKVS_SRC_BENCH, s_tkvs_queue);
+}
+
+static void bench_tkvs_publish(void)
+{
+	bsp_tkvs_msg_t *msg;
+	INT8U perr;
+
+	// alloc, fan out and every subscriber's free - the whole life of a message
+	msg = bsp_tkvs_alloc(0);
+	msg->data_len = 0;
+	bsp_tkvs_publish(BSP_TKVS_SRC_BENCH, 1, msg);
+
+	for (int i=0; i<s_tkvs_fanout; i++)
+	{
+		msg = (bsp_tkvs_msg_t*) OSQAccept(s_tkvs_queue, &perr);
+		if (msg) bsp_tkvs_free(msg);
+	}
+}
+
+static void bench_dlib_vsnprintf(void)
+{
+	// dlib_snprintf() is an inline wrapper, the work is dlib_vsnprintf()
+	dlib_snprintf(s_text, sizeof(s_text), "%16s - Src: %u Mask: %04x Hits: %u\r\n", "Mux Task", 12, 0xffff, 123456);
+}
+
+static void bench_fletcher16_64(void)
+{
+	bsp_util_fletcher16(s_data, 64);
+}
+
+static void bench_fletcher16_512(void)
+{
+	bsp_util_fletcher16(s_data, 512);
+}
+
+static void bench_running_xsum_512(void)
+{
+	bsp_running_fletcher r;
+
+	bsp_util_running_xsum_init(&r);
+	bsp_util_running_xsum_add(&r, s_data, 512);
+	bsp_util_running_xsum_result(&r);
+}
+
+static void bench_fletcher32_512(void)
+{
+	bsp_util_fletcher32(s_data, 512);
+}
+
+static bsp_bench_t s_builtin[] =
+{
+	{ .name = "null",               .run = bench_null,              .iterations = 1024 },
+	{ .name = "circ_byte",          .run = bench_circ_byte,         .iterations = 1024, .bytes = 1,   .setup = bench_circ_setup },
+	{ .name = "circ_block64",       .run = bench_circ_block64,      .iterations = 256,  .bytes = 64,  .setup = bench_circ_setup },
+	{ .name = "malloc_free_64",     .run = bench_malloc_free_64,    .iterations = 256,  .bytes = 64 },
+	{ .name = "malloc_free_512",    .run = bench_malloc_free_512,   .iterations = 256,  .bytes = 512 },
+	{ .name = "tkvs_publish_1",     .run = bench_tkvs_publish,      .iterations = 256,
+	  .setup = bench_tkvs_setup_1,  .teardown = bench_tkvs_teardown },
+	{ .name = "tkvs_publish_4",     .run = bench_tkvs_publish,      .iterations = 256,
+	  .setup = bench_tkvs_setup_4,  .teardown = bench_tkvs_teardown },
+	{ .name = "dlib_vsnprintf",     .run = bench_dlib_vsnprintf,    .iterations = 64 },
+	{ .name = "fletcher16_64",      .run = bench_fletcher16_64,     .iterations = 256,  .bytes = 64 },
+	{ .name = "fletcher16_512",     .run = bench_fletcher16_512,    .iterations = 64,   .bytes = 512 },
+	{ .name = "fletcher32_512",     .run = bench_fletcher32_512,    .iterations = 64,   .bytes = 512 },
+	{ .name = "running_xsum_512",   .run = bench_running_xsum_512,  .iterations = 64,   .bytes = 512 },
+};
+
+/* -----------
+ *  Runner
+ * ----------*/
+static void bench_run(bsp_bench_t *bench, int rounds, uint8_t port)
+{
+	uint32_t t0, cycles, min = UINT32_MAX, avg;
+	uint64_t total = 0;
+
+	for (int r=0; r<rounds; r++)
+	{
+		// no other task runs from setup to teardown, so a benchmark can borrow
+		// a service's state and put it back
+		OSSchedLock();
+		if (bench->setup && !bench->setup())
+		{
+			OSSchedUnlock();
+			bsp_termios_printf(port, "bench name=%s failed\r\n", bench->name);
+			bsp_termios_flush(port);
+			return;
+		}
+
+		t0 = Get_sys_count();
+		for (uint16_t i=0; i<bench->iterations; i++)
+		{
+			bench->run();
+		}
+		cycles = Get_sys_count() - t0;
+
+		if (bench->teardown) bench->teardown();
+		OSSchedUnlock();
+
+		total += cycles;
+		if (cycles < min) min = cycles;
+	}
+
+	// per operation, in hundredths of a cycle
+	min = (uint32_t) ((uint64_t) min * 100 / bench->iterations);
+	avg = (uint32_t) (total * 100 / ((uint32_t) rounds * bench->iterations));
+
+	bsp_termios_printf(port, "bench name=%s n=%u rounds=%u min=%u.%02u avg=%u.%02u bytes=%u hz=%u\r\n",
+		bench->name, bench->iterations, rounds, min / 100, min % 100, avg / 100, avg % 100,
+		bench->bytes, sysclk_get_cpu_hz());
+	bsp_termios_flush(port);
+}
+
+/* -----------
+ *  BENCH
+ * ----------*/
+static void bench_handler(int argc, char** argv, uint8_t port)
+{
+	bsp_bench_t *bench;
+	int rounds = BENCH_DEFAULT_ROUNDS;
+	const char *prefix = "";
+	int count = 0;
+
+	if (argc > 1 && !strcasecmp(argv[1], "list"))
+	{
+		for (bench = s_bench_head; bench; bench = bench->next)
+		{
+			bsp_termios_printf(port, "%s\r\n", bench->name);
+		}
+		return;
+	}
+
+	if (argc > 1) prefix = argv[1];
+	if (argc > 2) rounds = atoi(argv[2]);
+	if (rounds < 1 || rounds > BENCH_MAX_ROUNDS)
+	{
+		bsp_termios_printf(port, "rounds must be 1..%d\r\n", BENCH_MAX_ROUNDS);
+		return;
+	}
+
+	// the start and end lines let a script know when to stop reading
+	bsp_termios_write_str(port, "bench start\r\n");
+	for (bench = s_bench_head; bench; bench = bench->next)
+	{
+		if (!strncmp(bench->name, prefix, strlen(prefix)) || !strcmp(prefix, "all"))
+		{
+			bench_run(bench, rounds, port);
+			count++;
+		}
+	}
+	bsp_termios_printf(port, "bench end count=%d\r\n", count);
+}
+
+static bsp_sti_command_t bench_command =
+{
+	.name = "bench",
+	.handler = &bench_handler,
+	.minArgs = 0,
+	.maxArgs = 2,
+	STI_HELP("bench [prefix|all] [rounds]           Run the benchmarks (cycles per op)\r\n"
+	         "bench list                            List the benchmarks")
+};
+
+void bsp_bench_init(void)
+{
+	memset(s_data, 0xa5, sizeof(s_data));
+
+	for (int i=0; i<sizeof(s_builtin)/sizeof(s_builtin[0]); i++)
+	{
+		bsp_bench_register(&s_builtin[i]);
+	}
+
+	bsp_sti_register_command(&bench_command);
+}
+
+void bsp_bench_register(bsp_bench_t* bench)
+{
+	bsp_bench_t **tail = &s_bench_head;
+
+	// kept in registration order so the output lines up run to run
+	while (*tail) tail = &(*tail)->next;
+	bench->next = 0;
+	*tail = bench;
+}
+
+#endif // CONFIG_BSP_ENABLE_BENCH
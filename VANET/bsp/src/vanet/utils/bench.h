@@ -0,0 +1,73 @@
+/**
+ *	@file	bench.h
+ *
+ *	@brief	Microbenchmarks of the BSP primitives
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef BSP_BENCH_H
+#define BSP_BENCH_H
+
+/**
+ * @ingroup group_bsp_utils_util
+ *
+ * Each benchmark runs its operation a number of times back to back, timed with
+ * the CPU cycle counter, with the scheduler locked (interrupts still run).  The
+ * "bench" STI command prints one line per benchmark:
+ *
+ *   bench name=fletcher16_64 n=256 rounds=8 min=412.25 avg=418.50 bytes=64 hz=32000000
+ *
+ * min and avg are cycles per operation, over the rounds.  The "null" benchmark
+ * is the cost of the loop and the call, and is not subtracted from the others.
+ *
+ * @{
+ */
+
+#include <avr32/io.h>
+#include "compiler.h"
+
+/** @name API
+ *
+ *  @{
+ */
+
+/// A benchmark
+typedef struct _bsp_bench_t
+{
+	const char* name;                               ///< Benchmark name, no spaces
+	bool (*setup)(void);                            ///< Called before each round, untimed (optional) - false fails the benchmark
+	void (*run)(void);                              ///< One operation
+	void (*teardown)(void);                         ///< Called after each round, untimed (optional)
+	uint16_t iterations;                            ///< Operations per round
+	uint16_t bytes;                                 ///< Bytes per operation, 0 if it doesn't apply
+	struct _bsp_bench_t* next;                      ///< Internal use
+} bsp_bench_t;
+
+/// Initialization - registers the BSP's own benchmarks and the STI command
+extern void bsp_bench_init(void);
+
+/**
+ * Register a benchmark.  setup(), run() and teardown() are called with the
+ * scheduler locked and must not pend.  A setup() that fails undoes its own work
+ * and returns false - teardown() isn't called and the benchmark prints failed.
+ *
+ * @param bench The benchmark
+ */
+extern void bsp_bench_register(bsp_bench_t* bench);
+
+/// @}
+
+/// @}
+
+#endif // BSP_BENCH_H
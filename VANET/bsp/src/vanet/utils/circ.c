@@ -24,14 +24,19 @@ typedef unsigned short uint16_t;
 #endif
 
 #include <string.h>
+#ifndef UNIT_TEST
+#include <asf.h>
+#include "vanet.h"
+#endif
 #include "circ.h"
 
 #ifdef UNIT_TEST
 #define circ_lock()
 #define circ_unlock()
 #else
-#define circ_lock()         { irqflags_t flags = cpu_irq_save();
-#define circ_unlock()       cpu_irq_restore(flags); }
+// the UART handlers share these with the tasks - the time pulse capture doesn't
+#define circ_lock()         { irqflags_t flags = bsp_intc_shared_save();
+#define circ_unlock()       bsp_intc_shared_restore(flags); }
 #endif
 
 void bsp_circ_init(bsp_circ_buffer_t* c, void* buffer, uint16_t buffer_length)
@@ -2,6 +2,12 @@
  *	@file	fletcher.c
  *
  *	@brief	Fletcher's Checksum
+ *
+ *  The sums are kept in 32 bits and only reduced when they could overflow,
+ *  and aligned data is taken a word at a time.  2^8 and 2^16 are both 1 mod
+ *  255, so folding a sum's high bits onto its low bits doesn't change it mod
+ *  255 - the results are bit for bit those of the byte at a time code these
+ *  replace (see the UNIT_TEST build).
  */
 /*----------------------------------------------------------------------------
  *
@@ -16,26 +22,131 @@
  *----------------------------------------------------------------------------
  */
 
+#ifdef UNIT_TEST
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define min(a,b)    ((a) < (b) ? (a) : (b))
+#include "fletcher.h"
+#else
 #include <asf.h>
 #include "vanet.h"
+#endif
+
+/// Bytes of 8-bit data the 32-bit sums take without overflowing, starting from 0x1ff (5790)
+#define FLETCHER16_BLOCK			4096
+
+/// 16-bit words the 32-bit sums take without overflowing, starting from 0xffff (360)
+#define FLETCHER32_BLOCK			360
+
+/// Byte i (in memory order) of a word loaded from memory - the AVR32 is big-endian
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define WORD_BYTE(w, i)				(((w) >> (8 * (i))) & 0xff)
+#else
+#define WORD_BYTE(w, i)				(((w) >> (24 - 8 * (i))) & 0xff)
+#endif
+
+/// Fold a sum to 9 bits, the same mod 255
+static inline uint32_t fletcher16_fold(uint32_t x)
+{
+	x = (x & 0xffff) + (x >> 16);
+	x = (x & 0xff) + (x >> 8);
+	return (x & 0xff) + (x >> 8);
+}
+
+/// Add bytes to the sums with no reduction
+static void fletcher16_sum(uint32_t* sum1, uint32_t* sum2, const uint8_t* data, int bytes)
+{
+	uint32_t s1 = *sum1, s2 = *sum2;
+	uint32_t w, b0, b1, b2, b3;
+
+	while (bytes > 0 && ((uintptr_t)data & 3))
+	{
+		s2 += s1 += *data++;
+		bytes--;
+	}
+
+	// four bytes of both sums at once: sum2 gets sum1 four times, the first byte four times, ...
+	while (bytes >= 4)
+	{
+		w = *(const uint32_t*)data;
+		data += 4;
+		bytes -= 4;
+
+		b0 = WORD_BYTE(w, 0);
+		b1 = WORD_BYTE(w, 1);
+		b2 = WORD_BYTE(w, 2);
+		b3 = WORD_BYTE(w, 3);
+		s2 += (s1 << 2) + (b0 << 2) + 3 * b1 + (b2 << 1) + b3;
+		s1 += b0 + b1 + b2 + b3;
+	}
+
+	while (bytes-- > 0)
+	{
+		s2 += s1 += *data++;
+	}
+
+	*sum1 = s1;
+	*sum2 = s2;
+}
 
 uint16_t bsp_util_fletcher16(const uint8_t* data, int bytes)
 {
-	uint16_t sum1 = 0xff, sum2 = 0xff;
+	uint32_t sum1 = 0xff, sum2 = 0xff;
+	int n;
 	
-	while (bytes)
+	while (bytes > 0)
 	{
-		size_t tlen = bytes > 20 ? 20 : bytes;
-		bytes -= tlen;
-		do {
-			sum2 += sum1 += *data++;
-		} while (--tlen);
-		sum1 = (sum1 & 0xff) + (sum1 >> 8);
-		sum2 = (sum2 & 0xff) + (sum2 >> 8);
+		n = min(bytes, FLETCHER16_BLOCK);
+		fletcher16_sum(&sum1, &sum2, data, n);
+		data += n;
+		bytes -= n;
+		sum1 = fletcher16_fold(sum1);
+		sum2 = fletcher16_fold(sum2);
 	}
-	/* Second reduction step to reduce sums to 8 bits */
-	sum1 = (sum1 & 0xff) + (sum1 >> 8);
-	sum2 = (sum2 & 0xff) + (sum2 >> 8);
+
+	// the sums never reach 0, so 0 mod 255 comes out as 0xff
+	while (sum1 > 0xff) sum1 = (sum1 & 0xff) + (sum1 >> 8);
+	while (sum2 > 0xff) sum2 = (sum2 & 0xff) + (sum2 >> 8);
+	return sum2 << 8 | sum1;
+}
+
+uint16_t bsp_util_fletcher16_update(uint16_t xsum, int buffer_length, int offset,
+									const uint8_t* old, const uint8_t* new, int bytes)
+{
+	uint32_t sum1 = xsum & 0xff, sum2 = xsum >> 8;
+	uint32_t delta, weight;
+	
+	// byte i is added into sum1 once and into sum2 once per byte from i to the end
+	weight = (buffer_length - offset) % 255;
+	for (int i=0; i<bytes; i++)
+	{
+		delta = new[i] + 255 - old[i];
+		sum1 += delta;
+		sum2 = (sum2 + weight * delta) % 255;
+		weight = weight ? weight - 1 : 254;
+	}
+	sum1 %= 255;
+	
+	// as bsp_util_fletcher16() - 0 mod 255 is 0xff
+	if (sum1 == 0) sum1 = 0xff;
+	if (sum2 == 0) sum2 = 0xff;
+	return sum2 << 8 | sum1;
+}
+
+uint16_t bsp_util_fletcher16_append(uint16_t xsum, const uint8_t* data, int bytes)
+{
+	uint32_t more = bsp_util_fletcher16(data, bytes);
+	uint32_t sum1 = xsum & 0xff, sum2 = xsum >> 8;
+	
+	// every byte already summed goes into sum2 once more for each byte added
+	sum2 = (sum2 + (bytes % 255) * sum1 + (more >> 8)) % 255;
+	sum1 = (sum1 + (more & 0xff)) % 255;
+	
+	// as bsp_util_fletcher16() - 0 mod 255 is 0xff
+	if (sum1 == 0) sum1 = 0xff;
+	if (sum2 == 0) sum2 = 0xff;
 	return sum2 << 8 | sum1;
 }
 
@@ -62,7 +173,31 @@ void bsp_util_running_xsum_addb(bsp_running_fletcher* r, uint8_t b)
 
 void bsp_util_running_xsum_add(bsp_running_fletcher* r, const uint8_t* b, int len)
 {
-	while (len--) bsp_util_running_xsum_addb(r,*b++);
+	uint32_t sum1, sum2;
+	int n;
+
+	// the 16-bit sums can wrap between folds, so they fold exactly where
+	// bsp_util_running_xsum_addb() would.  Wrapping once at the end of a
+	// stretch is the same as wrapping byte by byte
+	while (len > 0)
+	{
+		n = min(len, r->count);
+		sum1 = r->sum1;
+		sum2 = r->sum2;
+		fletcher16_sum(&sum1, &sum2, b, n);
+		r->sum1 = (uint16_t)sum1;
+		r->sum2 = (uint16_t)sum2;
+		b += n;
+		len -= n;
+
+		r->count -= n;
+		if (r->count == 0)
+		{
+			r->sum1 = (r->sum1 & 0xff) + (r->sum1 >> 8);
+			r->sum2 = (r->sum2 & 0xff) + (r->sum2 >> 8);
+			r->count = 21;
+		}
+	}
 }
 
 uint16_t bsp_util_running_xsum_result(bsp_running_fletcher* r)
@@ -76,4 +211,257 @@ uint16_t bsp_util_running_xsum_result(bsp_running_fletcher* r)
 	r->sum1 = (r->sum1 & 0xff) + (r->sum1 >> 8);
 	r->sum2 = (r->sum2 & 0xff) + (r->sum2 >> 8);
 	return (r->sum2 << 8) | r->sum1;
-}
\ No newline at end of file
+}
+
+/// Add little-endian 16-bit words to the sums, reducing every FLETCHER32_BLOCK words
+static void fletcher32_sum(bsp_running_fletcher32* r, const uint8_t* data, int words)
+{
+	uint32_t s1 = r->sum1, s2 = r->sum2;
+	int n;
+
+	while (words > 0)
+	{
+		n = min(words, FLETCHER32_BLOCK - r->count);
+		words -= n;
+		r->count += n;
+
+		for (; n >= 2; n -= 2)
+		{
+			s2 += s1 += data[0] | (data[1] << 8);
+			s2 += s1 += data[2] | (data[3] << 8);
+			data += 4;
+		}
+		if (n)
+		{
+			s2 += s1 += data[0] | (data[1] << 8);
+			data += 2;
+		}
+
+		if (r->count == FLETCHER32_BLOCK)
+		{
+			s1 %= 0xffff;
+			s2 %= 0xffff;
+			r->count = 0;
+		}
+	}
+
+	r->sum1 = s1;
+	r->sum2 = s2;
+}
+
+uint32_t bsp_util_fletcher32(const uint8_t* data, int bytes)
+{
+	bsp_running_fletcher32 r;
+
+	bsp_util_running_xsum32_init(&r);
+	bsp_util_running_xsum32_add(&r, data, bytes);
+	return bsp_util_running_xsum32_result(&r);
+}
+
+void bsp_util_running_xsum32_init(bsp_running_fletcher32* r)
+{
+	r->sum1 = 0;
+	r->sum2 = 0;
+	r->count = 0;
+	r->odd = -1;
+}
+
+void bsp_util_running_xsum32_add(bsp_running_fletcher32* r, const uint8_t* b, int len)
+{
+	uint8_t word[2];
+
+	if (len <= 0)
+		return;
+
+	// finish the word the last call started
+	if (r->odd >= 0)
+	{
+		word[0] = r->odd;
+		word[1] = *b++;
+		len--;
+		r->odd = -1;
+		fletcher32_sum(r, word, 1);
+	}
+
+	fletcher32_sum(r, b, len >> 1);
+
+	if (len & 1)
+	{
+		r->odd = b[len - 1];
+	}
+}
+
+uint32_t bsp_util_running_xsum32_result(bsp_running_fletcher32* r)
+{
+	uint8_t word[2];
+
+	// an odd length is padded with a zero
+	if (r->odd >= 0)
+	{
+		word[0] = r->odd;
+		word[1] = 0;
+		r->odd = -1;
+		fletcher32_sum(r, word, 1);
+	}
+
+	return (r->sum2 % 0xffff) << 16 | (r->sum1 % 0xffff);
+}
+
+#ifdef UNIT_TEST
+/* -----------
+ *  The byte at a time code, as it was - the optimized code has to match it exactly
+ * ----------*/
+static uint16_t ref_fletcher16(const uint8_t* data, int bytes)
+{
+	uint16_t sum1 = 0xff, sum2 = 0xff;
+	
+	while (bytes)
+	{
+		size_t tlen = bytes > 20 ? 20 : bytes;
+		bytes -= tlen;
+		do {
+			sum2 += sum1 += *data++;
+		} while (--tlen);
+		sum1 = (sum1 & 0xff) + (sum1 >> 8);
+		sum2 = (sum2 & 0xff) + (sum2 >> 8);
+	}
+	/* Second reduction step to reduce sums to 8 bits */
+	sum1 = (sum1 & 0xff) + (sum1 >> 8);
+	sum2 = (sum2 & 0xff) + (sum2 >> 8);
+	return sum2 << 8 | sum1;
+}
+
+/// Fletcher-32 as usually published - reduced every word
+static uint32_t ref_fletcher32(const uint8_t* data, int bytes)
+{
+	uint32_t sum1 = 0, sum2 = 0, w;
+	
+	for (int i=0; i<bytes; i+=2)
+	{
+		w = data[i] | (i + 1 < bytes ? data[i + 1] << 8 : 0);
+		sum1 = (sum1 + w) % 0xffff;
+		sum2 = (sum2 + sum1) % 0xffff;
+	}
+	return sum2 << 16 | sum1;
+}
+
+#define TEST_MAX			12000
+
+static uint8_t s_buf[TEST_MAX + 4];
+
+static void fill(int pattern)
+{
+	for (int i=0; i<sizeof(s_buf); i++)
+	{
+		s_buf[i] = pattern == 0 ? 0x00 : pattern == 1 ? 0xff : rand();
+	}
+}
+
+int main(void)
+{
+	static const int lens[] = { 0, 1, 2, 3, 4, 5, 7, 8, 19, 20, 21, 22, 41, 42, 43, 63, 64, 65, 255, 256, 719, 720,
+		721, 1440, 1441, 4095, 4096, 4097, 8192, 8193, TEST_MAX };
+	bsp_running_fletcher r, ref;
+	bsp_running_fletcher32 r32;
+	uint16_t xsum;
+	int errors = 0, len, off, pos, n;
+	
+	srand(1);
+	for (int pattern=0; pattern<3; pattern++)
+	{
+		fill(pattern);
+		for (int l=0; l<sizeof(lens)/sizeof(lens[0]); l++)
+		{
+			len = lens[l];
+			for (off=0; off<4; off++)
+			{
+				const uint8_t* p = s_buf + off;
+				
+				if (bsp_util_fletcher16(p, len) != ref_fletcher16(p, len))
+				{
+					printf("bsp_util_fletcher16 wrong (pattern %d len %d off %d)\n", pattern, len, off);
+					errors++;
+				}
+				
+				if (bsp_util_fletcher32(p, len) != ref_fletcher32(p, len))
+				{
+					printf("bsp_util_fletcher32 wrong (pattern %d len %d off %d)\n", pattern, len, off);
+					errors++;
+				}
+				
+				// the running sums fed in random pieces, against a byte at a time
+				bsp_util_running_xsum_init(&r);
+				bsp_util_running_xsum_init(&ref);
+				bsp_util_running_xsum32_init(&r32);
+				for (pos=0; pos<len; pos+=n)
+				{
+					n = rand() % 50;
+					n = min(len - pos, n);
+					bsp_util_running_xsum_add(&r, p + pos, n);
+					bsp_util_running_xsum32_add(&r32, p + pos, n);
+					for (int i=0; i<n; i++) bsp_util_running_xsum_addb(&ref, p[pos + i]);
+				}
+				if (r.sum1 != ref.sum1 || r.sum2 != ref.sum2 || r.count != ref.count ||
+					bsp_util_running_xsum_result(&r) != bsp_util_running_xsum_result(&ref))
+				{
+					printf("bsp_util_running_xsum_add wrong (pattern %d len %d off %d)\n", pattern, len, off);
+					errors++;
+				}
+				
+				// bsp_util_fletcher16() a piece at a time
+				xsum = 0xffff;
+				for (pos=0; pos<len; pos+=n)
+				{
+					n = rand() % 600;
+					n = min(len - pos, n);
+					xsum = bsp_util_fletcher16_append(xsum, p + pos, n);
+				}
+				if (xsum != ref_fletcher16(p, len))
+				{
+					printf("bsp_util_fletcher16_append wrong (pattern %d len %d off %d)\n", pattern, len, off);
+					errors++;
+				}
+				if (bsp_util_running_xsum32_result(&r32) != ref_fletcher32(p, len))
+				{
+					printf("bsp_util_running_xsum32_add wrong (pattern %d len %d off %d)\n", pattern, len, off);
+					errors++;
+				}
+			}
+		}
+	}
+	
+	// a few bytes changed at a time, against checksumming the lot again
+	for (int pattern=0; pattern<3; pattern++)
+	{
+		uint8_t change[16];
+		
+		fill(pattern);
+		len = 512;
+		xsum = bsp_util_fletcher16(s_buf, len);
+		for (int i=0; i<2000; i++)
+		{
+			n = 1 + rand() % sizeof(change);
+			off = rand() % (len - n + 1);
+			for (int j=0; j<n; j++) change[j] = rand() % 3 ? rand() : s_buf[off + j];
+			if (i % 7 == 0) memset(change, pattern == 1 ? 0x00 : 0xff, n);
+			
+			xsum = bsp_util_fletcher16_update(xsum, len, off, s_buf + off, change, n);
+			memcpy(s_buf + off, change, n);
+			if (xsum != bsp_util_fletcher16(s_buf, len))
+			{
+				printf("bsp_util_fletcher16_update wrong (pattern %d off %d n %d)\n", pattern, off, n);
+				errors++;
+				xsum = bsp_util_fletcher16(s_buf, len);
+			}
+		}
+	}
+	
+	// the published check values
+	if (bsp_util_fletcher32((const uint8_t*)"abcde", 5) != 0xf04fc729) { printf("bsp_util_fletcher32 wrong (abcde)\n"); errors++; }
+	if (bsp_util_fletcher32((const uint8_t*)"abcdef", 6) != 0x56502d2a) { printf("bsp_util_fletcher32 wrong (abcdef)\n"); errors++; }
+	if (bsp_util_fletcher32((const uint8_t*)"abcdefgh", 8) != 0xebe19591) { printf("bsp_util_fletcher32 wrong (abcdefgh)\n"); errors++; }
+	
+	printf("Done - %d errors\n", errors);
+	return errors != 0;
+}
+#endif // UNIT_TEST
@@ -19,6 +19,32 @@
 /// Compute a 16-bit Fletchers checksum
 extern uint16_t bsp_util_fletcher16(const uint8_t* buffer, int buffer_length);
 
+/**
+ * Update a bsp_util_fletcher16() result for bytes changed in the buffer,
+ * without going over the rest of it
+ *
+ * @param xsum          bsp_util_fletcher16() of the buffer before the change
+ * @param buffer_length Length of the whole buffer
+ * @param offset        Where the change is in the buffer
+ * @param old           The bytes that were there
+ * @param new           The bytes that are there now
+ * @param bytes         Length of the change
+ * @return bsp_util_fletcher16() of the buffer after the change
+ */
+extern uint16_t bsp_util_fletcher16_update(uint16_t xsum, int buffer_length, int offset,
+										   const uint8_t* old, const uint8_t* new, int bytes);
+
+/**
+ * Extend a bsp_util_fletcher16() result with bytes added to the end of the
+ * buffer, so a buffer can be checksummed a piece at a time
+ *
+ * @param xsum  bsp_util_fletcher16() of the buffer so far - 0xffff for none
+ * @param data  The bytes added
+ * @param bytes How many
+ * @return bsp_util_fletcher16() of the buffer with the bytes added
+ */
+extern uint16_t bsp_util_fletcher16_append(uint16_t xsum, const uint8_t* data, int bytes);
+
 /// Data for a running fletchers checksum
 typedef struct
 {
@@ -37,4 +63,25 @@ extern void bsp_util_running_xsum_addb(bsp_running_fletcher* r, uint8_t b);
 extern void bsp_util_running_xsum_add(bsp_running_fletcher* r, const uint8_t* b, int len);
 
 /// Get a running fletcher's checksum result
-extern uint16_t bsp_util_running_xsum_result(bsp_running_fletcher* r);
\ No newline at end of file
+extern uint16_t bsp_util_running_xsum_result(bsp_running_fletcher* r);
+
+/// Compute a Fletcher-32 checksum - 16-bit little-endian words, an odd length padded with a zero
+extern uint32_t bsp_util_fletcher32(const uint8_t* buffer, int buffer_length);
+
+/// Data for a running Fletcher-32 checksum
+typedef struct
+{
+	uint32_t sum1;
+	uint32_t sum2;
+	uint16_t count;			///< words since the sums were reduced
+	int16_t odd;			///< the first byte of a word split across calls, or -1
+} bsp_running_fletcher32;
+
+/// Start a running Fletcher-32 checksum
+extern void bsp_util_running_xsum32_init(bsp_running_fletcher32* r);
+
+/// Add data to a running Fletcher-32 checksum.  The pieces can be any length
+extern void bsp_util_running_xsum32_add(bsp_running_fletcher32* r, const uint8_t* b, int len);
+
+/// Get a running Fletcher-32 checksum result - the same as bsp_util_fletcher32() over all the pieces
+extern uint32_t bsp_util_running_xsum32_result(bsp_running_fletcher32* r);
\ No newline at end of file
@@ -41,7 +41,7 @@ typedef struct
     int8_t status;
     int8_t pend_status;
     uint8_t pad;
-    uint32_t uptime;
+    uint32_t time_us;       // bsp_rtc_get_time_us(), wrapping every 71 minutes
 } task_switch_t;
 
 static task_switch_t s_switches[NUM_TASK_SWITCHES];
@@ -167,13 +167,21 @@ void bsp_print_stack_usage(uint8_t port)
 
 void App_TaskSwHook(void)
 {
+    #ifdef CONFIG_BSP_ENABLE_RTC
+    bsp_rtc_tick_resume();
+    #endif
+    
     if (!s_block_switch)
     {
         task_switch_t* x = &s_switches[s_switches_head];
         x->pri = OSTCBHighRdy->OSTCBPrio;
         x->status = OSTCBHighRdy->OSTCBStat;
         x->pend_status = OSTCBHighRdy->OSTCBStatPend;
-        x->uptime = 0; // TBD - bsp_rtc_get_uptime();
+        #ifdef CONFIG_BSP_ENABLE_RTC
+        x->time_us = (uint32_t) bsp_rtc_get_time_us();
+        #else
+        x->time_us = 0;
+        #endif
         
         s_switches_head++;
         if (s_switches_head >= NUM_TASK_SWITCHES) s_switches_head = 0;
@@ -188,15 +196,17 @@ void bsp_print_stack_switches(uint8_t port)
     
     s_block_switch = true;
     
-    //         0123456789 0123456789012345 0123 01   01
-    bsp_termios_printf(port, "      Time             Task  Pri Stat PStat\r\n");
+    //         0123456789 0123456789 0123456789012345 0123 01   01
+    bsp_termios_printf(port, " Time (us)    +us             Task  Pri Stat PStat\r\n");
     
     for (i=0; i<NUM_TASK_SWITCHES; i++)
     {
         task_switch_t* x = &s_switches[(s_switches_head + i) % NUM_TASK_SWITCHES];
+        task_switch_t* prev = &s_switches[(s_switches_head + i + NUM_TASK_SWITCHES - 1) % NUM_TASK_SWITCHES];
 
         if (OSRunning) OSTaskNameGet(x->pri, &task_name_ptr, &perr);
-        bsp_termios_printf(port, "%10d %16s %4d %02X   %02X\r\n", x->uptime, task_name_ptr, x->pri, x->status&0xff, x->pend_status&0xff);
+        bsp_termios_printf(port, "%10u %10u %16s %4d %02X   %02X\r\n", x->time_us, i ? x->time_us - prev->time_us : 0,
+            task_name_ptr, x->pri, x->status&0xff, x->pend_status&0xff);
         
         if (OSRunning && (i&0xf)==0xf) OSTimeDly(1);
     }
@@ -14,5 +14,20 @@ if not exist %file% (
     goto :eof
 )
 
+rem program -e erases the whole chip, and with it the codeplug journal
+rem (BSP_CP_JOURNAL_ADDRESS, the CODEPLUG region) - carry it over
+set journal="%TEMP%\vanet-codeplug.bin"
+
+echo Saving the codeplug
+atprogram -t jtagice3 -i jtag -d at32uc3c1512c read -fl -o 0x80076A00 -s 0x1000 --format bin -f %journal%
+if errorlevel 1 (
+    echo Unable to read the codeplug - not programming
+    goto :eof
+)
+
 echo Programming %sw%-%hw%
 atprogram -t jtagice3 -i jtag -d at32uc3c1512c program -e --verify -f %file%
+if errorlevel 1 goto :eof
+
+echo Restoring the codeplug
+atprogram -t jtagice3 -i jtag -d at32uc3c1512c program -fl -o 0x80076A00 --format bin --verify -f %journal%
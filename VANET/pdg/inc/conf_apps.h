@@ -30,6 +30,9 @@
 // PDG Task
 #include "pdg_task.h"
 
+// Event Recorder Task
+#include "rec_task.h"
+
 // Macros to check return codes
 #define OS_SHOW_ERRORS
 #define OS_SHOW_VALUES
@@ -33,11 +33,13 @@
 enum bsp_pin_events 
 {
     BSP_PIN_EVENT_SW_PB02	= 0x0001,   ///< Push button on PB02
-	BSP_PIN_EVENT_ACCEL		= 0x0002,	///< Accelerometer Event
+	BSP_PIN_EVENT_ACCEL		= 0x0002,	///< Accelerometer Event (LIS3DSH INT1: FIFO watermark or movement, MPU-6050 INT: data ready)
 };
 
 #define BSP_PIN_COUNT   2       ///< Number of Pins on Board
 
+// An active time of 0 is for outputs of other parts: each change is published from the interrupt
+
 //                                                                          active		active	pull up/
 // Pin Config                 pin                   event                   time(ms)	level	down
 #define BSP_PIN_0_CFG       { AVR32_PIN_PB02,		BSP_PIN_EVENT_SW_PB02,	250,		0,      true }
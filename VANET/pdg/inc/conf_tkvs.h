@@ -31,6 +31,7 @@ enum
 	APP_TKVS_GPS_TASK = BSP_TKVS_SRC_APP_START,
 	APP_TKVS_PDG_TASK,
 	APP_TKVS_ACCEL_TASK,
+	APP_TKVS_REC_TASK,
 };
 
 /// @}
@@ -57,17 +57,23 @@
 #define CONFIG_BSP_ENABLE_CODEPLUG	
 #define CONFIG_BSP_ENABLE_I2C
 #define CONFIG_BSP_ENABLE_RTC
+#define CONFIG_BSP_RTC_TICKLESS		// requires CONFIG_BSP_UCOS
+#define CONFIG_BSP_ENABLE_BENCH		// requires CONFIG_BSP_ENABLE_STI
 #define CONFIG_BSP_ENABLE_MUX		// requires CONFIG_BSP_UCOS
 #define CONFIG_BSP_ENABLE_OSTRACKER
 #define CONFIG_BSP_ENABLE_STI		// requires CONFIG_BSP_UCOS
 #define CONFIG_BSP_ENABLE_TKVS		// requires CONFIG_BSP_UCOS
 #define CONFIG_BSP_ENABLE_TERMIOS	// ditto
+#define CONFIG_BSP_ENABLE_TERMIOS_CAPTURE	// requires CONFIG_BSP_ENABLE_MUX and CONFIG_BSP_ENABLE_STI
 #define CONFIG_BSP_ENABLE_LOGCAT	// requires somebody to call display (STI will!)
 
 // TKVS Configuration
 #define CONFIG_BSP_TKVS_MAX_SUBSCRIPTIONS 32
 #undef CONFIG_BSP_TKVS_ENABLE_1STICK
 
+// Termios Capture Configuration
+#define CONFIG_BSP_TERMIOS_CAPTURE_DLCI	6	// VANET_MUXCH_CAPTURE
+
 // INTC Configuration
 #define CONFIG_BSP_INTC_MAX_INTERRUPTS 16
 
@@ -55,6 +55,12 @@
 #define		TASK_PDG_PRIO					44u
 #define		TASK_PDG_STACK_SIZE				256u
 
+/*
+ * Event Recorder Task
+ */
+#define		TASK_REC_PRIO					46u
+#define		TASK_REC_STACK_SIZE				256u
+
 /*
  * System Test Interface (STI) Task
  */
@@ -39,10 +39,13 @@
 #define OS_LOWEST_PRIO           63u   /* Defines the lowest priority that can be assigned ...         */
                                        /* ... MUST NEVER be higher than 254!                           */
 
-#define OS_MAX_EVENTS            10u   /* Max. number of event control blocks in your application      */
+#define OS_MAX_EVENTS            13u   /* Max. number of event control blocks in your application      */
+                                       /* ... the queues below plus the two OS_TMR semaphores          */
 #define OS_MAX_FLAGS              5u   /* Max. number of Event Flag Groups    in your application      */
 #define OS_MAX_MEM_PART           0u   /* Max. number of memory partitions                             */
-#define OS_MAX_QS                 8u   /* Max. number of queue control blocks in your application      */
+#define OS_MAX_QS                10u   /* Max. number of queue control blocks in your application      */
+                                       /* ... 9 used: termios, capture, mux, sti, bench, pdg, rec,     */
+                                       /* accel and gps - one spare                                    */
 #define OS_MAX_TASKS             10u   /* Max. number of tasks in your application, MUST be >= 2       */
 
 #define OS_SCHED_LOCK_EN          1u   /* Include code for OSSchedLock() and OSSchedUnlock()           */
@@ -109,7 +112,7 @@
 
                                        /* ---------------------- MESSAGE QUEUES ---------------------- */
 #define OS_Q_EN                   1u   /* Enable (1) or Disable (0) code generation for QUEUES         */
-#define OS_Q_ACCEPT_EN            0u   /*     Include code for OSQAccept()                             */
+#define OS_Q_ACCEPT_EN            1u   /*     Include code for OSQAccept()                             */
 #define OS_Q_DEL_EN               0u   /*     Include code for OSQDel()                                */
 #define OS_Q_FLUSH_EN             0u   /*     Include code for OSQFlush()                              */
 #define OS_Q_PEND_ABORT_EN        0u   /*     Include code for OSQPendAbort()                          */
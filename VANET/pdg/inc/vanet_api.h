@@ -28,11 +28,12 @@
 #define VANET_MUXCH_ACCELEROMETER_RAW       3
 #define VANET_MUXCH_GPS_RAW                 4
 #define VANET_MUXCH_ECHO                    5
+#define VANET_MUXCH_CAPTURE                 6
 
-#define VANET_MUXCH_MAX                     6
+#define VANET_MUXCH_MAX                     7
 
 // The API version
-#define VANET_API_VERSION                   4
+#define VANET_API_VERSION                   12
 
 /*
     This is the main payload structure for commands sent on the unified mux channel (2). All fields
@@ -72,10 +73,12 @@ enum
     VANET_GRP_GENERAL,
     VANET_GRP_ACCEL,
     VANET_GRP_GPS,
+    VANET_GRP_RECORDER,
 
     VANET_GRP_ACCEL_EVENT = 0x80,
     VANET_GRP_GPS_EVENT,
     VANET_GRP_BUTTON_EVENT,
+    VANET_GRP_RECORDER_EVENT,
 };
 
 
@@ -160,6 +163,7 @@ enum
 	VANET_OP_ACCELEROMETER_SET_RANGE,
 	VANET_OP_ACCELEROMETER_REGISTER_READ,
 	VANET_OP_ACCELEROMETER_REGISTER_WRITE,
+	VANET_OP_ACCELEROMETER_SET_DETECTOR,
 };
 
 /*
@@ -186,6 +190,10 @@ enum
         Byte 7          - Range, Unsigned, +/- G Scale (e.g. 2, 4, 8, 16, etc.)
 		Byte 8-9        - Bandwidth, Unsigned (e.g. 100Hz)
 		Byte 10-11      - Threshold, Unsigned, G*1000
+		Byte 12-13      - Gyro X, Signed (API version 9)
+		Byte 14-15      - Gyro Y, Signed
+		Byte 16-17      - Gyro Z, Signed
+		Byte 18-19      - Gyro Range, Unsigned, +/- degrees per second (0 = no gyro, e.g. the LIS3DSH)
 */
 
 typedef struct
@@ -197,6 +205,10 @@ typedef struct
 	uint8_t		range;
 	uint16_t	bandwidth;
 	uint16_t	threshold;
+	int16_t		x_gyro;
+	int16_t		y_gyro;
+	int16_t		z_gyro;
+	uint16_t	gyro_range;
 } vanet_api_accel_t;
 
 /*
@@ -209,6 +221,8 @@ typedef struct
 							   16000 = 16G
 					      Note: Send 0 to disable built in algorithm
 						        Accelerometer Range will be adjusted to accommodate requested threshold
+								On the MPU-6050 it is the crash detector's - the squared magnitude
+								this far (squared) from its running baseline
 						  
 	Response Payload:
 		Empty
@@ -255,6 +269,41 @@ typedef struct
 		Empty
 */
 
+/*
+	Opcode: Set Detector (API 8)
+	
+	Command Payload:
+		Byte 0			- State machine, 1 or 2
+		Byte 1			- Detector (VANET_API_ACCEL_DETECT_xxx)
+		Byte 2-3		- Threshold 1, G*1000
+		Byte 4-5		- Time 1, ms
+		Byte 6-7		- Threshold 2, G*1000
+		Byte 8-9		- Time 2, ms
+	  or for VANET_API_ACCEL_DETECT_PROGRAM
+		Byte 2-29		- The state machine's registers from ST_1 to SETT, as the LIS3DSH lays them out
+		
+	Response Payload:
+		Empty, or an Error if the part can't run it - a threshold beyond the range, a time too long
+		at the output data rate, or no state machines (MPU-6050)
+		
+	The detector runs on the accelerometer itself and raises a Motion Interrupt when it fires, so
+	nothing polls for it.  Magnitude is the length of the acceleration vector - 1G at rest, whatever
+	the orientation.  Thresholds and times are converted at the current range and output data rate,
+	and again whenever either changes; a program is loaded as it is.  State machine 1 is the one Set
+	Movement Threshold uses.
+*/
+enum
+{
+	VANET_API_ACCEL_DETECT_OFF			= 0,
+	VANET_API_ACCEL_DETECT_MOTION		= 1,		///< Any axis beyond threshold 1, gravity and all
+	VANET_API_ACCEL_DETECT_IMPACT		= 2,		///< Magnitude above threshold 1 for at least time 1
+	VANET_API_ACCEL_DETECT_FREEFALL		= 3,		///< Magnitude below threshold 1 for at least time 1
+	VANET_API_ACCEL_DETECT_DROP			= 4,		///< A free fall, then magnitude above threshold 2 within time 2
+	VANET_API_ACCEL_DETECT_PROGRAM		= 0xff,		///< A state machine program, compiled by the main board
+};
+
+#define VANET_API_ACCEL_PROGRAM_SIZE	28
+
 /*******************************************************************
 
     Command Group:  GPS
@@ -263,6 +312,7 @@ typedef struct
 enum
 {
     VANET_OP_GET_GPS_STATE = 0,
+    VANET_OP_GPS_SUBSCRIBE,
 };
 
 /*
@@ -284,6 +334,29 @@ enum
         Byte 24-27  - Microsecond part of timestamp
 */
 
+/*
+    Opcode: GPS Subscribe
+
+    Command Payload:
+        Byte 0      - Triggers (see below), 0 to stop the events
+        Byte 1-2    - Periodic: ms between events, 0 for every fix
+        Byte 3-4    - Movement: meters moved since the last event
+
+    Response Payload:
+        Empty
+
+    Each fix the receiver reports that meets any of the triggers is sent as a GPS Position event
+    as soon as it is parsed.  The first fix after subscribing meets the periodic and movement
+    triggers.  Fix change is a change in the location or time lock flags, either way.
+*/
+
+enum
+{
+    VANET_API_GPS_TRIGGER_PERIODIC              = 0x01,
+    VANET_API_GPS_TRIGGER_FIX_CHANGE            = 0x02,
+    VANET_API_GPS_TRIGGER_MOVEMENT              = 0x04,
+};
+
 #define VANET_API_GPS_LOC_MULTIPLIER            10000000
 #define VANET_API_GPS_LOC_MULTIPLIERF           10000000.0
 
@@ -309,22 +382,129 @@ typedef struct
 
 /*******************************************************************
 
-    Command Group:  Accelerometer Events
+    Command Group:  Event Recorder (API 10)
 
 *******************************************************************/
 enum
 {
-    VANET_OP_MOTION_INTERRUPT = 0,
+    VANET_OP_RECORDER_LIST = 0,
+    VANET_OP_RECORDER_READ,
+    VANET_OP_RECORDER_CONFIG,
+    VANET_OP_RECORDER_TRIGGER,
 };
 
 /*
-    Opcode: Motion Interrupt
+    The daughterboard keeps the last few seconds of accelerometer blocks and GPS fixes in RAM.  A
+    trigger freezes the window around it - pre-trigger ms before, post-trigger ms after - and
+    writes it to one of VANET_API_REC_SLOTS slots in flash, over the oldest.  A Recording Saved
+    event follows.  A trigger while a recording is being taken is part of that one.  The
+    recording is a run of records in the raw channel's format (see below); how far back it goes
+    is limited by what the RAM holds, a few seconds at 200 Hz.
+*/
+
+/*
+    Opcode: List Recordings
 
     Command Payload:
         Empty
 
     Response Payload:
+        VANET_API_REC_ENTRY_SIZE bytes for each slot that holds a recording:
+        Byte 0      - Slot
+        Byte 1      - Cause: the accelerometer state machines that fired (as for Motion
+                      Interrupt), or VANET_API_REC_MANUAL
+        Byte 2      - Flags (VANET_API_REC_xxx)
+        Byte 3      - Reserved
+        Byte 4-7    - Sequence number, counting up across the slots
+        Byte 8-11   - Trigger time as Unix timestamp
+        Byte 12-15  - Microsecond part of trigger time
+        Byte 16-19  - Trigger time on the recording's clock (see the records)
+        Byte 20-23  - Length in bytes
+        Byte 24-25  - Pre-trigger ms
+        Byte 26-27  - Post-trigger ms
+        Byte 28-29  - Fletcher-16 of the recording's data, as Read Recording returns it: sum 2
+                      then sum 1, each mod 255 with 0 sent as 0xff (API 12)
+*/
+
+/*
+    Opcode: Read Recording
+
+    Command Payload:
+        Byte 0      - Slot
+        Byte 1-4    - Offset
+        Byte 5-8    - Length, 0 for the rest
+
+    Response Payload (one or more, each up to VANET_API_REC_CHUNK bytes of data):
+        Byte 0-3    - Offset of the data
+        Byte 4..    - Data
+
+    The last response has no data.  An empty slot, or one written over partway through, ends the
+    read with an Error.
+*/
+
+/*
+    Opcode: Configure Recorder
+
+    Command Payload (empty to just read the configuration):
+        Byte 0      - Triggers (VANET_API_REC_TRIGGER_xxx), 0 to stop the recorder
+        Byte 1-2    - Pre-trigger ms
+        Byte 3-4    - Post-trigger ms
+
+    Response Payload:
+        As the command - the configuration in use.  The window is cut to what the daughterboard's
+        RAM holds at the accelerometer's rate, pre-trigger ms first, and cut again if the rate
+        changes
+*/
+
+/*
+    Opcode: Trigger Recording
+
+    Command Payload:
         Empty
+
+    Response Payload:
+        Empty, or an Error if the recorder is stopped
+*/
+
+#define VANET_API_REC_SLOTS             4
+#define VANET_API_REC_ENTRY_SIZE        30
+/// Read Recording data per response - a response fits a mux frame
+#define VANET_API_REC_CHUNK             112
+#define VANET_API_REC_MAX_MS            10000
+
+/// Configure Recorder triggers
+enum
+{
+    VANET_API_REC_TRIGGER_SM1           = 0x01,     ///< Accelerometer state machine 1 fired
+    VANET_API_REC_TRIGGER_SM2           = 0x02,     ///< Accelerometer state machine 2 fired
+    VANET_API_REC_TRIGGER_RUN           = 0x80,     ///< Keep the window - Trigger Recording only, without the others
+};
+
+/// List Recordings cause
+#define VANET_API_REC_MANUAL            0x80
+
+/// List Recordings flags
+enum
+{
+    VANET_API_REC_GAP                   = 0x01,     ///< RAM ran out while it was written - records are missing at the end
+    VANET_API_REC_SHORT                 = 0x02,     ///< The pre-trigger window goes back less than asked for
+};
+
+/*******************************************************************
+
+    Command Group:  Accelerometer Events
+
+*******************************************************************/
+enum
+{
+    VANET_OP_MOTION_INTERRUPT = 0,
+};
+
+/*
+    Opcode: Motion Interrupt
+
+    Event Payload:
+        Byte 0      - The state machines that fired: bit 0 for 1, bit 1 for 2 (API 8)
 */
 
 /*******************************************************************
@@ -333,6 +513,19 @@ enum
 
 *******************************************************************/
 
+enum
+{
+    VANET_OP_GPS_POSITION = 0,
+};
+
+/*
+    Opcode: GPS Position
+
+    Event Payload:
+        Byte 0-27   - GPS state as for Get GPS State, but the timestamp is the time of the fix
+        Byte 28     - The triggers it met
+*/
+
 /*******************************************************************
 
     Command Group:  Button Events
@@ -359,6 +552,24 @@ enum
         Byte 0              - Button ID
 */
 
+/*******************************************************************
+
+    Command Group:  Recorder Events
+
+*******************************************************************/
+
+enum
+{
+    VANET_OP_RECORDING_SAVED = 0,
+};
+
+/*
+    Opcode: Recording Saved
+
+    Event Payload:
+        Byte 0-29           - The recording's entry, as for List Recordings
+*/
+
 /*
     The time sync channel (1) is used exclusively for NTP-like time sync.  The main board sends a
     time request and the daughterboard replies with the current time.  Packet formats are as
@@ -370,6 +581,26 @@ enum
     Time Response:
         Byte 0-3            - Current time as Unix timestamp
         Byte 4-7            - Microsecond part of timestamp
+
+    A request carrying the main board's transmit time gets the NTP style reply, with the times
+    the daughterboard received the request and sent the reply.  The receive time is when the
+    UART interrupt got the request frame's start flag; the transmit time is when the reply's start
+    flag will have gone out.  The main board stamps its side the same way, and then:
+
+        offset = ((T2 - T1) + (T3 - T4)) / 2
+        delay  = (T4 - T1) - (T3 - T2)
+
+    Time Request (API 6):
+        Byte 0              - 0x69
+        Byte 1-8            - Originate time (T1) - any 8 bytes, echoed back
+
+    Time Response (API 6):
+        Byte 0-7            - Originate time, as sent
+        Byte 8-11           - Receive time (T2) as Unix timestamp
+        Byte 12-15          - Nanosecond part of receive time
+        Byte 16-19          - Status (VANET_API_TIME_xxx)
+        Byte 20-23          - Transmit time (T3) as Unix timestamp
+        Byte 24-27          - Nanosecond part of transmit time
 */
 #define VANET_API_TIME_REQUEST          0x69
 
@@ -379,4 +610,165 @@ typedef struct
     uint32_t timestamp_us;
 } vanet_api_timestamp_t;
 
+/// Time sync status
+enum
+{
+    VANET_API_TIME_UNSYNCED             = 0,        ///< No time pulse - don't follow this clock
+    VANET_API_TIME_LOCKED               = 1,        ///< Disciplined to the GPS time pulse
+    VANET_API_TIME_HOLDOVER             = 2,        ///< Lost the time pulse, running on the last frequency
+};
+
+typedef struct
+{
+    uint8_t  origin[8];
+    uint32_t rx_timestamp;
+    uint32_t rx_ns;
+    uint32_t status;
+    uint32_t tx_timestamp;
+    uint32_t tx_ns;
+} vanet_api_timesync_t;
+
+/*
+    The raw accelerometer channel (3) starts out sending a text line with the newest sample once a
+    second.  A stream request switches it to batches of every sample the accelerometer takes, or a
+    feature request to batches of filtered features at a lower rate, in self-delimiting binary
+    records:
+
+      +-- Type (8 bits)
+      |   +-- Length of the rest (8 bits)
+      |   |   +-- Record ...
+      |   |   |
+    | 0 | 1 | 2 | ...
+
+    All fields are big-endian (network order).  Records are sent whole, one to a mux frame, but
+    the main board may see them run together - a reader skips a byte at a time past anything with
+    an unknown type.
+
+    Stream Request (main board to daughterboard, API 7):
+        Byte 0              - 'S'
+        Byte 1-2            - Output data rate in Hz, 0 to keep the current one.  The part runs at
+                              its nearest rate at or below this
+        Byte 3              - Samples per batch (1 .. VANET_API_ACCEL_BATCH_MAX), 0 to go back to
+                              the text lines
+
+    Feature Request (main board to daughterboard, API 11):
+        Byte 0              - 'F'
+        Byte 1-2            - Output data rate in Hz, as for a Stream Request
+        Byte 3-4            - Features per second.  The samples are decimated by the nearest whole
+                              factor that gives it (1 .. 256)
+        Byte 5              - Features per batch (1 .. VANET_API_ACCEL_FEATURE_MAX), 0 to go back to
+                              the text lines
+        Byte 6              - Flags (VANET_API_ACCEL_FEATURE_DYNAMIC)
+
+    Config (sent after each request that starts or changes the stream):
+        Byte 0              - 'C'
+        Byte 1              - 4
+        Byte 2-3            - Output data rate in Hz
+        Byte 4              - Samples (or features) per batch
+        Byte 5              - Range, +/- G
+
+    Batch:
+        Byte 0              - 'B'
+        Byte 1              - 18 + 6 * count
+        Byte 2              - Sample count - short of the batch size if the stream was interrupted
+        Byte 3              - Flags (VANET_API_ACCEL_xxx)
+        Byte 4-5            - Output data rate in Hz
+        Byte 6              - Range, +/- G
+        Byte 7              - Reserved
+        Byte 8-11           - Sequence number of the first sample: samples taken since the request,
+                              counting any that were lost - including whole batches dropped while
+                              the mux was too busy to send them
+        Byte 12-19          - Time of the first sample, us since 1970 UTC.  The rest follow at the
+                              output data rate
+        Byte 20-25          - First sample X, Y, Z in raw counts, signed (+/- range is +/- 32768)
+        ...
+
+    Features (API 11):
+        Byte 0              - 'D'
+        Byte 1              - 18 + 10 * count
+        Byte 2              - Feature count
+        Byte 3              - Flags (VANET_API_ACCEL_xxx)
+        Byte 4-5            - Output data rate in Hz
+        Byte 6-7            - Decimation factor: a feature every this many samples
+        Byte 8-11           - Sequence number of the first feature: features since the request,
+                              counting any that were lost
+        Byte 12-19          - Time of the first feature, us since 1970 UTC - the middle of the
+                              samples it was filtered from.  The rest follow a decimation factor
+                              of samples apart
+        Byte 20-21          - First feature X in mg, signed: low passed and decimated, less the
+                              codeplug's calibration offset, and less gravity if it was asked for
+        Byte 22-23          - Y
+        Byte 24-25          - Z
+        Byte 26-27          - Magnitude of X, Y, Z in mg
+        Byte 28-29          - Jerk: the change in acceleration since the feature before, 0.1 G/s
+        ...
+
+    A disconnect stops the stream, and the next connect starts with the text lines again.
+*/
+#define VANET_API_ACCEL_STREAM_REQUEST  'S'
+#define VANET_API_ACCEL_FEATURE_REQUEST 'F'
+#define VANET_API_ACCEL_CONFIG          'C'
+#define VANET_API_ACCEL_BATCH           'B'
+#define VANET_API_ACCEL_FEATURES        'D'
+
+/// Most samples in a batch - a full one still fits a mux frame
+#define VANET_API_ACCEL_BATCH_MAX       16
+
+/// Most features in a batch
+#define VANET_API_ACCEL_FEATURE_MAX     10
+
+#define VANET_API_ACCEL_REQUEST_SIZE    4
+#define VANET_API_ACCEL_FEATURE_REQUEST_SIZE 7
+#define VANET_API_ACCEL_CONFIG_SIZE     6
+#define VANET_API_ACCEL_BATCH_HDR_SIZE  20
+#define VANET_API_ACCEL_FEATURE_SIZE    10
+
+/// Feature request flags
+enum
+{
+    VANET_API_ACCEL_FEATURE_DYNAMIC     = 0x01,     ///< Take gravity out of X, Y, Z (and so the magnitude)
+};
+
+/*
+    A recording (see Read Recording) is records in the same format, in the order they were taken.
+    Times are on the daughterboard's monotonic clock: us since it started, the low 32 bits.  The
+    recording's entry has the trigger time on that clock and in UTC.
+
+    Accelerometer Block (API 10):
+        Byte 0              - 'A'
+        Byte 1              - 10 + 6 * count
+        Byte 2-5            - Time of the last sample.  The rest are a period apart before it
+        Byte 6-7            - Output data rate in Hz
+        Byte 8              - Range, +/- G
+        Byte 9              - Sample count
+        Byte 10             - Flags (VANET_API_ACCEL_OVERRUN)
+        Byte 11             - Reserved
+        Byte 12-17          - First sample X, Y, Z in raw counts, as for a Batch
+        ...
+
+    GPS Fix (API 10):
+        Byte 0              - 'G'
+        Byte 1              - 20
+        Byte 2-5            - Time the fix was parsed
+        Byte 6              - GPS state flags, the low byte
+        Byte 7              - Satellites
+        Byte 8-11           - Latitude in degrees * 10,000,000
+        Byte 12-15          - Longitude in degrees * 10,000,000
+        Byte 16-17          - Altitude in meters
+        Byte 18-19          - Speed in cm/s
+        Byte 20-21          - Track angle in degrees True
+*/
+#define VANET_API_REC_ACCEL             'A'
+#define VANET_API_REC_GPS               'G'
+
+#define VANET_API_REC_ACCEL_HDR_SIZE    12
+#define VANET_API_REC_GPS_SIZE          22
+
+/// Batch flags
+enum
+{
+    VANET_API_ACCEL_OVERRUN             = 0x01,     ///< Samples were lost just before this batch - the FIFO overran or the mux was backlogged
+    VANET_API_ACCEL_UNSYNCED            = 0x02,     ///< The time isn't disciplined to the GPS time pulse
+};
+
 #endif
\ No newline at end of file
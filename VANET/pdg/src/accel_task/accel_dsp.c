@@ -0,0 +1,353 @@
+/**
+ *	@file	accel_dsp.c
+ *
+ *	@brief	Fixed point accelerometer feature filter
+ *
+ *	Calibrated samples in mg go through a second order CIC decimator, which
+ *	averages away what the feature rate can't carry instead of aliasing it.
+ *	Gravity is the decimated output through a one pole low pass of about a
+ *	second, started at the first output so there's no settling.  Magnitude
+ *	and jerk come from the features themselves.  It's all integer - the MCU
+ *	has no FPU - and the UNIT_TEST build checks it against synthetic motion.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "accel_dsp.h"
+#else
+#include <asf.h>
+#include <string.h>
+#include "vanet.h"
+#include "accel_dsp.h"
+#endif
+
+#define DSP_SHIFT_MAX			12			// gravity's low pass never takes more than 4096 features
+
+static int32_t div_round(int32_t n, int32_t d)
+{
+	return n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d);
+}
+
+static int16_t sat16(int32_t v)
+{
+	return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+static uint16_t isqrt(uint32_t v)
+{
+	uint32_t root = 0, bit = 1UL << 30;
+
+	while (bit > v)
+		bit >>= 2;
+	while (bit)
+	{
+		if (v >= root + bit)
+		{
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+		bit >>= 2;
+	}
+	return root;
+}
+
+int16_t accel_dsp_mg(int16_t raw, uint8_t range)
+{
+	return ((int32_t) raw * range * 1000 + (1 << 14)) >> 15;
+}
+
+void accel_dsp_init(accel_dsp_t* dsp, uint16_t rate_hz, uint16_t feature_hz, bool dynamic)
+{
+	uint32_t r = feature_hz ? ((uint32_t) rate_hz + feature_hz / 2) / feature_hz : 1;
+
+	memset(dsp, 0, sizeof(*dsp));
+	if (r < 1)
+		r = 1;
+	else if (r > ACCEL_DSP_DECIMATION_MAX)
+		r = ACCEL_DSP_DECIMATION_MAX;
+	dsp->decimation = r;
+	dsp->rate_hz = rate_hz;
+	dsp->dynamic = dynamic;
+
+	// 2^shift features is the most that fit in a second
+	dsp->shift = 1;
+	while (dsp->shift < DSP_SHIFT_MAX && ((uint32_t) 2 << dsp->shift) * r <= rate_hz)
+		dsp->shift++;
+
+	accel_dsp_restart(dsp);
+}
+
+void accel_dsp_restart(accel_dsp_t* dsp)
+{
+	dsp->phase = 0;
+	memset(dsp->integ, 0, sizeof(dsp->integ));
+	memset(dsp->comb, 0, sizeof(dsp->comb));
+	// the first output still has the zeros from before the restart in it
+	dsp->warm = 1;
+}
+
+bool accel_dsp_sample(accel_dsp_t* dsp, const int16_t* mg, accel_dsp_feature_t* out)
+{
+	int32_t gain = (int32_t) dsp->decimation * dsp->decimation;
+	int32_t v[3], d;
+	uint32_t c1, c2, sq = 0, dsq = 0;
+	int i;
+
+	for (i=0; i<3; i++)
+	{
+		dsp->integ[0][i] += (uint32_t) (int32_t) mg[i];
+		dsp->integ[1][i] += dsp->integ[0][i];
+	}
+	if (++dsp->phase < dsp->decimation)
+		return false;
+	dsp->phase = 0;
+
+	// the combs at the feature rate - the wrapped sums difference out right
+	for (i=0; i<3; i++)
+	{
+		c1 = dsp->integ[1][i] - dsp->comb[0][i];
+		dsp->comb[0][i] = dsp->integ[1][i];
+		c2 = c1 - dsp->comb[1][i];
+		dsp->comb[1][i] = c1;
+		v[i] = div_round((int32_t) c2, gain);
+	}
+	if (dsp->warm)
+	{
+		dsp->warm--;
+		return false;
+	}
+
+	if (!dsp->primed)
+	{
+		for (i=0; i<3; i++)
+		{
+			dsp->gravity[i] = v[i] << ACCEL_DSP_FRAC;
+			dsp->last[i] = v[i];
+		}
+		dsp->primed = true;
+	}
+
+	for (i=0; i<3; i++)
+	{
+		dsp->gravity[i] += ((v[i] << ACCEL_DSP_FRAC) - dsp->gravity[i]) >> dsp->shift;
+		d = sat16(v[i] - dsp->last[i]);
+		dsq += d * d;
+		dsp->last[i] = v[i];
+		if (dsp->dynamic)
+			v[i] = sat16(v[i] - ((dsp->gravity[i] + (1 << (ACCEL_DSP_FRAC - 1))) >> ACCEL_DSP_FRAC));
+		sq += v[i] * v[i];
+	}
+
+	out->x = v[0];
+	out->y = v[1];
+	out->z = v[2];
+	out->mag = isqrt(sq);
+	// mg per feature to 0.1 G/s
+	c1 = (uint32_t) isqrt(dsq) * dsp->rate_hz / ((uint32_t) dsp->decimation * 100);
+	out->jerk = c1 > UINT16_MAX ? UINT16_MAX : c1;
+	return true;
+}
+
+#ifdef UNIT_TEST
+
+static int s_failed;
+
+static void expect(bool ok, const char* what)
+{
+	printf("%s: %s\n", ok ? "pass" : "FAIL", what);
+	if (!ok) s_failed = 1;
+}
+
+/// Run a profile (mg per axis at sample i of rate_hz) for ms, calling back with each feature
+static int test_run(accel_dsp_t* dsp, void (*profile)(int i, int rate_hz, double* xyz), int ms,
+					void (*feature)(int n, const accel_dsp_feature_t* f, void* arg), void* arg)
+{
+	accel_dsp_feature_t f;
+	double xyz[3];
+	int16_t mg[3];
+	int n = 0;
+
+	for (int i=0; i < ms * dsp->rate_hz / 1000; i++)
+	{
+		profile(i, dsp->rate_hz, xyz);
+		for (int a=0; a<3; a++)
+			mg[a] = lround(xyz[a]);
+		if (accel_dsp_sample(dsp, mg, &f))
+			feature(n++, &f, arg);
+	}
+	return n;
+}
+
+/// Flat and still
+static void test_flat(int i, int rate_hz, double* xyz)
+{
+	(void) i;
+	(void) rate_hz;
+	xyz[0] = 12; xyz[1] = -7; xyz[2] = 1000;
+}
+
+/// Flat, with a 500 mg 5 Hz shake along X
+static void test_shake(int i, int rate_hz, double* xyz)
+{
+	test_flat(i, rate_hz, xyz);
+	xyz[0] += 500 * sin(2 * M_PI * 5 * i / rate_hz);
+}
+
+/// Flat, with 500 mg of 180 Hz engine buzz along Y
+static void test_buzz(int i, int rate_hz, double* xyz)
+{
+	test_flat(i, rate_hz, xyz);
+	xyz[1] += 500 * sin(2 * M_PI * 180 * i / rate_hz);
+}
+
+/// Flat, then a 1G step along X at 1 s
+static void test_step(int i, int rate_hz, double* xyz)
+{
+	test_flat(i, rate_hz, xyz);
+	if (i >= rate_hz)
+		xyz[0] += 1000;
+}
+
+/// On its side and still
+static void test_side(int i, int rate_hz, double* xyz)
+{
+	(void) i;
+	(void) rate_hz;
+	xyz[0] = 1000; xyz[1] = 0; xyz[2] = 0;
+}
+
+/// Flat, then on its side from 1 s
+static void test_tilt(int i, int rate_hz, double* xyz)
+{
+	if (i < rate_hz)
+		test_flat(i, rate_hz, xyz);
+	else
+		test_side(i, rate_hz, xyz);
+}
+
+typedef struct
+{
+	int skip;						// features to leave out
+	int max[3];						// largest |x|, |y|, |z|
+	int min_mag, max_mag;
+	int max_jerk;
+	accel_dsp_feature_t last;
+} test_stats_t;
+
+static void test_collect(int n, const accel_dsp_feature_t* f, void* arg)
+{
+	test_stats_t* s = (test_stats_t*) arg;
+	int v[3] = { f->x, f->y, f->z };
+
+	s->last = *f;
+	if (n < s->skip)
+		return;
+	for (int a=0; a<3; a++)
+		if (abs(v[a]) > s->max[a])
+			s->max[a] = abs(v[a]);
+	if (f->mag < s->min_mag)
+		s->min_mag = f->mag;
+	if (f->mag > s->max_mag)
+		s->max_mag = f->mag;
+	if (f->jerk > s->max_jerk)
+		s->max_jerk = f->jerk;
+}
+
+static test_stats_t test_stats(int skip)
+{
+	test_stats_t s;
+
+	memset(&s, 0, sizeof(s));
+	s.skip = skip;
+	s.min_mag = 0xffff;
+	return s;
+}
+
+int main(int argc, char** argv)
+{
+	accel_dsp_t dsp;
+	test_stats_t s;
+	int n;
+
+	(void) argc;
+	(void) argv;
+	expect(accel_dsp_mg(16384, 2) == 1000 && accel_dsp_mg(-16384, 2) == -1000 && accel_dsp_mg(32767, 16) == 16000,
+		"counts to mg");
+
+	accel_dsp_init(&dsp, 400, 25, false);
+	expect(dsp.decimation == 16 && dsp.shift == 4, "400 Hz to 25 Hz decimates by 16");
+	s = test_stats(0);
+	n = test_run(&dsp, test_flat, 2000, test_collect, &s);
+	expect(n == 49, "a feature every 16 samples, less the first");
+	expect(s.last.x == 12 && s.last.y == -7 && s.last.z == 1000 && s.min_mag == 1000 && s.max_mag == 1000 && s.max_jerk == 0,
+		"still is exact");
+
+	accel_dsp_init(&dsp, 400, 25, true);
+	s = test_stats(0);
+	test_run(&dsp, test_flat, 2000, test_collect, &s);
+	expect(s.max[0] == 0 && s.max[1] == 0 && s.max[2] == 0 && s.max_mag == 0, "still without gravity is nothing");
+
+	accel_dsp_init(&dsp, 400, 50, false);
+	s = test_stats(10);
+	test_run(&dsp, test_shake, 2000, test_collect, &s);
+	printf("shake %d mg\n", s.max[0]);
+	expect(s.max[0] > 450 && s.max[0] < 515, "a 5 Hz shake comes through");
+
+	s = test_stats(10);
+	accel_dsp_init(&dsp, 400, 50, false);
+	test_run(&dsp, test_buzz, 2000, test_collect, &s);
+	printf("buzz %d mg\n", s.max[1]);
+	expect(s.max[1] < 25, "180 Hz buzz doesn't alias into 50 Hz features");
+
+	accel_dsp_init(&dsp, 400, 50, false);
+	s = test_stats(10);
+	test_run(&dsp, test_step, 2000, test_collect, &s);
+	printf("step jerk %d.%d G/s\n", s.max_jerk / 10, s.max_jerk % 10);
+	expect(s.max_jerk > 250 && s.max_jerk <= 500, "a 1G step over two features is 25 to 50 G/s");
+	expect(s.last.x == 1012 && s.last.jerk == 0, "and settles");
+
+	accel_dsp_init(&dsp, 400, 50, true);
+	s = test_stats(0);
+	test_run(&dsp, test_tilt, 6000, test_collect, &s);
+	expect(s.max[0] > 900, "tilting shows up without gravity");
+	expect(abs(s.last.x) < 10 && abs(s.last.z) < 10, "and gravity catches up in a few seconds");
+
+	// still on its side - the gravity from before the restart already cancels it
+	accel_dsp_restart(&dsp);
+	s = test_stats(0);
+	n = test_run(&dsp, test_side, 1000, test_collect, &s);
+	expect(n == 49 && s.max[0] < 10, "a restart drops a feature and keeps gravity");
+
+	accel_dsp_init(&dsp, 1600, 1, false);
+	expect(dsp.decimation == ACCEL_DSP_DECIMATION_MAX, "decimation stops at the most the CIC can take");
+	s = test_stats(0);
+	test_run(&dsp, test_step, 2000, test_collect, &s);
+	expect(s.last.x == 1012 && s.last.z == 1000, "at which the gain still fits");
+
+	accel_dsp_init(&dsp, 100, 200, false);
+	s = test_stats(0);
+	n = test_run(&dsp, test_shake, 1000, test_collect, &s);
+	expect(dsp.decimation == 1 && n == 99, "features faster than the samples are the samples");
+
+	return s_failed;
+}
+#endif // UNIT_TEST
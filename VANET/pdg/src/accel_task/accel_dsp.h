@@ -0,0 +1,77 @@
+/**
+ *	@file	accel_dsp.h
+ *
+ *	@brief	Fixed point accelerometer feature filter
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef ACCEL_DSP_H
+#define ACCEL_DSP_H
+
+/// The largest decimation factor - a second order CIC's gain (factor squared) times any mg still fits 32 bits
+#define ACCEL_DSP_DECIMATION_MAX	256
+
+/// Fraction bits of the gravity estimate
+#define ACCEL_DSP_FRAC				8
+
+typedef struct
+{
+	uint16_t decimation;			///< Input samples per feature
+	uint16_t rate_hz;				///< Of the samples going in
+	uint8_t shift;					///< Gravity low pass: it moves 1 / 2^shift of the way each feature, about a second
+	bool dynamic;					///< Features have gravity taken out
+	uint8_t warm;					///< Outputs still to drop after a restart
+	bool primed;					///< gravity[] and last[] hold something
+	uint16_t phase;					///< Input samples into this feature
+	uint32_t integ[2][3];			///< CIC integrators, wrapping
+	uint32_t comb[2][3];			///< CIC comb delays
+	int32_t gravity[3];				///< mg << ACCEL_DSP_FRAC
+	int16_t last[3];				///< The last feature before gravity came out, mg
+} accel_dsp_t;
+
+/// A feature, mg unless it says otherwise
+typedef struct
+{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	uint16_t mag;					///< Vector magnitude of x, y, z
+	uint16_t jerk;					///< Rate of change of the acceleration since the last feature, 0.1 G/s
+} accel_dsp_feature_t;
+
+/// Raw counts at +/- range G to mg
+int16_t accel_dsp_mg(int16_t raw, uint8_t range);
+
+/**
+ *	Set up a filter
+ *
+ *	@param rate_hz		Output data rate of the samples going in
+ *	@param feature_hz	Features wanted - the decimation factor is the nearest that gives it
+ *	@param dynamic		Take gravity out of the features
+ */
+void accel_dsp_init(accel_dsp_t* dsp, uint16_t rate_hz, uint16_t feature_hz, bool dynamic);
+
+/// Start the decimation over after samples were lost, keeping the gravity estimate
+void accel_dsp_restart(accel_dsp_t* dsp);
+
+/**
+ *	Filter a sample
+ *
+ *	@param mg	X, Y, Z with the calibration offsets taken out
+ *
+ *	@return true if it completed a feature, which is centred (decimation - 1) samples before this one
+ */
+bool accel_dsp_sample(accel_dsp_t* dsp, const int16_t* mg, accel_dsp_feature_t* out);
+
+#endif // ACCEL_DSP_H
@@ -20,6 +20,7 @@
 #include <string.h>
 #include "vanet.h"
 #include "vanet_api.h"
+#include "accel_lis3dsh_sm.h"
 
 #ifdef BSP_ENABLE_LIS3DSH
 
@@ -33,20 +34,18 @@
 #define LIS3DSH_CTRL_REG2	0x22
 #define LIS3DSH_CTRL_REG3	0x23
 #define LIS3DSH_CTRL_REG5	0x24
+#define LIS3DSH_CTRL_REG6	0x25
 #define LIS3DSH_STATUS		0x27
 #define LIS3DSH_OUT_X		0x28
 #define LIS3DSH_OUT_Y		0x2A
 #define LIS3DSH_OUT_Z		0x2C
+#define LIS3DSH_FIFO_CTRL	0x2e
+#define LIS3DSH_FIFO_SRC	0x2f
 
 #define LIS3DSH_ST1_1		0x40
-#define LIS3DSH_ST1_2		0x41
+#define LIS3DSH_ST2_1		0x60
 
 #define LIS3DSH_THRS1_1		0x57
-#define LIS3DSH_MASK1_B		0x59
-#define LIS3DSH_MASK1_A		0x5a
-#define LIS3DSH_SETT1		0x5b
-#define LIS3DSH_PR1			0x5c
-#define LIS3DSH_OUTS1		0x5f
 
 
 #define LIS3DSH_WHO_AM_I_EXPECTED	0x3f
@@ -54,6 +53,42 @@
 
 #define LIS3DSG_1G_AT_2G_SCALE		0x4000
 
+#define LIS3DSH_STAT_INT_SM1		0x08
+#define LIS3DSH_STAT_INT_SM2		0x04
+#define LIS3DSH_CTRL_REG1_SM_EN		0x01		// on INT1 (SMx_PIN clear), no hysteresis
+#define LIS3DSH_CTRL_REG3_INT1		0x48		// IEA active high, interrupt latched, INT1_EN
+#define LIS3DSH_CTRL_REG6_FIFO		0x54		// FIFO_EN, ADD_INC (OUT_Z_H wraps to OUT_X_L), P1_WTM
+#define LIS3DSH_CTRL_REG6_P1_WTM	0x04
+#define LIS3DSH_FIFO_CTRL_BYPASS	0x00
+#define LIS3DSH_FIFO_CTRL_STREAM	0x40
+#define LIS3DSH_FIFO_SRC_WTM		0x80
+#define LIS3DSH_FIFO_SRC_OVRN		0x40
+#define LIS3DSH_FIFO_SRC_FSS		0x1f
+
+#define LIS3DSH_ODR_400HZ			0x70
+#define LIS3DSH_XYZ_EN				0x07
+
+/// Half the FIFO - the other half covers the latency of getting to the interrupt
+#define LIS3DSH_FIFO_WATERMARK		16
+
+/// Bursts per service before giving up on getting under the watermark
+#define LIS3DSH_DRAIN_PASSES		4
+
+/// The newest sample read from the FIFO, for app_accel_query()
+static app_accel_xyz_t s_last;
+static uint64_t s_last_time_us;
+
+/// What we last set, so a query or a block doesn't go back to the part for them
+static uint16_t s_rate_hz;
+static uint8_t s_range;
+static uint16_t s_threshold;
+
+/// What each state machine runs - compiled again when the range or rate changes
+static app_accel_detector_t s_detector[APP_ACCEL_SM_COUNT];
+
+/// Streaming through the FIFO, or bypassed with the watermark off
+static bool s_fifo;
+
 /*
 typedef struct
 {
@@ -75,17 +110,27 @@ bool app_accel_init_dev(void)
 	{
 		bsp_logcat_print(BSP_LOGCAT_ACCEL, "LIS3DSH Accelerometer Found");
 		
-		// disable state machine!
+		// it can take fast mode, and its FIFO bursts are most of what's on the bus
+		bsp_i2c_set_speed(BSP_ACCEL_I2C_ADDR, BSP_I2C_SPEED_MAX_HZ);
+		
+		// disable state machines!
 		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_THRS1_1, 0x00);		// threshold
 		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG3, 0x00);	// Interrupts disabled
 		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG1, 0x00);	// disable SM1
+		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG2, 0x00);	// disable SM2
+		memset(s_detector, 0, sizeof(s_detector));
 				
-		// enable x,y,z @ 100Hz, +/- 2G scale
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG3, 0);		// disable interrupts
+		// enable x,y,z @ 400Hz, +/- 2G scale
 		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG5, 0);		// reset default scale
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG4, 0x67);	// enable x, y, & z @ 100Hz
-
-	
+		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG4, LIS3DSH_ODR_400HZ | LIS3DSH_XYZ_EN);
+		
+		s_rate_hz = app_accel_read_bandwidth();
+		s_range = app_accel_read_range();
+		s_threshold = 0;
+		
+		// the FIFO as it was (a reset doesn't stop a stream), and the state machines on INT1 with its watermark
+		app_accel_set_fifo(s_fifo);
+		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG3, LIS3DSH_CTRL_REG3_INT1);
 		
 		return true;
 	}
@@ -95,6 +140,105 @@ bool app_accel_init_dev(void)
 	}		
 }
 
+/// Read count samples from the FIFO in one burst and publish them
+static void lis3dsh_read_fifo(uint8_t count, bool overrun)
+{
+	bsp_tkvs_msg_t* msg = bsp_tkvs_alloc(APP_ACCEL_BLOCK_SIZE(count));
+	app_accel_block_t* block = (app_accel_block_t*) msg->data;
+	uint8_t* raw = (uint8_t*) block->xyz;
+	irqflags_t flags;
+	
+	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, LIS3DSH_OUT_X, raw, count * sizeof(app_accel_xyz_t));
+	block->time_us = bsp_rtc_get_time_us();
+	block->rate_hz = s_rate_hz;
+	block->range = s_range;
+	block->count = count;
+	block->overrun = overrun;
+	
+	// little endian off the part, in place
+	for (int i=0; i<count; i++, raw += sizeof(app_accel_xyz_t))
+	{
+		block->xyz[i].x = (int16_t)(raw[1] << 8 | raw[0]);
+		block->xyz[i].y = (int16_t)(raw[3] << 8 | raw[2]);
+		block->xyz[i].z = (int16_t)(raw[5] << 8 | raw[4]);
+	}
+	
+	flags = cpu_irq_save();
+	s_last = block->xyz[count - 1];
+	s_last_time_us = block->time_us;
+	cpu_irq_restore(flags);
+	
+	msg->data_len = APP_ACCEL_BLOCK_SIZE(count);
+	bsp_tkvs_publish(APP_TKVS_ACCEL_TASK, APP_ACCEL_EVENT_SAMPLES, msg);
+}
+
+/// Empty the FIFO, and keep at it while it is over the watermark - INT1 only rises again once it has dropped
+static void lis3dsh_drain(void)
+{
+	uint8_t src, count;
+	
+	for (int pass=0; pass<LIS3DSH_DRAIN_PASSES; pass++)
+	{
+		bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_FIFO_SRC, &src);
+		if (pass > 0 && !(src & LIS3DSH_FIFO_SRC_WTM))
+			break;
+			
+		// FSS only counts to 31: overrun means it's full
+		count = (src & LIS3DSH_FIFO_SRC_OVRN) ? APP_ACCEL_BLOCK_MAX : (src & LIS3DSH_FIFO_SRC_FSS);
+		if (count == 0)
+			break;
+		lis3dsh_read_fifo(count, (src & LIS3DSH_FIFO_SRC_OVRN) != 0);
+	}
+}
+
+/// The output registers as they stand - only while the FIFO is bypassed
+static void lis3dsh_read_now(void)
+{
+	uint8_t raw[sizeof(app_accel_xyz_t)];
+	app_accel_xyz_t xyz;
+	uint64_t now;
+	irqflags_t flags;
+	
+	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, LIS3DSH_OUT_X, raw, sizeof(raw));
+	now = bsp_rtc_get_time_us();
+	xyz.x = (int16_t)(raw[1] << 8 | raw[0]);
+	xyz.y = (int16_t)(raw[3] << 8 | raw[2]);
+	xyz.z = (int16_t)(raw[5] << 8 | raw[4]);
+	
+	flags = cpu_irq_save();
+	s_last = xyz;
+	s_last_time_us = now;
+	cpu_irq_restore(flags);
+}
+
+void app_accel_set_fifo(bool on)
+{
+	uint8_t ctrl6 = on ? LIS3DSH_CTRL_REG6_FIFO : (LIS3DSH_CTRL_REG6_FIFO & ~LIS3DSH_CTRL_REG6_P1_WTM);
+	
+	// bypass empties it either way, so a stream starts without a stale overrun
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_FIFO_CTRL, LIS3DSH_FIFO_CTRL_BYPASS);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG6, ctrl6);
+	if (on)
+		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_FIFO_CTRL, LIS3DSH_FIFO_CTRL_STREAM | LIS3DSH_FIFO_WATERMARK);
+	s_fifo = on;
+}
+
+uint8_t app_accel_service(void)
+{
+	uint8_t stat, fired = 0;
+	
+	// INT1 is any of them
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_STAT, &stat);
+	if (s_fifo)
+		lis3dsh_drain();
+	
+	if (stat & LIS3DSH_STAT_INT_SM1)
+		fired |= APP_ACCEL_SM(1);
+	if (stat & LIS3DSH_STAT_INT_SM2)
+		fired |= APP_ACCEL_SM(2);
+	return fired;
+}
+
 void app_accel_exercise(void)
 {
 	app_accel_out_t out;
@@ -105,76 +249,108 @@ void app_accel_exercise(void)
 	temp = out.t;
 	temp = temp * 1.8 + 32;
 	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "LIS3DSH Temperature: %d F", temp);
-	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "x = %d, y = %d, z = %d", out.x, out.y, out.z);
-			
-	// loop a few more measurements
-	for (int c=0; c<10; c++)
-	{
-		app_accel_query(&out);
-		bsp_logcat_printf(BSP_LOGCAT_ACCEL, "x = %d, y = %d, z = %d", out.x, out.y, out.z);
-		bsp_delay(1);
-	}
+	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "x = %d, y = %d, z = %d @ %d Hz", out.x, out.y, out.z, out.b);
 }
 
 void app_accel_query(app_accel_out_t *out)
 {
 	uint8_t val;
-	uint8_t buf[6];
-	
-	do
-	{
-		bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_STATUS, &val);
-	} while ((val & 0x80) == 0);
+	irqflags_t flags;
 	
-	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, LIS3DSH_OUT_X, buf, sizeof(buf));
-	out->x = (int16_t)(buf[1] << 8 | buf[0]);
-	out->y = (int16_t)(buf[3] << 8 | buf[2]);
-	out->z = (int16_t)(buf[5] << 8 | buf[4]);
+	// the FIFO is the accel task's - no waiting on the part here
+	if (!s_fifo)
+		lis3dsh_read_now();
+	flags = cpu_irq_save();
+	out->x = s_last.x;
+	out->y = s_last.y;
+	out->z = s_last.z;
+	out->time_us = s_last_time_us;
+	cpu_irq_restore(flags);
 	
 	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_OUT_T, &val);
 	out->t = (int8_t)val + 25;		// temperature in C (0 == 25)
 	//out->t = out->t * 1.8 + 32;		// temperature in F
 	
-	out->b = app_accel_read_bandwidth();
+	out->b = s_rate_hz;
 	
-	out->r = app_accel_read_range();
+	out->r = s_range;
 	
-	out->th = app_accel_get_movement_threshold();
+	out->th = s_threshold;
+	
+	out->gx = out->gy = out->gz = 0;
+	out->dps = 0;
 }
 
-void app_accel_set_movement_threshold(uint16_t threshold)
+/// (Re)load a state machine from s_detector - off if it doesn't compile at the range and rate
+static bool lis3dsh_sm_load(uint8_t sm)
 {
-	if (threshold != 0)
+	const app_accel_detector_t* d = &s_detector[sm - 1];
+	uint8_t base = sm == 1 ? LIS3DSH_ST1_1 : LIS3DSH_ST2_1;
+	uint8_t ctrl = sm == 1 ? LIS3DSH_CTRL_REG1 : LIS3DSH_CTRL_REG2;
+	uint8_t image[LIS3DSH_SM_IMAGE_SIZE];
+	bool ok = true;
+	
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, ctrl, 0x00);
+	
+	if (d->kind != VANET_API_ACCEL_DETECT_OFF)
 	{
-		uint8_t range, reg;
-		// set the range for the given threshold
-		//app_accel_write_range(threshold / 1000);
-		
-		// calculate actual register value for new range
-		range = app_accel_read_range();
-		reg = threshold / range * 128 / 1000;
-		if (reg > 0x7f) reg = 0x7f;
-		bsp_logcat_printf(BSP_LOGCAT_ACCEL, "Accel State Machine: threshold=%d, range=%d, reg=%02x", threshold, range*1000, reg);
-			
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_THRS1_1, reg);		// threshold
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_MASK1_A, 0xfc);		// xyz +/- enabled
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_MASK1_B, 0xfc);		// xyz +/- enabled
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_SETT1, 0x01);		// CONT generates interrupt
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_PR1, 0x00);			// program / reset pointers
-			
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_ST1_1, 0x05);		// GNTH1
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_ST1_2, 0x11);		// CONT
-			
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG3, 0x48);	// IEA active high, interrupt latched, INT1_EN
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG1, 0x01);	// enable SM1	
+		ok = lis3dsh_sm_compile(image, d, s_range, s_rate_hz);
+		if (ok)
+		{
+			// the states, then the timers up to SETT, in one write
+			bsp_i2c_write_bytes(BSP_ACCEL_I2C_ADDR, base + LIS3DSH_SM_ST, image, LIS3DSH_SM_IMAGE_SIZE);
+			bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, base + LIS3DSH_SM_PR, 0x00);
+			bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, ctrl, LIS3DSH_CTRL_REG1_SM_EN);
+		}
+		bsp_logcat_printf(BSP_LOGCAT_ACCEL, "Accel SM%d: detector %d, %s (range=%d, rate=%d)", sm, d->kind,
+				ok ? "loaded" : "won't run", s_range, s_rate_hz);
 	}
-	else
+	
+	if (sm == 1)
+		s_threshold = app_accel_get_movement_threshold();
+	return ok;
+}
+
+/// The range or rate changed - the thresholds and timers are in its units
+static void lis3dsh_sm_reload(void)
+{
+	for (uint8_t sm=1; sm<=APP_ACCEL_SM_COUNT; sm++)
 	{
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_THRS1_1, 0x00);		// threshold
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG3, 0x00);	// Interrupts disabled
-		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG1, 0x00);	// disable SM1
+		if (s_detector[sm - 1].kind != VANET_API_ACCEL_DETECT_OFF &&
+			s_detector[sm - 1].kind != VANET_API_ACCEL_DETECT_PROGRAM)
+			lis3dsh_sm_load(sm);
+	}
+}
+
+bool app_accel_set_detector(uint8_t sm, const app_accel_detector_t* d)
+{
+	if (sm < 1 || sm > APP_ACCEL_SM_COUNT)
+		return false;
+	
+	s_detector[sm - 1] = *d;
+	if (!lis3dsh_sm_load(sm))
+	{
+		s_detector[sm - 1].kind = VANET_API_ACCEL_DETECT_OFF;
+		return false;
 	}
+	return true;
+}
 
+void app_accel_set_movement_threshold(uint16_t threshold)
+{
+	app_accel_detector_t d;
+	
+	// any axis over it, on SM1
+	memset(&d, 0, sizeof(d));
+	d.kind = threshold ? VANET_API_ACCEL_DETECT_MOTION : VANET_API_ACCEL_DETECT_OFF;
+	d.thresh1_mg = threshold;
+	app_accel_set_detector(1, &d);
+	
+	if (!threshold)
+	{
+		bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_THRS1_1, 0x00);
+		s_threshold = 0;
+	}
 }
 
 uint16_t app_accel_get_movement_threshold(void)
@@ -188,11 +364,18 @@ uint16_t app_accel_get_movement_threshold(void)
 	return reg * 1000 * range / 128;
 }
 
-void app_accel_ack(void)
+void app_accel_ack(uint8_t fired)
 {
 	uint8_t out;
-	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_OUTS1, &out);
-	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "LIS3DSH SM1 Out: %2x", out);
+	
+	for (uint8_t sm=1; sm<=APP_ACCEL_SM_COUNT; sm++)
+	{
+		if (fired & APP_ACCEL_SM(sm))
+		{
+			bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, (sm == 1 ? LIS3DSH_ST1_1 : LIS3DSH_ST2_1) + LIS3DSH_SM_OUTS, &out);
+			bsp_logcat_printf(BSP_LOGCAT_ACCEL, "LIS3DSH SM%d Out: %2x", sm, out);
+		}
+	}
 }
 
 uint8_t app_accel_read_register(uint8_t reg)
@@ -205,6 +388,14 @@ uint8_t app_accel_read_register(uint8_t reg)
 void app_accel_write_register(uint8_t reg, uint8_t val)
 {
 	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, reg, val);
+	
+	// keep what query and the blocks report honest
+	if (reg == LIS3DSH_CTRL_REG4)
+		s_rate_hz = app_accel_read_bandwidth();
+	else if (reg == LIS3DSH_CTRL_REG5)
+		s_range = app_accel_read_range();
+	else if (reg == LIS3DSH_THRS1_1)
+		s_threshold = app_accel_get_movement_threshold();
 }
 
 uint8_t app_accel_read_range(void)
@@ -247,6 +438,8 @@ void app_accel_write_range(uint8_t range)
 	reg = (reg & 0xc3) | (fscale << 3);
 	bsp_logcat_printf(BSP_ACCEL_I2C_ADDR, "LIS3DSH_CTRL_REG5=%02x", reg);
 	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG5, reg);
+	s_range = app_accel_read_range();
+	lis3dsh_sm_reload();
 }
 
 uint16_t app_accel_read_bandwidth(void)
@@ -303,6 +496,8 @@ void app_accel_write_bandwidth(uint16_t bandwidth)
 	reg = (reg & 0x0f) | (bw << 4);
 	bsp_logcat_printf(BSP_ACCEL_I2C_ADDR, "LIS3DSH_CTRL_REG4=%02x", reg);
 	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, LIS3DSH_CTRL_REG4, reg);
+	s_rate_hz = app_accel_read_bandwidth();
+	lis3dsh_sm_reload();
 }
 
 #endif // BSP_ENABLE_LIS3DSH
\ No newline at end of file
@@ -0,0 +1,308 @@
+/**
+ *	@file	accel_lis3dsh_sm.c
+ *
+ *	@brief	LIS3DSH state machine programs
+ *
+ *	Each detector is a few states of the part's own state machine, so the MCU
+ *	only hears about a qualified event.  A threshold condition on the vector
+ *	magnitude alone is exactly "the magnitude is above (or below) it"; the
+ *	timers count samples from when their state was entered.  Nothing here
+ *	touches the part, so the UNIT_TEST build runs the programs through a model
+ *	of the state machine.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "accel_task.h"
+#include "accel_lis3dsh_sm.h"
+#else
+#include <asf.h>
+#include <string.h>
+#include "vanet.h"
+#include "accel_lis3dsh_sm.h"
+#endif
+
+#if defined(UNIT_TEST) || defined(BSP_ENABLE_LIS3DSH)
+
+#define SM_STATE(reset, next)		(((reset) << 4) | (next))
+
+/// mg to a threshold register - 0 if it's beyond the range
+static uint8_t sm_threshold(uint16_t mg, uint8_t range)
+{
+	uint32_t reg = ((uint32_t) mg * 128 + range * 500) / (range * 1000);
+	
+	return reg <= 0x7f ? (reg ? reg : 1) : 0;
+}
+
+/// ms to a 16 bit timer in samples - 0 if it's too long
+static uint16_t sm_timer(uint16_t ms, uint16_t rate_hz)
+{
+	uint32_t n = ((uint32_t) ms * rate_hz + 500) / 1000;
+	
+	return n <= 0xffff ? (n ? n : 1) : 0;
+}
+
+bool lis3dsh_sm_compile(uint8_t* image, const app_accel_detector_t* d, uint8_t range, uint16_t rate_hz)
+{
+	uint8_t* st = &image[LIS3DSH_SM_ST];
+	uint8_t mask = LIS3DSH_SM_MASK_V;
+	uint16_t tim1 = 0, tim2 = 0;
+	int n = 0;
+	
+	memset(image, 0, LIS3DSH_SM_IMAGE_SIZE);
+	
+	if (d->kind == VANET_API_ACCEL_DETECT_PROGRAM)
+	{
+		memcpy(image, d->program, LIS3DSH_SM_IMAGE_SIZE);
+		return true;
+	}
+	
+	if (!range || !rate_hz)
+		return false;
+	
+	image[LIS3DSH_SM_THRS1] = sm_threshold(d->thresh1_mg, range);
+	if (!image[LIS3DSH_SM_THRS1] && d->kind == VANET_API_ACCEL_DETECT_MOTION)
+		image[LIS3DSH_SM_THRS1] = 0x7f;			// Set Movement Threshold has always clamped to the range
+	if (!image[LIS3DSH_SM_THRS1])
+		return false;
+	
+	if (d->time1_ms && !(tim1 = sm_timer(d->time1_ms, rate_hz)))
+		return false;
+	
+	switch (d->kind)
+	{
+		case VANET_API_ACCEL_DETECT_MOTION:
+			mask = LIS3DSH_SM_MASK_XYZ;
+			st[n++] = SM_STATE(LIS3DSH_SM_NOP, LIS3DSH_SM_GNTH1);
+			break;
+		
+		case VANET_API_ACCEL_DETECT_IMPACT:
+			// over, and it has to stay over until the timer runs out
+			st[n++] = SM_STATE(LIS3DSH_SM_NOP, LIS3DSH_SM_GNTH1);
+			if (tim1)
+				st[n++] = SM_STATE(LIS3DSH_SM_LNTH1, LIS3DSH_SM_TI1);
+			break;
+			
+		case VANET_API_ACCEL_DETECT_FREEFALL:
+		case VANET_API_ACCEL_DETECT_DROP:
+			st[n++] = SM_STATE(LIS3DSH_SM_NOP, LIS3DSH_SM_LNTH1);
+			if (tim1)
+				st[n++] = SM_STATE(LIS3DSH_SM_GNTH1, LIS3DSH_SM_TI1);
+			if (d->kind == VANET_API_ACCEL_DETECT_FREEFALL)
+				break;
+			
+			// then the landing, before timer 2 runs out
+			image[LIS3DSH_SM_THRS2] = sm_threshold(d->thresh2_mg, range);
+			tim2 = sm_timer(d->time2_ms, rate_hz);
+			if (!image[LIS3DSH_SM_THRS2] || !d->time2_ms || !tim2)
+				return false;
+			st[n++] = SM_STATE(LIS3DSH_SM_TI2, LIS3DSH_SM_GNTH2);
+			break;
+			
+		default:
+			return false;
+	}
+	st[n++] = LIS3DSH_SM_CONT;
+	
+	image[LIS3DSH_SM_TIM1] = tim1;
+	image[LIS3DSH_SM_TIM1 + 1] = tim1 >> 8;
+	image[LIS3DSH_SM_TIM2] = tim2;
+	image[LIS3DSH_SM_TIM2 + 1] = tim2 >> 8;
+	image[LIS3DSH_SM_MASK_A] = mask;
+	image[LIS3DSH_SM_MASK_B] = mask;
+	image[LIS3DSH_SM_SETT] = LIS3DSH_SM_SETT_SITR;
+	
+	return true;
+}
+
+#endif // UNIT_TEST || BSP_ENABLE_LIS3DSH
+
+#ifdef UNIT_TEST
+/* -----------
+ *  The programs against a model of the state machine, at 400 Hz and +/- 8G
+ * ----------*/
+#define TEST_HZ				400
+#define TEST_RANGE			8
+
+static int s_failed;
+
+/// One condition on a sample - only what the compiler uses
+static bool test_cond(const uint8_t* image, uint8_t cond, const double* xyz, int ticks)
+{
+	double thr1 = image[LIS3DSH_SM_THRS1] * TEST_RANGE / 128.0;
+	double thr2 = image[LIS3DSH_SM_THRS2] * TEST_RANGE / 128.0;
+	double v[8], thr;
+	bool above = false, below = false;
+	
+	switch (cond)
+	{
+		case LIS3DSH_SM_NOP:
+			return false;
+		case LIS3DSH_SM_TI1:
+			return ticks >= (image[LIS3DSH_SM_TIM1] | image[LIS3DSH_SM_TIM1 + 1] << 8);
+		case LIS3DSH_SM_TI2:
+			return ticks >= (image[LIS3DSH_SM_TIM2] | image[LIS3DSH_SM_TIM2 + 1] << 8);
+	}
+	
+	thr = (cond == LIS3DSH_SM_GNTH1 || cond == LIS3DSH_SM_LNTH1) ? thr1 : thr2;
+	
+	// P_X N_X P_Y N_Y P_Z N_Z P_V N_V
+	v[0] = xyz[0]; v[1] = -xyz[0];
+	v[2] = xyz[1]; v[3] = -xyz[1];
+	v[4] = xyz[2]; v[5] = -xyz[2];
+	v[6] = sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2]); v[7] = -v[6];
+	for (int i=0; i<8; i++)
+	{
+		if (image[LIS3DSH_SM_MASK_A] & (0x80 >> i))
+		{
+			above |= v[i] > thr;
+			below |= v[i] <= thr;
+		}
+	}
+	return (cond == LIS3DSH_SM_GNTH1 || cond == LIS3DSH_SM_GNTH2) ? above : below;
+}
+
+/// Run a profile (G per axis, a sample at a time), returning the sample the interrupt came on, or -1.
+/// CONT takes a sample of its own, so that's one after the last condition was met
+static int test_run(const uint8_t* image, void (*profile)(int i, double* xyz), int samples)
+{
+	int state = 0, ticks = 0;
+	double xyz[3];
+	
+	for (int i=0; i<samples; i++)
+	{
+		uint8_t st = image[LIS3DSH_SM_ST + state];
+		
+		profile(i, xyz);
+		ticks++;
+		if (st == LIS3DSH_SM_CONT)
+			return i;
+		if (test_cond(image, st >> 4, xyz, ticks))
+		{
+			state = 0;
+			ticks = 0;
+		}
+		else if (test_cond(image, st & 0x0f, xyz, ticks))
+		{
+			state++;
+			ticks = 0;
+		}
+	}
+	return -1;
+}
+
+static void expect(bool ok, const char* what)
+{
+	printf("%s: %s\n", ok ? "pass" : "FAIL", what);
+	if (!ok) s_failed = 1;
+}
+
+/// Samples at a time (ms from the start)
+#define MS(ms)				((ms) * TEST_HZ / 1000)
+
+/// On its side (1G on X), a 3G knock 5 ms long at 100 ms, then a 4G crash 60 ms long at 500 ms
+static void test_crash(int i, double* xyz)
+{
+	xyz[0] = 1.0; xyz[1] = 0.02; xyz[2] = -0.01;
+	if (i >= MS(100) && i < MS(105))
+		xyz[1] = 3.0;
+	if (i >= MS(500) && i < MS(560))
+		xyz[2] = -4.0;
+}
+
+/// Flat, dropped at 200 ms for 300 ms, landing with 6G
+static void test_drop(int i, double* xyz)
+{
+	xyz[0] = 0.01; xyz[1] = -0.02; xyz[2] = 1.0;
+	if (i >= MS(200) && i < MS(500))
+		xyz[2] = 0.05;
+	else if (i >= MS(500) && i < MS(520))
+		xyz[2] = 6.0;
+}
+
+/// Flat, lifted and set down - never below 0.6G
+static void test_lift(int i, double* xyz)
+{
+	xyz[0] = 0; xyz[1] = 0; xyz[2] = 1.0;
+	if (i >= MS(200) && i < MS(400))
+		xyz[2] = 0.6;
+	else if (i >= MS(400) && i < MS(450))
+		xyz[2] = 1.8;
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t image[LIS3DSH_SM_IMAGE_SIZE];
+	app_accel_detector_t d;
+	int at;
+	
+	memset(&d, 0, sizeof(d));
+	d.kind = VANET_API_ACCEL_DETECT_IMPACT;
+	d.thresh1_mg = 2500;
+	d.time1_ms = 20;
+	expect(lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ), "impact compiles");
+	at = test_run(image, test_crash, MS(1000));
+	printf("impact at %d ms\n", at * 1000 / TEST_HZ);
+	expect(at > MS(520) && at <= MS(520) + 2, "impact ignores the knock, fires 20 ms into the crash");
+	
+	d.time1_ms = 0;
+	lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ);
+	expect(test_run(image, test_crash, MS(1000)) == MS(100) + 1, "impact without a time fires on the knock");
+	
+	d.kind = VANET_API_ACCEL_DETECT_FREEFALL;
+	d.thresh1_mg = 350;
+	d.time1_ms = 100;
+	lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ);
+	at = test_run(image, test_drop, MS(1000));
+	expect(at > MS(300) && at <= MS(300) + 2, "free fall fires 100 ms into the fall");
+	expect(test_run(image, test_lift, MS(1000)) < 0, "free fall ignores a lift");
+	expect(test_run(image, test_crash, MS(1000)) < 0, "free fall ignores a crash");
+	
+	d.kind = VANET_API_ACCEL_DETECT_DROP;
+	d.thresh2_mg = 3000;
+	d.time2_ms = 500;
+	lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ);
+	at = test_run(image, test_drop, MS(1000));
+	expect(at > MS(500) && at <= MS(500) + 2, "drop fires on the landing");
+	d.time2_ms = 100;
+	lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ);
+	expect(test_run(image, test_drop, MS(1000)) < 0, "drop times out before a late landing");
+	
+	d.kind = VANET_API_ACCEL_DETECT_MOTION;
+	d.thresh1_mg = 1500;
+	lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ);
+	expect(image[LIS3DSH_SM_MASK_A] == LIS3DSH_SM_MASK_XYZ && image[LIS3DSH_SM_ST] == 0x05 && image[LIS3DSH_SM_ST + 1] == LIS3DSH_SM_CONT,
+		"motion is the old single threshold program");
+	expect(test_run(image, test_crash, MS(1000)) == MS(100) + 1, "motion fires on the knock");
+	
+	d.thresh1_mg = 9000;
+	expect(lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ) && image[LIS3DSH_SM_THRS1] == 0x7f, "motion clamps to the range");
+	d.kind = VANET_API_ACCEL_DETECT_IMPACT;
+	expect(!lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ), "a threshold beyond the range is refused");
+	d.kind = VANET_API_ACCEL_DETECT_DROP;
+	d.thresh1_mg = 350;
+	d.time2_ms = 0;
+	expect(!lis3dsh_sm_compile(image, &d, TEST_RANGE, TEST_HZ), "a drop needs a time to land in");
+	d.time2_ms = 60000;
+	expect(!lis3dsh_sm_compile(image, &d, TEST_RANGE, 1600), "a timer too long for the rate is refused");
+	
+	return s_failed;
+}
+#endif // UNIT_TEST
@@ -0,0 +1,77 @@
+/**
+ *	@file	accel_lis3dsh_sm.h
+ *
+ *	@brief	LIS3DSH state machine programs
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef ACCEL_LIS3DSH_SM_H
+#define ACCEL_LIS3DSH_SM_H
+
+/*
+	Each state machine's registers, from its first state (ST1_1 at 0x40, ST2_1 at 0x60).  A
+	program image is the block from ST_1 up to SETT, written in one go.
+*/
+#define LIS3DSH_SM_ST				0x00		// 16 states: reset condition << 4 | next condition
+#define LIS3DSH_SM_STATES			16
+#define LIS3DSH_SM_TIM4				0x10		// 8 bit timers, in samples
+#define LIS3DSH_SM_TIM3				0x11
+#define LIS3DSH_SM_TIM2				0x12		// 16 bit timers, little endian
+#define LIS3DSH_SM_TIM1				0x14
+#define LIS3DSH_SM_THRS2			0x16		// thresholds, full scale / 128
+#define LIS3DSH_SM_THRS1			0x17
+#define LIS3DSH_SM_MASK_B			0x19
+#define LIS3DSH_SM_MASK_A			0x1a
+#define LIS3DSH_SM_SETT				0x1b
+#define LIS3DSH_SM_PR				0x1c		// program / reset pointers
+#define LIS3DSH_SM_OUTS				0x1f		// reading it releases the interrupt
+
+#define LIS3DSH_SM_IMAGE_SIZE		(LIS3DSH_SM_SETT + 1)
+
+/// Conditions - a state's high nibble resets to the reset pointer, the low one goes on to the next state
+enum
+{
+	LIS3DSH_SM_NOP		= 0x0,
+	LIS3DSH_SM_TI1		= 0x1,		// timer 1 ran out
+	LIS3DSH_SM_TI2		= 0x2,
+	LIS3DSH_SM_TI3		= 0x3,
+	LIS3DSH_SM_TI4		= 0x4,
+	LIS3DSH_SM_GNTH1	= 0x5,		// any masked axis above threshold 1
+	LIS3DSH_SM_GNTH2	= 0x6,
+	LIS3DSH_SM_LNTH1	= 0x7,		// any masked axis at or below threshold 1
+	LIS3DSH_SM_LNTH2	= 0x8,
+};
+
+/// Commands take a whole state
+#define LIS3DSH_SM_STOP				0x00
+#define LIS3DSH_SM_CONT				0x11		// back to the reset pointer - an interrupt with SITR
+
+/// Axis masks
+#define LIS3DSH_SM_MASK_XYZ			0xfc		// X, Y, Z, either sign
+#define LIS3DSH_SM_MASK_V			0x02		// the vector magnitude
+
+#define LIS3DSH_SM_SETT_SITR		0x01		// STOP and CONT raise the interrupt
+
+/**
+ *	Compile a detector into a program image
+ *
+ *	@param image	LIS3DSH_SM_IMAGE_SIZE bytes
+ *	@param range	Full scale, +/- G
+ *	@param rate_hz	Output data rate - the timers count samples
+ *
+ *	@return false if it can't run at this range and rate
+ */
+bool lis3dsh_sm_compile(uint8_t* image, const app_accel_detector_t* d, uint8_t range, uint16_t rate_hz);
+
+#endif // ACCEL_LIS3DSH_SM_H
@@ -2,6 +2,15 @@
  *	@file	accel_mpu6050.c
  *
  *	@brief	InvenSense MPU-6050 Accelerometer Handler
+ *
+ *  The accelerometer and gyro go into the part's FIFO at the sample rate, and
+ *  INT is data ready, latched until the next read.  The first sample after a
+ *  drain raises INT; that starts a batch timer and the FIFO collects until it
+ *  expires, when the accel task drains it (which drops INT again).  So the
+ *  task wakes a few times a batch instead of polling the bus every sample.
+ *
+ *  The crash detector runs over each batch as it's drained, and reports as
+ *  state machine 1 - the part has no state machines of its own.
  */
 /*----------------------------------------------------------------------------
  *
@@ -23,135 +32,454 @@
 
 #ifdef BSP_ENABLE_MPU_6050
 
-void accel_mpu6050_crash_detector(void);
-
+#define MPU6050_SMPLRT_DIV		0x19	// r/w
+#define MPU6050_CONFIG			0x1a	// r/w
 #define MPU6050_GYRO_CONFIG     0x1b    // r/w
 #define MPU6050_ACCEL_CONFIG    0x1c    // r/w
+#define MPU6050_FIFO_EN			0x23	// r/w
+#define MPU6050_INT_PIN_CFG		0x37	// r/w
+#define MPU6050_INT_ENABLE		0x38	// r/w
+#define MPU6050_INT_STATUS		0x3a	// r
 #define MPU6050_ACCEL_XOUT_H    0x3b	// r
+#define MPU6050_TEMP_OUT_H		0x41	// r
+#define MPU6050_USER_CTRL		0x6a	// r/w
 #define MPU6050_PWR_MGMT_1		0x6b	// r/w
 #define MPU6050_PWR_MGMT_2		0x6c	// r/w
+#define MPU6050_FIFO_COUNTH		0x72	// r
+#define MPU6050_FIFO_R_W		0x74	// r/w
 #define MPU6050_WHO_AM_I		0x75	// r
 
-typedef struct
-{
-	int16_t x_accel;
-	int16_t y_accel;
-	int16_t z_accel;
-	int16_t temperature;
-	int16_t x_gyro;
-	int16_t y_gyro;
-	int16_t z_gyro;
+#define MPU6050_WHO_AM_I_EXPECTED	0x68
+
+#define MPU6050_PWR_MGMT_1_RESET	0x80
+#define MPU6050_PWR_MGMT_1_PLL_X	0x01		// clocked from the X gyro, awake
+#define MPU6050_FIFO_EN_XYZG_ACCEL	0x78		// XG, YG, ZG and ACCEL - 12 bytes a sample, accel first
+#define MPU6050_INT_PIN_CFG_LATCH	0x30		// active high, push-pull, held until any read
+#define MPU6050_INT_DATA_RDY		0x01
+#define MPU6050_INT_FIFO_OFLOW		0x10
+#define MPU6050_USER_CTRL_FIFO_EN	0x40
+#define MPU6050_USER_CTRL_FIFO_RST	0x04
+#define MPU6050_GYRO_FS_2000DPS		0x18
+
+/// With the DLPF on, the sample rate is 1 kHz / (1 + SMPLRT_DIV)
+#define MPU6050_BASE_HZ			1000
+#define MPU6050_DEFAULT_HZ		200
+#define MPU6050_DEFAULT_RANGE	4
+#define MPU6050_GYRO_DPS		2000
+
+#define MPU6050_SAMPLE_SIZE		12
+
+/// How long the FIFO collects before a drain - a tick, which can run to two: 62 ms of the 85 its 1024 bytes hold at the top rate
+#define MPU6050_BATCH_MS		32
+
+/// Samples the baseline settles over before the crash detector is armed
+#define MPU6050_CRASH_SETTLE	32
+
+/// The newest sample read from the FIFO, for app_accel_query()
+static app_accel_xyz_t s_last;
+static app_accel_xyz_t s_last_gyro;
+static uint64_t s_last_time_us;
+
+/// What we last set, so a query or a block doesn't go back to the part for them
+static uint16_t s_rate_hz;
+static uint8_t s_range;
+static uint16_t s_threshold;
+
+/// Publishing the batches as blocks - the FIFO itself always runs, for the crash detector
+static bool s_fifo;
+
+/// The FIFO overflowed and was reset - the next block says samples were lost
+static bool s_overrun;
+
+/// Running out the batch - s_batch ends it
+static bool s_batching;
+static bsp_tkvs_timer_t s_batch;
+
+/// One burst off the FIFO
+static uint8_t s_raw[APP_ACCEL_BLOCK_MAX * MPU6050_SAMPLE_SIZE];
 
-} mpu_6500_basic_raw_t;
-static mpu_6500_basic_raw_t mpu_6500_basic_raw;
+/// Crash detector - squared magnitude against a running baseline, in counts at the current range
+static uint32_t s_baseline;
+static uint8_t s_settle;
+static bool s_crashed;
 
-static uint32_t accel_get_vector(void)
+static inline int16_t mpu6050_be16(const uint8_t* p)
 {
-	uint32_t g;
-	bsp_i2c_read_bytes(0x68, MPU6050_ACCEL_XOUT_H, (uint8_t *)&mpu_6500_basic_raw, sizeof(mpu_6500_basic_raw));
-	g = mpu_6500_basic_raw.x_accel * mpu_6500_basic_raw.x_accel +
-	mpu_6500_basic_raw.y_accel * mpu_6500_basic_raw.y_accel +
-	mpu_6500_basic_raw.z_accel * mpu_6500_basic_raw.z_accel;
-	return g;
+	return (int16_t)(p[0] << 8 | p[1]);
 }
 
-void accel_mpu6050_crash_detector(void)
+static void mpu6050_crash_reset(void)
 {
-	uint8_t val;
-	uint32_t baseg, currentg;
-	bool crashed = false;
-	
-	bsp_i2c_read_byte(0x68, MPU6050_WHO_AM_I, &val);
-	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "MPU-6050 Query: %02X", val);
-	val = 0;		// clear sleep mode
-	bsp_i2c_write_byte(0x68, MPU6050_PWR_MGMT_1, val);
-	bsp_i2c_read_byte(0x68, MPU6050_PWR_MGMT_1, &val);
-	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "MPU-6050 Power Mgmt: %02X", val);
-	val = 0x08;	// +/- 4G
-	bsp_i2c_write_byte(0x68, MPU6050_ACCEL_CONFIG, val);
-		
-
-	bsp_logcat_print(BSP_LOGCAT_ACCEL, "MPU-6050 Getting Baseline");
-	baseg = accel_get_vector();
-	for (int i=0; i<32; i++)
+	s_baseline = 0;
+	s_settle = 0;
+	s_crashed = false;
+}
+
+/// One sample through the crash detector - true on the sample it goes over
+static bool mpu6050_crash_sample(const app_accel_xyz_t* a)
+{
+	uint32_t g = (uint32_t)((int32_t) a->x * a->x) + (uint32_t)((int32_t) a->y * a->y) + (uint32_t)((int32_t) a->z * a->z);
+	uint32_t counts, dev;
+	uint64_t limit;
+	bool fired = false;
+
+	if (s_settle == 0)
+		s_baseline = g;
+
+	if (s_settle < MPU6050_CRASH_SETTLE)
 	{
-		currentg = accel_get_vector();
-			
-		//baseg = (currentg + (baseg * 63)) >> 6;	// 1/64th new
-		baseg = (currentg + (baseg * 7)) >> 3;		// 1/8 new
-		bsp_delay(1);
+		s_settle++;
 	}
-	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "MPU-6050 Baseline Vector: %d", baseg);
-	bsp_delay(50);		// give up the CPU for logcat
-
-	while (1)
+	else if (s_threshold)
 	{
-		currentg = accel_get_vector();
-		if (!crashed && abs(currentg - baseg) > 100000000)
-		{
-			app_pdg_accelerometer_event();
-			bsp_logcat_printf(BSP_LOGCAT_ACCEL, "CRASH!!! %d %d %d", currentg, baseg, abs(currentg - baseg));
+		// the threshold in counts, squared to compare with the magnitudes
+		counts = (uint32_t) s_threshold * (32768 / s_range) / 1000;
+		limit = (uint64_t) counts * counts;
+		dev = g > s_baseline ? g - s_baseline : s_baseline - g;
 
-			crashed = true;
+		if (!s_crashed && dev > limit)
+		{
+			bsp_logcat_printf(BSP_LOGCAT_ACCEL, "CRASH!!! %u %u %u", g, s_baseline, dev);
+			s_crashed = true;
+			fired = true;
 		}
-		else if (abs(currentg - baseg) < 100000000)
+		else if (dev < limit)
 		{
-			crashed = false;
+			s_crashed = false;
 		}
-		baseg = (currentg + (baseg * 7)) >> 3;		// 1/8 new
-		//bsp_logcat_printf(BSP_LOGCAT_INFO, "MPU-6080 %d %d", currentg, baseg);
-		bsp_delay(1);
 	}
+
+	// 1/8 new - in 64 bits, as seven of a hard hit's magnitude don't fit in 32
+	s_baseline = (uint32_t) ((g + (uint64_t) s_baseline * 7) >> 3);
+	return fired;
 }
 
+/// Read count samples from the FIFO in one burst, run them past the detector and publish them while streaming
+static bool mpu6050_read_fifo(uint8_t count)
+{
+	bsp_tkvs_msg_t* msg = NULL;
+	app_accel_block_t* block = NULL;
+	app_accel_xyz_t xyz, gyro;
+	const uint8_t* raw = s_raw;
+	uint64_t now;
+	irqflags_t flags;
+	bool fired = false;
 
-/*
-	The following are stub just to be able to build P1
-*/
-uint8_t app_accel_read_register(uint8_t reg)
+	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, MPU6050_FIFO_R_W, s_raw, count * MPU6050_SAMPLE_SIZE);
+	now = bsp_rtc_get_time_us();
+
+	if (s_fifo)
+	{
+		msg = bsp_tkvs_alloc(APP_ACCEL_BLOCK_SIZE(count));
+		block = (app_accel_block_t*) msg->data;
+		block->time_us = now;
+		block->rate_hz = s_rate_hz;
+		block->range = s_range;
+		block->count = count;
+		block->overrun = s_overrun;
+		s_overrun = false;
+	}
+
+	// big endian off the part, accel then gyro
+	for (int i=0; i<count; i++, raw += MPU6050_SAMPLE_SIZE)
+	{
+		xyz.x = mpu6050_be16(&raw[0]);
+		xyz.y = mpu6050_be16(&raw[2]);
+		xyz.z = mpu6050_be16(&raw[4]);
+		if (mpu6050_crash_sample(&xyz))
+			fired = true;
+		if (block)
+			block->xyz[i] = xyz;
+	}
+	raw -= MPU6050_SAMPLE_SIZE;
+	gyro.x = mpu6050_be16(&raw[6]);
+	gyro.y = mpu6050_be16(&raw[8]);
+	gyro.z = mpu6050_be16(&raw[10]);
+
+	flags = cpu_irq_save();
+	s_last = xyz;
+	s_last_gyro = gyro;
+	s_last_time_us = now;
+	cpu_irq_restore(flags);
+
+	if (msg)
+	{
+		msg->data_len = APP_ACCEL_BLOCK_SIZE(count);
+		bsp_tkvs_publish(APP_TKVS_ACCEL_TASK, APP_ACCEL_EVENT_SAMPLES, msg);
+	}
+	return fired;
+}
+
+static void mpu6050_fifo_reset(void)
 {
-	(void)reg;
-	return 0xff;
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_USER_CTRL, MPU6050_USER_CTRL_FIFO_RST);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_USER_CTRL, MPU6050_USER_CTRL_FIFO_EN);
 }
 
-void app_accel_write_register(uint8_t reg, uint8_t val)
+/// Empty the FIFO - returns the state machines that fired
+static uint8_t mpu6050_drain(void)
 {
-	(void)reg;
-	(void)val;
+	uint8_t status, count[2];
+	uint16_t samples, n;
+	bool fired = false;
+
+	// reading it drops INT, so a sample from here on starts the next batch
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, MPU6050_INT_STATUS, &status);
+	if (status & MPU6050_INT_FIFO_OFLOW)
+	{
+		// it wraps a byte at a time, so whatever is in it no longer starts on a sample
+		mpu6050_fifo_reset();
+		s_overrun = true;
+		bsp_logcat_print(BSP_LOGCAT_ACCEL, "MPU-6050 FIFO overflow");
+		return 0;
+	}
+
+	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, MPU6050_FIFO_COUNTH, count, sizeof(count));
+	samples = (count[0] << 8 | count[1]) / MPU6050_SAMPLE_SIZE;
+	while (samples)
+	{
+		n = samples < APP_ACCEL_BLOCK_MAX ? samples : APP_ACCEL_BLOCK_MAX;
+		if (mpu6050_read_fifo(n))
+			fired = true;
+		samples -= n;
+	}
+	return fired ? APP_ACCEL_SM(1) : 0;
 }
 
-void app_accel_ack(void)
+/// The output registers as they stand, for the exercise
+static void mpu6050_read_now(void)
 {
+	uint8_t raw[14];
+	irqflags_t flags;
+
+	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, MPU6050_ACCEL_XOUT_H, raw, sizeof(raw));
+	flags = cpu_irq_save();
+	s_last.x = mpu6050_be16(&raw[0]);
+	s_last.y = mpu6050_be16(&raw[2]);
+	s_last.z = mpu6050_be16(&raw[4]);
+	s_last_gyro.x = mpu6050_be16(&raw[8]);
+	s_last_gyro.y = mpu6050_be16(&raw[10]);
+	s_last_gyro.z = mpu6050_be16(&raw[12]);
+	s_last_time_us = bsp_rtc_get_time_us();
+	cpu_irq_restore(flags);
 }
 
-void app_accel_set_movement_threshold(uint16_t threshold)
+bool app_accel_init_dev(void)
 {
-	(void)threshold;
-}	
+	uint8_t who_am_i;
+
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, MPU6050_WHO_AM_I, &who_am_i);
+	if (who_am_i != MPU6050_WHO_AM_I_EXPECTED)
+		return false;
+
+	bsp_logcat_print(BSP_LOGCAT_ACCEL, "MPU-6050 Accelerometer Found");
+
+	// it can take fast mode, and its FIFO bursts are most of what's on the bus
+	bsp_i2c_set_speed(BSP_ACCEL_I2C_ADDR, BSP_I2C_SPEED_MAX_HZ);
+
+	// from scratch - a reset of ours doesn't stop its FIFO or interrupt
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_PWR_MGMT_1, MPU6050_PWR_MGMT_1_RESET);
+	bsp_delay(100);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_PWR_MGMT_1, MPU6050_PWR_MGMT_1_PLL_X);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_GYRO_CONFIG, MPU6050_GYRO_FS_2000DPS);
+
+	bsp_tkvs_init_timer(&s_batch, BSP_TKVS_TIMER_ONE_SHOT, 0, APP_TKVS_ACCEL_TASK,
+		APP_ACCEL_EVENT_SERVICE, BSP_TKVS_TIMER_MS_TO_TICKS(MPU6050_BATCH_MS));
+	s_batching = false;
+	s_threshold = 0;
+	app_accel_write_range(MPU6050_DEFAULT_RANGE);
+	app_accel_write_bandwidth(MPU6050_DEFAULT_HZ);
+
+	// accel and gyro into the FIFO, and data ready (or it overflowing) on INT
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_FIFO_EN, MPU6050_FIFO_EN_XYZG_ACCEL);
+	mpu6050_fifo_reset();
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_INT_PIN_CFG, MPU6050_INT_PIN_CFG_LATCH);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_INT_ENABLE, MPU6050_INT_DATA_RDY | MPU6050_INT_FIFO_OFLOW);
+
+	return true;
+}
+
+void app_accel_set_fifo(bool on)
+{
+	s_fifo = on;
+}
+
+uint8_t app_accel_service(void)
+{
+	// an edge while the batch runs is just the next sample
+	if (bsp_tkvs_is_timer_active(&s_batch))
+		return 0;
+
+	if (!s_batching)
+	{
+		s_batching = true;
+		bsp_tkvs_start_timer(&s_batch);
+		return 0;
+	}
+
+	s_batching = false;
+	return mpu6050_drain();
+}
+
+void app_accel_exercise(void)
+{
+	app_accel_out_t out;
+	int8_t temp;
+
+	mpu6050_read_now();
+	app_accel_query(&out);
+	temp = out.t;
+	temp = temp * 1.8 + 32;
+	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "MPU-6050 Temperature: %d F", temp);
+	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "x = %d, y = %d, z = %d @ %d Hz", out.x, out.y, out.z, out.b);
+	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "gx = %d, gy = %d, gz = %d @ %d dps", out.gx, out.gy, out.gz, out.dps);
+}
 
 void app_accel_query(app_accel_out_t *out)
 {
-	out->t = 25;
-	out->x = 0;
-	out->y = 0;
-	out->z = -16384;
-	out->b = 100;
-	out->r = 2;
-	out->th = 1500;
+	uint8_t raw[2];
+	irqflags_t flags;
+
+	// the FIFO is the accel task's - what it last drained
+	flags = cpu_irq_save();
+	out->x = s_last.x;
+	out->y = s_last.y;
+	out->z = s_last.z;
+	out->gx = s_last_gyro.x;
+	out->gy = s_last_gyro.y;
+	out->gz = s_last_gyro.z;
+	out->time_us = s_last_time_us;
+	cpu_irq_restore(flags);
+
+	// 340 per degree C, 0 at 36.53 C
+	bsp_i2c_read_bytes(BSP_ACCEL_I2C_ADDR, MPU6050_TEMP_OUT_H, raw, sizeof(raw));
+	out->t = (int8_t)((mpu6050_be16(raw) + 12420) / 340);
+
+	out->b = s_rate_hz;
+	out->r = s_range;
+	out->th = s_threshold;
+	out->dps = MPU6050_GYRO_DPS;
+}
+
+bool app_accel_set_detector(uint8_t sm, const app_accel_detector_t* d)
+{
+	(void)sm;
+	(void)d;
+	return false;
 }
 
-bool app_accel_init_dev(void)
-{	
-	return true;
+void app_accel_set_movement_threshold(uint16_t threshold)
+{
+	// the crash detector's, away from the baseline - 0 turns it off
+	s_threshold = threshold;
+	s_crashed = false;
 }
 
-void app_accel_write_bandwidth(uint16_t bandwidth)
+uint16_t app_accel_get_movement_threshold(void)
 {
-	(void)bandwidth;
+	return s_threshold;
+}
+
+void app_accel_ack(uint8_t fired)
+{
+	// the crash detector re-arms itself once the magnitude is back under
+	if (fired & APP_ACCEL_SM(1))
+		bsp_logcat_print(BSP_LOGCAT_ACCEL, "MPU-6050 crash acknowledged");
+}
+
+uint8_t app_accel_read_register(uint8_t reg)
+{
+	uint8_t val;
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, reg, &val);
+	return val;
+}
+
+void app_accel_write_register(uint8_t reg, uint8_t val)
+{
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, reg, val);
+
+	// keep what query and the blocks report honest
+	if (reg == MPU6050_SMPLRT_DIV || reg == MPU6050_CONFIG)
+	{
+		s_rate_hz = app_accel_read_bandwidth();
+	}
+	else if (reg == MPU6050_ACCEL_CONFIG)
+	{
+		s_range = app_accel_read_range();
+		mpu6050_crash_reset();
+	}
+}
+
+uint8_t app_accel_read_range(void)
+{
+	uint8_t reg;
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, MPU6050_ACCEL_CONFIG, &reg);
+	return 2 << ((reg >> 3) & 3);	// AFS_SEL in bits 3-4
 }
 
 void app_accel_write_range(uint8_t range)
 {
-	(void)range;
+	uint8_t afs;
+
+	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "Accel Range: range=%d", range);
+
+	// the range that covers the requested one, as the LIS3DSH does
+	if (range > 8)
+		afs = 3;		// +/- 16G
+	else if (range > 4)
+		afs = 2;		// +/- 8G
+	else if (range > 2)
+		afs = 1;		// +/- 4G
+	else
+		afs = 0;		// +/- 2G
+
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_ACCEL_CONFIG, afs << 3);
+	s_range = app_accel_read_range();
+
+	// the baseline is in counts at the old range
+	mpu6050_crash_reset();
+}
+
+uint16_t app_accel_read_bandwidth(void)
+{
+	uint8_t div, config;
+
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, MPU6050_SMPLRT_DIV, &div);
+	bsp_i2c_read_byte(BSP_ACCEL_I2C_ADDR, MPU6050_CONFIG, &config);
+
+	// the gyro runs at 8 kHz with the DLPF off, though the accelerometer still only makes 1 kHz
+	return ((config & 7) == 0 || (config & 7) == 7 ? 8 * MPU6050_BASE_HZ : MPU6050_BASE_HZ) / (1 + div);
+}
+
+void app_accel_write_bandwidth(uint16_t bandwidth)
+{
+	uint8_t dlpf;
+	uint16_t div;
+
+	// at least the rate asked for, 4 Hz to 1 kHz
+	if (bandwidth < 4)
+		bandwidth = 4;
+	div = MPU6050_BASE_HZ / bandwidth;
+	div = div ? div - 1 : 0;
+
+	// the widest filter under half the rate
+	bandwidth = MPU6050_BASE_HZ / (1 + div);
+	if (bandwidth >= 400)
+		dlpf = 1;		// 184 Hz
+	else if (bandwidth >= 200)
+		dlpf = 2;		// 94 Hz
+	else if (bandwidth >= 100)
+		dlpf = 3;		// 44 Hz
+	else if (bandwidth >= 50)
+		dlpf = 4;		// 21 Hz
+	else if (bandwidth >= 20)
+		dlpf = 5;		// 10 Hz
+	else
+		dlpf = 6;		// 5 Hz
+
+	bsp_logcat_printf(BSP_LOGCAT_ACCEL, "MPU-6050 Rate: %d Hz, DLPF %d", bandwidth, dlpf);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_CONFIG, dlpf);
+	bsp_i2c_write_byte(BSP_ACCEL_I2C_ADDR, MPU6050_SMPLRT_DIV, (uint8_t) div);
+	s_rate_hz = app_accel_read_bandwidth();
 }
-#endif // BSP_ENABLE_MPU_6050
\ No newline at end of file
+#endif // BSP_ENABLE_MPU_6050
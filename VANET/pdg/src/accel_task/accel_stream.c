@@ -0,0 +1,276 @@
+/**
+ *	@file	accel_stream.c
+ *
+ *	@brief	Batched binary samples on the raw accelerometer mux channel
+ *
+ *	The sample blocks the driver publishes from the FIFO are cut into batches
+ *	of the size the main board asked for, each stamped with the UTC time and
+ *	sequence number of its first sample.  A feature stream instead batches
+ *	what accel_dsp.c makes of the samples, at the rate asked for, with the
+ *	calibration offsets from the codeplug taken out first.  The record
+ *	formats are in vanet_api.h.
+ *
+ *	Nothing stops the main board asking for more than the mux UART can carry,
+ *	so a batch is dropped while the mux is backlogged.  The main board sees
+ *	the gap in the sequence numbers and the next batch's overrun flag.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "vanet.h"
+#include "vanet_api.h"
+#include "accel_dsp.h"
+
+#define STREAM_TIME_SMOOTH		16		// a read's latency is taken out of the stream's time over this many blocks
+#define STREAM_MUX_BACKLOG		8		// batches are dropped while the mux task has this many messages waiting
+
+static uint8_t s_batch;					// samples (or features) per batch, 0 when the stream is off
+static bool s_features;					// batches of features, not samples
+static uint16_t s_feature_hz;
+static bool s_dynamic;					// gravity comes out of the features
+static int16_t s_offset_mg[3];			// calibration, from the codeplug
+static accel_dsp_t s_dsp;
+static uint8_t s_count;					// samples in s_record so far
+static uint8_t s_flags;					// for the batch being built
+static uint16_t s_rate_hz;				// of the samples in s_record
+static uint8_t s_range;
+static uint32_t s_seq;					// of the next sample or feature
+static uint64_t s_next_us;				// when the next sample is due, monotonic - 0 before the first
+static uint8_t s_record[VANET_API_ACCEL_BATCH_HDR_SIZE + VANET_API_ACCEL_FEATURE_MAX * VANET_API_ACCEL_FEATURE_SIZE];
+
+static uint8_t* put16(uint8_t* p, uint16_t v)
+{
+	*p++ = v >> 8;
+	*p++ = v;
+	return p;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v)
+{
+	p = put16(p, v >> 16);
+	return put16(p, v);
+}
+
+static void stream_flush(void)
+{
+	if (s_count)
+	{
+		uint8_t size = s_features ? VANET_API_ACCEL_FEATURE_SIZE : 6;
+		
+		s_record[0] = s_features ? VANET_API_ACCEL_FEATURES : VANET_API_ACCEL_BATCH;
+		s_record[1] = VANET_API_ACCEL_BATCH_HDR_SIZE - 2 + s_count * size;
+		s_record[2] = s_count;
+		s_record[3] = s_flags;
+		put16(&s_record[4], s_rate_hz);
+		if (s_features)
+		{
+			put16(&s_record[6], s_dsp.decimation);
+		}
+		else
+		{
+			s_record[6] = s_range;
+			s_record[7] = 0;
+		}
+		if (bsp_mux_backlog() < STREAM_MUX_BACKLOG)
+		{
+			bsp_mux_send(VANET_MUXCH_ACCELEROMETER_RAW, s_record, VANET_API_ACCEL_BATCH_HDR_SIZE + s_count * size);
+			s_flags = 0;
+		}
+		else
+		{
+			// its samples are counted in s_seq, so the next batch starts after a gap
+			s_flags = VANET_API_ACCEL_OVERRUN;
+		}
+		s_count = 0;
+	}
+}
+
+static void stream_config(void)
+{
+	uint8_t rec[VANET_API_ACCEL_CONFIG_SIZE];
+	
+	rec[0] = VANET_API_ACCEL_CONFIG;
+	rec[1] = VANET_API_ACCEL_CONFIG_SIZE - 2;
+	put16(&rec[2], app_accel_read_bandwidth());
+	rec[4] = s_batch;
+	rec[5] = app_accel_read_range();
+	bsp_mux_send(VANET_MUXCH_ACCELEROMETER_RAW, rec, sizeof(rec));
+}
+
+bool app_accel_stream_request(const uint8_t* data, uint16_t len)
+{
+	uint16_t rate;
+	bool features = len && data[0] == VANET_API_ACCEL_FEATURE_REQUEST;
+	
+	if (features ? (len < VANET_API_ACCEL_FEATURE_REQUEST_SIZE || (data[5] && !((data[3] << 8) | data[4]))) :
+		(len < VANET_API_ACCEL_REQUEST_SIZE || data[0] != VANET_API_ACCEL_STREAM_REQUEST))
+	{
+		bsp_logcat_print(BSP_LOGCAT_WARNING, "Accel stream: bad request");
+		return s_batch != 0;
+	}
+	
+	rate = (data[1] << 8) | data[2];
+	if (rate)
+		app_accel_write_bandwidth(rate);
+	
+	// whatever is pending was taken under the old request
+	stream_flush();
+	s_features = features;
+	if (features)
+	{
+		s_batch = min(data[5], VANET_API_ACCEL_FEATURE_MAX);
+		s_feature_hz = (data[3] << 8) | data[4];
+		s_dynamic = (data[6] & VANET_API_ACCEL_FEATURE_DYNAMIC) != 0;
+		s_offset_mg[0] = bsp_cp_get_field(accel_offset_x);
+		s_offset_mg[1] = bsp_cp_get_field(accel_offset_y);
+		s_offset_mg[2] = bsp_cp_get_field(accel_offset_z);
+	}
+	else
+	{
+		s_batch = min(data[3], VANET_API_ACCEL_BATCH_MAX);
+	}
+	s_seq = 0;
+	s_next_us = 0;
+	// the filter is set up at the first block's rate
+	s_rate_hz = 0;
+	
+	if (s_batch)
+	{
+		if (features)
+			bsp_logcat_printf(BSP_LOGCAT_INFO, "Accel stream: %u Hz, %u Hz features, %u per batch",
+				app_accel_read_bandwidth(), s_feature_hz, s_batch);
+		else
+			bsp_logcat_printf(BSP_LOGCAT_INFO, "Accel stream: %u Hz, %u per batch", app_accel_read_bandwidth(), s_batch);
+		stream_config();
+	}
+	return s_batch != 0;
+}
+
+/// Open a batch: stamp it with the sequence number and UTC time t_us
+static void stream_start_batch(uint64_t t_us)
+{
+	bsp_rtc_servo_t servo;
+	uint8_t* p;
+	
+	bsp_rtc_get_servo(&servo);
+	if (servo.state != BSP_RTC_SERVO_LOCKED && servo.state != BSP_RTC_SERVO_HOLDOVER)
+		s_flags |= VANET_API_ACCEL_UNSYNCED;
+	p = put32(&s_record[8], s_seq);
+	p = put32(p, (uint32_t) (t_us >> 32));
+	put32(p, (uint32_t) t_us);
+}
+
+/// Run a sample through the filter, adding the feature it completes to the batch - false if it didn't
+static bool stream_feature(const app_accel_xyz_t* xyz, uint8_t range)
+{
+	accel_dsp_feature_t f;
+	int16_t mg[3];
+	uint8_t* p;
+	
+	mg[0] = accel_dsp_mg(xyz->x, range) - s_offset_mg[0];
+	mg[1] = accel_dsp_mg(xyz->y, range) - s_offset_mg[1];
+	mg[2] = accel_dsp_mg(xyz->z, range) - s_offset_mg[2];
+	if (!accel_dsp_sample(&s_dsp, mg, &f))
+		return false;
+	
+	p = &s_record[VANET_API_ACCEL_BATCH_HDR_SIZE + s_count * VANET_API_ACCEL_FEATURE_SIZE];
+	p = put16(p, f.x);
+	p = put16(p, f.y);
+	p = put16(p, f.z);
+	p = put16(p, f.mag);
+	put16(p, f.jerk);
+	return true;
+}
+
+void app_accel_stream_samples(const app_accel_block_t* block)
+{
+	uint64_t cycles, period_us, t, delay_us;
+	int64_t utc_offset_us;
+	uint8_t* p;
+	uint32_t lost;
+	
+	if (!s_batch || !block->count || !block->rate_hz)
+		return;
+	
+	period_us = 1000000 / block->rate_hz;
+	
+	// the block's time is monotonic - carry it over to UTC at a single instant
+	cycles = bsp_rtc_get_cycles();
+	utc_offset_us = (int64_t) (bsp_rtc_get_utc_ns_at(cycles) / 1000) - (int64_t) bsp_rtc_get_time_us_at(cycles);
+	
+	// the first sample of the block
+	t = block->time_us - (block->count - 1) * period_us;
+	
+	if (block->overrun || block->rate_hz != s_rate_hz || block->range != s_range)
+	{
+		// a batch's samples are evenly spaced at one scale
+		stream_flush();
+		if (block->overrun && s_next_us && t > s_next_us)
+		{
+			lost = (uint32_t) ((t - s_next_us + period_us / 2) / period_us);
+			s_seq += s_features ? (lost + s_dsp.decimation / 2) / s_dsp.decimation : lost;
+			s_flags |= VANET_API_ACCEL_OVERRUN;
+		}
+		if (s_features)
+		{
+			// the features are in mg, so only the rate matters to the filter
+			if (block->rate_hz != s_rate_hz)
+				accel_dsp_init(&s_dsp, block->rate_hz, s_feature_hz, s_dynamic);
+			else if (block->overrun)
+				accel_dsp_restart(&s_dsp);
+		}
+		s_rate_hz = block->rate_hz;
+		s_range = block->range;
+	}
+	else if (s_next_us)
+	{
+		// unbroken since the last block - follow the part's own clock, which is only roughly the rate
+		t = s_next_us + ((int64_t) (t - s_next_us)) / STREAM_TIME_SMOOTH;
+	}
+	
+	// a feature is centred in the samples it was filtered from
+	delay_us = s_features ? (s_dsp.decimation - 1) * period_us : 0;
+	
+	for (int i=0; i<block->count; i++, t += period_us)
+	{
+		if (s_features)
+		{
+			if (!stream_feature(&block->xyz[i], block->range))
+				continue;
+		}
+		else
+		{
+			p = &s_record[VANET_API_ACCEL_BATCH_HDR_SIZE + s_count * 6];
+			p = put16(p, block->xyz[i].x);
+			p = put16(p, block->xyz[i].y);
+			put16(p, block->xyz[i].z);
+		}
+		if (s_count == 0)
+			stream_start_batch(t - delay_us + utc_offset_us);
+		s_seq++;
+		
+		if (++s_count == s_batch)
+			stream_flush();
+	}
+	s_next_us = t;
+}
+
+void app_accel_stream_stop(void)
+{
+	s_batch = 0;
+	s_features = false;
+	s_count = 0;
+	s_flags = 0;
+}
@@ -26,15 +26,23 @@ static void accel_task(void* p_arg);
 static OS_EVENT* s_msg_flag;
 static void *s_msg_queue[16];
 
-enum
-{
-	APP_ACCEL_EVENT_TIMER		= 0x0001,
-};
 static bsp_tkvs_timer_t s_timer;
+static bool s_streaming;				// the raw channel asked for binary batches
 
-#ifdef BSP_ENABLE_MPU_6050
-extern void accel_mpu6050_crash_detector(void);
-#endif
+/// Our own events - the sample blocks only while the raw channel streams them
+static void accel_subscribe_self(bool samples)
+{
+	bsp_tkvs_unsubscribe(APP_TKVS_ACCEL_TASK, s_msg_flag);
+	bsp_tkvs_subscribe(APP_TKVS_ACCEL_TASK, 
+			APP_ACCEL_EVENT_TIMER | APP_ACCEL_EVENT_SERVICE | (samples ? APP_ACCEL_EVENT_SAMPLES : 0),
+			s_msg_flag, TASK_ACCEL_PRIO);
+}
+
+/// The FIFO runs for the raw channel's stream and for the event recorder's window
+static void accel_update_fifo(void)
+{
+	app_accel_set_fifo(s_streaming || app_rec_armed());
+}
 
 void app_accel_task_init()
 {
@@ -63,9 +71,10 @@ void app_accel_task_init()
 	OS_CHECK_PERR(perr, "Accelerometer task: OSTaskNameSet");
 	
 	// subscribe to our sources
-	bsp_tkvs_subscribe(APP_TKVS_ACCEL_TASK, BSP_TKVS_ALL_EVENTS, s_msg_flag, TASK_ACCEL_PRIO);
+	accel_subscribe_self(false);
 	bsp_tkvs_subscribe(BSP_MUX_DLCI_TO_TKVS_SOURCE(VANET_MUXCH_ACCELEROMETER_RAW), 
 			BSP_TKVS_ALL_EVENTS, s_msg_flag, TASK_ACCEL_PRIO);
+	bsp_tkvs_subscribe(APP_TKVS_REC_TASK, APP_REC_EVENT_ARMED, s_msg_flag, TASK_ACCEL_PRIO);
 }
 
 static void accel_task(void *p_arg)
@@ -75,11 +84,7 @@ static void accel_task(void *p_arg)
 	
 	(void) p_arg;
 		
-#ifdef BSP_ENABLE_MPU_6050
-	accel_mpu6050_crash_detector();		// this will block forever... test code for P1
-#endif
-
-#ifdef BSP_ENABLE_LIS3DSH
+#if defined(BSP_ENABLE_LIS3DSH) || defined(BSP_ENABLE_MPU_6050)
 	if (app_accel_init_dev())
 	{
 		// exercise some readings
@@ -90,6 +95,7 @@ static void accel_task(void *p_arg)
 		
 		// subscribe to accelerometer events
 		bsp_tkvs_subscribe(BSP_TKVS_SRC_PIN, BSP_PIN_EVENT_ACCEL, s_msg_flag, TASK_ACCEL_PRIO);
+		accel_update_fifo();
 	}
 #endif
 	
@@ -102,14 +108,18 @@ static void accel_task(void *p_arg)
 		msg = (bsp_tkvs_msg_t*) OSQPend(s_msg_flag, 0, &perr);    // block forever on my queue
 		if (msg != (void *)0)
 		{
-			if (msg->source == BSP_TKVS_SRC_PIN && msg->event == BSP_PIN_EVENT_ACCEL)
+			if ((msg->source == BSP_TKVS_SRC_PIN && msg->event == BSP_PIN_EVENT_ACCEL) ||
+				(msg->source == APP_TKVS_ACCEL_TASK && msg->event == APP_ACCEL_EVENT_SERVICE))
 			{
-				bsp_logcat_printf(BSP_LOGCAT_ACCEL, "Accel Event %d", msg->immed_data);
-				if (msg->immed_data == 1)
+				// either edge - a change too quick for the pin driver still wants looking at
+				uint8_t fired = app_accel_service();
+				if (fired)
 				{
-					app_pdg_accelerometer_event();
+					bsp_logcat_print(BSP_LOGCAT_ACCEL, "Accel Event");
+					app_pdg_accelerometer_event(fired);
+					bsp_tkvs_publish_immed(APP_TKVS_ACCEL_TASK, APP_ACCEL_EVENT_FIRED, fired);
 					// re-arm
-					app_accel_ack();
+					app_accel_ack(fired);
 				}
 			}	
 			else if (msg->source == BSP_MUX_DLCI_TO_TKVS_SOURCE(VANET_MUXCH_ACCELEROMETER_RAW))		
@@ -124,14 +134,49 @@ static void accel_task(void *p_arg)
 				{
 					bsp_logcat_print(BSP_LOGCAT_INFO, "Stopping Raw Accelerometer Data");
 					bsp_tkvs_stop_timer(&s_timer);
+					app_accel_stream_stop();
+					s_streaming = false;
+					accel_update_fifo();
+					accel_subscribe_self(false);
+				}
+				else if (msg->event == BSP_MUX_EVENT_DATA_RCVD && BSP_TKVS_MSG_HAS_DATA(msg))
+				{
+					// binary batches instead of the text lines, or back again
+					if (app_accel_stream_request(msg->data, msg->data_len))
+					{
+						bsp_tkvs_stop_timer(&s_timer);
+						accel_subscribe_self(true);
+						s_streaming = true;
+						accel_update_fifo();
+					}
+					else
+					{
+						s_streaming = false;
+						accel_update_fifo();
+						accel_subscribe_self(false);
+						bsp_tkvs_start_timer(&s_timer);
+					}
 				}
 			}
+			else if (msg->source == APP_TKVS_REC_TASK && msg->event == APP_REC_EVENT_ARMED)
+			{
+				accel_update_fifo();
+			}
+			else if (msg->source == APP_TKVS_ACCEL_TASK && msg->event == APP_ACCEL_EVENT_SAMPLES)
+			{
+				app_accel_stream_samples((const app_accel_block_t*) msg->data);
+			}
 			else if (msg->source == APP_TKVS_ACCEL_TASK && msg->event == APP_ACCEL_EVENT_TIMER)
 			{
-				char msg[40];
+				char msg[96];
+				int len;
 				app_accel_out_t out;
 				app_accel_query(&out);
-				dlib_snprintf(msg, sizeof(msg), "t=%d x=%d y=%d z=%d\r\n", out.t, out.x, out.y, out.z);
+				len = dlib_snprintf(msg, sizeof(msg), "%u.%06u t=%d x=%d y=%d z=%d", (uint32_t)(out.time_us / 1000000),
+							  (uint32_t)(out.time_us % 1000000), out.t, out.x, out.y, out.z);
+				if (out.dps)
+					len += dlib_snprintf(msg + len, sizeof(msg) - len, " gx=%d gy=%d gz=%d", out.gx, out.gy, out.gz);
+				dlib_snprintf(msg + len, sizeof(msg) - len, "\r\n");
 				bsp_mux_send(VANET_MUXCH_ACCELEROMETER_RAW, msg, strlen(msg));
 			}											
 				
@@ -19,6 +19,8 @@
 #ifndef ACCEL_TASK_H
 #define ACCEL_TASK_H
 
+#include "vanet_api.h"
+
 typedef struct
 {
 	int16_t x;
@@ -28,8 +30,62 @@ typedef struct
 	uint8_t	r;
 	uint16_t b;
 	uint16_t th;
+	uint64_t time_us;				// bsp_rtc_get_time_us() when the sample was read
+	int16_t gx;						// gyro, +/- dps full scale
+	int16_t gy;
+	int16_t gz;
+	uint16_t dps;					// 0 - the part has no gyro
 } app_accel_out_t;
 
+/// APP_TKVS_ACCEL_TASK Events
+enum
+{
+	APP_ACCEL_EVENT_TIMER		= 0x0001,
+	APP_ACCEL_EVENT_SAMPLES		= 0x0002,		///< data is an app_accel_block_t, cut to its count
+	APP_ACCEL_EVENT_SERVICE		= 0x0004,		///< the driver wants app_accel_service() called, as for the interrupt pin
+	APP_ACCEL_EVENT_FIRED		= 0x0008,		///< immed_data is the state machines that fired, as for app_accel_service()
+};
+
+/// The most samples in a block - the LIS3DSH FIFO depth (the MPU-6050's is read in bursts of this many)
+#define APP_ACCEL_BLOCK_MAX			32
+
+typedef struct
+{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+} app_accel_xyz_t;
+
+/// A burst of samples read from the FIFO, oldest first
+typedef struct
+{
+	uint64_t time_us;				///< bsp_rtc_get_time_us() when the FIFO was read - the last sample is at most a period older
+	uint16_t rate_hz;				///< Output data rate: sample i was taken (count - 1 - i) periods before the last
+	uint8_t range;					///< Full scale, +/- g
+	uint8_t count;					///< Samples in xyz[]
+	uint8_t overrun;				///< The FIFO filled up before this block - samples were lost ahead of it
+	uint8_t unused[3];
+	app_accel_xyz_t xyz[APP_ACCEL_BLOCK_MAX];
+} app_accel_block_t;
+
+/// Bytes of a block with count samples, as published
+#define APP_ACCEL_BLOCK_SIZE(count)	(offsetof(app_accel_block_t, xyz) + (count) * sizeof(app_accel_xyz_t))
+
+/// Detector state machines - app_accel_service() returns a bit for each that fired
+#define APP_ACCEL_SM_COUNT			2
+#define APP_ACCEL_SM(sm)			(1 << ((sm) - 1))
+
+/// What a state machine detects, as the Set Detector command gives it
+typedef struct
+{
+	uint8_t kind;					///< VANET_API_ACCEL_DETECT_xxx
+	uint16_t thresh1_mg;
+	uint16_t time1_ms;
+	uint16_t thresh2_mg;
+	uint16_t time2_ms;
+	uint8_t program[VANET_API_ACCEL_PROGRAM_SIZE];	///< VANET_API_ACCEL_DETECT_PROGRAM
+} app_accel_detector_t;
+
 /// Initialize / Start the Accelerometer Task
 void app_accel_task_init(void);
 
@@ -41,10 +97,20 @@ void app_accel_exercise(void);
 void app_accel_set_movement_threshold(uint16_t threshold);
 uint16_t app_accel_get_movement_threshold(void);
 
-/// Acknowledge a State Machine Event
-void app_accel_ack(void);
+/// Run a detector on state machine sm (1 or 2) - false if the part can't
+bool app_accel_set_detector(uint8_t sm, const app_accel_detector_t* d);
 
-/// Request (Poll) Current Accelerometer Data
+/// Acknowledge State Machine Events, as app_accel_service() returned them
+void app_accel_ack(uint8_t fired);
+
+/// Service the interrupt pin: publish what the FIFO holds, returns the state machines that fired
+uint8_t app_accel_service(void);
+
+/// Stream samples through the FIFO (published as blocks), or leave the MCU be until a detector fires
+/// (the MPU-6050's FIFO always runs for its crash detector - this only turns the blocks on)
+void app_accel_set_fifo(bool on);
+
+/// The newest sample (the last FIFO read, or the part itself while the FIFO is off), with the temperature and settings
 void app_accel_query(app_accel_out_t *out);
 
 /// Read/Write Register
@@ -59,4 +125,13 @@ void app_accel_write_bandwidth(uint16_t bandwidth);
 uint8_t app_accel_read_range(void);
 void app_accel_write_range(uint8_t range);
 
+/// A request on the raw channel, for samples or features - returns true if the binary stream is on
+bool app_accel_stream_request(const uint8_t* data, uint16_t len);
+
+/// Batch up a block of samples (or the features filtered from them) for the raw channel
+void app_accel_stream_samples(const app_accel_block_t* block);
+
+/// The raw channel went away
+void app_accel_stream_stop(void);
+
 #endif // ACCEL_TASK_H
\ No newline at end of file
@@ -21,6 +21,35 @@
 #include "vanet.h"
 #include "vanet_api.h"
 #include "pdg_cmd.h"
+#include "nmea.h"
+#include "ubx.h"
+
+/// UBX mode - a navigation solution every GPS_UBX_RATE_MS
+#define GPS_UBX_RATE_MS             100
+
+/// How long the receiver has to answer in UBX before we fall back to NMEA
+#define GPS_UBX_TIMEOUT_MS          3000
+
+/// Seconds from 1970 to the GPS epoch, Jan 6 1980
+#define GPS_EPOCH                   315964800
+#define GPS_SECONDS_PER_WEEK        604800
+
+/// Forwarded UBX frames are split to fit a mux frame
+#define GPS_MUX_CHUNK               64
+
+/// APP_GPS_EVENT_FIX is published no faster than this - passes every fix at
+/// 10 Hz but bounds what a burst of sentences can post to a subscriber's queue
+#define GPS_FIX_PUBLISH_MIN_US      50000
+
+/// What the receiver speaks
+enum
+{
+    GPS_MODE_NMEA,                              ///< Lines of NMEA at GPS_USART_BAUDRATE
+    GPS_MODE_UBX_WAIT,                          ///< Configured for UBX, no frame yet
+    GPS_MODE_UBX,                               ///< UBX at GPS_USART_UBX_BAUDRATE
+};
+
+static const char* const s_gps_mode_names[] = { "NMEA", "UBX (waiting)", "UBX" };
 
 static OS_STK s_app_gps_task_stack[TASK_GPS_STACK_SIZE];
 static void gps_task(void* p_arg);
@@ -28,9 +57,42 @@ static OS_EVENT* s_msg_flag;
 static void *s_msg_queue[16];
 static vanet_api_gps_state_t s_gps_state;
 static uint32_t s_gps_timestamp;
-static int32_t s_gps_offset_us;
+static uint16_t s_gps_speed_cms;            // s_gps_state.speed before it was rounded to knots
 static uint8_t s_termios_gps;
 static uint8_t s_termios_nmea;
+static app_nmea_parser_t s_nmea;
+static uint8_t s_gps_in_view[4];            // GSV per constellation: GPS, GLONASS, Galileo, BeiDou
+static uint8_t s_gps_mode;
+static app_ubx_parser_t s_ubx;
+static bsp_tkvs_timer_t s_ubx_timer;
+static bool s_gps_forward_ubx;
+static int8_t s_gps_leap_s;                 // GPS - UTC, -1 until NAV-TIMEUTC and TIM-TP both seen
+static uint16_t s_gps_week;                 // from the last TIM-TP
+static int32_t s_gps_qerr_ps;               // the last TIM-TP's pulse quantization error
+static volatile bool s_gps_pulsed;          // a time pulse the task hasn't caught up with yet
+static uint32_t s_gps_pulse_timestamp;      // and s_gps_timestamp when it came
+static uint64_t s_gps_fix_published_us;     // bsp_rtc_get_time_us() of the last APP_GPS_EVENT_FIX
+static bool s_gps_benching;                 // the parsers are fed canned data - a fix goes nowhere
+
+/// Position event subscription (VANET_OP_GPS_SUBSCRIBE)
+static struct
+{
+    uint8_t     triggers;                   // VANET_API_GPS_TRIGGER_xxx, 0 for none
+    uint16_t    period_ms;
+    uint16_t    move_m;
+    bool        sent;                       // an event since subscribing - last_xxx are good
+    bool        have_ref;                   // last_lat/lon are good
+    uint32_t    lock;                       // the lock flags at the last fix
+    uint32_t    last_s;                     // fix time of the last event
+    uint32_t    last_us;
+    int32_t     last_lat;                   // position of the last event with a location lock
+    int32_t     last_lon;
+    uint32_t    events;
+} s_gps_sub;
+
+#ifdef CONFIG_BSP_ENABLE_BENCH
+static void gps_bench_init(void);
+#endif
 
 static void gps_handler(int argc, char** argv, uint8_t port)
 {
@@ -49,6 +111,24 @@ static void gps_handler(int argc, char** argv, uint8_t port)
                 s_termios_nmea = 0xff;
             }
         }
+        else if (argc > 2 && !strcasecmp("mode", argv[1]))
+        {
+            if (!strcasecmp("ubx", argv[2]))
+                bsp_tkvs_publish_immed(APP_TKVS_GPS_TASK, APP_GPS_EVENT_MODE, GPS_MODE_UBX);
+            else if (!strcasecmp("nmea", argv[2]))
+                bsp_tkvs_publish_immed(APP_TKVS_GPS_TASK, APP_GPS_EVENT_MODE, GPS_MODE_NMEA);
+            else
+                bsp_termios_write_str(port, "Invalid arguments\r\n");
+        }
+        else if (argc > 2 && !strcasecmp("raw", argv[1]))
+        {
+            s_gps_forward_ubx = !strcasecmp("on", argv[2]);
+            bsp_termios_printf(port, "UBX forwarding %s\r\n", s_gps_forward_ubx ? "enabled" : "disabled");
+        }
+        else
+        {
+            bsp_termios_write_str(port, "Invalid arguments\r\n");
+        }
     }
     else
     {
@@ -58,7 +138,14 @@ static void gps_handler(int argc, char** argv, uint8_t port)
         bsp_termios_printf(port, "Speed: %d knots, %d deg\r\n", s_gps_state.speed, s_gps_state.direction);
         bsp_termios_printf(port, "Satellites: %d\r\n", s_gps_state.satellites);
         bsp_termios_printf(port, "HDOP: %d\r\n", s_gps_state.hdop);
-        bsp_termios_printf(port, "Offset: %d\r\n", s_gps_offset_us);
+        bsp_termios_printf(port, "Mode: %s\r\n", s_gps_mode_names[s_gps_mode]);
+        bsp_termios_printf(port, "NMEA: %u good, %u checksum errors, %u unknown\r\n",
+            s_nmea.good, s_nmea.bad_xsum, s_nmea.unknown);
+        bsp_termios_printf(port, "UBX: %u good, %u checksum errors, %u too long\r\n",
+            s_ubx.good, s_ubx.bad_xsum, s_ubx.too_long);
+        bsp_termios_printf(port, "Time pulse: leap %d s, qErr %d ps\r\n", s_gps_leap_s, s_gps_qerr_ps);
+        bsp_termios_printf(port, "Events: triggers %X, every %u ms, %u m moved, %u sent\r\n",
+            s_gps_sub.triggers, s_gps_sub.period_ms, s_gps_sub.move_m, s_gps_sub.events);
     }
 }
 
@@ -69,20 +156,71 @@ static bsp_sti_command_t gps_command =
     .minArgs = 0,
     .maxArgs = 2,
     STI_HELP("gps                                  Show state of GPS\r\n"
-             "gps stream on|off                    Print NMEA stream to port")
+             "gps stream on|off                    Print NMEA stream to port\r\n"
+             "gps mode ubx|nmea                    Configure the receiver's protocol\r\n"
+             "gps raw on|off                       Forward UBX frames to the raw channel")
 };
 
+/// At GPS_TIMEPULSE_IRQ_PRI, above everything that uses TKVS or the buffers - so only the capture here
 static void gps_timepulse_handler(void)
 {
+    // the edge, before anything else adds latency
+    uint64_t cycles = bsp_rtc_get_cycles();
+    
 	gpio_clear_pin_interrupt_flag(GPS_TIMEPULSE_PIN);
     gpio_toggle_pin(BSP_GPS_SYNC_LED);
 
     // pulse comes at the beginning of the second, so timestamp is previous second.
-    // always set the clock to the previous second so the offset is the number of us
-    // until the next AST tick
-    bsp_rtc_set_clock(s_gps_timestamp);
-    s_gps_offset_us = 1000000 - bsp_rtc_get_clock_us();
-    s_gps_state.flags |= VAPET_API_GPS_TIME_LOCK;
+    // the servo keeps the sub-second time; the calendar just follows the seconds
+    bsp_rtc_pps(cycles, s_gps_timestamp ? s_gps_timestamp + 1 : 0);
+    s_gps_pulse_timestamp = s_gps_timestamp;
+    s_gps_pulsed = true;
+}
+
+/// The rest of a time pulse - setting the calendar publishes, which the handler can't
+static void gps_timepulse_catch_up(void)
+{
+    if (s_gps_pulsed)
+    {
+        s_gps_pulsed = false;
+        bsp_rtc_set_clock(s_gps_pulse_timestamp);
+        s_gps_state.flags |= VAPET_API_GPS_TIME_LOCK;
+    }
+}
+
+/// The disciplined UTC time as a VANET API timestamp
+static void gps_now(uint32_t* timestamp, uint32_t* timestamp_us)
+{
+    uint64_t ns = bsp_rtc_get_utc_ns();
+    
+    *timestamp = (uint32_t) (ns / 1000000000);
+    *timestamp_us = (uint32_t) (ns % 1000000000) / 1000;
+}
+
+/// Answer an NTP style time request - origin is its T1
+static void gps_timesync(const uint8_t* origin)
+{
+    vanet_api_timesync_t t;
+    bsp_rtc_servo_t servo;
+    uint32_t rx_cycles = bsp_mux_rx_cycles(VANET_MUXCH_TIMESYNC);
+    uint64_t ns;
+    
+    // T2 from the UART interrupt, unless the mux lost track of it
+    ns = rx_cycles ? bsp_rtc_get_utc_ns_at(bsp_rtc_extend_cycles(rx_cycles)) : bsp_rtc_get_utc_ns();
+    memcpy(t.origin, origin, sizeof(t.origin));
+    t.rx_timestamp = cpu_to_be32((uint32_t) (ns / 1000000000));
+    t.rx_ns = cpu_to_be32((uint32_t) (ns % 1000000000));
+    
+    bsp_rtc_get_servo(&servo);
+    if (servo.state == BSP_RTC_SERVO_LOCKED)
+        t.status = cpu_to_be32(VANET_API_TIME_LOCKED);
+    else if (servo.state == BSP_RTC_SERVO_HOLDOVER)
+        t.status = cpu_to_be32(VANET_API_TIME_HOLDOVER);
+    else
+        t.status = cpu_to_be32(VANET_API_TIME_UNSYNCED);
+    
+    // T3 goes in as the mux queues the frame
+    bsp_mux_send_stamped(VANET_MUXCH_TIMESYNC, &t, sizeof(t));
 }
 
 void app_gps_task_init()
@@ -90,7 +228,7 @@ void app_gps_task_init()
 	INT8U perr;
 	
 	// Register the GPS Timepulse pin
-	INTC_register_GPIO_interrupt(&gps_timepulse_handler, GPS_TIMEPULSE_PIN);
+	INTC_register_GPIO_interrupt(&gps_timepulse_handler, GPS_TIMEPULSE_PIN, GPS_TIMEPULSE_IRQ_PRI);
 	gpio_enable_gpio_pin(GPS_TIMEPULSE_PIN);
 	gpio_enable_pin_glitch_filter(GPS_TIMEPULSE_PIN);
 	gpio_enable_pin_interrupt(GPS_TIMEPULSE_PIN, GPIO_RISING_EDGE);
@@ -125,144 +263,603 @@ void app_gps_task_init()
 	else
 	{
 		print_dbg("Unable to find Termios Port - GPS will not work!\r\n");
+		s_termios_gps = 0xff;
 	}
     
 	bsp_tkvs_subscribe(BSP_MUX_DLCI_TO_TKVS_SOURCE(VANET_MUXCH_TIMESYNC), BSP_TKVS_ALL_EVENTS, s_msg_flag, TASK_GPS_PRIO);
 	bsp_tkvs_subscribe(BSP_MUX_DLCI_TO_TKVS_SOURCE(VANET_MUXCH_GPS_RAW), BSP_TKVS_ALL_EVENTS, s_msg_flag, TASK_GPS_PRIO);
+	bsp_tkvs_subscribe(APP_TKVS_GPS_TASK, APP_GPS_EVENT_UBX_TIMEOUT | APP_GPS_EVENT_MODE, s_msg_flag, TASK_GPS_PRIO);
+	bsp_tkvs_init_timer(&s_ubx_timer, BSP_TKVS_TIMER_ONE_SHOT, 0, APP_TKVS_GPS_TASK, APP_GPS_EVENT_UBX_TIMEOUT,
+		BSP_TKVS_TIMER_MS_TO_TICKS(GPS_UBX_TIMEOUT_MS));
     
     memset(&s_gps_state, 0, sizeof(s_gps_state));
+    memset(s_gps_in_view, 0, sizeof(s_gps_in_view));
+    app_nmea_init(&s_nmea);
+    app_ubx_init(&s_ubx);
+    s_gps_mode = GPS_MODE_NMEA;
+    s_gps_forward_ubx = false;
+    s_gps_leap_s = -1;
+    s_gps_week = 0;
+    s_gps_qerr_ps = 0;
+    memset(&s_gps_sub, 0, sizeof(s_gps_sub));
     s_gps_timestamp = 0;
-    s_gps_offset_us = 0;
+    s_gps_speed_cms = 0;
     s_termios_nmea = 0xff;
     
     bsp_sti_register_command(&gps_command);
+    
+    #ifdef CONFIG_BSP_ENABLE_BENCH
+    gps_bench_init();
+    #endif
 }
 
-static uint32_t gps_parse_timestamp(const char* ds, const char* ts)
+static uint32_t gps_timestamp(uint16_t year, uint8_t month, uint8_t day, uint32_t seconds)
 {
-    // Ex: time=201426.000 date=280114 -> 20:14:26 Jan 28, 2014 UTC    
-    uint32_t r = 0;
-    if (strlen(ds) >= 6 && strlen(ts) >= 6)
+    // Ex: 20:14:26 Jan 28, 2014 UTC - seconds is the time of day
+    struct calendar_date dt;
+    
+    dt.date = day - 1;
+    dt.month = month - 1;
+    dt.year = year;
+    dt.hour = seconds / 3600;
+    dt.minute = (seconds / 60) % 60;
+    dt.second = seconds % 60;
+    
+    return calendar_date_to_timestamp(&dt);
+}
+
+static void gps_forward_nmea(const char* nmea)
+{
+	bsp_mux_send(VANET_MUXCH_GPS_RAW, nmea, strlen(nmea));
+	bsp_mux_send(VANET_MUXCH_GPS_RAW, "\r\n", 2);
+    if (s_termios_nmea != 0xff)
     {
-        struct calendar_date dt;
-        dt.date = 10 * (ds[0]-'0') + (ds[1]-'0') - 1;
-        dt.month = 10 * (ds[2]-'0') + (ds[3]-'0') - 1;
-        dt.year = 2000 + 10 * (ds[4]-'0') + (ds[5]-'0');
-        dt.hour = 10 * (ts[0]-'0') + (ts[1]-'0');
-        dt.minute = 10 * (ts[2]-'0') + (ts[3]-'0');
-        dt.second = 10 * (ts[4]-'0') + (ts[5]-'0');
-        
-        r = calendar_date_to_timestamp(&dt);
-        
-        //bsp_termios_printf(BSP_TERMIOS_RAW_DEBUG_PORT, "%d %d\r\n", r, s_gps_offset_us);
+        bsp_termios_printf(s_termios_nmea, "%s\r\n", nmea);
+        bsp_termios_flush(s_termios_nmea);
     }
+}
+
+/// cos() of 0..90 degrees, * 32767
+static const uint16_t s_cos_q15[91] =
+{
+    32767, 32762, 32747, 32722, 32687, 32642, 32587, 32523, 32448, 32364,
+    32269, 32165, 32051, 31927, 31794, 31650, 31498, 31335, 31163, 30982,
+    30791, 30591, 30381, 30162, 29934, 29697, 29451, 29196, 28932, 28659,
+    28377, 28087, 27788, 27481, 27165, 26841, 26509, 26169, 25821, 25465,
+    25101, 24730, 24351, 23964, 23571, 23170, 22762, 22347, 21925, 21497,
+    21062, 20621, 20173, 19720, 19260, 18794, 18323, 17846, 17364, 16876,
+    16384, 15886, 15383, 14876, 14364, 13848, 13328, 12803, 12275, 11743,
+    11207, 10668, 10126,  9580,  9032,  8481,  7927,  7371,  6813,  6252,
+     5690,  5126,  4560,  3993,  3425,  2856,  2286,  1715,  1144,   572,
+        0,
+};
+
+/// Has the fix moved move_m from the last event's position - flat earth, fine for a few km
+static bool gps_moved(uint16_t move_m)
+{
+    // 1e-7 degrees of latitude is 11.132 mm
+    int64_t dlat = (int64_t) s_gps_state.latitude - s_gps_sub.last_lat;
+    int64_t dlon = (int64_t) s_gps_state.longitude - s_gps_sub.last_lon;
+    int32_t lat_deg = s_gps_state.latitude / VANET_API_GPS_LOC_MULTIPLIER;
+    int64_t dy, dx, limit;
+    
+    if (dlon > 180LL * VANET_API_GPS_LOC_MULTIPLIER) dlon -= 360LL * VANET_API_GPS_LOC_MULTIPLIER;
+    if (dlon < -180LL * VANET_API_GPS_LOC_MULTIPLIER) dlon += 360LL * VANET_API_GPS_LOC_MULTIPLIER;
     
-    return r;
+    dy = dlat * 11132 / 1000;
+    dx = (dlon * 11132 / 1000) * s_cos_q15[lat_deg < 0 ? -lat_deg : lat_deg] >> 15;
+    limit = (int64_t) move_m * 1000;
+    
+    return dx * dx + dy * dy >= limit * limit;
 }
 
-static int32_t gps_parse_location(const char* str, char compass)
+/// A fix has been parsed into s_gps_state - push it if the subscription wants it
+static void gps_fix(uint32_t fix_s, uint32_t fix_us)
 {
-    // Ex: 2606.94253,N    08009.91494,W
-    float x = atof(str);
-    int degrees =  x / 100;
-    float minutes = x - 100 * degrees;
+    uint8_t payload[sizeof(vanet_api_gps_state_t) + 1];
+    vanet_api_gps_state_t state;
+    uint32_t lock = s_gps_state.flags & (VAPET_API_GPS_LOCATION_LOCK | VAPET_API_GPS_TIME_LOCK);
+    uint8_t reason = 0;
+    int32_t elapsed_ms;
+    app_gps_fix_t fix;
+    uint64_t now_us;
+    
+    if (s_gps_benching)
+        return;
     
-    if (compass == 'S' || compass == 'W')
+    now_us = bsp_rtc_get_time_us();
+    if (bsp_tkvs_is_subscribed(APP_TKVS_GPS_TASK, APP_GPS_EVENT_FIX) &&
+        now_us - s_gps_fix_published_us >= GPS_FIX_PUBLISH_MIN_US)
     {
-        degrees = -degrees;
-        minutes = -minutes;
+        s_gps_fix_published_us = now_us;
+        fix.time_us = now_us;
+        fix.state = s_gps_state;
+        fix.state.timestamp = fix_s;
+        fix.state.timestamp_us = fix_us;
+        fix.speed_cms = s_gps_speed_cms;
+        bsp_tkvs_publish_data(APP_TKVS_GPS_TASK, APP_GPS_EVENT_FIX, &fix, sizeof(fix));
     }
     
-    return (degrees + minutes / 60) * VANET_API_GPS_LOC_MULTIPLIER;
+    if (s_gps_sub.triggers & VANET_API_GPS_TRIGGER_PERIODIC)
+    {
+        elapsed_ms = (int32_t) (fix_s - s_gps_sub.last_s) * 1000 + ((int32_t) fix_us - (int32_t) s_gps_sub.last_us) / 1000;
+        if (!s_gps_sub.sent || elapsed_ms >= s_gps_sub.period_ms || elapsed_ms < 0)
+            reason |= VANET_API_GPS_TRIGGER_PERIODIC;
+    }
+    if ((s_gps_sub.triggers & VANET_API_GPS_TRIGGER_FIX_CHANGE) && lock != s_gps_sub.lock)
+    {
+        reason |= VANET_API_GPS_TRIGGER_FIX_CHANGE;
+    }
+    if ((s_gps_sub.triggers & VANET_API_GPS_TRIGGER_MOVEMENT) && (lock & VAPET_API_GPS_LOCATION_LOCK))
+    {
+        if (!s_gps_sub.have_ref || gps_moved(s_gps_sub.move_m))
+            reason |= VANET_API_GPS_TRIGGER_MOVEMENT;
+    }
+    s_gps_sub.lock = lock;
+    
+    if (!reason)
+        return;
+    
+    // stamped with when the fix was, not when it was sent
+    state = s_gps_state;
+    state.timestamp = fix_s;
+    state.timestamp_us = fix_us;
+    memcpy(payload, &state, sizeof(state));
+    payload[sizeof(state)] = reason;
+    app_pdg_send_msg(VANET_GRP_GPS_EVENT, VANET_OP_GPS_POSITION, payload, sizeof(payload));
+    
+    s_gps_sub.sent = true;
+    s_gps_sub.last_s = fix_s;
+    s_gps_sub.last_us = fix_us;
+    if (lock & VAPET_API_GPS_LOCATION_LOCK)
+    {
+        s_gps_sub.have_ref = true;
+        s_gps_sub.last_lat = s_gps_state.latitude;
+        s_gps_sub.last_lon = s_gps_state.longitude;
+    }
+    s_gps_sub.events++;
 }
 
-static void gps_parse_nmea(char* nmea)
+/// A GGA's fix time - its time of day on the date of the last RMC / ZDA
+static void gps_nmea_fix(const app_nmea_sentence_t* s)
 {
-    int num_fields;
-    char* line;
-    char* fields[16];
+    uint32_t fix_s = s_gps_timestamp, fix_us = 0;
     
-    // send the raw data out before we mangle it
-	bsp_mux_send(VANET_MUXCH_GPS_RAW, nmea, strlen(nmea));
-	bsp_mux_send(VANET_MUXCH_GPS_RAW, "\r\n", 2);
-    if (s_termios_nmea != 0xff)
+    if (s->have & APP_NMEA_HAVE_TIME)
     {
-        bsp_termios_printf(s_termios_nmea, "%s\r\n", nmea);
-        bsp_termios_flush(s_termios_nmea);
+        fix_s = s_gps_timestamp - s_gps_timestamp % 86400 + s->time_ms / 1000;
+        fix_us = (s->time_ms % 1000) * 1000;
+        
+        // either side of midnight from the date
+        if (fix_s + 43200 < s_gps_timestamp) fix_s += 86400;
+        else if (fix_s > s_gps_timestamp + 43200) fix_s -= 86400;
     }
+    gps_fix(fix_s, fix_us);
+}
+
+/// Take what a sentence said (type is what the parser returned)
+static void gps_apply_nmea(uint8_t type)
+{
+    const app_nmea_sentence_t* s = &s_nmea.s;
+    int i;
     
-    line = bsp_util_strtrim(nmea);            
-    num_fields = bsp_util_strsplit(line, ",", fields, 16);
+    // any talker - $GP, $GN (combined), $GL, ...
+    switch (type)
+    {
+        case APP_NMEA_RMC:
+            if (s->valid)
+            {
+                if (s->have & APP_NMEA_HAVE_SPEED)
+                {
+                    s_gps_state.speed = s->speed_mknots / 1000;
+                    s_gps_speed_cms = (uint32_t) s->speed_mknots * 463 / 9000;    // 1852 m / 3600 s
+                }
+                if (s->have & APP_NMEA_HAVE_COURSE) s_gps_state.direction = s->course_cdeg / 100;
+                if ((s->have & (APP_NMEA_HAVE_TIME | APP_NMEA_HAVE_DATE)) == (APP_NMEA_HAVE_TIME | APP_NMEA_HAVE_DATE))
+                {
+                    s_gps_timestamp = gps_timestamp(s->year, s->month, s->day, s->time_ms / 1000);
+                }
+            }
+            else
+            {
+                s_gps_state.flags &= ~VAPET_API_GPS_TIME_LOCK;
+            }
+            break;
             
-    if (!strcmp(fields[0], "$GPRMC") && num_fields >= 10)
+        case APP_NMEA_GGA:
+            if (s->valid && (s->have & APP_NMEA_HAVE_POSITION))
+            {
+                s_gps_state.latitude = s->latitude;
+                s_gps_state.longitude = s->longitude;
+                s_gps_state.altitude = s->altitude_mm / 1000;
+                s_gps_state.flags |= VAPET_API_GPS_LOCATION_LOCK;
+            }
+            else
+            {
+                s_gps_state.flags &= ~VAPET_API_GPS_LOCATION_LOCK;
+            }
+            gps_nmea_fix(s);
+            break;
+            
+        case APP_NMEA_GSA:
+            if ((s->have & APP_NMEA_HAVE_HDOP) && s->hdop_c < 2500)
+            {
+                s_gps_state.hdop = s->hdop_c / 10;
+            }
+            break;
+            
+        case APP_NMEA_GSV:
+            // a combined receiver sends a GSV group per constellation
+            switch (s->talker[1])
+            {
+                case 'L':   i = 1; break;
+                case 'A':   i = 2; break;
+                case 'B':
+                case 'D':   i = 3; break;
+                default:    i = 0; break;
+            }
+            s_gps_in_view[i] = s->satellites;
+            s_gps_state.satellites = s_gps_in_view[0] + s_gps_in_view[1] + s_gps_in_view[2] + s_gps_in_view[3];
+            break;
+            
+        case APP_NMEA_VTG:
+            if (s->valid)
+            {
+                if (s->have & APP_NMEA_HAVE_SPEED)
+                {
+                    s_gps_state.speed = s->speed_mknots / 1000;
+                    s_gps_speed_cms = (uint32_t) s->speed_mknots * 463 / 9000;    // 1852 m / 3600 s
+                }
+                if (s->have & APP_NMEA_HAVE_COURSE) s_gps_state.direction = s->course_cdeg / 100;
+            }
+            break;
+            
+        case APP_NMEA_ZDA:
+            if ((s->have & (APP_NMEA_HAVE_TIME | APP_NMEA_HAVE_DATE)) == (APP_NMEA_HAVE_TIME | APP_NMEA_HAVE_DATE))
+            {
+                s_gps_timestamp = gps_timestamp(s->year, s->month, s->day, s->time_ms / 1000);
+            }
+            break;
+    }
+}
+
+static void gps_parse_nmea(const char* nmea)
+{
+    gps_apply_nmea(app_nmea_parse_line(&s_nmea, nmea));
+}
+
+static void gps_send_ubx(const uint8_t* frame, uint16_t len)
+{
+    bsp_termios_write(s_termios_gps, frame, len);
+}
+
+/// Configure the receiver for UBX at 10 Hz; gps_ubx_timeout() falls back if it doesn't answer
+static void gps_start_ubx(void)
+{
+    uint8_t frame[APP_UBX_MAX_CFG_FRAME];
+    uint8_t per_second = 1000 / GPS_UBX_RATE_MS;
+    
+    bsp_termios_set_mode(s_termios_gps, BSP_TERMIOS_MODE_RAW, false);
+    s_gps_mode = GPS_MODE_UBX_WAIT;
+    
+    // the receiver may be at its default rate, or still at ours from before a reset - tell both
+    gps_send_ubx(frame, app_ubx_cfg_prt(frame, GPS_USART_UBX_BAUDRATE, APP_UBX_PROTO_UBX | APP_UBX_PROTO_NMEA, APP_UBX_PROTO_UBX));
+    bsp_termios_set_baud(s_termios_gps, GPS_USART_UBX_BAUDRATE);
+    bsp_delay(100);
+    gps_send_ubx(frame, app_ubx_cfg_prt(frame, GPS_USART_UBX_BAUDRATE, APP_UBX_PROTO_UBX | APP_UBX_PROTO_NMEA, APP_UBX_PROTO_UBX));
+    
+    // every solution and its DOP, the time once a second
+    gps_send_ubx(frame, app_ubx_cfg_rate(frame, GPS_UBX_RATE_MS));
+    gps_send_ubx(frame, app_ubx_cfg_msg(frame, APP_UBX_NAV_PVT, 1));
+    gps_send_ubx(frame, app_ubx_cfg_msg(frame, APP_UBX_NAV_DOP, 1));
+    gps_send_ubx(frame, app_ubx_cfg_msg(frame, APP_UBX_NAV_TIMEUTC, per_second));
+    gps_send_ubx(frame, app_ubx_cfg_msg(frame, APP_UBX_TIM_TP, per_second));
+    bsp_termios_flush(s_termios_gps);
+    
+    bsp_tkvs_start_timer(&s_ubx_timer);
+}
+
+/// Put the receiver back to its defaults - NMEA once a second at GPS_USART_BAUDRATE
+static void gps_start_nmea(void)
+{
+    uint8_t frame[APP_UBX_MAX_CFG_FRAME];
+    
+    bsp_tkvs_stop_timer(&s_ubx_timer);
+    
+    gps_send_ubx(frame, app_ubx_cfg_rate(frame, 1000));
+    gps_send_ubx(frame, app_ubx_cfg_prt(frame, GPS_USART_BAUDRATE, APP_UBX_PROTO_UBX | APP_UBX_PROTO_NMEA, APP_UBX_PROTO_NMEA));
+    bsp_termios_set_baud(s_termios_gps, GPS_USART_BAUDRATE);
+    bsp_termios_set_mode(s_termios_gps, BSP_TERMIOS_MODE_CANONICAL, false);
+    s_gps_mode = GPS_MODE_NMEA;
+}
+
+/// Send the frame just parsed to the raw channel
+static void gps_forward_ubx(void)
+{
+    uint8_t frame[APP_UBX_HDR_SIZE + APP_UBX_MAX_PAYLOAD + APP_UBX_XSUM_SIZE];
+    uint16_t len = app_ubx_frame(frame, s_ubx.id, s_ubx.payload, s_ubx.len);
+    
+    for (uint16_t i=0; i<len; i+=GPS_MUX_CHUNK)
     {
-        // Ex: $GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A*6F
-        //     0      1         2 3          4 5           6 7    8 9
-        if (fields[2][0] == 'A')
-        {            
-            s_gps_state.speed = atoi(fields[7]);
-            s_gps_state.direction = atoi(fields[8]);
-            s_gps_timestamp = gps_parse_timestamp(fields[9],fields[1]);
-        }
-        else
-        {
-            s_gps_state.flags &= ~VAPET_API_GPS_TIME_LOCK;
-        }
+        bsp_mux_send(VANET_MUXCH_GPS_RAW, &frame[i], min(GPS_MUX_CHUNK, len - i));
     }
-    else if (!strcmp(fields[0], "$GPGGA") && num_fields >= 10)
+}
+
+static void gps_ubx_pvt(const app_ubx_nav_pvt_t* pvt)
+{
+    uint32_t seconds, fix_s = s_gps_timestamp, fix_us = 0;
+    
+    if ((pvt->flags & APP_UBX_PVT_GNSS_FIX_OK) && pvt->fix_type >= APP_UBX_FIX_2D && pvt->fix_type <= APP_UBX_FIX_GNSS_DR)
     {
-        // Ex: $GPGGA,021357.00,2606.94253,N,08009.91494,W,1,03,2.27,1.6,M,-26.8,M,,*65
-        //     0      1         2          3 4           5 6 7  8    9   10 11                
-        bool gotit = false;
-        if (fields[6][0] != '0')
-        {
-            s_gps_state.latitude = gps_parse_location(fields[2], fields[3][0]);
-            s_gps_state.longitude = gps_parse_location(fields[4], fields[5][0]);
-            s_gps_state.altitude = atoi(fields[9]);
-            gotit = s_gps_state.latitude >= -900000000L && s_gps_state.latitude <= 900000000L &&
-                    s_gps_state.longitude >= -1800000000L && s_gps_state.longitude <= 1800000000L;
-        }
-        
-        if (gotit)
+        s_gps_state.latitude = pvt->latitude;
+        s_gps_state.longitude = pvt->longitude;
+        s_gps_state.altitude = pvt->hmsl_mm / 1000;
+        s_gps_state.speed = (uint32_t) pvt->g_speed_mms * 9 / 4630;        // mm/s to knots
+        s_gps_speed_cms = pvt->g_speed_mms / 10;
+        s_gps_state.direction = pvt->head_mot / 100000;
+        s_gps_state.flags |= VAPET_API_GPS_LOCATION_LOCK;
+    }
+    else
+    {
+        s_gps_state.flags &= ~VAPET_API_GPS_LOCATION_LOCK;
+    }
+    
+    // satellites used, not in view as GSV says; HDOP comes from NAV-DOP
+    s_gps_state.satellites = pvt->num_sv;
+    
+    if ((pvt->valid & (APP_UBX_PVT_VALID_DATE | APP_UBX_PVT_VALID_TIME)) == (APP_UBX_PVT_VALID_DATE | APP_UBX_PVT_VALID_TIME))
+    {
+        // a negative nano is before the second the fields say
+        seconds = pvt->hour * 3600 + pvt->min * 60 + pvt->sec;
+        s_gps_timestamp = gps_timestamp(pvt->year, pvt->month, pvt->day, seconds) - (pvt->nano < 0);
+        fix_s = s_gps_timestamp;
+        fix_us = (pvt->nano < 0 ? pvt->nano + 1000000000 : pvt->nano) / 1000;
+    }
+    else
+    {
+        s_gps_state.flags &= ~VAPET_API_GPS_TIME_LOCK;
+    }
+    
+    gps_fix(fix_s, fix_us);
+}
+
+static void gps_ubx_dop(const app_ubx_nav_dop_t* dop)
+{
+    // same limit and units as the GSA path
+    if (dop->hdop_c < 2500)
+    {
+        s_gps_state.hdop = dop->hdop_c / 10;
+    }
+}
+
+static void gps_ubx_timeutc(const app_ubx_nav_timeutc_t* utc)
+{
+    uint32_t now, gps;
+    int32_t leap;
+    
+    if (!(utc->valid & APP_UBX_TIMEUTC_VALID_UTC) || s_gps_week == 0)
+        return;
+    
+    // GPS - UTC from the same instant both ways; near a week boundary s_gps_week
+    // can be the other week, which makes no sense as a leap second count
+    now = gps_timestamp(utc->year, utc->month, utc->day, utc->hour * 3600 + utc->min * 60 + utc->sec) - (utc->nano < 0);
+    gps = GPS_EPOCH + s_gps_week * GPS_SECONDS_PER_WEEK + utc->itow / 1000;
+    leap = (int32_t) (gps - now);
+    if (leap >= 0 && leap < 64)
+    {
+        s_gps_leap_s = leap;
+    }
+}
+
+static void gps_ubx_tim_tp(const app_ubx_tim_tp_t* tp)
+{
+    uint32_t pulse;
+    
+    s_gps_week = tp->week;
+    s_gps_qerr_ps = tp->q_err_ps;
+    
+    if (!(tp->flags & APP_UBX_TP_TIMEBASE_UTC) && s_gps_leap_s < 0)
+        return;
+    
+    // the UTC second the next pulse starts; the pulse handler wants the one before
+    pulse = GPS_EPOCH + tp->week * GPS_SECONDS_PER_WEEK + (tp->tow_ms + 500) / 1000;
+    if (!(tp->flags & APP_UBX_TP_TIMEBASE_UTC))
+    {
+        pulse -= s_gps_leap_s;
+    }
+    s_gps_timestamp = pulse - 1;
+}
+
+/// Take a frame (id is what the parser returned)
+static void gps_apply_ubx(uint16_t id)
+{
+    union
+    {
+        app_ubx_nav_pvt_t pvt;
+        app_ubx_nav_dop_t dop;
+        app_ubx_nav_timeutc_t utc;
+        app_ubx_tim_tp_t tp;
+    } m;
+    
+    switch (id)
+    {
+        case APP_UBX_NAV_PVT:
+            if (app_ubx_nav_pvt(&s_ubx, &m.pvt)) gps_ubx_pvt(&m.pvt);
+            break;
+            
+        case APP_UBX_NAV_DOP:
+            if (app_ubx_nav_dop(&s_ubx, &m.dop)) gps_ubx_dop(&m.dop);
+            break;
+            
+        case APP_UBX_NAV_TIMEUTC:
+            if (app_ubx_nav_timeutc(&s_ubx, &m.utc)) gps_ubx_timeutc(&m.utc);
+            break;
+            
+        case APP_UBX_TIM_TP:
+            if (app_ubx_tim_tp(&s_ubx, &m.tp)) gps_ubx_tim_tp(&m.tp);
+            break;
+    }
+}
+
+/// Bytes from the receiver in raw mode
+static void gps_parse_raw(const uint8_t* data, uint16_t len)
+{
+    uint16_t id;
+    
+    for (uint16_t i=0; i<len; i++)
+    {
+        if ((id = app_ubx_parse_char(&s_ubx, data[i])) != APP_UBX_NONE)
         {
-            s_gps_state.flags |= VAPET_API_GPS_LOCATION_LOCK;
+            // any good frame, even an ACK, says the receiver speaks UBX
+            if (s_gps_mode == GPS_MODE_UBX_WAIT)
+            {
+                bsp_tkvs_stop_timer(&s_ubx_timer);
+                s_gps_mode = GPS_MODE_UBX;
+            }
+            if (s_gps_forward_ubx)
+            {
+                gps_forward_ubx();
+            }
+            gps_apply_ubx(id);
         }
-        else
+        else if (s_gps_mode == GPS_MODE_UBX_WAIT)
         {
-            s_gps_state.flags &= ~VAPET_API_GPS_LOCATION_LOCK;
+            // until then NMEA still counts
+            gps_apply_nmea(app_nmea_parse_char(&s_nmea, data[i]));
         }
     }
-    else if (!strcmp(fields[0], "$GPGSA") && num_fields >= 15)
+}
+
+#ifdef CONFIG_BSP_ENABLE_BENCH
+/// One second of output from the receiver, parsed a sentence at a time
+static const char* const s_bench_nmea[] =
+{
+    "$GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A*6F",
+    "$GPGGA,021357.00,2606.94253,N,08009.91494,W,1,03,2.27,1.6,M,-26.8,M,,*65",
+    "$GPGSA,A,2,17,04,10,,,,,,,,,,2.48,2.27,1.00*08",
+    "$GPGSV,1,1,03,04,65,276,37,10,36,171,30,17,52,025,34*4B",
+};
+static int s_bench_index;
+static vanet_api_gps_state_t s_bench_saved_state;
+static uint32_t s_bench_saved_timestamp;
+static app_nmea_parser_t s_bench_saved_nmea;
+static app_ubx_parser_t s_bench_saved_ubx;
+static uint8_t s_bench_saved_mode;
+static uint8_t s_bench_pvt[APP_UBX_HDR_SIZE + 92 + APP_UBX_XSUM_SIZE];
+static uint8_t s_bench_saved_in_view[sizeof(s_gps_in_view)];
+static uint16_t s_bench_saved_speed_cms;
+static bool s_bench_saved_forward_ubx;
+
+static bool gps_bench_setup(void)
+{
+    // the canned fix mustn't leak into the real one, nor reach the
+    // subscribers, the API or the raw channel
+    s_gps_benching = true;
+    s_bench_saved_forward_ubx = s_gps_forward_ubx;
+    s_gps_forward_ubx = false;
+    s_bench_saved_speed_cms = s_gps_speed_cms;
+    s_bench_saved_state = s_gps_state;
+    s_bench_saved_timestamp = s_gps_timestamp;
+    s_bench_saved_nmea = s_nmea;
+    s_bench_saved_ubx = s_ubx;
+    s_bench_saved_mode = s_gps_mode;
+    memcpy(s_bench_saved_in_view, s_gps_in_view, sizeof(s_gps_in_view));
+    return true;
+}
+
+static void gps_bench_teardown(void)
+{
+    s_gps_state = s_bench_saved_state;
+    s_gps_timestamp = s_bench_saved_timestamp;
+    s_nmea = s_bench_saved_nmea;
+    s_ubx = s_bench_saved_ubx;
+    s_gps_mode = s_bench_saved_mode;
+    memcpy(s_gps_in_view, s_bench_saved_in_view, sizeof(s_gps_in_view));
+    s_gps_speed_cms = s_bench_saved_speed_cms;
+    s_gps_forward_ubx = s_bench_saved_forward_ubx;
+    s_gps_benching = false;
+}
+
+static void gps_bench_parse_nmea(void)
+{
+    gps_parse_nmea(s_bench_nmea[s_bench_index]);
+    s_bench_index = (s_bench_index + 1) % (sizeof(s_bench_nmea)/sizeof(s_bench_nmea[0]));
+}
+
+static void gps_bench_parse_ubx(void)
+{
+    // a 3D fix, one solution of the ten a second
+    s_gps_mode = GPS_MODE_UBX;
+    gps_parse_raw(s_bench_pvt, sizeof(s_bench_pvt));
+}
+
+static bsp_bench_t s_gps_bench[] =
+{
     {
-        // Ex: $GPGSA,A,2,17,04,10, , , , , , , , , ,2.48,2.27,1.00*08
-        //     0      1 2 3  4  5  6 7 8 9 0 1 2 3 4 5    6    7
-        float pdop = atof(fields[15]);
-        if (pdop < 25)
-        {
-            s_gps_state.hdop = (uint8_t) (pdop * 10);
-        }
-    }
-    else if (!strcmp(fields[0], "$GPGSV") && num_fields >= 3)
+        .name = "gps_parse_nmea",
+        .setup = gps_bench_setup,
+        .run = gps_bench_parse_nmea,
+        .teardown = gps_bench_teardown,
+        .iterations = 64,
+    },
     {
-        // Ex: $GPGSV,1,1,03,04,65,276,37,10,36,171,30,17,52,025,34*4B
-        //     0      1 2 3
-        s_gps_state.satellites = atoi(fields[3]);
-    }    
+        .name = "gps_parse_ubx",
+        .setup = gps_bench_setup,
+        .run = gps_bench_parse_ubx,
+        .teardown = gps_bench_teardown,
+        .iterations = 64,
+        .bytes = sizeof(s_bench_pvt),
+    },
+};
+
+static void gps_bench_init(void)
+{
+    uint8_t payload[92];
+    
+    memset(payload, 0, sizeof(payload));
+    payload[4] = 0xDD; payload[5] = 0x07;               // 2013-05-31 02:13:57
+    payload[6] = 5; payload[7] = 31; payload[8] = 2; payload[9] = 13; payload[10] = 57;
+    payload[11] = APP_UBX_PVT_VALID_DATE | APP_UBX_PVT_VALID_TIME;
+    payload[20] = APP_UBX_FIX_3D; payload[21] = APP_UBX_PVT_GNSS_FIX_OK; payload[23] = 3;
+    payload[36] = 0x40; payload[37] = 0x06;             // 1.6 m
+    payload[76] = 0xF8;                                 // PDOP 2.48
+    app_ubx_frame(s_bench_pvt, APP_UBX_NAV_PVT, payload, sizeof(payload));
+    
+    bsp_bench_register(&s_gps_bench[0]);
+    bsp_bench_register(&s_gps_bench[1]);
 }
+#endif // CONFIG_BSP_ENABLE_BENCH
 
 void app_gps_cmd_get_state(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len)
 {
     // we already store the GPS state in this format, so just send it
-    s_gps_state.timestamp = bsp_rtc_get_clock();
-    s_gps_state.timestamp_us = bsp_rtc_get_clock_us() + s_gps_offset_us;
-    if (s_gps_state.timestamp_us > 1000000)
-    {
-        s_gps_state.timestamp++;
-        s_gps_state.timestamp_us -= 1000000;
-    }
+    gps_now(&s_gps_state.timestamp, &s_gps_state.timestamp_us);
     app_pdg_send_msg(grp,opcode,(const uint8_t*) &s_gps_state,28);
 }
 
+void app_gps_cmd_subscribe(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len)
+{
+    /*
+        Byte 0      - Triggers, 0 to stop
+        Byte 1-2    - Period in ms
+        Byte 3-4    - Movement in meters
+    */
+    uint8_t triggers = payload_len > 0 ? payload[0] : 0;
+    uint16_t period_ms = payload_len > 2 ? (payload[1] << 8) | payload[2] : 0;
+    uint16_t move_m = payload_len > 4 ? (payload[3] << 8) | payload[4] : 0;
+    
+    // the GPS task reads these per fix
+    OSSchedLock();
+    memset(&s_gps_sub, 0, sizeof(s_gps_sub));
+    s_gps_sub.lock = s_gps_state.flags & (VAPET_API_GPS_LOCATION_LOCK | VAPET_API_GPS_TIME_LOCK);
+    s_gps_sub.period_ms = period_ms;
+    s_gps_sub.move_m = move_m;
+    s_gps_sub.triggers = triggers;
+    OSSchedUnlock();
+    
+    app_pdg_send_msg(grp, opcode, 0, 0);
+}
+
 static void gps_task(void *p_arg)
 {
 	bsp_tkvs_msg_t *msg;
@@ -270,10 +867,20 @@ static void gps_task(void *p_arg)
 	
 	(void) p_arg;
 	
+	// 10 Hz needs UBX; the receiver's answer (or not) picks the mode
+	if (s_termios_gps < BSP_TERMIOS_COUNT)
+	{
+		gps_start_ubx();
+	}
+	
 	// Task Loop
 	while (1)
 	{
 		msg = (bsp_tkvs_msg_t*) OSQPend(s_msg_flag, 0, &perr);    // block forever on my queue
+		
+		// the receiver reports every second, just after the pulse
+		gps_timepulse_catch_up();
+		
 		if (msg != (void *)0)
 		{
 			if (msg->source == BSP_TERMIOS_PORT_TO_TKVS_SOURCE(s_termios_gps))
@@ -282,10 +889,31 @@ static void gps_task(void *p_arg)
 				{
 					// Need to do anything?
 				}
+				else if (msg->event == BSP_TERMIOS_INPUT_RX && s_gps_mode != GPS_MODE_NMEA)
+				{
+					// UBX frames, or whatever the receiver sends before it takes the configuration
+					gps_parse_raw(msg->data, msg->data_len);
+				}
 				else if (msg->event == BSP_TERMIOS_INPUT_RX)
 				{
 					// Line of text from GPS Chip
-					gps_parse_nmea((char *)msg->data);
+					gps_forward_nmea((const char *)msg->data);
+					gps_parse_nmea((const char *)msg->data);
+				}
+			}
+			else if (msg->source == APP_TKVS_GPS_TASK)
+			{
+				if (msg->event == APP_GPS_EVENT_UBX_TIMEOUT && s_gps_mode == GPS_MODE_UBX_WAIT)
+				{
+					print_dbg("GPS: no UBX from the receiver, using NMEA\r\n");
+					gps_start_nmea();
+				}
+				else if (msg->event == APP_GPS_EVENT_MODE)
+				{
+					if (msg->immed_data == GPS_MODE_NMEA)
+						gps_start_nmea();
+					else
+						gps_start_ubx();
 				}
 			}
 			else if (msg->source == BSP_MUX_DLCI_TO_TKVS_SOURCE(VANET_MUXCH_TIMESYNC))
@@ -295,21 +923,23 @@ static void gps_task(void *p_arg)
         			if (msg->data[0] == VANET_API_TIME_REQUEST)
                     {
                         vanet_api_timestamp_t t;
-                        if (s_gps_state.flags & VAPET_API_GPS_TIME_LOCK)
+                        if (msg->data_len >= 1 + sizeof(((vanet_api_timesync_t*) 0)->origin))
                         {
-                            t.timestamp = bsp_rtc_get_clock();
-                            t.timestamp_us = bsp_rtc_get_clock_us() + s_gps_offset_us;
-                            if (t.timestamp_us > 1000000)
-                            {
-                                t.timestamp++;
-                                t.timestamp_us -= 1000000;
-                            }
+                            // NTP style, with the main board's T1
+                            gps_timesync(msg->data + 1);
                         }
                         else
                         {
-                            t.timestamp = t.timestamp_us = 0;
+                            if (s_gps_state.flags & VAPET_API_GPS_TIME_LOCK)
+                            {
+                                gps_now(&t.timestamp, &t.timestamp_us);
+                            }
+                            else
+                            {
+                                t.timestamp = t.timestamp_us = 0;
+                            }
+                            bsp_mux_send(VANET_MUXCH_TIMESYNC, (const uint8_t*) &t, sizeof(t));
                         }
-                        bsp_mux_send(VANET_MUXCH_TIMESYNC, (const uint8_t*) &t, sizeof(t));
                     }                        
     			}
 			}
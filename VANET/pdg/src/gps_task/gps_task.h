@@ -19,10 +19,31 @@
 #ifndef GPS_TASK_H
 #define GPS_TASK_H
 
+#include "vanet_api.h"
+
+/// APP_TKVS_GPS_TASK Events
+enum
+{
+    APP_GPS_EVENT_UBX_TIMEOUT   = 0x0001,
+    APP_GPS_EVENT_MODE          = 0x0002,       ///< immed_data is the mode to switch to
+    APP_GPS_EVENT_FIX           = 0x0004,       ///< data is an app_gps_fix_t - published only while somebody subscribes
+};
+
+/// A fix, as it was parsed
+typedef struct
+{
+    uint64_t time_us;                           ///< bsp_rtc_get_time_us() when it was parsed
+    vanet_api_gps_state_t state;                ///< timestamp is the time of the fix
+    uint16_t speed_cms;                         ///< state.speed, in cm/s
+} app_gps_fix_t;
+
 /// Initialize / Start the GPS Task
 extern void app_gps_task_init(void);
 
 /// PDG command handler for GPS get state
 extern void app_gps_cmd_get_state(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len);
 
+/// PDG command handler for GPS subscribe - position events pushed per fix
+extern void app_gps_cmd_subscribe(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len);
+
 #endif // GPS_TASK_H
\ No newline at end of file
@@ -0,0 +1,616 @@
+/**
+ *	@file	nmea.c
+ *
+ *	@brief	NMEA 0183 sentence parser
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifdef UNIT_TEST
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vanet_api.h"
+#include "nmea.h"
+#else
+#include <asf.h>
+#include <string.h>
+#include "vanet.h"
+#include "vanet_api.h"
+#include "nmea.h"
+#endif
+
+/// The three character formatter after the talker, packed
+#define NMEA_ID(a, b, c)				(((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (c))
+
+/// Largest integer part kept - hhmmss, ddmmyy and dddmm all fit
+#define NMEA_IPART_MAX					999999
+
+enum
+{
+	NMEA_IDLE,							///< Waiting for a '$'
+	NMEA_BODY,							///< Address and fields
+	NMEA_XSUM_HI,						///< After the '*'
+	NMEA_XSUM_LO,
+	NMEA_END,							///< Waiting for the CR / LF
+};
+
+static const uint32_t s_pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+static void nmea_field_reset(app_nmea_parser_t* p)
+{
+	p->chars = 0;
+	p->first = 0;
+	p->neg = false;
+	p->point = false;
+	p->frac_digits = 0;
+	p->ipart = 0;
+	p->fpart = 0;
+}
+
+/// The digits after the '.' scaled by 10^scale, scale <= 7, truncated
+static uint32_t nmea_frac(const app_nmea_parser_t* p, int scale)
+{
+	if (p->frac_digits > scale)
+		return p->fpart / s_pow10[p->frac_digits - scale];
+	else
+		return p->fpart * s_pow10[scale - p->frac_digits];
+}
+
+/// The field scaled by 10^scale, truncated.  Only for small scales - the integer part can be 6 digits
+static uint32_t nmea_fixed(const app_nmea_parser_t* p, int scale)
+{
+	return p->ipart * s_pow10[scale] + nmea_frac(p, scale);
+}
+
+/// A [d]ddmm.mmmmm field in degrees * VANET_API_GPS_LOC_MULTIPLIER, rounded
+static int32_t nmea_latlon(const app_nmea_parser_t* p)
+{
+	// minutes * 10^7 is under 6 * 10^8
+	uint32_t minutes = (p->ipart % 100) * 10000000 + nmea_frac(p, 7);
+
+	return (p->ipart / 100) * VANET_API_GPS_LOC_MULTIPLIER + (minutes + 30) / 60;
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+/// The address field is over: which sentence is it
+static bool nmea_address(app_nmea_parser_t* p)
+{
+	if (p->chars != 5)
+		return false;
+
+	switch (p->address)
+	{
+		case NMEA_ID('R','M','C'):	p->s.type = APP_NMEA_RMC; break;
+		case NMEA_ID('G','G','A'):	p->s.type = APP_NMEA_GGA; break;
+		case NMEA_ID('G','S','A'):	p->s.type = APP_NMEA_GSA; break;
+		case NMEA_ID('G','S','V'):	p->s.type = APP_NMEA_GSV; break;
+		case NMEA_ID('V','T','G'):	p->s.type = APP_NMEA_VTG; p->s.valid = true; break;
+		case NMEA_ID('Z','D','A'):	p->s.type = APP_NMEA_ZDA; break;
+		default:					return false;
+	}
+	return true;
+}
+
+static void nmea_time(app_nmea_parser_t* p)
+{
+	uint32_t hhmmss = p->ipart;
+
+	p->s.time_ms = ((hhmmss / 10000) * 3600 + ((hhmmss / 100) % 100) * 60 + hhmmss % 100) * 1000 + nmea_frac(p, 3);
+	p->s.have |= APP_NMEA_HAVE_TIME;
+}
+
+static void nmea_latitude(app_nmea_parser_t* p)
+{
+	p->s.latitude = nmea_latlon(p);
+	p->s.have |= APP_NMEA_HAVE_POSITION;
+}
+
+static void nmea_longitude(app_nmea_parser_t* p)
+{
+	p->s.longitude = nmea_latlon(p);
+}
+
+/// A field is over: put it where the sentence says it goes
+static void nmea_field(app_nmea_parser_t* p)
+{
+	app_nmea_sentence_t* s = &p->s;
+
+	// an empty field says nothing - but a position is both halves or nothing
+	if (p->chars == 0)
+	{
+		if ((s->type == APP_NMEA_RMC && p->field == 5) || (s->type == APP_NMEA_GGA && p->field == 4))
+			s->have &= ~APP_NMEA_HAVE_POSITION;
+		return;
+	}
+
+	switch (s->type)
+	{
+		case APP_NMEA_RMC:
+			// $GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A*6F
+			switch (p->field)
+			{
+				case 1:	nmea_time(p); break;
+				case 2:	s->valid = (p->first == 'A'); break;
+				case 3:	nmea_latitude(p); break;
+				case 4:	if (p->first == 'S') s->latitude = -s->latitude; break;
+				case 5:	nmea_longitude(p); break;
+				case 6:	if (p->first == 'W') s->longitude = -s->longitude; break;
+				case 7:	s->speed_mknots = nmea_fixed(p, 3); s->have |= APP_NMEA_HAVE_SPEED; break;
+				case 8:	s->course_cdeg = nmea_fixed(p, 2); s->have |= APP_NMEA_HAVE_COURSE; break;
+				case 9:
+					s->day = p->ipart / 10000;
+					s->month = (p->ipart / 100) % 100;
+					s->year = 2000 + p->ipart % 100;
+					s->have |= APP_NMEA_HAVE_DATE;
+					break;
+			}
+			break;
+
+		case APP_NMEA_GGA:
+			// $GPGGA,021357.00,2606.94253,N,08009.91494,W,1,03,2.27,1.6,M,-26.8,M,,*65
+			switch (p->field)
+			{
+				case 1:	nmea_time(p); break;
+				case 2:	nmea_latitude(p); break;
+				case 3:	if (p->first == 'S') s->latitude = -s->latitude; break;
+				case 4:	nmea_longitude(p); break;
+				case 5:	if (p->first == 'W') s->longitude = -s->longitude; break;
+				case 6:	s->fix = p->ipart; s->valid = (p->ipart != 0); break;
+				case 7:	s->satellites = p->ipart; s->have |= APP_NMEA_HAVE_SATELLITES; break;
+				case 8:	s->hdop_c = nmea_fixed(p, 2); s->have |= APP_NMEA_HAVE_HDOP; break;
+				case 9:
+					s->altitude_mm = p->neg ? -(int32_t)nmea_fixed(p, 3) : (int32_t)nmea_fixed(p, 3);
+					s->have |= APP_NMEA_HAVE_ALTITUDE;
+					break;
+			}
+			break;
+
+		case APP_NMEA_GSA:
+			// $GPGSA,A,2,17,04,10,,,,,,,,,,2.48,2.27,1.00*08 - PDOP, HDOP, VDOP
+			switch (p->field)
+			{
+				case 2:		s->fix = p->ipart; s->valid = (p->ipart >= 2); break;
+				case 16:	s->hdop_c = nmea_fixed(p, 2); s->have |= APP_NMEA_HAVE_HDOP; break;
+			}
+			break;
+
+		case APP_NMEA_GSV:
+			// $GPGSV,1,1,03,04,65,276,37,10,36,171,30,17,52,025,34*4B
+			if (p->field == 3)
+			{
+				s->satellites = p->ipart;
+				s->have |= APP_NMEA_HAVE_SATELLITES;
+			}
+			break;
+
+		case APP_NMEA_VTG:
+			// $GPVTG,,T,,M,0.045,N,0.083,K,A*2B
+			switch (p->field)
+			{
+				case 1:	s->course_cdeg = nmea_fixed(p, 2); s->have |= APP_NMEA_HAVE_COURSE; break;
+				case 5:	s->speed_mknots = nmea_fixed(p, 3); s->have |= APP_NMEA_HAVE_SPEED; break;
+				case 9:	s->valid = (p->first != 'N'); break;
+			}
+			break;
+
+		case APP_NMEA_ZDA:
+			// $GPZDA,021357.00,31,05,2013,00,00*6A
+			switch (p->field)
+			{
+				case 1:	nmea_time(p); break;
+				case 2:	s->day = p->ipart; break;
+				case 3:	s->month = p->ipart; break;
+				case 4:
+					s->year = p->ipart;
+					if (s->day && s->month) s->have |= APP_NMEA_HAVE_DATE;
+					break;
+			}
+			break;
+	}
+}
+
+void app_nmea_init(app_nmea_parser_t* p)
+{
+	memset(p, 0, sizeof(*p));
+	p->state = NMEA_IDLE;
+}
+
+uint8_t app_nmea_parse_char(app_nmea_parser_t* p, char c)
+{
+	int v;
+
+	// a '$' always starts over
+	if (c == '$')
+	{
+		memset(&p->s, 0, sizeof(p->s));
+		p->state = NMEA_BODY;
+		p->field = 0;
+		p->xsum = 0;
+		p->address = 0;
+		nmea_field_reset(p);
+		return APP_NMEA_NONE;
+	}
+
+	switch (p->state)
+	{
+		case NMEA_BODY:
+			if (c == '*' || c == ',')
+			{
+				if (p->field == 0)
+				{
+					if (!nmea_address(p))
+					{
+						p->unknown++;
+						p->state = NMEA_IDLE;
+						break;
+					}
+				}
+				else
+				{
+					nmea_field(p);
+				}
+
+				if (c == '*')
+				{
+					p->state = NMEA_XSUM_HI;
+				}
+				else
+				{
+					p->xsum ^= c;
+					p->field++;
+					nmea_field_reset(p);
+				}
+			}
+			else if (c == '\r' || c == '\n')
+			{
+				// no checksum
+				p->bad_xsum++;
+				p->state = NMEA_IDLE;
+			}
+			else
+			{
+				p->xsum ^= c;
+				p->chars++;
+				if (p->field == 0)
+				{
+					// GP RMC - the talker, then the formatter
+					if (p->chars <= 2)
+						p->s.talker[p->chars - 1] = c;
+					else
+						p->address = (p->address << 8) | (uint8_t) c;
+				}
+				else if (c >= '0' && c <= '9')
+				{
+					if (!p->point)
+					{
+						if (p->ipart <= NMEA_IPART_MAX / 10)
+							p->ipart = p->ipart * 10 + (c - '0');
+					}
+					else if (p->frac_digits < 7)
+					{
+						p->fpart = p->fpart * 10 + (c - '0');
+						p->frac_digits++;
+					}
+				}
+				else if (c == '.')
+				{
+					p->point = true;
+				}
+				else if (c == '-' && p->chars == 1)
+				{
+					p->neg = true;
+				}
+
+				if (p->chars == 1)
+					p->first = c;
+			}
+			break;
+
+		case NMEA_XSUM_HI:
+		case NMEA_XSUM_LO:
+			v = hex_value(c);
+			if (v < 0)
+			{
+				p->bad_xsum++;
+				p->state = NMEA_IDLE;
+			}
+			else if (p->state == NMEA_XSUM_HI)
+			{
+				p->given = v << 4;
+				p->state = NMEA_XSUM_LO;
+			}
+			else
+			{
+				p->given |= v;
+				p->state = NMEA_END;
+			}
+			break;
+
+		case NMEA_END:
+			p->state = NMEA_IDLE;
+			if (c == '\r' || c == '\n')
+			{
+				if (p->given == p->xsum)
+				{
+					p->good++;
+					return p->s.type;
+				}
+			}
+			p->bad_xsum++;
+			break;
+
+		default:
+			break;
+	}
+
+	return APP_NMEA_NONE;
+}
+
+uint8_t app_nmea_parse_line(app_nmea_parser_t* p, const char* line)
+{
+	while (*line)
+	{
+		app_nmea_parse_char(p, *line++);
+	}
+	return app_nmea_parse_char(p, '\n');
+}
+
+#ifdef UNIT_TEST
+/* -----------
+ *  gps_parse_nmea() as it was - the benchmark, and the numbers to compare
+ * ----------*/
+#define WHITESPACE          " \t\r\n"
+
+static char* legacy_strtrim(char* str)
+{
+	char* start, *end;
+
+	while (*str && strchr(WHITESPACE, *str)) str++;
+	start = str;
+
+	end = 0;
+	while (*str)
+	{
+		if (strchr(WHITESPACE, *str))
+		{
+			if (end == 0) end = str;
+		}
+		else
+		{
+			end = 0;
+		}
+		str++;
+	}
+	if (end) *end = 0;
+
+	return start;
+}
+
+static int legacy_strsplit(char* source, const char* delimiters, char** strs, int max_strs)
+{
+	int n = 0;
+
+	strs[n++] = source;
+	while (*source)
+	{
+		if (strchr(delimiters, *source))
+		{
+			*source = 0;
+			if (n < max_strs)
+				strs[n++] = source+1;
+			else
+				break;
+		}
+		source++;
+	}
+	return n;
+}
+
+static int32_t legacy_parse_location(const char* str, char compass)
+{
+	float x = atof(str);
+	int degrees =  x / 100;
+	float minutes = x - 100 * degrees;
+
+	if (compass == 'S' || compass == 'W')
+	{
+		degrees = -degrees;
+		minutes = -minutes;
+	}
+
+	return (degrees + minutes / 60) * VANET_API_GPS_LOC_MULTIPLIER;
+}
+
+static vanet_api_gps_state_t s_legacy;
+static uint32_t s_legacy_time;
+
+static void legacy_parse_nmea(char* nmea)
+{
+	int num_fields;
+	char* line;
+	char* fields[16];
+
+	line = legacy_strtrim(nmea);
+	num_fields = legacy_strsplit(line, ",", fields, 16);
+
+	if (!strcmp(fields[0], "$GPRMC") && num_fields >= 10)
+	{
+		if (fields[2][0] == 'A')
+		{
+			s_legacy.speed = atoi(fields[7]);
+			s_legacy.direction = atoi(fields[8]);
+			s_legacy_time = atoi(fields[1]);		// the calendar conversion isn't what we're timing
+		}
+	}
+	else if (!strcmp(fields[0], "$GPGGA") && num_fields >= 10)
+	{
+		if (fields[6][0] != '0')
+		{
+			s_legacy.latitude = legacy_parse_location(fields[2], fields[3][0]);
+			s_legacy.longitude = legacy_parse_location(fields[4], fields[5][0]);
+			s_legacy.altitude = atoi(fields[9]);
+		}
+	}
+	else if (!strcmp(fields[0], "$GPGSA") && num_fields >= 15)
+	{
+		float pdop = atof(fields[15]);
+		if (pdop < 25)
+			s_legacy.hdop = (uint8_t) (pdop * 10);
+	}
+	else if (!strcmp(fields[0], "$GPGSV") && num_fields >= 3)
+	{
+		s_legacy.satellites = atoi(fields[3]);
+	}
+}
+
+/// The same second as the firmware benchmark
+static const char* const s_second[] =
+{
+	"$GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A*6F",
+	"$GPGGA,021357.00,2606.94253,N,08009.91494,W,1,03,2.27,1.6,M,-26.8,M,,*65",
+	"$GPGSA,A,2,17,04,10,,,,,,,,,,2.48,2.27,1.00*08",
+	"$GPGSV,1,1,03,04,65,276,37,10,36,171,30,17,52,025,34*4B",
+};
+
+static char* with_xsum(char* buf, const char* body)
+{
+	uint8_t x = 0;
+
+	for (const char* c = body + 1; *c; c++) x ^= *c;
+	sprintf(buf, "%s*%02X", body, x);
+	return buf;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define CHECK(cond)		do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); errors++; } } while (0)
+
+int main(void)
+{
+	app_nmea_parser_t p;
+	char buf[160], line[128];
+	int errors = 0, n;
+	int32_t maxdiff = 0, maxerr = 0, d;
+	double exact;
+	double t0, t_new, t_old;
+
+	app_nmea_init(&p);
+
+	// the canned second
+	CHECK(app_nmea_parse_line(&p, s_second[0]) == APP_NMEA_RMC);
+	CHECK(p.s.valid && p.s.time_ms == (2 * 3600 + 13 * 60 + 57) * 1000);
+	CHECK(p.s.day == 31 && p.s.month == 5 && p.s.year == 2013);
+	CHECK(p.s.latitude == 261157088 && p.s.longitude == -801652490);
+	CHECK(p.s.speed_mknots == 45 && !(p.s.have & APP_NMEA_HAVE_COURSE));
+	CHECK(app_nmea_parse_line(&p, s_second[1]) == APP_NMEA_GGA);
+	CHECK(p.s.fix == 1 && p.s.satellites == 3 && p.s.hdop_c == 227 && p.s.altitude_mm == 1600);
+	CHECK(p.s.have == (APP_NMEA_HAVE_TIME | APP_NMEA_HAVE_POSITION | APP_NMEA_HAVE_SATELLITES |
+		APP_NMEA_HAVE_HDOP | APP_NMEA_HAVE_ALTITUDE));
+	CHECK(app_nmea_parse_line(&p, s_second[2]) == APP_NMEA_GSA);
+	CHECK(p.s.fix == 2 && p.s.valid && p.s.hdop_c == 227);
+	CHECK(app_nmea_parse_line(&p, s_second[3]) == APP_NMEA_GSV);
+	CHECK(p.s.satellites == 3);
+
+	// other talkers, the other sentences, the other hemispheres
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GNGGA,235959.999,3348.12345,S,15112.54321,E,2,12,0.8,-12.3,M,20.1,M,,")) == APP_NMEA_GGA);
+	CHECK(p.s.talker[0] == 'G' && p.s.talker[1] == 'N' && p.s.time_ms == 86399999);
+	CHECK(p.s.latitude == -338020575 && p.s.longitude == 1512090535 && p.s.altitude_mm == -12300);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GLGSV,3,1,10,65,12,045,30,66,45,123,41,,,,,,,,")) == APP_NMEA_GSV);
+	CHECK(p.s.satellites == 10);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GNVTG,123.45,T,,M,12.345,N,22.863,K,D")) == APP_NMEA_VTG);
+	CHECK(p.s.valid && p.s.course_cdeg == 12345 && p.s.speed_mknots == 12345);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GPVTG,,T,,M,,N,,K,N")) == APP_NMEA_VTG);
+	CHECK(!p.s.valid && p.s.have == 0);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GPZDA,201426.50,28,01,2014,00,00")) == APP_NMEA_ZDA);
+	CHECK(p.s.time_ms == 72866500 && p.s.day == 28 && p.s.month == 1 && p.s.year == 2014);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GNRMC,,V,,,,,,,,,,N")) == APP_NMEA_RMC);
+	CHECK(!p.s.valid && p.s.have == 0);
+
+	// what isn't taken
+	n = p.good;
+	CHECK(app_nmea_parse_line(&p, "$GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A*6E") == APP_NMEA_NONE);
+	CHECK(app_nmea_parse_line(&p, "$GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A") == APP_NMEA_NONE);
+	CHECK(app_nmea_parse_line(&p, "$GPRMC,021357.00,A,2606.94253,N,08009.91494,W,0.045,,310513,,,A*6") == APP_NMEA_NONE);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$GPTXT,01,01,02,ANTSTATUS=OK")) == APP_NMEA_NONE);
+	CHECK(app_nmea_parse_line(&p, with_xsum(buf, "$PUBX,00,021357.00")) == APP_NMEA_NONE);
+	CHECK(p.good == n && p.bad_xsum == 3 && p.unknown == 2);
+
+	// a sentence cut off by the next one
+	CHECK(app_nmea_parse_line(&p, "$GPGGA,021357.00,2606.9$GPGSV,1,1,03,04,65,276,37,10,36,171,30,17,52,025,34*4B") == APP_NMEA_GSV);
+
+	// positions all over, against doubles and the float code
+	srand(1);
+	for (int i=0; i<100000; i++)
+	{
+		int lat = rand() % 90, lon = rand() % 180;
+		double lat_min = (rand() % 6000000) / 100000.0, lon_min = (rand() % 6000000) / 100000.0;
+		char ns = rand() & 1 ? 'N' : 'S', ew = rand() & 1 ? 'E' : 'W';
+
+		sprintf(line, "$GPGGA,021357.00,%02d%08.5f,%c,%03d%08.5f,%c,1,03,2.27,1.6,M,-26.8,M,,", lat, lat_min, ns, lon, lon_min, ew);
+		with_xsum(buf, line);
+		CHECK(app_nmea_parse_line(&p, buf) == APP_NMEA_GGA);
+		exact = (lat + lat_min / 60) * VANET_API_GPS_LOC_MULTIPLIERF * (ns == 'S' ? -1 : 1);
+		d = abs(p.s.latitude - (int32_t) (exact + (exact < 0 ? -0.5 : 0.5)));
+		if (d > maxerr) maxerr = d;
+		exact = (lon + lon_min / 60) * VANET_API_GPS_LOC_MULTIPLIERF * (ew == 'W' ? -1 : 1);
+		d = abs(p.s.longitude - (int32_t) (exact + (exact < 0 ? -0.5 : 0.5)));
+		if (d > maxerr) maxerr = d;
+
+		legacy_parse_nmea(buf);
+		d = abs(p.s.latitude - s_legacy.latitude);
+		if (d > maxdiff) maxdiff = d;
+		d = abs(p.s.longitude - s_legacy.longitude);
+		if (d > maxdiff) maxdiff = d;
+	}
+	printf("position: largest error %d, largest difference from the float code %d (1e-7 degrees)\n", maxerr, maxdiff);
+	CHECK(maxerr <= 1);
+
+	// the benchmark - the old code needs its copy of the line
+	for (int round=0; round<2; round++)
+	{
+		t0 = now_ns();
+		for (int i=0; i<1000000; i++)
+			app_nmea_parse_line(&p, s_second[i & 3]);
+		t_new = (now_ns() - t0) / 1000000;
+
+		t0 = now_ns();
+		for (int i=0; i<1000000; i++)
+		{
+			strcpy(line, s_second[i & 3]);
+			legacy_parse_nmea(line);
+		}
+		t_old = (now_ns() - t0) / 1000000;
+	}
+	printf("per sentence: %.1f ns (gps_parse_nmea was %.1f ns)\n", t_new, t_old);
+
+	printf("Done - %d errors\n", errors);
+	return errors != 0;
+}
+#endif // UNIT_TEST
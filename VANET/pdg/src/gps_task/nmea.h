@@ -0,0 +1,113 @@
+/**
+ *	@file	nmea.h
+ *
+ *	@brief	NMEA 0183 sentence parser
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef NMEA_H
+#define NMEA_H
+
+/**
+ * The parser takes a character at a time and keeps no copy of the sentence.
+ * Each field is converted to fixed point as its characters arrive, into a
+ * scratch app_nmea_sentence_t; when the checksum after the '*' matches, the
+ * sentence type is returned and the scratch holds what the sentence said.
+ * Sentences without a checksum, with a bad one, or from a formatter we don't
+ * know are dropped (and counted).  Any talker is taken - $GP, $GN, $GL, ...
+ */
+
+/// Sentence formatters we parse
+enum
+{
+	APP_NMEA_NONE	= 0,
+	APP_NMEA_RMC,
+	APP_NMEA_GGA,
+	APP_NMEA_GSA,
+	APP_NMEA_GSV,
+	APP_NMEA_VTG,
+	APP_NMEA_ZDA,
+};
+
+/// Fields of app_nmea_sentence_t the sentence had (not empty)
+enum
+{
+	APP_NMEA_HAVE_TIME			= 0x0001,
+	APP_NMEA_HAVE_DATE			= 0x0002,
+	APP_NMEA_HAVE_POSITION		= 0x0004,
+	APP_NMEA_HAVE_ALTITUDE		= 0x0008,
+	APP_NMEA_HAVE_SPEED			= 0x0010,
+	APP_NMEA_HAVE_COURSE		= 0x0020,
+	APP_NMEA_HAVE_SATELLITES	= 0x0040,
+	APP_NMEA_HAVE_HDOP			= 0x0080,
+};
+
+/// What a sentence said
+typedef struct
+{
+	uint8_t		type;					///< APP_NMEA_RMC ...
+	char		talker[2];				///< "GP", "GN", ...
+	bool		valid;					///< RMC/GGA/GSA/VTG say the fix is good
+	uint16_t	have;					///< APP_NMEA_HAVE_xxx
+	uint32_t	time_ms;				///< UTC time of day, ms
+	uint8_t		day;					///< 1..31
+	uint8_t		month;					///< 1..12
+	uint16_t	year;					///< 4 digits
+	int32_t		latitude;				///< degrees * VANET_API_GPS_LOC_MULTIPLIER, north positive
+	int32_t		longitude;				///< degrees * VANET_API_GPS_LOC_MULTIPLIER, east positive
+	int32_t		altitude_mm;			///< above mean sea level
+	uint32_t	speed_mknots;			///< speed over ground, knots * 1000
+	uint32_t	course_cdeg;			///< track made good, degrees true * 100
+	uint16_t	hdop_c;					///< HDOP * 100
+	uint8_t		satellites;				///< GGA: used in the fix, GSV: in view
+	uint8_t		fix;					///< GGA: fix quality, GSA: 1 none, 2 2D, 3 3D
+} app_nmea_sentence_t;
+
+/// Parser state
+typedef struct
+{
+	app_nmea_sentence_t s;				///< The last good sentence, or the one being parsed
+	uint8_t		state;
+	uint8_t		field;					///< Index of the field being parsed, 0 is the address
+	uint8_t		xsum;					///< XOR of the characters after the '$'
+	uint8_t		given;					///< The checksum after the '*'
+	uint8_t		chars;					///< Characters in this field
+	char		first;					///< First character of this field
+	bool		neg;					///< The field started with a '-'
+	bool		point;					///< The field has had its '.'
+	uint8_t		frac_digits;			///< Digits after the '.', up to 7 are kept
+	uint32_t	ipart;					///< The digits before the '.'
+	uint32_t	fpart;					///< The digits after it
+	uint32_t	address;				///< The formatter, packed by NMEA_ID()
+	uint32_t	good;					///< Sentences returned
+	uint32_t	bad_xsum;				///< Sentences with a missing or wrong checksum
+	uint32_t	unknown;				///< Sentences we don't parse
+} app_nmea_parser_t;
+
+/// Reset a parser
+extern void app_nmea_init(app_nmea_parser_t* p);
+
+/**
+ * Parse a character
+ *
+ * @param p The parser
+ * @param c The character
+ * @return APP_NMEA_RMC etc. when c ends a good sentence (p->s has it), else APP_NMEA_NONE
+ */
+extern uint8_t app_nmea_parse_char(app_nmea_parser_t* p, char c);
+
+/// Parse a line - a sentence without its CR LF, as termios hands it over
+extern uint8_t app_nmea_parse_line(app_nmea_parser_t* p, const char* line);
+
+#endif // NMEA_H
@@ -0,0 +1,428 @@
+/**
+ *	@file	ubx.c
+ *
+ *	@brief	u-blox UBX binary protocol
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifdef UNIT_TEST
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ubx.h"
+#else
+#include <asf.h>
+#include <string.h>
+#include "vanet.h"
+#include "ubx.h"
+#endif
+
+/// A length bigger than any message the receiver sends - the "frame" is noise
+#define UBX_MAX_LENGTH					1024
+
+/// Payload sizes
+#define UBX_NAV_PVT_SIZE				92
+#define UBX_NAV_DOP_SIZE				18
+#define UBX_NAV_TIMEUTC_SIZE			20
+#define UBX_TIM_TP_SIZE					16
+#define UBX_CFG_PRT_SIZE				20
+#define UBX_CFG_RATE_SIZE				6
+#define UBX_CFG_MSG_SIZE				3
+
+/// CFG-PRT mode - 8 bits, no parity, 1 stop bit
+#define UBX_CFG_PRT_MODE_8N1			0x000008D0
+
+enum
+{
+	UBX_SYNC1,							///< Waiting for 0xB5
+	UBX_SYNC2,
+	UBX_CLASS,
+	UBX_ID,
+	UBX_LEN1,
+	UBX_LEN2,
+	UBX_PAYLOAD,
+	UBX_CK_A,
+	UBX_CK_B,
+};
+
+/* -----------
+ *  Little-endian fields
+ * ----------*/
+static uint16_t ubx_u16(const uint8_t* p)
+{
+	return p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t ubx_u32(const uint8_t* p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void ubx_put16(uint8_t* p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void ubx_put32(uint8_t* p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* -----------
+ *  Parser
+ * ----------*/
+void app_ubx_init(app_ubx_parser_t* p)
+{
+	memset(p, 0, sizeof(*p));
+	p->state = UBX_SYNC1;
+}
+
+uint16_t app_ubx_parse_char(app_ubx_parser_t* p, uint8_t c)
+{
+	switch (p->state)
+	{
+		case UBX_SYNC1:
+			if (c == APP_UBX_SYNC1) p->state = UBX_SYNC2;
+			break;
+
+		case UBX_SYNC2:
+			// B5 B5 62 is still a frame
+			if (c == APP_UBX_SYNC2) p->state = UBX_CLASS;
+			else if (c != APP_UBX_SYNC1) p->state = UBX_SYNC1;
+			break;
+
+		case UBX_CLASS:
+			p->ck_a = p->ck_b = 0;
+			p->id = (uint16_t)c << 8;
+			p->state = UBX_ID;
+			break;
+
+		case UBX_ID:
+			p->id |= c;
+			p->state = UBX_LEN1;
+			break;
+
+		case UBX_LEN1:
+			p->len = c;
+			p->state = UBX_LEN2;
+			break;
+
+		case UBX_LEN2:
+			p->len |= (uint16_t)c << 8;
+			p->count = 0;
+			if (p->len > UBX_MAX_LENGTH)
+				p->state = UBX_SYNC1;
+			else
+				p->state = p->len ? UBX_PAYLOAD : UBX_CK_A;
+			break;
+
+		case UBX_PAYLOAD:
+			if (p->count < APP_UBX_MAX_PAYLOAD) p->payload[p->count] = c;
+			if (++p->count == p->len) p->state = UBX_CK_A;
+			break;
+
+		case UBX_CK_A:
+			p->state = (c == p->ck_a) ? UBX_CK_B : UBX_SYNC1;
+			if (p->state == UBX_SYNC1)
+			{
+				p->bad_xsum++;
+				// the bad byte may start the next frame
+				if (c == APP_UBX_SYNC1) p->state = UBX_SYNC2;
+			}
+			return APP_UBX_NONE;
+
+		case UBX_CK_B:
+			p->state = UBX_SYNC1;
+			if (c != p->ck_b)
+			{
+				p->bad_xsum++;
+				if (c == APP_UBX_SYNC1) p->state = UBX_SYNC2;
+			}
+			else if (p->len > APP_UBX_MAX_PAYLOAD)
+			{
+				p->too_long++;
+			}
+			else
+			{
+				p->good++;
+				return p->id;
+			}
+			return APP_UBX_NONE;
+	}
+
+	// the checksum runs from the class to the end of the payload
+	if (p->state > UBX_CLASS)
+	{
+		p->ck_a += c;
+		p->ck_b += p->ck_a;
+	}
+	return APP_UBX_NONE;
+}
+
+/* -----------
+ *  Decoders
+ * ----------*/
+bool app_ubx_nav_pvt(const app_ubx_parser_t* p, app_ubx_nav_pvt_t* pvt)
+{
+	const uint8_t* b = p->payload;
+
+	if (p->id != APP_UBX_NAV_PVT || p->len != UBX_NAV_PVT_SIZE)
+		return false;
+
+	pvt->itow = ubx_u32(&b[0]);
+	pvt->year = ubx_u16(&b[4]);
+	pvt->month = b[6];
+	pvt->day = b[7];
+	pvt->hour = b[8];
+	pvt->min = b[9];
+	pvt->sec = b[10];
+	pvt->valid = b[11];
+	pvt->t_acc = ubx_u32(&b[12]);
+	pvt->nano = (int32_t) ubx_u32(&b[16]);
+	pvt->fix_type = b[20];
+	pvt->flags = b[21];
+	pvt->num_sv = b[23];
+	pvt->longitude = (int32_t) ubx_u32(&b[24]);
+	pvt->latitude = (int32_t) ubx_u32(&b[28]);
+	pvt->height_mm = (int32_t) ubx_u32(&b[32]);
+	pvt->hmsl_mm = (int32_t) ubx_u32(&b[36]);
+	pvt->h_acc_mm = ubx_u32(&b[40]);
+	pvt->v_acc_mm = ubx_u32(&b[44]);
+	pvt->g_speed_mms = (int32_t) ubx_u32(&b[60]);
+	pvt->head_mot = (int32_t) ubx_u32(&b[64]);
+	pvt->pdop_c = ubx_u16(&b[76]);
+	return true;
+}
+
+bool app_ubx_nav_dop(const app_ubx_parser_t* p, app_ubx_nav_dop_t* dop)
+{
+	const uint8_t* b = p->payload;
+
+	if (p->id != APP_UBX_NAV_DOP || p->len != UBX_NAV_DOP_SIZE)
+		return false;
+
+	dop->itow = ubx_u32(&b[0]);
+	dop->pdop_c = ubx_u16(&b[6]);
+	dop->vdop_c = ubx_u16(&b[10]);
+	dop->hdop_c = ubx_u16(&b[12]);
+	return true;
+}
+
+bool app_ubx_nav_timeutc(const app_ubx_parser_t* p, app_ubx_nav_timeutc_t* utc)
+{
+	const uint8_t* b = p->payload;
+
+	if (p->id != APP_UBX_NAV_TIMEUTC || p->len != UBX_NAV_TIMEUTC_SIZE)
+		return false;
+
+	utc->itow = ubx_u32(&b[0]);
+	utc->t_acc = ubx_u32(&b[4]);
+	utc->nano = (int32_t) ubx_u32(&b[8]);
+	utc->year = ubx_u16(&b[12]);
+	utc->month = b[14];
+	utc->day = b[15];
+	utc->hour = b[16];
+	utc->min = b[17];
+	utc->sec = b[18];
+	utc->valid = b[19];
+	return true;
+}
+
+bool app_ubx_tim_tp(const app_ubx_parser_t* p, app_ubx_tim_tp_t* tp)
+{
+	const uint8_t* b = p->payload;
+
+	if (p->id != APP_UBX_TIM_TP || p->len != UBX_TIM_TP_SIZE)
+		return false;
+
+	tp->tow_ms = ubx_u32(&b[0]);
+	tp->tow_sub_ms = ubx_u32(&b[4]);
+	tp->q_err_ps = (int32_t) ubx_u32(&b[8]);
+	tp->week = ubx_u16(&b[12]);
+	tp->flags = b[14];
+	return true;
+}
+
+/* -----------
+ *  Builders
+ * ----------*/
+uint16_t app_ubx_frame(uint8_t* buf, uint16_t id, const uint8_t* payload, uint16_t len)
+{
+	uint8_t ck_a = 0, ck_b = 0;
+
+	buf[0] = APP_UBX_SYNC1;
+	buf[1] = APP_UBX_SYNC2;
+	buf[2] = id >> 8;
+	buf[3] = id;
+	ubx_put16(&buf[4], len);
+	if (len) memmove(&buf[APP_UBX_HDR_SIZE], payload, len);
+
+	for (int i=2; i<APP_UBX_HDR_SIZE + len; i++)
+	{
+		ck_a += buf[i];
+		ck_b += ck_a;
+	}
+	buf[APP_UBX_HDR_SIZE + len] = ck_a;
+	buf[APP_UBX_HDR_SIZE + len + 1] = ck_b;
+
+	return APP_UBX_HDR_SIZE + len + APP_UBX_XSUM_SIZE;
+}
+
+uint16_t app_ubx_cfg_prt(uint8_t* buf, uint32_t baud, uint16_t in_proto, uint16_t out_proto)
+{
+	uint8_t b[UBX_CFG_PRT_SIZE];
+
+	memset(b, 0, sizeof(b));
+	b[0] = 1;									// UART1
+	ubx_put32(&b[4], UBX_CFG_PRT_MODE_8N1);
+	ubx_put32(&b[8], baud);
+	ubx_put16(&b[12], in_proto);
+	ubx_put16(&b[14], out_proto);
+
+	return app_ubx_frame(buf, APP_UBX_CFG_PRT, b, sizeof(b));
+}
+
+uint16_t app_ubx_cfg_rate(uint8_t* buf, uint16_t meas_ms)
+{
+	uint8_t b[UBX_CFG_RATE_SIZE];
+
+	ubx_put16(&b[0], meas_ms);
+	ubx_put16(&b[2], 1);						// a solution per measurement
+	ubx_put16(&b[4], 1);						// aligned to GPS time
+
+	return app_ubx_frame(buf, APP_UBX_CFG_RATE, b, sizeof(b));
+}
+
+uint16_t app_ubx_cfg_msg(uint8_t* buf, uint16_t id, uint8_t rate)
+{
+	uint8_t b[UBX_CFG_MSG_SIZE];
+
+	b[0] = id >> 8;
+	b[1] = id;
+	b[2] = rate;
+
+	return app_ubx_frame(buf, APP_UBX_CFG_MSG, b, sizeof(b));
+}
+
+#ifdef UNIT_TEST
+#define CHECK(cond)		do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); errors++; } } while (0)
+
+static uint16_t parse(app_ubx_parser_t* p, const uint8_t* data, int len, int* frames)
+{
+	uint16_t id, last = APP_UBX_NONE;
+
+	*frames = 0;
+	while (len-- > 0)
+	{
+		if ((id = app_ubx_parse_char(p, *data++)) != APP_UBX_NONE)
+		{
+			last = id;
+			(*frames)++;
+		}
+	}
+	return last;
+}
+
+int main(void)
+{
+	app_ubx_parser_t p;
+	app_ubx_nav_pvt_t pvt;
+	app_ubx_nav_dop_t dop;
+	app_ubx_nav_timeutc_t utc;
+	app_ubx_tim_tp_t tp;
+	uint8_t frame[512], payload[256], stream[1024];
+	int errors = 0, n, len, frames;
+	uint32_t good;
+
+	// frames from the u-blox protocol spec
+	static const uint8_t rate_100ms[] = { 0xB5, 0x62, 0x06, 0x08, 0x06, 0x00, 0x64, 0x00, 0x01, 0x00, 0x01, 0x00, 0x7A, 0x12 };
+	static const uint8_t msg_pvt[] = { 0xB5, 0x62, 0x06, 0x01, 0x03, 0x00, 0x01, 0x07, 0x01, 0x13, 0x51 };
+	CHECK(app_ubx_cfg_rate(frame, 100) == sizeof(rate_100ms) && !memcmp(frame, rate_100ms, sizeof(rate_100ms)));
+	CHECK(app_ubx_cfg_msg(frame, APP_UBX_NAV_PVT, 1) == sizeof(msg_pvt) && !memcmp(frame, msg_pvt, sizeof(msg_pvt)));
+	CHECK(app_ubx_cfg_prt(frame, 115200, APP_UBX_PROTO_UBX | APP_UBX_PROTO_NMEA, APP_UBX_PROTO_UBX) == APP_UBX_MAX_CFG_FRAME);
+	CHECK(frame[14] == 0x00 && frame[15] == 0xC2 && frame[16] == 0x01 && frame[18] == 3 && frame[20] == 1);
+
+	// a NAV-PVT, among NMEA
+	memset(payload, 0, sizeof(payload));
+	payload[0] = 0x10; payload[1] = 0x27;				// iTOW 10000
+	payload[4] = 0xDE; payload[5] = 0x07;				// 2014
+	payload[6] = 1; payload[7] = 28; payload[8] = 20; payload[9] = 14; payload[10] = 26;
+	payload[11] = APP_UBX_PVT_VALID_DATE | APP_UBX_PVT_VALID_TIME;
+	payload[16] = 0x00; payload[17] = 0xE1; payload[18] = 0xF5; payload[19] = 0x05;	// 100 ms
+	payload[20] = APP_UBX_FIX_3D; payload[21] = APP_UBX_PVT_GNSS_FIX_OK; payload[23] = 9;
+	payload[24] = 0xA7; payload[25] = 0xAB; payload[26] = 0x20; payload[27] = 0x5A;	// 1512090535
+	payload[28] = 0x21; payload[29] = 0x37; payload[30] = 0xDA; payload[31] = 0xEB;	// -338020575
+	payload[36] = 0x20; payload[37] = 0x4E;				// 20 m
+	payload[60] = 0xE8; payload[61] = 0x03;				// 1 m/s
+	payload[64] = 0x40; payload[65] = 0x4B; payload[66] = 0x4C; payload[67] = 0x00;	// 50 degrees
+	payload[76] = 150;
+	len = strlen(strcpy((char*) stream, "$GPTXT,01,01,02,u-blox*xx\r\n\xB5\xB5"));
+	len += app_ubx_frame(&stream[len], APP_UBX_NAV_PVT, payload, 92);
+	app_ubx_init(&p);
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_NAV_PVT && frames == 1);
+	CHECK(app_ubx_nav_pvt(&p, &pvt));
+	CHECK(pvt.itow == 10000 && pvt.year == 2014 && pvt.month == 1 && pvt.day == 28);
+	CHECK(pvt.hour == 20 && pvt.min == 14 && pvt.sec == 26 && pvt.nano == 100000000);
+	CHECK(pvt.fix_type == APP_UBX_FIX_3D && pvt.num_sv == 9 && pvt.flags == APP_UBX_PVT_GNSS_FIX_OK);
+	CHECK(pvt.longitude == 1512090535 && pvt.latitude == -338020575 && pvt.hmsl_mm == 20000);
+	CHECK(pvt.g_speed_mms == 1000 && pvt.head_mot == 5000000 && pvt.pdop_c == 150);
+	CHECK(!app_ubx_nav_timeutc(&p, &utc) && !app_ubx_tim_tp(&p, &tp) && !app_ubx_nav_dop(&p, &dop));
+
+	// a NAV-DOP, HDOP from its own field and not PDOP
+	memset(payload, 0, sizeof(payload));
+	payload[0] = 0x10; payload[1] = 0x27;				// iTOW 10000
+	payload[6] = 150; payload[10] = 120; payload[12] = 90;
+	len = app_ubx_frame(stream, APP_UBX_NAV_DOP, payload, 18);
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_NAV_DOP && app_ubx_nav_dop(&p, &dop));
+	CHECK(dop.itow == 10000 && dop.pdop_c == 150 && dop.vdop_c == 120 && dop.hdop_c == 90);
+	CHECK(!app_ubx_nav_pvt(&p, &pvt));
+
+	// TIM-TP and NAV-TIMEUTC back to back
+	memset(payload, 0, sizeof(payload));
+	payload[0] = 0x20; payload[1] = 0x4E; payload[8] = 0x9C; payload[9] = 0xFF; payload[10] = 0xFF; payload[11] = 0xFF;
+	payload[12] = 0x1B; payload[13] = 0x07;
+	len = app_ubx_frame(stream, APP_UBX_TIM_TP, payload, 16);
+	memset(payload, 0, sizeof(payload));
+	payload[12] = 0xDE; payload[13] = 0x07; payload[14] = 1; payload[15] = 28; payload[19] = 0x07;
+	n = app_ubx_frame(&stream[len], APP_UBX_NAV_TIMEUTC, payload, 20);
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_TIM_TP && app_ubx_tim_tp(&p, &tp));
+	CHECK(tp.tow_ms == 20000 && tp.q_err_ps == -100 && tp.week == 1819 && tp.flags == 0);
+	CHECK(parse(&p, &stream[len], n, &frames) == APP_UBX_NAV_TIMEUTC && app_ubx_nav_timeutc(&p, &utc));
+	CHECK(utc.year == 2014 && utc.month == 1 && utc.day == 28 && utc.valid == 7);
+
+	// what isn't taken: a bad checksum, a frame too big to keep, a silly length
+	good = p.good;
+	len = app_ubx_frame(stream, APP_UBX_NAV_PVT, payload, 92);
+	stream[len - 1] ^= 1;
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_NONE && p.bad_xsum == 1);
+	len = app_ubx_frame(stream, APP_UBX_ID(0x01, 0x35), payload, 200);
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_NONE && p.too_long == 1);
+	len = app_ubx_frame(stream, APP_UBX_ID(0x01, 0x35), payload, 0);
+	stream[5] = 0xFF;
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_NONE);
+	CHECK(p.good == good);
+
+	// and it picks up after them
+	len = app_ubx_cfg_msg(stream, APP_UBX_TIM_TP, 1);
+	CHECK(parse(&p, stream, len, &frames) == APP_UBX_CFG_MSG && p.len == 3 && p.payload[0] == 0x0D);
+
+	printf("Done - %d errors\n", errors);
+	return errors != 0;
+}
+#endif // UNIT_TEST
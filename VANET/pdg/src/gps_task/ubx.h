@@ -0,0 +1,225 @@
+/**
+ *	@file	ubx.h
+ *
+ *	@brief	u-blox UBX binary protocol
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef UBX_H
+#define UBX_H
+
+/**
+ * A UBX frame is two sync characters, a class, an id, a little-endian 16 bit
+ * payload length, the payload, and an 8 bit Fletcher checksum (two bytes) over
+ * everything from the class to the end of the payload:
+ *
+ *    | 0xB5 | 0x62 | Class | Id | Length (2) | Payload ... | CK_A | CK_B |
+ *
+ * The parser takes a byte at a time, like the NMEA parser, and keeps the
+ * payload of the frame being received.  Frames with payloads bigger than we
+ * keep are checked and counted, but not returned.
+ */
+
+/// Class and id packed into the 16 bit message id
+#define APP_UBX_ID(cls, id)				(((uint16_t)(cls) << 8) | (id))
+
+/// Messages we send or parse
+enum
+{
+	APP_UBX_NONE		= 0,
+	APP_UBX_NAV_DOP		= APP_UBX_ID(0x01, 0x04),
+	APP_UBX_NAV_PVT		= APP_UBX_ID(0x01, 0x07),
+	APP_UBX_NAV_TIMEUTC	= APP_UBX_ID(0x01, 0x21),
+	APP_UBX_ACK_NAK		= APP_UBX_ID(0x05, 0x00),
+	APP_UBX_ACK_ACK		= APP_UBX_ID(0x05, 0x01),
+	APP_UBX_CFG_PRT		= APP_UBX_ID(0x06, 0x00),
+	APP_UBX_CFG_MSG		= APP_UBX_ID(0x06, 0x01),
+	APP_UBX_CFG_RATE	= APP_UBX_ID(0x06, 0x08),
+	APP_UBX_TIM_TP		= APP_UBX_ID(0x0D, 0x01),
+};
+
+/// Sync characters, header (sync to length) and checksum sizes
+#define APP_UBX_SYNC1					0xB5
+#define APP_UBX_SYNC2					0x62
+#define APP_UBX_HDR_SIZE				6
+#define APP_UBX_XSUM_SIZE				2
+
+/// Largest payload kept - NAV-PVT is 92
+#define APP_UBX_MAX_PAYLOAD				100
+
+/// Largest frame we build
+#define APP_UBX_MAX_CFG_FRAME			(APP_UBX_HDR_SIZE + 20 + APP_UBX_XSUM_SIZE)
+
+/// CFG-PRT protocol mask bits
+enum
+{
+	APP_UBX_PROTO_UBX			= 0x0001,
+	APP_UBX_PROTO_NMEA			= 0x0002,
+};
+
+/// NAV-PVT valid bits
+enum
+{
+	APP_UBX_PVT_VALID_DATE		= 0x01,
+	APP_UBX_PVT_VALID_TIME		= 0x02,
+	APP_UBX_PVT_FULLY_RESOLVED	= 0x04,
+};
+
+/// NAV-PVT flags bits
+enum
+{
+	APP_UBX_PVT_GNSS_FIX_OK		= 0x01,
+};
+
+/// NAV-PVT fix types
+enum
+{
+	APP_UBX_FIX_NONE			= 0,
+	APP_UBX_FIX_DR,
+	APP_UBX_FIX_2D,
+	APP_UBX_FIX_3D,
+	APP_UBX_FIX_GNSS_DR,
+	APP_UBX_FIX_TIME,
+};
+
+/// NAV-TIMEUTC valid bits
+enum
+{
+	APP_UBX_TIMEUTC_VALID_TOW	= 0x01,
+	APP_UBX_TIMEUTC_VALID_WKN	= 0x02,
+	APP_UBX_TIMEUTC_VALID_UTC	= 0x04,
+};
+
+/// TIM-TP flags bits
+enum
+{
+	APP_UBX_TP_TIMEBASE_UTC		= 0x01,
+};
+
+/// NAV-PVT - navigation solution, the fields we use
+typedef struct
+{
+	uint32_t	itow;					///< GPS time of week of the solution, ms
+	uint16_t	year;					///< UTC
+	uint8_t		month;					///< 1..12
+	uint8_t		day;					///< 1..31
+	uint8_t		hour;
+	uint8_t		min;
+	uint8_t		sec;
+	uint8_t		valid;					///< APP_UBX_PVT_VALID_xxx
+	uint32_t	t_acc;					///< Time accuracy, ns
+	int32_t		nano;					///< Fraction of the second, ns (may be negative)
+	uint8_t		fix_type;				///< APP_UBX_FIX_xxx
+	uint8_t		flags;					///< APP_UBX_PVT_GNSS_FIX_OK ...
+	uint8_t		num_sv;					///< Satellites used in the solution
+	int32_t		longitude;				///< degrees * VANET_API_GPS_LOC_MULTIPLIER (1e-7)
+	int32_t		latitude;				///< degrees * VANET_API_GPS_LOC_MULTIPLIER (1e-7)
+	int32_t		height_mm;				///< above the ellipsoid
+	int32_t		hmsl_mm;				///< above mean sea level
+	uint32_t	h_acc_mm;				///< horizontal accuracy
+	uint32_t	v_acc_mm;				///< vertical accuracy
+	int32_t		g_speed_mms;			///< ground speed, mm/s
+	int32_t		head_mot;				///< heading of motion, degrees * 1e5
+	uint16_t	pdop_c;					///< PDOP * 100
+} app_ubx_nav_pvt_t;
+
+/// NAV-DOP - dilution of precision, the fields we use
+typedef struct
+{
+	uint32_t	itow;					///< GPS time of week of the solution, ms
+	uint16_t	pdop_c;					///< Position DOP * 100
+	uint16_t	vdop_c;					///< Vertical DOP * 100
+	uint16_t	hdop_c;					///< Horizontal DOP * 100
+} app_ubx_nav_dop_t;
+
+/// NAV-TIMEUTC - UTC time
+typedef struct
+{
+	uint32_t	itow;					///< GPS time of week, ms
+	uint32_t	t_acc;					///< Time accuracy, ns
+	int32_t		nano;					///< Fraction of the second, ns (may be negative)
+	uint16_t	year;
+	uint8_t		month;					///< 1..12
+	uint8_t		day;					///< 1..31
+	uint8_t		hour;
+	uint8_t		min;
+	uint8_t		sec;
+	uint8_t		valid;					///< APP_UBX_TIMEUTC_VALID_xxx
+} app_ubx_nav_timeutc_t;
+
+/// TIM-TP - the time of the next time pulse
+typedef struct
+{
+	uint32_t	tow_ms;					///< Time of week of the pulse, ms
+	uint32_t	tow_sub_ms;				///< Fraction of the ms, ms * 2^-32
+	int32_t		q_err_ps;				///< Quantization error of the pulse, ps
+	uint16_t	week;					///< Week number of the pulse
+	uint8_t		flags;					///< APP_UBX_TP_TIMEBASE_UTC ...
+} app_ubx_tim_tp_t;
+
+/// Parser state
+typedef struct
+{
+	uint8_t		state;
+	uint8_t		ck_a;					///< Running checksum
+	uint8_t		ck_b;
+	uint16_t	id;						///< APP_UBX_ID() of the frame being received
+	uint16_t	len;					///< Its payload length
+	uint16_t	count;					///< Payload bytes received
+	uint8_t		payload[APP_UBX_MAX_PAYLOAD];	///< The last good frame's, or the one being received
+	uint32_t	good;					///< Frames returned
+	uint32_t	bad_xsum;				///< Frames with a wrong checksum
+	uint32_t	too_long;				///< Good frames too big to keep
+} app_ubx_parser_t;
+
+/// Reset a parser
+extern void app_ubx_init(app_ubx_parser_t* p);
+
+/**
+ * Parse a byte
+ *
+ * @param p The parser
+ * @param c The byte
+ * @return The frame's APP_UBX_ID() when c ends a good frame (p->payload and
+ *         p->len have it), else APP_UBX_NONE
+ */
+extern uint16_t app_ubx_parse_char(app_ubx_parser_t* p, uint8_t c);
+
+/// Decode the frame just returned.  False if its length is wrong
+extern bool app_ubx_nav_pvt(const app_ubx_parser_t* p, app_ubx_nav_pvt_t* pvt);
+extern bool app_ubx_nav_dop(const app_ubx_parser_t* p, app_ubx_nav_dop_t* dop);
+extern bool app_ubx_nav_timeutc(const app_ubx_parser_t* p, app_ubx_nav_timeutc_t* utc);
+extern bool app_ubx_tim_tp(const app_ubx_parser_t* p, app_ubx_tim_tp_t* tp);
+
+/**
+ * Build a frame
+ *
+ * @param buf Where to build it - len + APP_UBX_HDR_SIZE + APP_UBX_XSUM_SIZE bytes
+ * @param id APP_UBX_ID() of the message
+ * @param payload The payload (may be NULL if len is 0)
+ * @param len Its length
+ * @return The frame's length
+ */
+extern uint16_t app_ubx_frame(uint8_t* buf, uint16_t id, const uint8_t* payload, uint16_t len);
+
+/// CFG-PRT for UART1 - 8N1 at baud, with the protocol masks (APP_UBX_PROTO_xxx)
+extern uint16_t app_ubx_cfg_prt(uint8_t* buf, uint32_t baud, uint16_t in_proto, uint16_t out_proto);
+
+/// CFG-RATE - a navigation solution every meas_ms, aligned to GPS time
+extern uint16_t app_ubx_cfg_rate(uint8_t* buf, uint16_t meas_ms);
+
+/// CFG-MSG - output message id once every rate solutions on this port (0 is off)
+extern uint16_t app_ubx_cfg_msg(uint8_t* buf, uint16_t id, uint8_t rate);
+
+#endif // UBX_H
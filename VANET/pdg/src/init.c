@@ -32,4 +32,7 @@ void board_init(void)
 	
 	// Initialize PDG Task
 	app_pdg_task_init();
+	
+	// Initialize Event Recorder Task
+	app_rec_task_init();
 }
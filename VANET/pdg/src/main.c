@@ -39,6 +39,7 @@ void App_TCBInitHook (OS_TCB *ptcb)
 #ifndef CONFIG_BSP_ENABLE_OSTRACKER
 void App_TaskSwHook(void)
 {
+    bsp_rtc_tick_resume();
 }
 #endif
 void App_TaskCreateHook (OS_TCB *ptcb)
@@ -84,8 +84,12 @@ static void cmd_accelerometer(uint8_t grp, uint8_t opcode, const uint8_t* payloa
 		accel.bandwidth = out.b;
 		accel.range = out.r;
 		accel.threshold = out.th;
+		accel.x_gyro = out.gx;
+		accel.y_gyro = out.gy;
+		accel.z_gyro = out.gz;
+		accel.gyro_range = out.dps;
 		
-		app_pdg_send_msg(grp, opcode, (const uint8_t *)&accel, 12);
+		app_pdg_send_msg(grp, opcode, (const uint8_t *)&accel, sizeof(accel));
 	}
 	else if (opcode == VANET_OP_ACCELEROMETER_SET_MOVEMENT_THRESHOLD)
 	{
@@ -126,6 +130,45 @@ static void cmd_accelerometer(uint8_t grp, uint8_t opcode, const uint8_t* payloa
 		app_accel_write_range(payload[0]);
 		app_pdg_send_msg(grp, opcode, 0, 0);
 	}
+	else if (opcode == VANET_OP_ACCELEROMETER_SET_DETECTOR)
+	{
+		/*
+			Byte 0 - State machine
+			Byte 1 - Detector
+			Byte 2.. - Thresholds and times, or a program
+		*/
+		app_accel_detector_t d;
+		bool ok = payload_len >= 2;
+		
+		memset(&d, 0, sizeof(d));
+		d.kind = ok ? payload[1] : VANET_API_ACCEL_DETECT_OFF;
+		if (d.kind == VANET_API_ACCEL_DETECT_PROGRAM)
+		{
+			ok = payload_len >= 2 + VANET_API_ACCEL_PROGRAM_SIZE;
+			if (ok) memcpy(d.program, &payload[2], VANET_API_ACCEL_PROGRAM_SIZE);
+		}
+		else if (d.kind != VANET_API_ACCEL_DETECT_OFF)
+		{
+			ok = payload_len >= 10;
+			if (ok)
+			{
+				d.thresh1_mg = read16(payload, 2);
+				d.time1_ms = read16(payload, 4);
+				d.thresh2_mg = read16(payload, 6);
+				d.time2_ms = read16(payload, 8);
+			}
+		}
+		
+		if (ok && app_accel_set_detector(payload[0], &d))
+		{
+			app_pdg_send_msg(grp, opcode, 0, 0);
+		}
+		else
+		{
+			static const char msg[] = "Detector won't run";
+			app_pdg_send_msg(VANET_GRP_ERROR, VANET_OP_ERROR, (const uint8_t*) msg, sizeof(msg));
+		}
+	}
 	else if (opcode == VANET_OP_ACCELEROMETER_RESET)
 	{
 		app_accel_init_dev();												// reset all registers
@@ -140,6 +183,7 @@ static const struct { uint16_t key; void (*handler)(uint8_t,uint8_t,const uint8_
     { CMDKEY(VANET_GRP_GENERAL, VANET_OP_SET_BUZZER_START), cmd_buzzer },
     { CMDKEY(VANET_GRP_GENERAL, VANET_OP_SET_BUZZER_STOP), cmd_buzzer },
     { CMDKEY(VANET_GRP_GPS, VANET_OP_GET_GPS_STATE), app_gps_cmd_get_state },
+    { CMDKEY(VANET_GRP_GPS, VANET_OP_GPS_SUBSCRIBE), app_gps_cmd_subscribe },
 	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_QUERY), cmd_accelerometer },
 	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_SET_MOVEMENT_THRESHOLD), cmd_accelerometer },
 	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_SET_BANDWIDTH), cmd_accelerometer },
@@ -147,6 +191,11 @@ static const struct { uint16_t key; void (*handler)(uint8_t,uint8_t,const uint8_
 	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_REGISTER_READ), cmd_accelerometer },
 	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_REGISTER_WRITE), cmd_accelerometer },
 	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_RESET), cmd_accelerometer },
+	{ CMDKEY(VANET_GRP_ACCEL, VANET_OP_ACCELEROMETER_SET_DETECTOR), cmd_accelerometer },
+    { CMDKEY(VANET_GRP_RECORDER, VANET_OP_RECORDER_LIST), app_rec_cmd },
+    { CMDKEY(VANET_GRP_RECORDER, VANET_OP_RECORDER_READ), app_rec_cmd },
+    { CMDKEY(VANET_GRP_RECORDER, VANET_OP_RECORDER_CONFIG), app_rec_cmd },
+    { CMDKEY(VANET_GRP_RECORDER, VANET_OP_RECORDER_TRIGGER), app_rec_cmd },
     { 0, 0 }
 };
 
@@ -158,13 +207,23 @@ void app_pdg_cmd_init(void)
 
 void app_pdg_send_msg(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len)
 {
-    uint8_t hdr[4];
-    hdr[0] = grp;
-    hdr[1] = opcode;
-    hdr[2] = (uint8_t) ((payload_len >> 8) & 0xff);
-    hdr[3] = (uint8_t) (payload_len & 0xff);
-    bsp_mux_send(VANET_MUXCH_UNIFIED, hdr, 4);
-    if (payload) bsp_mux_send(VANET_MUXCH_UNIFIED, payload, payload_len);
+    // events come from other tasks than the responses - a message that fits
+    // goes as one send so another can't land between its header and payload
+    uint8_t msg[64];
+    msg[0] = grp;
+    msg[1] = opcode;
+    msg[2] = (uint8_t) ((payload_len >> 8) & 0xff);
+    msg[3] = (uint8_t) (payload_len & 0xff);
+    if (payload && payload_len <= sizeof(msg) - 4)
+    {
+        memcpy(&msg[4], payload, payload_len);
+        bsp_mux_send(VANET_MUXCH_UNIFIED, msg, 4 + payload_len);
+    }
+    else
+    {
+        bsp_mux_send(VANET_MUXCH_UNIFIED, msg, 4);
+        if (payload) bsp_mux_send(VANET_MUXCH_UNIFIED, payload, payload_len);
+    }
 }
 
 static void exec_cmd(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len)
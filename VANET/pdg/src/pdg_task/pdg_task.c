@@ -215,12 +215,12 @@ static void pdg_task(void *p_arg)
 	}
 }			
 
-void app_pdg_accelerometer_event(void)
+void app_pdg_accelerometer_event(uint8_t fired)
 {			
 #ifdef CONFIG_BSP_ENABLE_ALERT
 	bsp_alert(BSP_ALERT_CRASH);
 #endif
-	app_pdg_send_msg(VANET_GRP_BUTTON_EVENT, VANET_OP_MOTION_INTERRUPT, 0, 0);
+	app_pdg_send_msg(VANET_GRP_BUTTON_EVENT, VANET_OP_MOTION_INTERRUPT, &fired, 1);
 }
 
 
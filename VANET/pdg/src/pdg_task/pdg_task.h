@@ -23,7 +23,7 @@
 void app_pdg_task_init(void);
 
 // Functions to make access to the VANET API easier
-void app_pdg_accelerometer_event(void);
+void app_pdg_accelerometer_event(uint8_t fired);
 void app_pdg_button_event(uint8_t button, uint8_t state);
 
 #endif // PDG_TASK_H
\ No newline at end of file
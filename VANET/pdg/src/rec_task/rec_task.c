@@ -0,0 +1,754 @@
+/**
+ *	@file	rec_task.c
+ *
+ *	@brief	Event Recorder Task
+ *
+ *	While the recorder runs, every accelerometer block and GPS fix goes into a
+ *	ring in RAM as a record in the format of vanet_api.h.  A trigger waits out
+ *	the post-trigger window, then the records from the start of the
+ *	pre-trigger window on are written to a slot in internal flash, a page a
+ *	tick so the sensors' tasks never wait on it.  The slot's header page is
+ *	erased first and written last - a slot without one holds no recording.
+ *
+ *	The blocks are the accelerometer task's own messages, shared with the raw
+ *	channel's stream: nothing is copied until they reach this task.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "vanet.h"
+#include "vanet_api.h"
+#include "pdg_cmd.h"
+
+/// Records in RAM - all of HRAMC0, which nothing else uses.  A power of two so the positions can run on past 4G
+#define REC_RING_SIZE				4096
+#define REC_RING_MASK				(REC_RING_SIZE - 1)
+
+#define REC_MAGIC					0x56524543		// "VREC"
+
+/// Where the codeplug leaves them at 0xffff - the ring holds this at 400 Hz
+#define REC_DEFAULT_PRE_MS			1000
+#define REC_DEFAULT_POST_MS			250
+
+/// The accelerometer's blocks until the first one comes in
+#define REC_DEFAULT_RATE_HZ			400
+#define REC_DEFAULT_BLOCK			16
+#define REC_DEFAULT_TRIGGERS		(VANET_API_REC_TRIGGER_RUN | VANET_API_REC_TRIGGER_SM1 | VANET_API_REC_TRIGGER_SM2)
+
+#define REC_CONFIG_SIZE				5
+
+/// Programming a page that doesn't read back, before the recording is given up
+#define REC_WRITE_TRIES				3
+
+/// A slot's first page, written last
+typedef struct
+{
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t seq_inv;				// ~seq
+	uint32_t length;				// of the records in the pages after this one
+	uint32_t trigger_us;			// on the records' clock
+	uint32_t utc_s;
+	uint32_t utc_us;
+	uint16_t pre_ms;
+	uint16_t post_ms;
+	uint8_t cause;
+	uint8_t flags;
+	uint16_t xsum;					// bsp_util_fletcher16() of the records, as copied from the ring
+} rec_header_t;
+
+/// What the recorder is doing with the ring
+enum
+{
+	REC_IDLE,						// keeping the window, or stopped
+	REC_TRIGGERED,					// waiting out the post-trigger window
+	REC_WRITING,					// a page a tick - records from s_pos on may not be dropped
+};
+
+static OS_STK s_app_rec_task_stack[TASK_REC_STACK_SIZE];
+static void rec_task(void* p_arg);
+static OS_EVENT* s_msg_flag;
+static void *s_msg_queue[16];
+static bsp_tkvs_timer_t s_post_timer;
+
+static uint8_t s_triggers;			// VANET_API_REC_TRIGGER_xxx
+static uint16_t s_pre_ms;			// what the ring holds of the window asked for
+static uint16_t s_post_ms;
+static uint16_t s_want_pre_ms;		// as configured
+static uint16_t s_want_post_ms;
+static uint16_t s_rate_hz;			// of the accelerometer's blocks, and how many samples to one
+static uint8_t s_block_count;
+static volatile bool s_armed;		// VANET_API_REC_TRIGGER_RUN, as app_rec_armed() tells the accelerometer task
+
+__attribute__((__section__(".bss_hram0")))
+static uint8_t s_ring[REC_RING_SIZE];
+static uint32_t s_head;				// where the next record goes
+static uint32_t s_tail;				// the oldest record
+
+static uint8_t s_state;
+static bool s_gap;					// a record was dropped because the recording being written held the ring
+static rec_header_t s_hdr;			// of the recording being taken
+static uint8_t s_slot;				// and where it goes
+static uint8_t s_page;				// the next page of the slot to write, 0 for the erase of the header
+static uint8_t s_tries;				// at programming it
+static uint32_t s_pos;				// the next record byte to write
+static uint32_t s_end;
+static uint32_t s_seq;				// of the newest recording in flash
+static uint32_t s_tick;				// of the last page written or chunk sent
+static uint8_t s_page_buf[AVR32_FLASHC_PAGE_SIZE];
+
+/// The Read Recording being sent
+static struct
+{
+	bool active;
+	uint8_t slot;
+	uint32_t seq;					// a different one in the slot ends it
+	uint32_t pos;
+	uint32_t end;
+} s_read;
+
+/// A Read Recording response, header and all - one send, so an event can't land inside it
+static uint8_t s_chunk[sizeof(vanet_api_hdr_t) + 4 + VANET_API_REC_CHUNK];
+
+static uint8_t* put16(uint8_t* p, uint16_t v)
+{
+	*p++ = v >> 8;
+	*p++ = v;
+	return p;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v)
+{
+	p = put16(p, v >> 16);
+	return put16(p, v);
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return ((uint32_t) get16(p) << 16) | get16(p + 2);
+}
+
+static const rec_header_t* rec_slot(uint8_t slot)
+{
+	return (const rec_header_t*) (APP_REC_FLASH_ADDRESS + slot * APP_REC_SLOT_SIZE);
+}
+
+static const uint8_t* rec_slot_data(uint8_t slot)
+{
+	return (const uint8_t*) rec_slot(slot) + AVR32_FLASHC_PAGE_SIZE;
+}
+
+static bool rec_slot_valid(const rec_header_t* h)
+{
+	return h->magic == REC_MAGIC && h->seq == ~h->seq_inv && h->length <= APP_REC_MAX_LENGTH;
+}
+
+/// A List Recordings entry
+static uint8_t* rec_entry(uint8_t* p, uint8_t slot, const rec_header_t* h)
+{
+	*p++ = slot;
+	*p++ = h->cause;
+	*p++ = h->flags;
+	*p++ = 0;
+	p = put32(p, h->seq);
+	p = put32(p, h->utc_s);
+	p = put32(p, h->utc_us);
+	p = put32(p, h->trigger_us);
+	p = put32(p, h->length);
+	p = put16(p, h->pre_ms);
+	p = put16(p, h->post_ms);
+	return put16(p, h->xsum);
+}
+
+static void rec_error(const char* msg)
+{
+	app_pdg_send_msg(VANET_GRP_ERROR, VANET_OP_ERROR, (const uint8_t*) msg, strlen(msg) + 1);
+}
+
+static uint8_t ring_byte(uint32_t pos)
+{
+	return s_ring[pos & REC_RING_MASK];
+}
+
+static uint32_t ring_next(uint32_t pos)
+{
+	return pos + 2 + ring_byte(pos + 1);
+}
+
+/// A record's time - the same place in both
+static uint32_t ring_time(uint32_t pos)
+{
+	return ((uint32_t) ring_byte(pos + 2) << 24) | ((uint32_t) ring_byte(pos + 3) << 16) |
+		   ((uint32_t) ring_byte(pos + 4) << 8) | ring_byte(pos + 5);
+}
+
+static void ring_write(const uint8_t* src, uint16_t len)
+{
+	while (len--)
+		s_ring[s_head++ & REC_RING_MASK] = *src++;
+}
+
+static void ring_read(uint32_t pos, uint8_t* dst, uint16_t len)
+{
+	while (len--)
+		*dst++ = s_ring[pos++ & REC_RING_MASK];
+}
+
+/// Drop the oldest records until len more fit - false if the recording being written holds them
+static bool ring_room(uint16_t len)
+{
+	uint32_t next;
+
+	while (s_head + len - s_tail > REC_RING_SIZE)
+	{
+		next = ring_next(s_tail);
+		if (s_state == REC_WRITING && (int32_t) (next - s_pos) > 0)
+		{
+			s_gap = true;
+			return false;
+		}
+		s_tail = next;
+	}
+	return true;
+}
+
+/// Cut the window to what the ring holds at the accelerometer's rate, the pre-trigger part first
+static void rec_window(void)
+{
+	// the samples, their blocks' headers and a GPS fix a second - less the record on its way out of the ring
+	uint32_t per_s = (uint32_t) s_rate_hz * 6 + (s_rate_hz / s_block_count + 1) * VANET_API_REC_ACCEL_HDR_SIZE +
+					 VANET_API_REC_GPS_SIZE;
+	uint32_t ms = (REC_RING_SIZE - VANET_API_REC_ACCEL_HDR_SIZE - APP_ACCEL_BLOCK_MAX * 6) * 1000 / per_s;
+
+	s_post_ms = min(s_want_post_ms, ms);
+	s_pre_ms = min(s_want_pre_ms, ms - s_post_ms);
+}
+
+static void rec_accel(const app_accel_block_t* block)
+{
+	uint8_t rec[VANET_API_REC_ACCEL_HDR_SIZE];
+	uint16_t len = VANET_API_REC_ACCEL_HDR_SIZE + block->count * 6;
+	uint8_t* p;
+	int i;
+
+	if (block->rate_hz != s_rate_hz && block->rate_hz && block->count)
+	{
+		s_rate_hz = block->rate_hz;
+		s_block_count = block->count;
+		rec_window();
+		bsp_logcat_printf(BSP_LOGCAT_INFO, "Recorder: %u Hz, %u ms before, %u ms after", s_rate_hz, s_pre_ms, s_post_ms);
+	}
+
+	if (!ring_room(len))
+		return;
+
+	rec[0] = VANET_API_REC_ACCEL;
+	rec[1] = len - 2;
+	put32(&rec[2], (uint32_t) block->time_us);
+	put16(&rec[6], block->rate_hz);
+	rec[8] = block->range;
+	rec[9] = block->count;
+	rec[10] = block->overrun ? VANET_API_ACCEL_OVERRUN : 0;
+	rec[11] = 0;
+	ring_write(rec, sizeof(rec));
+
+	for (i=0; i<block->count; i++)
+	{
+		p = put16(rec, block->xyz[i].x);
+		p = put16(p, block->xyz[i].y);
+		put16(p, block->xyz[i].z);
+		ring_write(rec, 6);
+	}
+}
+
+static void rec_gps(const app_gps_fix_t* fix)
+{
+	uint8_t rec[VANET_API_REC_GPS_SIZE];
+	uint8_t* p;
+
+	if (!ring_room(sizeof(rec)))
+		return;
+
+	rec[0] = VANET_API_REC_GPS;
+	rec[1] = sizeof(rec) - 2;
+	put32(&rec[2], (uint32_t) fix->time_us);
+	rec[6] = fix->state.flags;
+	rec[7] = fix->state.satellites;
+	p = put32(&rec[8], fix->state.latitude);
+	p = put32(p, fix->state.longitude);
+	p = put16(p, fix->state.altitude);
+	p = put16(p, fix->speed_cms);
+	put16(p, fix->state.direction);
+	ring_write(rec, sizeof(rec));
+}
+
+/// Feed the ring from the accelerometer and GPS tasks while it runs
+static void rec_subscribe(bool on)
+{
+	bsp_tkvs_unsubscribe(APP_TKVS_ACCEL_TASK, s_msg_flag);
+	bsp_tkvs_unsubscribe(APP_TKVS_GPS_TASK, s_msg_flag);
+	if (on)
+	{
+		bsp_tkvs_subscribe(APP_TKVS_ACCEL_TASK, APP_ACCEL_EVENT_SAMPLES | APP_ACCEL_EVENT_FIRED, s_msg_flag, TASK_REC_PRIO);
+		bsp_tkvs_subscribe(APP_TKVS_GPS_TASK, APP_GPS_EVENT_FIX, s_msg_flag, TASK_REC_PRIO);
+	}
+}
+
+static void rec_config(const uint8_t* config)
+{
+	bool armed = (config[0] & VANET_API_REC_TRIGGER_RUN) != 0;
+
+	s_triggers = config[0];
+	s_want_pre_ms = get16(&config[1]);
+	s_want_post_ms = get16(&config[3]);
+	rec_window();
+
+	if (armed != s_armed)
+	{
+		// what was there from before is too old to be a window
+		if (armed && s_state == REC_IDLE)
+			s_tail = s_head;
+
+		s_armed = armed;
+		rec_subscribe(armed);
+		bsp_tkvs_publish_immed(APP_TKVS_REC_TASK, APP_REC_EVENT_ARMED, armed);
+	}
+	bsp_logcat_printf(BSP_LOGCAT_INFO, "Recorder: triggers %02x, %u ms before, %u ms after", s_triggers, s_pre_ms, s_post_ms);
+}
+
+/// A Configure Recorder response - the configuration in use
+static void rec_send_config(void)
+{
+	uint8_t config[REC_CONFIG_SIZE];
+
+	config[0] = s_triggers;
+	put16(&config[1], s_pre_ms);
+	put16(&config[3], s_post_ms);
+	app_pdg_send_msg(VANET_GRP_RECORDER, VANET_OP_RECORDER_CONFIG, config, sizeof(config));
+}
+
+static void rec_trigger(uint8_t cause)
+{
+	uint64_t cycles, utc_us;
+
+	if (s_state != REC_IDLE)
+	{
+		s_hdr.cause |= cause;
+		return;
+	}
+
+	cycles = bsp_rtc_get_cycles();
+	utc_us = bsp_rtc_get_utc_ns_at(cycles) / 1000;
+
+	memset(&s_hdr, 0, sizeof(s_hdr));
+	s_hdr.trigger_us = (uint32_t) bsp_rtc_get_time_us_at(cycles);
+	s_hdr.utc_s = (uint32_t) (utc_us / 1000000);
+	s_hdr.utc_us = (uint32_t) (utc_us % 1000000);
+	s_hdr.pre_ms = s_pre_ms;
+	s_hdr.post_ms = s_post_ms;
+	s_hdr.cause = cause;
+	s_gap = false;
+	s_state = REC_TRIGGERED;
+
+	bsp_tkvs_set_timer(&s_post_timer, max(1, BSP_TKVS_TIMER_MS_TO_TICKS(s_post_ms)));
+	bsp_tkvs_start_timer(&s_post_timer);
+	bsp_logcat_printf(BSP_LOGCAT_INFO, "Recorder: triggered (%02x)", cause);
+}
+
+/// The post-trigger window is over - freeze the recording and pick its slot
+static void rec_start_write(void)
+{
+	uint32_t from = s_hdr.trigger_us - (uint32_t) s_hdr.pre_ms * 1000;
+	const rec_header_t* h;
+	uint32_t oldest = 0;
+	int i;
+
+	// the first record in the pre-trigger window, and no more than a slot holds
+	s_pos = s_tail;
+	while (s_pos != s_head && (int32_t) (ring_time(s_pos) - from) < 0)
+		s_pos = ring_next(s_pos);
+	if (s_pos == s_tail && (s_pos == s_head || (int32_t) (ring_time(s_pos) - from) > 0))
+		s_hdr.flags |= VANET_API_REC_SHORT;
+	while (s_head - s_pos > APP_REC_MAX_LENGTH)
+	{
+		s_pos = ring_next(s_pos);
+		s_hdr.flags |= VANET_API_REC_SHORT;
+	}
+	s_end = s_head;
+	s_hdr.length = s_end - s_pos;
+
+	// an empty slot, or the oldest recording
+	s_slot = 0;
+	for (i=0; i<VANET_API_REC_SLOTS; i++)
+	{
+		h = rec_slot(i);
+		if (!rec_slot_valid(h))
+		{
+			s_slot = i;
+			break;
+		}
+		if (s_seq - h->seq >= oldest)
+		{
+			oldest = s_seq - h->seq;
+			s_slot = i;
+		}
+	}
+
+	s_hdr.xsum = 0xffff;			// bsp_util_fletcher16() of nothing, added to a page at a time
+	s_page = 0;
+	s_tries = 0;
+	s_state = REC_WRITING;
+}
+
+/// Program a page of the slot and read it back - false to try again next tick, or if the recording is given up
+static bool rec_program(void* page, const void* src, size_t len)
+{
+	flashc_memcpy(page, src, len, true);
+	if (!memcmp(page, src, len))
+	{
+		s_tries = 0;
+		return true;
+	}
+
+	if (++s_tries == REC_WRITE_TRIES)
+	{
+		// without its header the slot holds no recording
+		flashc_memset8((void*) rec_slot(s_slot), 0xff, AVR32_FLASHC_PAGE_SIZE, true);
+		s_state = REC_IDLE;
+		bsp_logcat_printf(BSP_LOGCAT_WARNING, "Recorder: slot %u page %u won't program, recording lost", s_slot, s_page);
+	}
+	return false;
+}
+
+/// One page of the recording being written
+static void rec_write_page(void)
+{
+	uint8_t* page = (uint8_t*) rec_slot(s_slot) + s_page * AVR32_FLASHC_PAGE_SIZE;
+	uint16_t len = min(s_end - s_pos, AVR32_FLASHC_PAGE_SIZE);
+	uint8_t entry[VANET_API_REC_ENTRY_SIZE];
+
+	if (s_page == 0)
+	{
+		// the old recording is gone from here on
+		flashc_memset8(page, 0xff, AVR32_FLASHC_PAGE_SIZE, true);
+	}
+	else if (len)
+	{
+		ring_read(s_pos, s_page_buf, len);
+		memset(s_page_buf + len, 0xff, AVR32_FLASHC_PAGE_SIZE - len);
+		if (!rec_program(page, s_page_buf, AVR32_FLASHC_PAGE_SIZE))
+			return;
+		s_hdr.xsum = bsp_util_fletcher16_append(s_hdr.xsum, s_page_buf, len);
+		s_pos += len;
+	}
+	else
+	{
+		// all there - the header makes it a recording
+		s_hdr.magic = REC_MAGIC;
+		s_hdr.seq = s_seq + 1;
+		s_hdr.seq_inv = ~s_hdr.seq;
+		if (s_gap)
+			s_hdr.flags |= VANET_API_REC_GAP;
+		if (!rec_program((void*) rec_slot(s_slot), &s_hdr, sizeof(s_hdr)))
+			return;
+		s_seq = s_hdr.seq;
+		s_state = REC_IDLE;
+
+		bsp_logcat_printf(BSP_LOGCAT_INFO, "Recorder: %u bytes to slot %u", s_hdr.length, s_slot);
+		rec_entry(entry, s_slot, rec_slot(s_slot));
+		app_pdg_send_msg(VANET_GRP_RECORDER_EVENT, VANET_OP_RECORDING_SAVED, entry, sizeof(entry));
+		return;
+	}
+	s_page++;
+}
+
+static void rec_start_read(const uint8_t* payload)
+{
+	const rec_header_t* h = rec_slot(payload[0] % VANET_API_REC_SLOTS);
+	uint32_t offset = get32(&payload[1]), len = get32(&payload[5]);
+
+	if (payload[0] >= VANET_API_REC_SLOTS || !rec_slot_valid(h))
+	{
+		s_read.active = false;
+		rec_error("No recording");
+		return;
+	}
+
+	s_read.slot = payload[0];
+	s_read.seq = h->seq;
+	s_read.pos = min(offset, h->length);
+	s_read.end = (len == 0 || len > h->length - s_read.pos) ? h->length : s_read.pos + len;
+	s_read.active = true;
+}
+
+/// The next Read Recording response - an empty one is the last
+static void rec_send_chunk(void)
+{
+	const rec_header_t* h = rec_slot(s_read.slot);
+	uint16_t len = min(s_read.end - s_read.pos, VANET_API_REC_CHUNK);
+
+	if (!rec_slot_valid(h) || h->seq != s_read.seq)
+	{
+		s_read.active = false;
+		rec_error("Recording overwritten");
+		return;
+	}
+
+	s_chunk[0] = VANET_GRP_RECORDER;
+	s_chunk[1] = VANET_OP_RECORDER_READ;
+	put16(&s_chunk[2], 4 + len);
+	put32(&s_chunk[4], s_read.pos);
+	memcpy(&s_chunk[8], rec_slot_data(s_read.slot) + s_read.pos, len);
+	bsp_mux_send(VANET_MUXCH_UNIFIED, s_chunk, 8 + len);
+
+	s_read.pos += len;
+	if (len == 0)
+		s_read.active = false;
+}
+
+static void rec_handler(int argc, char** argv, uint8_t port)
+{
+	const rec_header_t* h;
+	int i;
+
+	if (argc > 1)
+	{
+		if (!strcasecmp("trigger", argv[1]))
+			bsp_tkvs_publish_immed(APP_TKVS_REC_TASK, APP_REC_EVENT_TRIGGER, VANET_API_REC_MANUAL);
+		else
+			bsp_termios_write_str(port, "Invalid arguments\r\n");
+	}
+	else
+	{
+		bsp_termios_printf(port, "Triggers: %02X, %u ms before, %u ms after\r\n", s_triggers, s_pre_ms, s_post_ms);
+		bsp_termios_printf(port, "Ring: %u of %u bytes\r\n", s_head - s_tail, REC_RING_SIZE);
+		for (i=0; i<VANET_API_REC_SLOTS; i++)
+		{
+			h = rec_slot(i);
+			if (rec_slot_valid(h))
+				bsp_termios_printf(port, "Slot %d: #%u, %u bytes, cause %02X, flags %02X, xsum %04X, %u.%06u\r\n",
+					i, h->seq, h->length, h->cause, h->flags, h->xsum, h->utc_s, h->utc_us);
+			else
+				bsp_termios_printf(port, "Slot %d: empty\r\n", i);
+		}
+	}
+}
+
+static bsp_sti_command_t rec_command =
+{
+	.name = "rec",
+	.handler = &rec_handler,
+	.minArgs = 0,
+	.maxArgs = 1,
+	STI_HELP("rec                                  Show the event recorder and its recordings\r\n"
+			 "rec trigger                          Take a recording")
+};
+
+void app_rec_task_init()
+{
+	INT8U perr;
+	uint16_t pre_ms = bsp_cp_get_field(rec_pre_ms), post_ms = bsp_cp_get_field(rec_post_ms);
+	int i;
+
+	// debug console message
+	print_dbg("Creating Event Recorder Task\r\n");
+
+	// create a message queue
+	s_msg_flag = OSQCreate(&s_msg_queue[0], sizeof(s_msg_queue)/sizeof(s_msg_queue[0]));
+	OS_CHECK_NULL(s_msg_flag, "Recorder task: OSQCreate");
+
+	// Create the task
+	perr = OSTaskCreateExt(rec_task,
+		(void *)0,
+		(OS_STK *)&s_app_rec_task_stack[TASK_REC_STACK_SIZE - 1],
+		TASK_REC_PRIO,
+		TASK_REC_PRIO,
+		(OS_STK *)&s_app_rec_task_stack[0],
+		TASK_REC_STACK_SIZE,
+		(void *)0,
+		OS_TASK_OPT_STK_CHK | OS_TASK_OPT_STK_CLR);
+	OS_CHECK_PERR(perr, "Recorder task: OSTaskCreateExt");
+
+	OSTaskNameSet(TASK_REC_PRIO, (INT8U *)"Recorder", &perr);
+	OS_CHECK_PERR(perr, "Recorder task: OSTaskNameSet");
+
+	bsp_tkvs_subscribe(APP_TKVS_REC_TASK, APP_REC_EVENT_POST | APP_REC_EVENT_TRIGGER | APP_REC_EVENT_CONFIG | APP_REC_EVENT_READ,
+		s_msg_flag, TASK_REC_PRIO);
+	bsp_tkvs_init_timer(&s_post_timer, BSP_TKVS_TIMER_ONE_SHOT, 0, APP_TKVS_REC_TASK, APP_REC_EVENT_POST,
+		BSP_TKVS_TIMER_MS_TO_TICKS(REC_DEFAULT_POST_MS));
+
+	// numbering carries on from the newest recording
+	s_seq = 0;
+	for (i=0; i<VANET_API_REC_SLOTS; i++)
+	{
+		if (rec_slot_valid(rec_slot(i)) && rec_slot(i)->seq > s_seq)
+			s_seq = rec_slot(i)->seq;
+	}
+
+	s_head = s_tail = 0;
+	s_state = REC_IDLE;
+	s_armed = false;
+	s_read.active = false;
+	s_triggers = 0;
+	s_want_pre_ms = pre_ms == 0xffff ? REC_DEFAULT_PRE_MS : min(pre_ms, VANET_API_REC_MAX_MS);
+	s_want_post_ms = post_ms == 0xffff ? REC_DEFAULT_POST_MS : min(post_ms, VANET_API_REC_MAX_MS);
+	s_rate_hz = REC_DEFAULT_RATE_HZ;
+	s_block_count = REC_DEFAULT_BLOCK;
+
+	bsp_sti_register_command(&rec_command);
+}
+
+static void rec_task(void *p_arg)
+{
+	bsp_tkvs_msg_t *msg;
+	INT8U perr;
+	uint8_t config[REC_CONFIG_SIZE];
+	bool busy;
+
+	(void) p_arg;
+
+	config[0] = REC_DEFAULT_TRIGGERS;
+	put16(&config[1], s_want_pre_ms);
+	put16(&config[3], s_want_post_ms);
+	rec_config(config);
+
+	// Task Loop
+	while (1)
+	{
+		// pages and chunks go a tick apart, whatever else comes in
+		busy = s_state == REC_WRITING || s_read.active;
+		msg = (bsp_tkvs_msg_t*) OSQPend(s_msg_flag, busy ? 1 : 0, &perr);
+		if (msg != (void *)0)
+		{
+			if (msg->source == APP_TKVS_ACCEL_TASK && msg->event == APP_ACCEL_EVENT_SAMPLES)
+			{
+				rec_accel((const app_accel_block_t*) msg->data);
+			}
+			else if (msg->source == APP_TKVS_GPS_TASK && msg->event == APP_GPS_EVENT_FIX)
+			{
+				rec_gps((const app_gps_fix_t*) msg->data);
+			}
+			else if (msg->source == APP_TKVS_ACCEL_TASK && msg->event == APP_ACCEL_EVENT_FIRED)
+			{
+				if (msg->immed_data & s_triggers & (VANET_API_REC_TRIGGER_SM1 | VANET_API_REC_TRIGGER_SM2))
+					rec_trigger(msg->immed_data);
+			}
+			else if (msg->source == APP_TKVS_REC_TASK && msg->event == APP_REC_EVENT_TRIGGER)
+			{
+				if (s_armed)
+					rec_trigger(msg->immed_data);
+			}
+			else if (msg->source == APP_TKVS_REC_TASK && msg->event == APP_REC_EVENT_POST)
+			{
+				if (s_state == REC_TRIGGERED)
+					rec_start_write();
+			}
+			else if (msg->source == APP_TKVS_REC_TASK && msg->event == APP_REC_EVENT_CONFIG && msg->data_len >= REC_CONFIG_SIZE)
+			{
+				rec_config(msg->data);
+				rec_send_config();
+			}
+			else if (msg->source == APP_TKVS_REC_TASK && msg->event == APP_REC_EVENT_READ && msg->data_len >= 9)
+			{
+				rec_start_read(msg->data);
+			}
+
+			bsp_tkvs_free(msg);
+		}
+
+		if ((s_state == REC_WRITING || s_read.active) && bsp_rtc_get_ticks() != s_tick)
+		{
+			s_tick = bsp_rtc_get_ticks();
+			if (s_state == REC_WRITING)
+				rec_write_page();
+			if (s_read.active)
+				rec_send_chunk();
+		}
+	}
+}
+
+bool app_rec_armed(void)
+{
+	return s_armed;
+}
+
+void app_rec_cmd(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len)
+{
+	uint8_t buf[VANET_API_REC_SLOTS * VANET_API_REC_ENTRY_SIZE];
+	uint8_t* p = buf;
+	int i;
+
+	if (opcode == VANET_OP_RECORDER_LIST)
+	{
+		for (i=0; i<VANET_API_REC_SLOTS; i++)
+		{
+			if (rec_slot_valid(rec_slot(i)))
+				p = rec_entry(p, i, rec_slot(i));
+		}
+		app_pdg_send_msg(grp, opcode, buf, p - buf);
+	}
+	else if (opcode == VANET_OP_RECORDER_READ)
+	{
+		/*
+			Byte 0 - Slot
+			Byte 1-4 - Offset
+			Byte 5-8 - Length
+		*/
+		if (payload_len < 9)
+			rec_error("Bad read");
+		else
+			bsp_tkvs_publish_data(APP_TKVS_REC_TASK, APP_REC_EVENT_READ, payload, 9);
+	}
+	else if (opcode == VANET_OP_RECORDER_CONFIG)
+	{
+		/*
+			Byte 0 - Triggers
+			Byte 1-2 - Pre-trigger ms
+			Byte 3-4 - Post-trigger ms
+		*/
+		if (payload_len >= REC_CONFIG_SIZE)
+		{
+			buf[0] = payload[0];
+			put16(&buf[1], min(get16(&payload[1]), VANET_API_REC_MAX_MS));
+			put16(&buf[3], min(get16(&payload[3]), VANET_API_REC_MAX_MS));
+			// the recorder answers once it has cut the window to fit
+			bsp_tkvs_publish_data(APP_TKVS_REC_TASK, APP_REC_EVENT_CONFIG, buf, REC_CONFIG_SIZE);
+		}
+		else
+		{
+			buf[0] = s_triggers;
+			put16(&buf[1], s_pre_ms);
+			put16(&buf[3], s_post_ms);
+			app_pdg_send_msg(grp, opcode, buf, REC_CONFIG_SIZE);
+		}
+	}
+	else if (opcode == VANET_OP_RECORDER_TRIGGER)
+	{
+		if (s_armed)
+		{
+			bsp_tkvs_publish_immed(APP_TKVS_REC_TASK, APP_REC_EVENT_TRIGGER, VANET_API_REC_MANUAL);
+			app_pdg_send_msg(grp, opcode, 0, 0);
+		}
+		else
+		{
+			rec_error("Recorder stopped");
+		}
+	}
+}
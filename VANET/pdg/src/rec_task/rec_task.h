@@ -0,0 +1,52 @@
+/**
+ *	@file	rec_task.h
+ *
+ *	@brief	Event Recorder Task
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef REC_TASK_H
+#define REC_TASK_H
+
+#include "vanet_api.h"
+
+/// Main flash for the recordings, just below the codeplug journal (the RECORDER region in link_uc3c0512c.lds)
+#define APP_REC_FLASH_ADDRESS		0x8006EA00
+#define APP_REC_SLOT_PAGES			16
+#define APP_REC_SLOT_SIZE			(APP_REC_SLOT_PAGES * AVR32_FLASHC_PAGE_SIZE)
+#define APP_REC_FLASH_SIZE			(VANET_API_REC_SLOTS * APP_REC_SLOT_SIZE)
+
+/// The most a recording holds - the slot less its header page
+#define APP_REC_MAX_LENGTH			(APP_REC_SLOT_SIZE - AVR32_FLASHC_PAGE_SIZE)
+
+/// APP_TKVS_REC_TASK Events
+enum
+{
+	APP_REC_EVENT_POST			= 0x0001,		///< the post-trigger window is over
+	APP_REC_EVENT_TRIGGER		= 0x0002,		///< immed_data is the cause, VANET_API_REC_MANUAL from the main board
+	APP_REC_EVENT_CONFIG		= 0x0004,		///< data is a Configure Recorder payload
+	APP_REC_EVENT_READ			= 0x0008,		///< data is a Read Recording payload
+	APP_REC_EVENT_ARMED			= 0x0010,		///< app_rec_armed() changed
+};
+
+/// Initialize / Start the Event Recorder Task
+void app_rec_task_init(void);
+
+/// The recorder keeps its window - the accelerometer FIFO has to run
+bool app_rec_armed(void);
+
+/// PDG command handler for the recorder group
+void app_rec_cmd(uint8_t grp, uint8_t opcode, const uint8_t* payload, uint16_t payload_len);
+
+#endif // REC_TASK_H
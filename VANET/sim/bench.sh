@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Run the STI "bench" command in vanet-sim and print its result lines
+#
+#   ./bench.sh [prefix|all] [rounds] > bench.txt
+#
+# The lines are key=value, so two runs diff cleanly.  Cycles are the
+# simulator's 32 MHz COUNT, i.e. host time - compare host runs with host runs.
+#
+
+dir=$(mktemp -d /tmp/vanet-bench.XXXXXX) || exit 1
+
+./vanet-sim -d "$dir" -D -P > "$dir/sim.log" 2>&1 &
+sim=$!
+trap 'kill $sim 2>/dev/null; rm -rf "$dir"' EXIT
+
+n=0
+while [ ! -e "$dir/debug" ]; do
+    n=$((n + 1))
+    if [ $n -gt 50 ]; then
+        echo "vanet-sim didn't start:" >&2
+        cat "$dir/sim.log" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+exec 3<> "$dir/debug"
+stty -F "$dir/debug" raw -echo
+
+# let the tasks come up before STI gets the command
+sleep 2
+printf 'bench %s\r\n' "$*" >&3
+
+while IFS= read -r line <&3; do
+    line=$(printf '%s' "$line" | tr -d '\r')
+    case "$line" in
+        "bench end"*)   break ;;
+        "bench name="*) echo "$line" ;;
+    esac
+done
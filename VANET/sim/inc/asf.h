@@ -0,0 +1,48 @@
+/**
+ *	@file	asf.h
+ *
+ *	@brief	vanet-sim - ASF for the host build
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_ASF_H
+#define SIM_ASF_H
+
+// The ASF modules the BSP uses, in the order of bsp/src/asf.h
+
+#include <compiler.h>
+#include <status_codes.h>
+#include <reset_cause.h>
+#include <cycle_counter.h>
+#include <ast.h>
+#include <calendar.h>
+#include <flashc.h>
+#include <gpio.h>
+#include <board.h>
+#include <intc.h>
+#include <interrupt.h>
+#include <pdca.h>
+#include <sleep.h>
+#include <pwm4.h>
+#include <scif_uc3c.h>
+#include <sleepmgr.h>
+#include <sysclk.h>
+#include <tc.h>
+#include <twim.h>
+#include <usart.h>
+#include <print_funcs.h>
+#include <wdt.h>
+
+
+#endif // SIM_ASF_H
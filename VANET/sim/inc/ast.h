@@ -0,0 +1,55 @@
+/**
+ *	@file	ast.h
+ *
+ *	@brief	vanet-sim - Asynchronous timer
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_AST_H
+#define SIM_AST_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+#define AST_OSC_RC                  0
+#define AST_OSC_32KHZ               1
+#define AST_OSC_PB                  2
+#define AST_OSC_GCLK                3
+#define AST_OSC_1KHZ                4
+
+#define AST_MODE_COUNTER            0
+#define AST_MODE_CALENDAR           1
+
+extern bool ast_init_counter(volatile avr32_ast_t *ast, unsigned char osc_type, unsigned char psel, unsigned long ast_counter);
+extern void ast_enable(volatile avr32_ast_t *ast);
+extern void ast_disable(volatile avr32_ast_t *ast);
+extern void ast_set_counter_value(volatile avr32_ast_t *ast, unsigned long ast_counter);
+extern unsigned long ast_get_counter_value(volatile avr32_ast_t *ast);
+extern void ast_set_alarm0_value(volatile avr32_ast_t *ast, uint32_t alarm_value);
+extern void ast_set_periodic0_value(volatile avr32_ast_t *ast, avr32_ast_pir0_t pir);
+extern void ast_enable_alarm0(volatile avr32_ast_t *ast);
+extern void ast_disable_alarm0(volatile avr32_ast_t *ast);
+extern void ast_enable_periodic0(volatile avr32_ast_t *ast);
+extern void ast_disable_periodic0(volatile avr32_ast_t *ast);
+extern void ast_clear_all_status_flags(volatile avr32_ast_t *ast);
+extern void ast_enable_alarm_interrupt(volatile avr32_ast_t *ast, uint8_t alarm_channel);
+extern void ast_disable_alarm_interrupt(volatile avr32_ast_t *ast, uint8_t alarm_channel);
+extern void ast_clear_alarm_status_flag(volatile avr32_ast_t *ast, uint32_t alarm_channel);
+extern void ast_enable_periodic_interrupt(volatile avr32_ast_t *ast, uint8_t periodic_channel);
+extern void ast_disable_periodic_interrupt(volatile avr32_ast_t *ast, uint8_t periodic_channel);
+extern void ast_clear_periodic_status_flag(volatile avr32_ast_t *ast, uint32_t periodic_channel);
+extern void ast_enable_async_wakeup(volatile avr32_ast_t *ast, uint32_t wakeup_mask);
+extern void ast_disable_async_wakeup(volatile avr32_ast_t *ast, uint32_t wakeup_mask);
+
+#endif // SIM_AST_H
@@ -0,0 +1,395 @@
+/**
+ *	@file	io.h
+ *
+ *	@brief	vanet-sim - UC3C0512C peripheral map for the host build
+ *
+ *	The registers the BSP touches directly are plain structures in host memory.
+ *	The peripheral models in sim/src watch and update them.  Everything else is
+ *	reached through the ASF driver headers in sim/inc.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_AVR32_IO_H
+#define SIM_AVR32_IO_H
+
+#include <stdint.h>
+
+/*---------------------------------------------------------------------------
+ * Memory map (reported by the STI mem command - nothing lives there)
+ *---------------------------------------------------------------------------*/
+#define AVR32_FLASH_ADDRESS                 0x80000000
+#define AVR32_FLASH_SIZE                    0x00080000
+#define AVR32_SRAM_ADDRESS                  0x00000000
+#define AVR32_SRAM_SIZE                     0x00010000
+#define AVR32_HRAMC0_ADDRESS                0xA0000000
+#define AVR32_HRAMC0_SIZE                   0x00001000
+#define AVR32_FLASHC_USER_PAGE_ADDRESS      0x80800000
+#define AVR32_FLASHC_USER_PAGE_SIZE         512
+#define AVR32_FLASHC_PAGE_SIZE              512
+
+/// The user page is host memory (see sim_flash.c)
+extern uint8_t sim_flash_user_page[AVR32_FLASHC_USER_PAGE_SIZE];
+#define AVR32_FLASHC_USER_PAGE              (sim_flash_user_page)
+
+/*---------------------------------------------------------------------------
+ * Interrupts.  Group * 32 + line as on the part, but only the ones we model
+ *---------------------------------------------------------------------------*/
+#define AVR32_INTC_INT0                     0
+#define AVR32_INTC_INT1                     1
+#define AVR32_INTC_INT2                     2
+#define AVR32_INTC_INT3                     3
+
+#define AVR32_GPIO_IRQ_0                    32          // 16 lines, one per 8 pins
+#define AVR32_AST_ALARM_IRQ                 48
+#define AVR32_AST_PER_IRQ                   49
+#define AVR32_AST_OVF_IRQ                   50
+#define AVR32_TC0_IRQ0                      52
+#define AVR32_TC0_IRQ1                      53
+#define AVR32_TC0_IRQ2                      54
+#define AVR32_USART0_IRQ                    56
+#define AVR32_USART1_IRQ                    57
+#define AVR32_USART2_IRQ                    58
+#define AVR32_USART3_IRQ                    59
+#define AVR32_USART4_IRQ                    60
+#define AVR32_TWIM0_IRQ                     61
+#define AVR32_TWIM1_IRQ                     62
+#define AVR32_TWIM2_IRQ                     63
+
+#define SIM_IRQ_COUNT                       64
+
+/*---------------------------------------------------------------------------
+ * GPIO
+ *---------------------------------------------------------------------------*/
+#define AVR32_GPIO_PORT_COUNT               4
+
+#define AVR32_PIN_PA12                      12
+#define AVR32_PIN_PA13                      13
+#define AVR32_PIN_PA22                      22
+#define AVR32_PIN_PA23                      23
+#define AVR32_PIN_PB02                      34
+#define AVR32_PIN_PB03                      35
+#define AVR32_PIN_PB21                      53
+#define AVR32_PIN_PC11                      75
+#define AVR32_PIN_PC19                      83
+#define AVR32_PIN_PC20                      84
+#define AVR32_PIN_PD03                      99
+
+typedef struct
+{
+    uint32_t    gper;       ///< GPIO enable
+    uint32_t    pmr0;       ///< peripheral mux
+    uint32_t    pmr1;
+    uint32_t    pmr2;
+    uint32_t    oder;       ///< output driver enable
+    uint32_t    ovr;        ///< output value
+    uint32_t    pvr;        ///< pin value
+    uint32_t    puer;       ///< pull-up enable
+    uint32_t    pder;       ///< pull-down enable
+    uint32_t    ier;        ///< interrupt enable
+    uint32_t    imr0;       ///< interrupt mode
+    uint32_t    imr1;
+    uint32_t    gfer;       ///< glitch filter enable
+    uint32_t    ifr;        ///< interrupt flag
+} avr32_gpio_port_t;
+
+typedef struct
+{
+    avr32_gpio_port_t   port[AVR32_GPIO_PORT_COUNT];
+} avr32_gpio_t;
+
+extern volatile avr32_gpio_t sim_gpio;
+#define AVR32_GPIO                          (sim_gpio)
+
+/*---------------------------------------------------------------------------
+ * USART
+ *---------------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t    cr;
+    uint32_t    mr;
+    uint32_t    ier;        ///< write-only: the model folds it into imr
+    uint32_t    idr;        ///< write-only: the model folds it into imr
+    uint32_t    imr;
+    uint32_t    csr;
+    uint32_t    rhr;
+    uint32_t    thr;        ///< the model sends whatever the firmware writes here
+    uint32_t    brgr;
+} avr32_usart_t;
+
+#define AVR32_USART_CSR_RXRDY_MASK          0x00000001
+#define AVR32_USART_CSR_TXRDY_MASK          0x00000002
+#define AVR32_USART_CSR_OVRE_MASK           0x00000020
+#define AVR32_USART_CSR_FRAME_MASK          0x00000040
+#define AVR32_USART_CSR_PARE_MASK           0x00000080
+#define AVR32_USART_CSR_TXEMPTY_MASK        0x00000200
+#define AVR32_USART_IER_RXRDY_MASK          AVR32_USART_CSR_RXRDY_MASK
+#define AVR32_USART_IER_TXRDY_MASK          AVR32_USART_CSR_TXRDY_MASK
+#define AVR32_USART_IDR_RXRDY_MASK          AVR32_USART_CSR_RXRDY_MASK
+#define AVR32_USART_IDR_TXRDY_MASK          AVR32_USART_CSR_TXRDY_MASK
+#define AVR32_USART_THR_TXCHR_OFFSET        0
+#define AVR32_USART_THR_TXCHR_MASK          0x000001ff
+#define AVR32_USART_RHR_RXCHR_MASK          0x000001ff
+
+#define SIM_USART_COUNT                     5
+
+extern volatile avr32_usart_t sim_usart[SIM_USART_COUNT];
+#define AVR32_USART0                        (sim_usart[0])
+#define AVR32_USART1                        (sim_usart[1])
+#define AVR32_USART2                        (sim_usart[2])
+#define AVR32_USART3                        (sim_usart[3])
+#define AVR32_USART4                        (sim_usart[4])
+
+// pin muxing is accepted and ignored
+#define AVR32_USART0_RXD_PIN                0x80
+#define AVR32_USART0_RXD_FUNCTION           0
+#define AVR32_USART0_TXD_PIN                0x81
+#define AVR32_USART0_TXD_FUNCTION           0
+#define AVR32_USART1_RXD_0_1_PIN            0x82
+#define AVR32_USART1_RXD_0_1_FUNCTION       0
+#define AVR32_USART1_TXD_0_1_PIN            0x83
+#define AVR32_USART1_TXD_0_1_FUNCTION       0
+#define AVR32_USART2_RXD_0_1_PIN            0x84
+#define AVR32_USART2_RXD_0_1_FUNCTION       0
+#define AVR32_USART2_TXD_0_1_PIN            0x85
+#define AVR32_USART2_TXD_0_1_FUNCTION       0
+#define AVR32_USART3_RXD_0_0_PIN            0x86
+#define AVR32_USART3_RXD_0_0_FUNCTION       0
+#define AVR32_USART3_TXD_0_0_PIN            0x87
+#define AVR32_USART3_TXD_0_0_FUNCTION       0
+#define AVR32_TWIMS0_TWCK_0_0_PIN           0x88
+#define AVR32_TWIMS0_TWCK_0_0_FUNCTION      0
+#define AVR32_TWIMS0_TWD_0_0_PIN            0x89
+#define AVR32_TWIMS0_TWD_0_0_FUNCTION       0
+#define AVR32_TC0_A0_PIN                    0x8a
+#define AVR32_TC0_A0_FUNCTION               0
+#define AVR32_TC0_B0_PIN                    0x8b
+#define AVR32_TC0_B0_FUNCTION               0
+#define AVR32_PWM_PWML_2_PIN                0x8c
+#define AVR32_PWM_PWML_2_FUNCTION           0
+#define AVR32_PWM_PWMH_2_PIN                0x8d
+#define AVR32_PWM_PWMH_2_FUNCTION           0
+
+#define AVR32_USART0_CLK_PBA                0
+#define AVR32_USART1_CLK_PBC                1
+#define AVR32_USART2_CLK_PBA                2
+#define AVR32_USART3_CLK_PBA                3
+
+/*---------------------------------------------------------------------------
+ * AST
+ *---------------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t    cr;
+    uint32_t    cv;
+    uint32_t    sr;
+    uint32_t    scr;        ///< the model clears sr bits written here
+    uint32_t    ier;        ///< and sets imr bits written here
+    uint32_t    idr;        ///< and clears imr bits written here
+    uint32_t    imr;
+    uint32_t    wer;
+    uint32_t    ar0;
+    uint32_t    ar1;
+    uint32_t    pir0;
+    uint32_t    pir1;
+    uint32_t    clock;
+} avr32_ast_t;
+
+typedef struct
+{
+    uint32_t    :27;
+    uint32_t    insel:5;
+} avr32_ast_pir0_t;
+
+#define AVR32_AST_SR_ALARM0_MASK            0x00000100
+#define AVR32_AST_SR_PER0_MASK              0x00010000
+#define AVR32_AST_SR_BUSY_MASK              0x01000000
+#define AVR32_AST_SCR_PER0_MASK             AVR32_AST_SR_PER0_MASK
+#define AVR32_AST_SCR_ALARM0_MASK           AVR32_AST_SR_ALARM0_MASK
+#define AVR32_AST_PER0_MASK                 AVR32_AST_SR_PER0_MASK
+#define AVR32_AST_ALARM0_MASK               AVR32_AST_SR_ALARM0_MASK
+#define AVR32_AST_IER_PER0_MASK             AVR32_AST_SR_PER0_MASK
+#define AVR32_AST_IER_ALARM0_MASK           AVR32_AST_SR_ALARM0_MASK
+#define AVR32_AST_IDR_PER0_MASK             AVR32_AST_SR_PER0_MASK
+#define AVR32_AST_IDR_ALARM0_MASK           AVR32_AST_SR_ALARM0_MASK
+
+extern volatile avr32_ast_t sim_ast;
+#define AVR32_AST                           (sim_ast)
+
+/*---------------------------------------------------------------------------
+ * TC
+ *---------------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t    ccr;
+    uint32_t    cmr;
+    uint32_t    cv;
+    uint32_t    ra;
+    uint32_t    rb;
+    uint32_t    rc;
+    uint32_t    sr;
+    uint32_t    ier;
+    uint32_t    idr;
+    uint32_t    imr;
+} avr32_tc_channel_t;
+
+typedef struct
+{
+    avr32_tc_channel_t  channel[3];
+} avr32_tc_t;
+
+extern volatile avr32_tc_t sim_tc[2];
+#define AVR32_TC0                           (sim_tc[0])
+#define AVR32_TC1                           (sim_tc[1])
+
+/*---------------------------------------------------------------------------
+ * TWIM - commands run as soon as the model sees them, the data through the PDCA
+ *---------------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t    cr;         ///< the model acts on what's written here, then clears it
+    uint32_t    cwgr;
+    uint32_t    smbtr;
+    uint32_t    cmdr;
+    uint32_t    ncmdr;      ///< moves up to cmdr when cmdr isn't valid
+    uint32_t    rhr;
+    uint32_t    thr;
+    uint32_t    sr;
+    uint32_t    ier;        ///< the model sets imr bits written here
+    uint32_t    idr;        ///< and clears imr bits written here
+    uint32_t    imr;
+    uint32_t    scr;        ///< and clears sr bits written here
+    uint32_t    pr;
+    uint32_t    vr;
+} avr32_twim_t;
+
+#define AVR32_TWIM_CR_MEN_MASK              0x00000001
+#define AVR32_TWIM_CR_MDIS_MASK             0x00000002
+#define AVR32_TWIM_CR_SWRST_MASK            0x00000080
+#define AVR32_TWIM_CMDR_READ_MASK           0x00000001
+#define AVR32_TWIM_CMDR_READ_OFFSET         0
+#define AVR32_TWIM_CMDR_SADR_OFFSET         1
+#define AVR32_TWIM_CMDR_SADR_MASK           0x000007fe
+#define AVR32_TWIM_CMDR_START_MASK          0x00002000
+#define AVR32_TWIM_CMDR_STOP_MASK           0x00004000
+#define AVR32_TWIM_CMDR_VALID_MASK          0x00008000
+#define AVR32_TWIM_CMDR_NBYTES_OFFSET       16
+#define AVR32_TWIM_CMDR_NBYTES_MASK         0x00ff0000
+#define AVR32_TWIM_SR_RXRDY_MASK            0x00000001
+#define AVR32_TWIM_SR_TXRDY_MASK            0x00000002
+#define AVR32_TWIM_SR_CRDY_MASK             0x00000004
+#define AVR32_TWIM_SR_CCOMP_MASK            0x00000008
+#define AVR32_TWIM_SR_IDLE_MASK             0x00000010
+#define AVR32_TWIM_SR_BUSFREE_MASK          0x00000020
+#define AVR32_TWIM_SR_ANAK_MASK             0x00000100
+#define AVR32_TWIM_SR_DNAK_MASK             0x00000200
+#define AVR32_TWIM_SR_ARBLST_MASK           0x00000400
+#define AVR32_TWIM_SR_MENB_MASK             0x00010000
+#define AVR32_TWIM_IER_CRDY_MASK            AVR32_TWIM_SR_CRDY_MASK
+#define AVR32_TWIM_IER_CCOMP_MASK           AVR32_TWIM_SR_CCOMP_MASK
+#define AVR32_TWIM_IER_ANAK_MASK            AVR32_TWIM_SR_ANAK_MASK
+#define AVR32_TWIM_IER_DNAK_MASK            AVR32_TWIM_SR_DNAK_MASK
+#define AVR32_TWIM_IER_ARBLST_MASK          AVR32_TWIM_SR_ARBLST_MASK
+#define AVR32_TWIM_IDR_CRDY_MASK            AVR32_TWIM_SR_CRDY_MASK
+#define AVR32_TWIM_SCR_CCOMP_MASK           AVR32_TWIM_SR_CCOMP_MASK
+
+extern volatile avr32_twim_t sim_twim[3];
+#define AVR32_TWIM0                         (sim_twim[0])
+#define AVR32_TWIM1                         (sim_twim[1])
+#define AVR32_TWIM2                         (sim_twim[2])
+
+/*---------------------------------------------------------------------------
+ * PDCA - a channel moves bytes when the peripheral it's selected for asks
+ *---------------------------------------------------------------------------*/
+typedef struct
+{
+    uint32_t    mar;
+    uint32_t    psr;
+    uint32_t    tcr;
+    uint32_t    marr;       ///< taken up into mar when tcr runs out
+    uint32_t    tcrr;
+    uint32_t    cr;
+    uint32_t    mr;
+    uint32_t    sr;
+    uint32_t    ier;
+    uint32_t    idr;
+    uint32_t    imr;
+    uint32_t    isr;
+} avr32_pdca_channel_t;
+
+#define AVR32_PDCA_CHANNEL_LENGTH           8
+#define AVR32_PDCA_BYTE                     0
+#define AVR32_PDCA_TEN_MASK                 0x00000001
+#define AVR32_PDCA_PID_TWIM0_RX             7
+#define AVR32_PDCA_PID_TWIM0_TX             17
+
+extern volatile avr32_pdca_channel_t sim_pdca[AVR32_PDCA_CHANNEL_LENGTH];
+
+/*---------------------------------------------------------------------------
+ * PWM / PM - only their addresses are used
+ *---------------------------------------------------------------------------*/
+typedef struct { uint32_t clk; } avr32_pwm_t;
+
+extern volatile avr32_pwm_t sim_pwm;
+#define AVR32_PWM                           (sim_pwm)
+
+typedef struct
+{
+    uint32_t    cpre:4;
+    uint32_t    :4;
+    uint32_t    calg:1;
+    uint32_t    cpol:1;
+    uint32_t    ces:1;
+    uint32_t    :5;
+    uint32_t    dte:1;
+    uint32_t    dthi:1;
+    uint32_t    dtli:1;
+} avr32_pwm_cmr_t;
+
+typedef struct
+{
+    union { uint32_t cmr; avr32_pwm_cmr_t CMR; };
+    union { uint32_t cdty; };
+    union { uint32_t cdtyupd; };
+    union { uint32_t cprd; };
+    union { uint32_t cprdupd; };
+    union { uint32_t ccnt; };
+    union { uint32_t dt; };
+    union { uint32_t dtupd; };
+} avr32_pwm_channel_t;
+
+#define AVR32_PWM_DIVA_CLK_OFF              0
+#define AVR32_PWM_DIVB_CLK_OFF              0
+#define AVR32_PWM_PREA_CCK                  0
+#define AVR32_PWM_PREB_CCK                  0
+#define AVR32_PWM_CPRE_CCK                  0
+#define AVR32_PWM_CPRE_CCK_DIV_2            1
+#define AVR32_PWM_CPRE_CCK_DIV_4            2
+#define AVR32_PWM_CPRE_CCK_DIV_8            3
+#define AVR32_PWM_CPRE_CCK_DIV_16           4
+#define AVR32_PWM_CPRE_CCK_DIV_32           5
+#define AVR32_PWM_CPRE_CCK_DIV_64           6
+#define AVR32_PWM_CPRE_CCK_DIV_128          7
+#define AVR32_PWM_CPRE_CCK_DIV_256          8
+#define AVR32_PWM_CPRE_CCK_DIV_512          9
+#define AVR32_PWM_CPRE_CCK_DIV_1024         10
+
+#define AVR32_PM_SMODE_IDLE                 0
+#define AVR32_PM_SMODE_FROZEN               1
+#define AVR32_PM_SMODE_STANDBY              2
+#define AVR32_PM_SMODE_STOP                 3
+#define AVR32_PM_SMODE_DEEP_STOP            4
+#define AVR32_PM_SMODE_STATIC               5
+#define AVR32_PM_SMODE_GMCLEAR_MASK         0x80
+
+#endif // SIM_AVR32_IO_H
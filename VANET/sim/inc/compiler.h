@@ -0,0 +1,124 @@
+/**
+ *	@file	compiler.h
+ *
+ *	@brief	vanet-sim - Compiler abstraction for the host build
+ *
+ *	Stands in for the ASF avr32/utils/compiler.h.  Only the parts the BSP
+ *	actually uses are here.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_COMPILER_H
+#define SIM_COMPILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "preprocessor.h"
+#include "parts.h"
+
+typedef int8_t          S8;
+typedef uint8_t         U8;
+typedef int16_t         S16;
+typedef uint16_t        U16;
+typedef int32_t         S32;
+typedef uint32_t        U32;
+typedef int64_t         S64;
+typedef uint64_t        U64;
+typedef float           F32;
+typedef double          F64;
+typedef bool            Bool;
+
+typedef U8              Status_bool_t;
+typedef U8              Status_t;
+
+#ifndef FALSE
+#define FALSE           0
+#define TRUE            1
+#endif
+#define DISABLE         0
+#define ENABLE          1
+#define PASS            0
+#define FAIL            1
+#define LOW             0
+#define HIGH            1
+
+#define Assert(expr)    assert(expr)
+#define UNUSED(v)       (void)(v)
+#define unused(v)       do { (void)(v); } while(0)
+
+#define Min(a, b)       (((a) < (b)) ? (a) : (b))
+#define Max(a, b)       (((a) > (b)) ? (a) : (b))
+#define min(a, b)       Min(a, b)
+#define max(a, b)       Max(a, b)
+#define Abs(a)          (((a) < 0) ? -(a) : (a))
+
+#define COMPILER_ALIGNED(a)     __attribute__((__aligned__(a)))
+#define COMPILER_WORD_ALIGNED   __attribute__((__aligned__(4)))
+#define COMPILER_PACK_SET(a)
+#define COMPILER_PACK_RESET()
+
+#define Long_call(addr)         ((*(void (*)(void))(addr))())
+
+#define barrier()       __asm__ __volatile__ ("" ::: "memory")
+
+#define LSB(u16)        (((U8  *)&(u16))[0])
+#define MSB(u16)        (((U8  *)&(u16))[1])
+
+#define Rd_bitfield(value, mask)            (((value) & (mask)) >> ctz(mask))
+#define Wr_bitfield(lvalue, mask, bitfield) ((lvalue) = ((lvalue) & ~(mask)) | (((bitfield) << ctz(mask)) & (mask)))
+#define ctz(u)          __builtin_ctz(u)
+#define clz(u)          __builtin_clz(u)
+
+static inline int_fast8_t ilog2(uint32_t x)
+{
+    return x ? 31 - clz(x) : -1;
+}
+
+#define swap16(u16)     __builtin_bswap16(u16)
+#define swap32(u32)     __builtin_bswap32(u32)
+
+// the UC3 is big-endian, the host isn't
+#define cpu_to_be16(x)  swap16(x)
+#define be16_to_cpu(x)  swap16(x)
+#define cpu_to_be32(x)  swap32(x)
+#define be32_to_cpu(x)  swap32(x)
+#define cpu_to_le16(x)  (x)
+#define le16_to_cpu(x)  (x)
+#define cpu_to_le32(x)  (x)
+#define le32_to_cpu(x)  (x)
+
+/// System registers
+#define AVR32_SR                0x000
+#define AVR32_COUNT             0x108
+#define AVR32_COMPARE           0x10c
+#define AVR32_SR_GM_OFFSET      16
+#define AVR32_SR_GM_MASK        0x00010000
+#define AVR32_SR_I0M_OFFSET     17                  ///< I1M..I3M follow
+#define AVR32_SR_I0M_MASK       0x00020000
+#define AVR32_SR_I3M_MASK       0x00100000
+
+extern uint32_t sim_sysreg_read(uint32_t reg);
+extern void sim_sysreg_write(uint32_t reg, uint32_t value);
+#define Get_system_register(reg)            sim_sysreg_read(reg)
+#define Set_system_register(reg, value)     sim_sysreg_write(reg, value)
+#define sysreg_read(reg)                    sim_sysreg_read(reg)
+#define sysreg_write(reg, value)            sim_sysreg_write(reg, value)
+
+#include "interrupt.h"
+
+#endif // SIM_COMPILER_H
@@ -0,0 +1,26 @@
+/**
+ *	@file	cycle_counter.h
+ *
+ *	@brief	vanet-sim - CPU cycle counter
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_CYCLE_COUNTER_H
+#define SIM_CYCLE_COUNTER_H
+
+// the ASF helpers work unchanged on top of the simulated COUNT register
+#include "compiler.h"
+#include "../../bsp/src/asf/avr32/drivers/cpu/cycle_counter.h"
+
+#endif // SIM_CYCLE_COUNTER_H
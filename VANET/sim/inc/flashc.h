@@ -0,0 +1,29 @@
+/**
+ *	@file	flashc.h
+ *
+ *	@brief	vanet-sim - Flash controller
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_FLASHC_H
+#define SIM_FLASHC_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+/// Copy into the user page or the codeplug journal.  Both are written back to the codeplug file
+extern volatile void *flashc_memcpy(volatile void *dst, const void *src, size_t nbytes, bool erase);
+extern volatile void *flashc_memset8(volatile void *dst, uint8_t src, size_t nbytes, bool erase);
+
+#endif // SIM_FLASHC_H
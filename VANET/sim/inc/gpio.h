@@ -0,0 +1,74 @@
+/**
+ *	@file	gpio.h
+ *
+ *	@brief	vanet-sim - GPIO
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_GPIO_H
+#define SIM_GPIO_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+#define GPIO_SUCCESS            0
+#define GPIO_INVALID_ARGUMENT   1
+
+#define GPIO_PIN_CHANGE         0
+#define GPIO_RISING_EDGE        1
+#define GPIO_FALLING_EDGE       2
+
+#define GPIO_DIR_INPUT          (0 << 0)
+#define GPIO_DIR_OUTPUT         (1 << 0)
+#define GPIO_INIT_LOW           (0 << 1)
+#define GPIO_INIT_HIGH          (1 << 1)
+#define GPIO_PULL_UP            (1 << 2)
+#define GPIO_PULL_DOWN          (2 << 2)
+#define GPIO_BUSKEEPER          (3 << 2)
+#define GPIO_OPEN_DRAIN         (1 << 6)
+#define GPIO_INTERRUPT          (1 << 7)
+#define GPIO_BOTHEDGES          (3 << 7)
+#define GPIO_RISING             (5 << 7)
+#define GPIO_FALLING            (7 << 7)
+
+typedef const struct
+{
+    uint32_t pin;
+    uint32_t function;
+} gpio_map_t[];
+
+extern int gpio_enable_module(const gpio_map_t gpiomap, uint32_t size);
+extern int gpio_enable_module_pin(uint32_t pin, uint32_t function);
+extern void gpio_enable_gpio_pin(uint32_t pin);
+extern void gpio_enable_pin_pull_up(uint32_t pin);
+extern void gpio_disable_pin_pull_up(uint32_t pin);
+extern void gpio_enable_pin_pull_down(uint32_t pin);
+extern void gpio_disable_pin_pull_down(uint32_t pin);
+extern void gpio_configure_pin(uint32_t pin, uint32_t flags);
+extern int gpio_get_pin_value(uint32_t pin);
+extern int gpio_get_gpio_pin_output_value(uint32_t pin);
+extern void gpio_set_gpio_pin(uint32_t pin);
+extern void gpio_set_pin_high(uint32_t pin);
+extern void gpio_clr_gpio_pin(uint32_t pin);
+extern void gpio_set_pin_low(uint32_t pin);
+extern void gpio_tgl_gpio_pin(uint32_t pin);
+extern void gpio_toggle_pin(uint32_t pin);
+extern void gpio_enable_pin_glitch_filter(uint32_t pin);
+extern void gpio_disable_pin_glitch_filter(uint32_t pin);
+extern int gpio_enable_pin_interrupt(uint32_t pin, uint32_t mode);
+extern void gpio_disable_pin_interrupt(uint32_t pin);
+extern int gpio_get_pin_interrupt_flag(uint32_t pin);
+extern void gpio_clear_pin_interrupt_flag(uint32_t pin);
+
+#endif // SIM_GPIO_H
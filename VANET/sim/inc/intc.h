@@ -0,0 +1,32 @@
+/**
+ *	@file	intc.h
+ *
+ *	@brief	vanet-sim - Interrupt controller
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_INTC_H
+#define SIM_INTC_H
+
+#include "compiler.h"
+
+typedef void (*__int_handler)(void);
+
+/// Forget all handlers
+extern void INTC_init_interrupts(void);
+
+/// Install handler for irq at int_level (AVR32_INTC_INTn) - a higher level preempts a lower one
+extern void INTC_register_interrupt(__int_handler handler, uint32_t irq, uint32_t int_level);
+
+#endif // SIM_INTC_H
@@ -0,0 +1,63 @@
+/**
+ *	@file	interrupt.h
+ *
+ *	@brief	vanet-sim - Global interrupt mask
+ *
+ *	The "CPU" status register lives in sim_cpu.c.  Unmasking is where pending
+ *	peripheral interrupts get taken (see sim_cpu.c).
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_INTERRUPT_H
+#define SIM_INTERRUPT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t irqflags_t;
+
+extern void sim_irq_enable(void);
+extern void sim_irq_disable(void);
+extern irqflags_t sim_irq_save(void);
+extern void sim_irq_restore(irqflags_t flags);
+
+#define cpu_irq_enable()                    sim_irq_enable()
+#define cpu_irq_disable()                   sim_irq_disable()
+
+static inline irqflags_t cpu_irq_save(void)
+{
+    return sim_irq_save();
+}
+
+static inline void cpu_irq_restore(irqflags_t flags)
+{
+    sim_irq_restore(flags);
+}
+
+static inline bool cpu_irq_is_enabled_flags(irqflags_t flags)
+{
+    return !(flags & AVR32_SR_GM_MASK);
+}
+
+#define cpu_irq_is_enabled()                cpu_irq_is_enabled_flags(sysreg_read(AVR32_SR))
+
+#define Enable_global_interrupt()           cpu_irq_enable()
+#define Disable_global_interrupt()          cpu_irq_disable()
+#define Is_global_interrupt_enabled()       cpu_irq_is_enabled()
+
+#define ISR(func, int_grp, int_lvl)         static void func(void)
+#define irq_initialize_vectors()            INTC_init_interrupts()
+#define irq_register_handler(func, int_num, int_lvl)     INTC_register_interrupt(func, int_num, int_lvl)
+
+#endif // SIM_INTERRUPT_H
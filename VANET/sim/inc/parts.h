@@ -0,0 +1,31 @@
+/**
+ *	@file	parts.h
+ *
+ *	@brief	vanet-sim - Part selection for the host build
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_PARTS_H
+#define SIM_PARTS_H
+
+// We stand in for a UC3C0512C.  XMEGA/SAM are left undefined: sleepmgr.h
+// tests them with defined()
+#define UC3             1
+#define UC3C            1
+#define UC3A            0
+#define UC3B            0
+#define UC3D            0
+#define UC3L            0
+
+#endif // SIM_PARTS_H
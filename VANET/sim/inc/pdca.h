@@ -0,0 +1,50 @@
+/**
+ *	@file	pdca.h
+ *
+ *	@brief	vanet-sim - Peripheral DMA controller
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_PDCA_H
+#define SIM_PDCA_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+#define PDCA_TRANSFER_SIZE_BYTE             AVR32_PDCA_BYTE
+
+#define PDCA_SUCCESS                        0
+#define PDCA_INVALID_ARGUMENT               (-1)
+
+typedef struct
+{
+    volatile void   *addr;
+    unsigned int    size;
+    volatile void   *r_addr;
+    unsigned int    r_size;
+    unsigned int    pid;
+    unsigned int    transfer_size;
+} pdca_channel_options_t;
+
+extern volatile avr32_pdca_channel_t *pdca_get_handler(unsigned int pdca_ch_number);
+extern int pdca_init_channel(unsigned int pdca_ch_number, const pdca_channel_options_t *opt);
+extern void pdca_disable(unsigned int pdca_ch_number);
+extern void pdca_enable(unsigned int pdca_ch_number);
+extern unsigned int pdca_get_load_size(unsigned int pdca_ch_number);
+extern void pdca_load_channel(unsigned int pdca_ch_number, volatile void *addr, unsigned int size);
+extern unsigned int pdca_get_reload_size(unsigned int pdca_ch_number);
+extern void pdca_reload_channel(unsigned int pdca_ch_number, volatile void *addr, unsigned int size);
+extern void pdca_set_peripheral_select(unsigned int pdca_ch_number, unsigned int pid);
+
+#endif // SIM_PDCA_H
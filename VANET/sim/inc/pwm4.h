@@ -0,0 +1,54 @@
+/**
+ *	@file	pwm4.h
+ *
+ *	@brief	vanet-sim - PWM
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_PWM4_H
+#define SIM_PWM4_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+#define PWM_SUCCESS                                 0
+#define PWM_INVALID_INPUT                           1
+#define PWM_INVALID_ARGUMENT                        1
+
+#define PWM_MODE_LEFT_ALIGNED                       0
+#define PWM_MODE_CENTER_ALIGNED                     1
+#define PWM_POLARITY_LOW                            0
+#define PWM_POLARITY_HIGH                           1
+#define PWM_CKSEL_MCK                               0
+#define PWM_CKSEL_GCLK                              1
+#define PWM_SYNC_UPDATE_MANUAL_WRITE_MANUAL_UPDATE  0
+
+typedef struct
+{
+    unsigned char   diva, divb, prea, preb;
+    bool            fault_detection_activated;
+    bool            sync_channel_activated;
+    unsigned int    sync_update_channel_mode;
+    bool            sync_channel_select[4];
+    unsigned int    cksel;
+} pwm_opt_t;
+
+extern int pwm_init(const pwm_opt_t *opt);
+extern int pwm_channel_init(unsigned int channel_id, const avr32_pwm_channel_t *pwm_channel);
+extern int pwm_start_channels(unsigned long channels_bitmask);
+extern int pwm_stop_channels(unsigned long channels_bitmask);
+extern int pwm_update_channel(unsigned int channel_id, const avr32_pwm_channel_t *pwm_channel);
+extern int pwm_update_period_value(unsigned int value);
+
+#endif // SIM_PWM4_H
@@ -0,0 +1,44 @@
+/**
+ *	@file	reset_cause.h
+ *
+ *	@brief	vanet-sim - Reset cause
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_RESET_CAUSE_H
+#define SIM_RESET_CAUSE_H
+
+#include "compiler.h"
+
+#define RESET_CAUSE_BOD_CPU     0x0001
+#define RESET_CAUSE_BOD_IO      0x0002
+#define RESET_CAUSE_CPU_ERROR   0x0004
+#define RESET_CAUSE_EXTRST      0x0008
+#define RESET_CAUSE_JTAG        0x0010
+#define RESET_CAUSE_OCD         0x0020
+#define RESET_CAUSE_POR         0x0040
+#define RESET_CAUSE_SLEEP       0x0080
+#define RESET_CAUSE_SOFT        0x0100
+#define RESET_CAUSE_SPIKE       0x0200
+#define RESET_CAUSE_WDT         0x0400
+
+typedef uint32_t reset_cause_t;
+
+/// Power-on the first time, soft after reset_do_soft_reset()
+extern reset_cause_t reset_cause_get_causes(void);
+
+/// Restart the simulator in place (re-exec with the same arguments)
+extern void reset_do_soft_reset(void) __attribute__((noreturn));
+
+#endif // SIM_RESET_CAUSE_H
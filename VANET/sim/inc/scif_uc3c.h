@@ -0,0 +1,28 @@
+/**
+ *	@file	scif_uc3c.h
+ *
+ *	@brief	vanet-sim - SCIF general purpose low-power registers
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_SCIF_UC3C_H
+#define SIM_SCIF_UC3C_H
+
+#include "compiler.h"
+
+/// The GPLP registers survive a (simulated) soft reset
+extern unsigned long scif_read_gplp(unsigned long gplp);
+extern void scif_write_gplp(int gplp, unsigned long value);
+
+#endif // SIM_SCIF_UC3C_H
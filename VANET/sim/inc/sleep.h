@@ -0,0 +1,30 @@
+/**
+ *	@file	sleep.h
+ *
+ *	@brief	vanet-sim - Power manager sleep
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_SLEEP_H
+#define SIM_SLEEP_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+/// Sleep until an interrupt is pending.  GMCLEAR unmasks interrupts on the way in
+extern void sim_cpu_sleep(uint32_t mode);
+
+#define pm_sleep(mode)                      sim_cpu_sleep(mode)
+
+#endif // SIM_SLEEP_H
@@ -0,0 +1,29 @@
+/**
+ *	@file	sleepmgr.h
+ *
+ *	@brief	vanet-sim - Sleep manager
+ *
+ *	The ASF sleep manager is used as-is.  It picks its UC3 flavour on __AVR32__,
+ *	which the host compiler doesn't define.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_SLEEPMGR_H
+#define SIM_SLEEPMGR_H
+
+#define __AVR32__ 1
+#include "../../bsp/src/asf/common/services/sleepmgr/sleepmgr.h"
+#undef __AVR32__
+
+#endif // SIM_SLEEPMGR_H
@@ -0,0 +1,24 @@
+/**
+ *	@file	status_codes.h
+ *
+ *	@brief	vanet-sim - ASF status codes
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_STATUS_CODES_H
+#define SIM_STATUS_CODES_H
+
+#include "../../bsp/src/asf/avr32/utils/status_codes.h"
+
+#endif // SIM_STATUS_CODES_H
@@ -0,0 +1,47 @@
+/**
+ *	@file	sysclk.h
+ *
+ *	@brief	vanet-sim - System clocks
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_SYSCLK_H
+#define SIM_SYSCLK_H
+
+#include "compiler.h"
+#include "conf_clock.h"
+
+/// The daughterboard runs everything off a 32 MHz PLL
+#define SIM_SYSCLK_HZ               32000000UL
+
+#define OSC_ID_OSC0                 0
+#define OSC_ID_OSC1                 1
+#define OSC_ID_OSC32                2
+#define OSC_ID_RC32K                3
+
+static inline void sysclk_init(void) {}
+static inline uint32_t sysclk_get_main_hz(void) { return SIM_SYSCLK_HZ; }
+static inline uint32_t sysclk_get_cpu_hz(void) { return SIM_SYSCLK_HZ; }
+static inline uint32_t sysclk_get_pba_hz(void) { return SIM_SYSCLK_HZ; }
+static inline uint32_t sysclk_get_pbb_hz(void) { return SIM_SYSCLK_HZ; }
+static inline uint32_t sysclk_get_pbc_hz(void) { return SIM_SYSCLK_HZ; }
+static inline uint32_t sysclk_get_peripheral_bus_hz(const volatile void *module) { (void)module; return SIM_SYSCLK_HZ; }
+static inline void sysclk_enable_peripheral_clock(const volatile void *module) { (void)module; }
+static inline void sysclk_disable_peripheral_clock(const volatile void *module) { (void)module; }
+
+static inline void osc_enable(uint8_t id) { (void)id; }
+static inline bool osc_is_ready(uint8_t id) { (void)id; return true; }
+static inline void osc_wait_ready(uint8_t id) { (void)id; }
+
+#endif // SIM_SYSCLK_H
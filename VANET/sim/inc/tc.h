@@ -0,0 +1,97 @@
+/**
+ *	@file	tc.h
+ *
+ *	@brief	vanet-sim - Timer/counter
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_TC_H
+#define SIM_TC_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+#define TC_INVALID_ARGUMENT                 (-1)
+
+#define TC_CLOCK_SOURCE_TC1                 0   // 32 kHz
+#define TC_CLOCK_SOURCE_TC2                 1   // PBA / 2
+#define TC_CLOCK_SOURCE_TC3                 2   // PBA / 8
+#define TC_CLOCK_SOURCE_TC4                 3   // PBA / 32
+#define TC_CLOCK_SOURCE_TC5                 4   // PBA / 128
+#define TC_CLOCK_SOURCE_XC0                 5
+#define TC_CLOCK_SOURCE_XC1                 6
+#define TC_CLOCK_SOURCE_XC2                 7
+
+#define TC_WAVEFORM_SEL_UP_MODE             0
+#define TC_WAVEFORM_SEL_UPDOWN_MODE         1
+#define TC_WAVEFORM_SEL_UP_MODE_RC_TRIGGER  2
+#define TC_WAVEFORM_SEL_UPDOWN_MODE_RC_TRIGGER 3
+
+#define TC_EVT_EFFECT_NOOP                  0
+#define TC_EVT_EFFECT_SET                   1
+#define TC_EVT_EFFECT_CLEAR                 2
+#define TC_EVT_EFFECT_TOGGLE                3
+
+#define TC_EXT_EVENT_SEL_TIOB_INPUT         0
+#define TC_EXT_EVENT_SEL_XC0_OUTPUT         1
+#define TC_EXT_EVENT_SEL_XC1_OUTPUT         2
+#define TC_EXT_EVENT_SEL_XC2_OUTPUT         3
+
+#define TC_SEL_NO_EDGE                      0
+#define TC_SEL_RISING_EDGE                  1
+#define TC_SEL_FALLING_EDGE                 2
+#define TC_SEL_EACH_EDGE                    3
+
+#define TC_BURST_NOT_GATED                  0
+#define TC_CLOCK_RISING_EDGE                0
+#define TC_CLOCK_FALLING_EDGE               1
+
+typedef struct
+{
+    unsigned int channel;
+    unsigned int bswtrg, beevt, bcpc, bcpb;
+    unsigned int aswtrg, aeevt, acpc, acpa;
+    unsigned int wavsel;
+    bool enetrg;
+    unsigned int eevt, eevtedg;
+    bool cpcdis, cpcstop;
+    unsigned int burst;
+    bool clki;
+    unsigned int tcclks;
+} tc_waveform_opt_t;
+
+typedef struct
+{
+    unsigned int etrgs:1;
+    unsigned int ldrbs:1;
+    unsigned int ldras:1;
+    unsigned int cpcs:1;
+    unsigned int cpbs:1;
+    unsigned int cpas:1;
+    unsigned int lovrs:1;
+    unsigned int covfs:1;
+} tc_interrupt_t;
+
+extern int tc_init_waveform(volatile avr32_tc_t *tc, const tc_waveform_opt_t *opt);
+extern int tc_configure_interrupts(volatile avr32_tc_t *tc, unsigned int channel, const tc_interrupt_t *bitfield);
+extern int tc_start(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_stop(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_software_trigger(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_read_sr(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_read_tc(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_write_ra(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value);
+extern int tc_write_rb(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value);
+extern int tc_write_rc(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value);
+
+#endif // SIM_TC_H
@@ -0,0 +1,49 @@
+/**
+ *	@file	twim.h
+ *
+ *	@brief	vanet-sim - Two-wire master
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_TWIM_H
+#define SIM_TWIM_H
+
+#include "compiler.h"
+#include "status_codes.h"
+#include <avr32/io.h>
+
+typedef struct
+{
+    uint32_t    pba_hz;
+    uint32_t    speed;
+    uint32_t    chip;
+    bool        smbus;
+} twim_options_t;
+
+typedef struct
+{
+    uint32_t    chip;
+    uint8_t     addr[3];
+    uint8_t     addr_length;
+    void        *buffer;
+    uint32_t    length;
+} twim_package_t;
+
+#define twi_options_t       twim_options_t
+#define twi_package_t       twim_package_t
+
+// the BSP drives the registers itself (see sim_twim.c) - only the clock maths is borrowed
+extern status_code_t twim_set_speed(volatile avr32_twim_t *twim, uint32_t speed, uint32_t pba_hz);
+
+#endif // SIM_TWIM_H
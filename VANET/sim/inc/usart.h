@@ -0,0 +1,89 @@
+/**
+ *	@file	usart.h
+ *
+ *	@brief	vanet-sim - USART
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_USART_H
+#define SIM_USART_H
+
+#include "compiler.h"
+#include <avr32/io.h>
+
+#define USART_SUCCESS                 0
+#define USART_FAILURE                -1
+#define USART_INVALID_INPUT           1
+#define USART_INVALID_ARGUMENT       -1
+#define USART_TX_BUSY                 2
+#define USART_RX_EMPTY                3
+#define USART_RX_ERROR                4
+#define USART_MODE_FAULT              5
+
+#define USART_DEFAULT_TIMEOUT         10000
+
+#define USART_EVEN_PARITY             0
+#define USART_ODD_PARITY              1
+#define USART_SPACE_PARITY            2
+#define USART_MARK_PARITY             3
+#define USART_NO_PARITY               4
+#define USART_MULTIDROP_PARITY        6
+
+#define USART_1_STOPBIT               0
+#define USART_1_5_STOPBITS            1
+#define USART_2_STOPBITS              2
+
+#define USART_NORMAL_CHMODE           0
+#define USART_AUTO_ECHO               1
+#define USART_LOCAL_LOOPBACK          2
+#define USART_REMOTE_LOOPBACK         3
+
+typedef struct
+{
+    unsigned long   baudrate;
+    unsigned char   charlength;
+    unsigned char   paritytype;
+    unsigned short  stopbits;
+    unsigned char   channelmode;
+} usart_options_t;
+
+extern void usart_reset(volatile avr32_usart_t *usart);
+extern int usart_init_rs232(volatile avr32_usart_t *usart, const usart_options_t *opt, long pba_hz);
+extern int usart_write_char(volatile avr32_usart_t *usart, int c);
+extern int usart_putchar(volatile avr32_usart_t *usart, int c);
+extern int usart_read_char(volatile avr32_usart_t *usart, int *c);
+extern int usart_getchar(volatile avr32_usart_t *usart);
+extern void usart_write_line(volatile avr32_usart_t *usart, const char *string);
+
+static inline void usart_reset_status(volatile avr32_usart_t *usart)
+{
+    usart->csr &= ~(AVR32_USART_CSR_OVRE_MASK | AVR32_USART_CSR_FRAME_MASK | AVR32_USART_CSR_PARE_MASK);
+}
+
+static inline int usart_tx_ready(volatile avr32_usart_t *usart)
+{
+    return (usart->csr & AVR32_USART_CSR_TXRDY_MASK) != 0;
+}
+
+static inline int usart_tx_empty(volatile avr32_usart_t *usart)
+{
+    return (usart->csr & AVR32_USART_CSR_TXEMPTY_MASK) != 0;
+}
+
+static inline int usart_test_hit(volatile avr32_usart_t *usart)
+{
+    return (usart->csr & AVR32_USART_CSR_RXRDY_MASK) != 0;
+}
+
+#endif // SIM_USART_H
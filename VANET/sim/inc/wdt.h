@@ -0,0 +1,27 @@
+/**
+ *	@file	wdt.h
+ *
+ *	@brief	vanet-sim - Watchdog
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_WDT_H
+#define SIM_WDT_H
+
+#include "compiler.h"
+
+static inline void wdt_disable(void) {}
+static inline void wdt_clear(void) {}
+
+#endif // SIM_WDT_H
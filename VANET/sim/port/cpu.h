@@ -0,0 +1,85 @@
+/**
+ *	@file	cpu.h
+ *
+ *	@brief	vanet-sim - uC/CPU port for the host build
+ *
+ *	Same types as the AVR32 port (32-bit words) except for the byte order.
+ *	Critical sections go through the simulated status register in sim_cpu.c.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef  CPU_MODULE_PRESENT
+#define  CPU_MODULE_PRESENT
+
+#include  <cpu_def.h>
+#include  <cpu_cfg.h>
+
+typedef            void        CPU_VOID;
+typedef            char        CPU_CHAR;
+typedef  unsigned  char        CPU_BOOLEAN;
+typedef  unsigned  char        CPU_INT08U;
+typedef    signed  char        CPU_INT08S;
+typedef  unsigned  short       CPU_INT16U;
+typedef    signed  short       CPU_INT16S;
+typedef  unsigned  int         CPU_INT32U;
+typedef    signed  int         CPU_INT32S;
+typedef  unsigned  long  long  CPU_INT64U;
+typedef    signed  long  long  CPU_INT64S;
+
+typedef            float       CPU_FP32;
+typedef            double      CPU_FP64;
+
+typedef  volatile  CPU_INT08U  CPU_REG08;
+typedef  volatile  CPU_INT16U  CPU_REG16;
+typedef  volatile  CPU_INT32U  CPU_REG32;
+typedef  volatile  CPU_INT64U  CPU_REG64;
+
+typedef            void      (*CPU_FNCT_VOID)(void);
+typedef            void      (*CPU_FNCT_PTR )(void *p_obj);
+
+// Addresses are 32 bits like the target.  The sim links non-PIE and keeps its
+// thread stacks below 4G (see sim_cpu.c) so this holds for anything the
+// firmware can point at.
+#define  CPU_CFG_ADDR_SIZE              CPU_WORD_SIZE_32
+#define  CPU_CFG_DATA_SIZE              CPU_WORD_SIZE_32
+#define  CPU_CFG_DATA_SIZE_MAX          CPU_WORD_SIZE_64
+
+#define  CPU_CFG_ENDIAN_TYPE            CPU_ENDIAN_TYPE_LITTLE
+
+typedef  CPU_INT32U  CPU_ADDR;
+typedef  CPU_INT32U  CPU_DATA;
+typedef  CPU_DATA    CPU_ALIGN;
+typedef  CPU_ADDR    CPU_SIZE_T;
+
+#define  CPU_CFG_STK_GROWTH             CPU_STK_GROWTH_HI_TO_LO
+
+typedef  CPU_INT32U                     CPU_STK;
+typedef  CPU_ADDR                       CPU_STK_SIZE;
+
+#define  CPU_CFG_CRITICAL_METHOD        CPU_CRITICAL_METHOD_STATUS_LOCAL
+
+typedef  CPU_INT32U                     CPU_SR;
+
+#define  CPU_SR_ALLOC()                 CPU_SR  cpu_sr = (CPU_SR)0
+
+#define  CPU_INT_DIS()                  do { cpu_sr = CPU_SR_Save(); } while (0)
+#define  CPU_INT_EN()                   do { CPU_SR_Restore(cpu_sr); } while (0)
+
+#define  CPU_CRITICAL_ENTER()           do { CPU_INT_DIS(); } while (0)
+#define  CPU_CRITICAL_EXIT()            do { CPU_INT_EN();  } while (0)
+
+CPU_SR   CPU_SR_Save    (void);
+void     CPU_SR_Restore (CPU_SR  cpu_sr);
+
+#endif // CPU_MODULE_PRESENT
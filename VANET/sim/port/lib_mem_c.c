@@ -0,0 +1,32 @@
+/**
+ *	@file	lib_mem_c.c
+ *
+ *	@brief	vanet-sim - C stand-in for micrium/lib/avr32/lib_mem_a.S
+ *
+ *	lib_cfg.h asks for the assembly Mem_Copy(), so lib_mem.c leaves it out.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include  <string.h>
+#include  <lib_mem.h>
+
+void  Mem_Copy (      void        *pdest,
+                const void        *psrc,
+                      CPU_SIZE_T   size)
+{
+    if ((pdest == (void *)0) || (psrc == (const void *)0) || (size < 1))
+        return;
+
+    memcpy(pdest, psrc, size);
+}
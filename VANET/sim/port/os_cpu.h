@@ -0,0 +1,60 @@
+/**
+ *	@file	os_cpu.h
+ *
+ *	@brief	vanet-sim - uC/OS-II port for the host build
+ *
+ *	Every task is a pthread.  Only the thread owning OSTCBCur runs; a context
+ *	switch hands the "CPU" to the thread of OSTCBHighRdy and waits to be handed
+ *	it back (see sim_cpu.c).
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef  OS_CPU_H
+#define  OS_CPU_H
+
+#include  <cpu.h>
+
+#ifdef    OS_CPU_GLOBALS
+#define   OS_CPU_EXT
+#else
+#define   OS_CPU_EXT  extern
+#endif
+
+typedef  CPU_BOOLEAN    BOOLEAN;
+typedef  CPU_INT08U     INT8U;
+typedef  CPU_INT08S     INT8S;
+typedef  CPU_INT16U     INT16U;
+typedef  CPU_INT16S     INT16S;
+typedef  CPU_INT32U     INT32U;
+typedef  CPU_INT32S     INT32S;
+typedef  CPU_FP32       FP32;
+typedef  CPU_FP64       FP64;
+
+typedef  CPU_STK        OS_STK;
+typedef  CPU_SR         OS_CPU_SR;
+
+#define  OS_CRITICAL_METHOD     CPU_CFG_CRITICAL_METHOD
+
+#define  OS_ENTER_CRITICAL()    {CPU_CRITICAL_ENTER();}
+#define  OS_EXIT_CRITICAL()     {CPU_CRITICAL_EXIT();}
+
+#define  OS_STK_GROWTH          1
+
+#define  OS_TASK_SW()           OSCtxSw()
+
+void  OSCtxSw(void);
+void  OSIntCtxSw(void);
+void  OSStartHighRdy(void);
+
+#endif // OS_CPU_H
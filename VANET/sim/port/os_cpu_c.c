@@ -0,0 +1,184 @@
+/**
+ *	@file	os_cpu_c.c
+ *
+ *	@brief	vanet-sim - uC/OS-II port for the host build
+ *
+ *	The hooks are the AVR32 port's.  A task's "stack pointer" is the handle of
+ *	the thread that runs it; switching context is handing the CPU lock to that
+ *	thread (sim_cpu.c).
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define   OS_CPU_GLOBALS
+#include  <ucos_ii.h>
+#include  <interrupt.h>
+#include  "sim.h"
+
+#if      (OS_VERSION >= 281) && (OS_TMR_EN > 0)
+static  INT16U  OSTmrCtr;
+#endif
+
+/*---------------------------------------------------------------------------
+ * Critical sections
+ *---------------------------------------------------------------------------*/
+
+CPU_SR  CPU_SR_Save (void)
+{
+    return sim_irq_save();
+}
+
+void  CPU_SR_Restore (CPU_SR  cpu_sr)
+{
+    sim_irq_restore(cpu_sr);
+}
+
+/*---------------------------------------------------------------------------
+ * Hooks
+ *---------------------------------------------------------------------------*/
+
+#if (OS_CPU_HOOKS_EN > 0) && (OS_VERSION > 203)
+void  OSInitHookBegin (void)
+{
+#if (OS_VERSION >= 281) && (OS_TMR_EN > 0)
+    OSTmrCtr = 0;
+#endif
+}
+
+void  OSInitHookEnd (void)
+{
+}
+#endif
+
+#if OS_CPU_HOOKS_EN > 0
+void  OSTaskCreateHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TaskCreateHook(ptcb);
+#else
+    (void)ptcb;
+#endif
+}
+
+void  OSTaskDelHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TaskDelHook(ptcb);
+#else
+    (void)ptcb;
+#endif
+}
+
+void  OSTaskReturnHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TaskReturnHook(ptcb);
+#else
+    (void)ptcb;
+#endif
+}
+
+void  OSTaskStatHook (void)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TaskStatHook();
+#endif
+}
+#endif
+
+#if (OS_CPU_HOOKS_EN > 0) && (OS_VERSION >= 251)
+void  OSTaskIdleHook (void)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TaskIdleHook();
+#endif
+}
+#endif
+
+#if (OS_CPU_HOOKS_EN > 0) && (OS_TASK_SW_HOOK_EN > 0)
+void  OSTaskSwHook (void)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TaskSwHook();
+#endif
+}
+#endif
+
+#if (OS_CPU_HOOKS_EN > 0) && (OS_VERSION > 203)
+void  OSTCBInitHook (OS_TCB *ptcb)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TCBInitHook(ptcb);
+#else
+    (void)ptcb;
+#endif
+}
+#endif
+
+#if (OS_CPU_HOOKS_EN > 0) && (OS_TIME_TICK_HOOK_EN > 0)
+void  OSTimeTickHook (void)
+{
+#if OS_APP_HOOKS_EN > 0
+    App_TimeTickHook();
+#endif
+
+#if (OS_VERSION >= 281) && (OS_TMR_EN > 0)
+    OSTmrCtr++;
+    if (OSTmrCtr >= (OS_TICKS_PER_SEC / OS_TMR_CFG_TICKS_PER_SEC)) {
+        OSTmrCtr = 0;
+        OSTmrSignal();
+    }
+#endif
+}
+#endif
+
+/*---------------------------------------------------------------------------
+ * Context
+ *---------------------------------------------------------------------------*/
+
+OS_STK  *OSTaskStkInit (void (*task)(void *pd), void *p_arg, OS_STK *ptos, INT16U opt)
+{
+    (void)ptos;
+    (void)opt;
+
+    // the task's stack array is left alone - the thread has its own
+    return ((OS_STK *)sim_task_create(task, p_arg));
+}
+
+void  OSCtxSw (void)
+{
+    OSTaskSwHook();
+
+    OSTCBCur  = OSTCBHighRdy;
+    OSPrioCur = OSPrioHighRdy;
+
+    sim_task_switch();
+}
+
+void  OSIntCtxSw (void)
+{
+    OSTaskSwHook();
+
+    OSTCBCur  = OSTCBHighRdy;
+    OSPrioCur = OSPrioHighRdy;
+
+    sim_task_switch();
+}
+
+void  OSStartHighRdy (void)
+{
+    OSTaskSwHook();
+    OSRunning = 1;
+
+    sim_task_start();
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Replay a termios capture in vanet-sim and print the result line
+#
+#   ./replay.sh <capture> [speed]
+#
+# Captures come from "capture file" here or "vcap rec" on the mainboard.  The
+# speed is times the recorded pace (default 100), 0 as fast as the firmware
+# takes it.  The result is key=value - speed= is what was achieved, stalls=
+# counts the times a port's receive buffer was full.
+#
+
+[ -r "$1" ] || { echo "usage: $0 <capture> [speed]" >&2; exit 1; }
+capture=$(realpath "$1")
+
+dir=$(mktemp -d /tmp/vanet-replay.XXXXXX) || exit 1
+
+./vanet-sim -d "$dir" -D -P > "$dir/sim.log" 2>&1 &
+sim=$!
+trap 'kill $sim 2>/dev/null; rm -rf "$dir"' EXIT
+
+n=0
+while [ ! -e "$dir/debug" ]; do
+    n=$((n + 1))
+    if [ $n -gt 50 ]; then
+        echo "vanet-sim didn't start:" >&2
+        cat "$dir/sim.log" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+exec 3<> "$dir/debug"
+stty -F "$dir/debug" raw -echo
+
+# let the tasks come up before STI gets the command
+sleep 2
+printf 'replay file %s %s\r\n' "$capture" "${2:-100}" >&3
+printf 'replay wait\r\n' >&3
+
+while IFS= read -r line <&3; do
+    line=$(printf '%s' "$line" | tr -d '\r')
+    case "$line" in
+        "replay state="*) echo "$line"; break ;;
+    esac
+done
@@ -0,0 +1,126 @@
+/**
+ *	@file	sim.h
+ *
+ *	@brief	vanet-sim - Simulator internals shared by the peripheral models
+ *
+ *	Two locks run the show.  The CPU lock is held by whichever firmware thread
+ *	is executing (one task at a time, like the part).  The bus lock protects
+ *	the peripheral registers; the model threads only ever take the bus lock,
+ *	the firmware takes it under the CPU lock (never the other way around).
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/*---------------------------------------------------------------------------
+ * Peripheral models
+ *---------------------------------------------------------------------------*/
+
+/// A peripheral model as seen by the interrupt dispatcher
+typedef struct sim_model
+{
+    const char          *name;
+    uint32_t            irq_first;          ///< first INTC line owned by the model
+    uint32_t            irq_count;          ///< number of lines owned
+    void                (*sync)(void);      ///< fold firmware register writes into model state (bus lock held)
+    bool                (*pending)(uint32_t irq);   ///< level of an owned line (bus lock held)
+    struct sim_model    *next;
+} sim_model_t;
+
+/// Hook a model into the dispatcher.  Call before the firmware starts
+extern void sim_model_register(sim_model_t *model);
+
+/// Take / release the bus lock
+extern void sim_bus_lock(void);
+extern void sim_bus_unlock(void);
+
+/// Tell a sleeping CPU that a line may have changed (bus lock held)
+extern void sim_bus_kick(void);
+
+/// Wait on the bus condition (bus lock held).  abstime NULL waits forever
+extern int sim_bus_wait(const struct timespec *abstime);
+
+/// Nanoseconds since the simulator started (CLOCK_MONOTONIC)
+extern uint64_t sim_now_ns(void);
+
+/// An absolute CLOCK_MONOTONIC time ns from now, for sim_bus_wait()
+extern void sim_abstime(struct timespec *ts, uint64_t ns);
+
+/// Start a thread the firmware can run on (stack below 4G, see sim_cpu.c)
+extern int sim_thread_create(pthread_t *thread, void *(*fn)(void *), void *arg);
+
+/// Diagnostics from the simulator itself (stderr, never the debug USART)
+extern void sim_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/*---------------------------------------------------------------------------
+ * Model bring-up, called from sim_main.c in this order
+ *---------------------------------------------------------------------------*/
+
+typedef struct
+{
+    const char  *dir;                   ///< where the pty links and the lcd file go
+    const char  *codeplug;              ///< user page and codeplug journal backing file
+    bool        console;                ///< debug USART on stdin/stdout
+    bool        pps;                    ///< 1PPS on the GPS timepulse pin
+    bool        count_stops;            ///< COUNT stops while the CPU sleeps
+} sim_config_t;
+
+extern sim_config_t g_sim;
+
+extern void sim_cpu_init(void);
+extern void sim_reset_init(char **argv);
+extern void sim_flash_init(void);
+extern void sim_gpio_init(void);
+extern void sim_usart_init(void);
+extern void sim_ast_init(void);
+extern void sim_tc_init(void);
+extern void sim_twim_init(void);
+
+/// Run the firmware.  Never returns
+extern void sim_cpu_run(int (*entry)(void)) __attribute__((noreturn));
+
+/*---------------------------------------------------------------------------
+ * uC/OS-II port (sim/port/os_cpu_c.c)
+ *---------------------------------------------------------------------------*/
+
+typedef struct sim_task sim_task_t;
+
+/// A thread for a new task.  It waits until the task is OSTCBCur
+extern sim_task_t *sim_task_create(void (*task)(void *p_arg), void *p_arg);
+
+/// OSTCBCur has changed: run it and wait until we are current again
+extern void sim_task_switch(void);
+
+/// OSTCBCur is the first task: run it and abandon the boot context
+extern void sim_task_start(void) __attribute__((noreturn));
+
+/// Drive an input pin from outside the part (bus lock held)
+extern void sim_gpio_drive(uint32_t pin, bool level);
+
+/// Bytes the enabled PDCA channel for a peripheral still has to move (bus lock held)
+extern uint32_t sim_pdca_ready(uint32_t pid);
+
+/// Move up to len bytes through a peripheral's PDCA channel, returning how many (bus lock held)
+extern uint32_t sim_pdca_move(uint32_t pid, uint8_t *buf, uint32_t len, bool to_memory);
+
+/// Restore the host terminal (debug console) before exit / exec
+extern void sim_usart_shutdown(void);
+
+#endif // SIM_H
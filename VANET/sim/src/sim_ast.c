@@ -0,0 +1,323 @@
+/**
+ *	@file	sim_ast.c
+ *
+ *	@brief	vanet-sim - AST model (counter mode, periodic 0 and alarm 0)
+ *
+ *	The counter is computed from the host monotonic clock.  A thread raises
+ *	PER0 on the prescaler period and ALARM0 when the counter passes AR0.  A
+ *	periodic event that lands while the last one is still pending is lost,
+ *	as on the part.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <time.h>
+
+#include <asf.h>
+#include "sim.h"
+
+#define SIM_AST_IDLE_NS             1000000000ULL
+
+volatile avr32_ast_t sim_ast;
+
+static uint32_t s_osc_hz;           ///< AST clock source
+static uint32_t s_psel;             ///< counter prescaler
+static bool s_enabled;
+static uint64_t s_base_ns;          ///< host time at which the counter held s_base_cv
+static uint32_t s_base_cv;
+static uint64_t s_next_per_ns;      ///< next PER0 event
+
+/*---------------------------------------------------------------------------
+ * Model (bus lock held)
+ *---------------------------------------------------------------------------*/
+
+static uint64_t sim_ast_counter_hz_x1000(void)
+{
+    return (uint64_t)s_osc_hz * 1000 >> (s_psel + 1);
+}
+
+static uint32_t sim_ast_cv(uint64_t now)
+{
+    if (!s_enabled || !s_osc_hz)
+        return s_base_cv;
+    return s_base_cv + (uint32_t)((now - s_base_ns) * sim_ast_counter_hz_x1000() / 1000000000000ULL);
+}
+
+static uint64_t sim_ast_per_ns(void)
+{
+    avr32_ast_pir0_t pir;
+
+    pir = *(avr32_ast_pir0_t *)&sim_ast.pir0;
+    return 1000000000ULL * (2ULL << pir.insel) / s_osc_hz;
+}
+
+/// host time at which the counter reaches cv
+static uint64_t sim_ast_cv_ns(uint32_t cv)
+{
+    return s_base_ns + (uint64_t)(uint32_t)(cv - s_base_cv) * 1000000000000ULL / sim_ast_counter_hz_x1000();
+}
+
+static void sim_ast_sync(void)
+{
+    if (sim_ast.scr)
+    {
+        sim_ast.sr &= ~sim_ast.scr;
+        sim_ast.scr = 0;
+    }
+    if (sim_ast.ier)
+    {
+        sim_ast.imr |= sim_ast.ier;
+        sim_ast.ier = 0;
+    }
+    if (sim_ast.idr)
+    {
+        sim_ast.imr &= ~sim_ast.idr;
+        sim_ast.idr = 0;
+    }
+    sim_ast.cv = sim_ast_cv(sim_now_ns());
+}
+
+static bool sim_ast_pending(uint32_t irq)
+{
+    switch (irq)
+    {
+        case AVR32_AST_PER_IRQ:
+            return (sim_ast.sr & sim_ast.imr & AVR32_AST_SR_PER0_MASK) != 0;
+        case AVR32_AST_ALARM_IRQ:
+            return (sim_ast.sr & sim_ast.imr & AVR32_AST_SR_ALARM0_MASK) != 0;
+        default:
+            return false;
+    }
+}
+
+static sim_model_t s_ast_model =
+{
+    .name = "ast",
+    .irq_first = AVR32_AST_ALARM_IRQ,
+    .irq_count = 3,
+    .sync = sim_ast_sync,
+    .pending = sim_ast_pending,
+};
+
+static void *sim_ast_thread(void *arg)
+{
+    struct timespec ts;
+
+    sim_bus_lock();
+    for (;;)
+    {
+        uint64_t now = sim_now_ns();
+        uint64_t wake = now + SIM_AST_IDLE_NS;
+
+        if (s_enabled && s_osc_hz)
+        {
+            if (sim_ast.cr & AVR32_AST_PER0_MASK)
+            {
+                if (now >= s_next_per_ns)
+                {
+                    sim_ast.sr |= AVR32_AST_SR_PER0_MASK;
+                    while (s_next_per_ns <= now)
+                        s_next_per_ns += sim_ast_per_ns();
+                    sim_bus_kick();
+                }
+                wake = Min(wake, s_next_per_ns);
+            }
+
+            if ((sim_ast.cr & AVR32_AST_ALARM0_MASK) && !(sim_ast.sr & AVR32_AST_SR_ALARM0_MASK))
+            {
+                uint64_t alarm = sim_ast_cv_ns(sim_ast.ar0);
+
+                if ((int32_t)(sim_ast_cv(now) - sim_ast.ar0) >= 0)
+                {
+                    sim_ast.sr |= AVR32_AST_SR_ALARM0_MASK;
+                    sim_bus_kick();
+                }
+                else
+                {
+                    wake = Min(wake, alarm);
+                }
+            }
+        }
+
+        // anything the firmware changes kicks us too
+        ts.tv_sec = 0;
+        sim_abstime(&ts, wake - now);
+        sim_bus_wait(&ts);
+    }
+    return NULL;
+}
+
+void sim_ast_init(void)
+{
+    pthread_t thread;
+
+    sim_model_register(&s_ast_model);
+    pthread_create(&thread, NULL, sim_ast_thread, NULL);
+}
+
+/*---------------------------------------------------------------------------
+ * ASF driver
+ *---------------------------------------------------------------------------*/
+
+// cr bits this model uses to remember which events are on
+#define SIM_AST_CR_PER0             AVR32_AST_PER0_MASK
+#define SIM_AST_CR_ALARM0           AVR32_AST_ALARM0_MASK
+
+bool ast_init_counter(volatile avr32_ast_t *ast, unsigned char osc_type, unsigned char psel, unsigned long ast_counter)
+{
+    static const uint32_t osc_hz[] = { 115000, 32768, SIM_SYSCLK_HZ, SIM_SYSCLK_HZ, 1024 };
+
+    sim_bus_lock();
+    s_osc_hz = osc_hz[osc_type < 5 ? osc_type : 1];
+    s_psel = psel;
+    s_base_ns = sim_now_ns();
+    s_base_cv = ast_counter;
+    ast->cv = ast_counter;
+    sim_bus_kick();
+    sim_bus_unlock();
+    return true;
+}
+
+void ast_enable(volatile avr32_ast_t *ast)
+{
+    sim_bus_lock();
+    if (!s_enabled)
+    {
+        s_enabled = true;
+        s_base_ns = sim_now_ns();
+        s_next_per_ns = s_base_ns + sim_ast_per_ns();
+    }
+    sim_bus_kick();
+    sim_bus_unlock();
+}
+
+void ast_disable(volatile avr32_ast_t *ast)
+{
+    sim_bus_lock();
+    s_base_cv = sim_ast_cv(sim_now_ns());
+    s_enabled = false;
+    sim_bus_unlock();
+}
+
+void ast_set_counter_value(volatile avr32_ast_t *ast, unsigned long ast_counter)
+{
+    sim_bus_lock();
+    s_base_ns = sim_now_ns();
+    s_base_cv = ast_counter;
+    ast->cv = ast_counter;
+    sim_bus_kick();
+    sim_bus_unlock();
+}
+
+unsigned long ast_get_counter_value(volatile avr32_ast_t *ast)
+{
+    unsigned long cv;
+
+    sim_bus_lock();
+    cv = sim_ast_cv(sim_now_ns());
+    sim_bus_unlock();
+    return cv;
+}
+
+void ast_set_alarm0_value(volatile avr32_ast_t *ast, uint32_t alarm_value)
+{
+    sim_bus_lock();
+    ast->ar0 = alarm_value;
+    sim_bus_kick();
+    sim_bus_unlock();
+}
+
+void ast_set_periodic0_value(volatile avr32_ast_t *ast, avr32_ast_pir0_t pir)
+{
+    sim_bus_lock();
+    *(avr32_ast_pir0_t *)&ast->pir0 = pir;
+    s_next_per_ns = sim_now_ns() + sim_ast_per_ns();
+    sim_bus_kick();
+    sim_bus_unlock();
+}
+
+static void sim_ast_modify(volatile uint32_t *reg, uint32_t mask, bool set)
+{
+    sim_bus_lock();
+    if (set)
+        *reg |= mask;
+    else
+        *reg &= ~mask;
+    sim_bus_kick();
+    sim_bus_unlock();
+}
+
+void ast_enable_alarm0(volatile avr32_ast_t *ast)
+{
+    sim_ast_modify(&ast->cr, SIM_AST_CR_ALARM0, true);
+}
+
+void ast_disable_alarm0(volatile avr32_ast_t *ast)
+{
+    sim_ast_modify(&ast->cr, SIM_AST_CR_ALARM0, false);
+}
+
+void ast_enable_periodic0(volatile avr32_ast_t *ast)
+{
+    sim_ast_modify(&ast->cr, SIM_AST_CR_PER0, true);
+}
+
+void ast_disable_periodic0(volatile avr32_ast_t *ast)
+{
+    sim_ast_modify(&ast->cr, SIM_AST_CR_PER0, false);
+}
+
+void ast_clear_all_status_flags(volatile avr32_ast_t *ast)
+{
+    sim_ast_modify(&ast->sr, 0xffffffff, false);
+}
+
+void ast_enable_alarm_interrupt(volatile avr32_ast_t *ast, uint8_t alarm_channel)
+{
+    sim_ast_modify(&ast->imr, AVR32_AST_ALARM0_MASK << alarm_channel, true);
+}
+
+void ast_disable_alarm_interrupt(volatile avr32_ast_t *ast, uint8_t alarm_channel)
+{
+    sim_ast_modify(&ast->imr, AVR32_AST_ALARM0_MASK << alarm_channel, false);
+}
+
+void ast_clear_alarm_status_flag(volatile avr32_ast_t *ast, uint32_t alarm_channel)
+{
+    sim_ast_modify(&ast->sr, AVR32_AST_ALARM0_MASK << alarm_channel, false);
+}
+
+void ast_enable_periodic_interrupt(volatile avr32_ast_t *ast, uint8_t periodic_channel)
+{
+    sim_ast_modify(&ast->imr, AVR32_AST_PER0_MASK << periodic_channel, true);
+}
+
+void ast_disable_periodic_interrupt(volatile avr32_ast_t *ast, uint8_t periodic_channel)
+{
+    sim_ast_modify(&ast->imr, AVR32_AST_PER0_MASK << periodic_channel, false);
+}
+
+void ast_clear_periodic_status_flag(volatile avr32_ast_t *ast, uint32_t periodic_channel)
+{
+    sim_ast_modify(&ast->sr, AVR32_AST_PER0_MASK << periodic_channel, false);
+}
+
+void ast_enable_async_wakeup(volatile avr32_ast_t *ast, uint32_t wakeup_mask)
+{
+    sim_ast_modify(&ast->wer, wakeup_mask, true);
+}
+
+void ast_disable_async_wakeup(volatile avr32_ast_t *ast, uint32_t wakeup_mask)
+{
+    sim_ast_modify(&ast->wer, wakeup_mask, false);
+}
@@ -0,0 +1,418 @@
+/**
+ *	@file	sim_cpu.c
+ *
+ *	@brief	vanet-sim - The simulated CPU: status register, INTC and threads
+ *
+ *	Interrupts are taken at the points the firmware unmasks them: restoring an
+ *	unmasked SR (every critical section exit), cpu_irq_enable(), reading the
+ *	cycle counter and waking from sleep.  Code that spins with interrupts on
+ *	and calls none of those will starve the ISRs - the real part would not.
+ *
+ *	The highest pending line (by INTC level, then by line number) is taken
+ *	first.  Taking one masks its level and those below (I0M..InM) and, as
+ *	OSIntISRHandler does, runs the handler with GM clear - so a higher level
+ *	nests into it at the handler's next unmask point, as on the part.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+#include <asf.h>
+#include <ucos_ii.h>
+#include "sim.h"
+
+#define SIM_THREAD_STACK_SIZE       (256 * 1024)
+
+typedef struct
+{
+    __int_handler   handler;
+    uint32_t        level;
+} sim_vector_t;
+
+struct sim_task
+{
+    void            (*task)(void *p_arg);
+    void            *p_arg;
+};
+
+static pthread_mutex_t s_cpu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_switch = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t s_bus = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_bus_cond;
+
+static sim_vector_t s_vectors[SIM_IRQ_COUNT];
+static sim_model_t *s_models;
+static sim_model_t *s_line_model[SIM_IRQ_COUNT];
+
+static struct timespec s_start;
+static sigset_t s_signals;
+static volatile uint64_t s_slept_ns;        ///< time COUNT was stopped (-S)
+
+// Per context state.  Each uC/OS task has its own thread, so thread-locals are
+// exactly what the port would have saved on the task's stack
+static __thread uint32_t t_sr = AVR32_SR_GM_MASK;
+static __thread sim_task_t *t_task;
+
+/*---------------------------------------------------------------------------
+ * Time and threads
+ *---------------------------------------------------------------------------*/
+
+uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - s_start.tv_sec) * 1000000000ULL + ts.tv_nsec - s_start.tv_nsec;
+}
+
+void sim_abstime(struct timespec *ts, uint64_t ns)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ns += ts->tv_nsec;
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+}
+
+int sim_thread_create(pthread_t *thread, void *(*fn)(void *), void *arg)
+{
+    pthread_attr_t attr;
+    void *stack;
+    int err;
+
+    // the firmware keeps addresses in 32 bit words, so its stacks have to be
+    // addressable that way.  Everything else it sees is in the non-PIE image
+    // or on the brk heap
+    stack = mmap(NULL, SIM_THREAD_STACK_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED)
+        return -1;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, SIM_THREAD_STACK_SIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    err = pthread_create(thread, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return err ? -1 : 0;
+}
+
+void sim_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fputs("vanet-sim: ", stderr);
+    vfprintf(stderr, fmt, ap);
+    fputs("\r\n", stderr);
+    va_end(ap);
+}
+
+/*---------------------------------------------------------------------------
+ * Bus
+ *---------------------------------------------------------------------------*/
+
+void sim_bus_lock(void)
+{
+    pthread_mutex_lock(&s_bus);
+}
+
+void sim_bus_unlock(void)
+{
+    pthread_mutex_unlock(&s_bus);
+}
+
+void sim_bus_kick(void)
+{
+    pthread_cond_broadcast(&s_bus_cond);
+}
+
+int sim_bus_wait(const struct timespec *abstime)
+{
+    if (abstime)
+        return pthread_cond_timedwait(&s_bus_cond, &s_bus, abstime);
+    return pthread_cond_wait(&s_bus_cond, &s_bus);
+}
+
+void sim_model_register(sim_model_t *model)
+{
+    for (uint32_t i = 0; i < model->irq_count; i++)
+        s_line_model[model->irq_first + i] = model;
+
+    model->next = s_models;
+    s_models = model;
+}
+
+/*---------------------------------------------------------------------------
+ * INTC
+ *---------------------------------------------------------------------------*/
+
+void INTC_init_interrupts(void)
+{
+    memset(s_vectors, 0, sizeof(s_vectors));
+}
+
+void INTC_register_interrupt(__int_handler handler, uint32_t irq, uint32_t int_level)
+{
+    if (irq >= SIM_IRQ_COUNT)
+    {
+        sim_log("no model behind irq %u", irq);
+        return;
+    }
+
+    s_vectors[irq].handler = handler;
+    s_vectors[irq].level = int_level;
+}
+
+/// The SR mask bits that hold off a level, and that taking it sets
+#define SIM_LEVEL_MASK(level)   (AVR32_SR_I0M_MASK << (level))
+#define SIM_TAKEN_MASK(level)   ((AVR32_SR_I0M_MASK << ((level) + 1)) - AVR32_SR_I0M_MASK)
+
+/// The line to take next with the levels in sr masked, or -1.  Bus lock held
+static int sim_irq_pending(uint32_t sr)
+{
+    int irq = -1;
+
+    for (sim_model_t *m = s_models; m; m = m->next)
+    {
+        if (m->sync)
+            m->sync();
+    }
+
+    for (uint32_t i = 0; i < SIM_IRQ_COUNT; i++)
+    {
+        if (!s_vectors[i].handler || (sr & SIM_LEVEL_MASK(s_vectors[i].level)) ||
+            !s_line_model[i] || !s_line_model[i]->pending(i))
+            continue;
+
+        if (irq < 0 || s_vectors[i].level > s_vectors[irq].level)
+            irq = i;
+    }
+
+    return irq;
+}
+
+/// Take every pending interrupt.  Called wherever the firmware unmasks
+static void sim_irq_dispatch(void)
+{
+    uint32_t sr;
+    int irq;
+
+    while (!(t_sr & AVR32_SR_GM_MASK))
+    {
+        sim_bus_lock();
+        irq = sim_irq_pending(t_sr);
+        sim_bus_unlock();
+        if (irq < 0)
+            return;
+
+        // the INTC masks the level and below; OSIntISRHandler counts the
+        // nesting with GM set, then runs the handler with it clear
+        sr = t_sr;
+        t_sr |= AVR32_SR_GM_MASK | SIM_TAKEN_MASK(s_vectors[irq].level);
+        OSIntEnter();
+        t_sr &= ~AVR32_SR_GM_MASK;
+
+        s_vectors[irq].handler();
+
+        OSIntExit();
+        t_sr = sr;
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * Status register
+ *---------------------------------------------------------------------------*/
+
+void sim_irq_enable(void)
+{
+    t_sr &= ~AVR32_SR_GM_MASK;
+    sim_irq_dispatch();
+}
+
+void sim_irq_disable(void)
+{
+    t_sr |= AVR32_SR_GM_MASK;
+}
+
+irqflags_t sim_irq_save(void)
+{
+    irqflags_t flags = t_sr;
+
+    t_sr |= AVR32_SR_GM_MASK;
+    return flags;
+}
+
+void sim_irq_restore(irqflags_t flags)
+{
+    t_sr = flags;
+    sim_irq_dispatch();
+}
+
+uint32_t sim_sysreg_read(uint32_t reg)
+{
+    switch (reg)
+    {
+        case AVR32_SR:
+            return t_sr;
+
+        case AVR32_COUNT:
+            // busy waits poll this, so it doubles as a preemption point
+            sim_irq_dispatch();
+            return (uint32_t)((sim_now_ns() - s_slept_ns) * (SIM_SYSCLK_HZ / 1000000) / 1000);
+
+        default:
+            return 0;
+    }
+}
+
+void sim_sysreg_write(uint32_t reg, uint32_t value)
+{
+    if (reg == AVR32_SR)
+        sim_irq_restore(value);
+}
+
+void sim_cpu_sleep(uint32_t mode)
+{
+    uint64_t start = sim_now_ns();
+
+    sim_bus_lock();
+    while (sim_irq_pending(0) < 0)
+        sim_bus_wait(NULL);
+    if (g_sim.count_stops)
+        s_slept_ns += sim_now_ns() - start;
+    sim_bus_unlock();
+
+    // sleepmgr always asks for the wake-up with interrupts enabled
+    if (mode & AVR32_PM_SMODE_GMCLEAR_MASK)
+        sim_irq_enable();
+}
+
+/*---------------------------------------------------------------------------
+ * uC/OS-II tasks
+ *---------------------------------------------------------------------------*/
+
+static bool sim_task_is_current(sim_task_t *task)
+{
+    return OSTCBCur && OSTCBCur->OSTCBStkPtr == (OS_STK *)task;
+}
+
+static void *sim_task_thread(void *arg)
+{
+    sim_task_t *task = arg;
+
+    pthread_mutex_lock(&s_cpu);
+    t_task = task;
+    while (!sim_task_is_current(task))
+        pthread_cond_wait(&s_switch, &s_cpu);
+
+    // a new task starts with interrupts enabled
+    sim_irq_enable();
+    task->task(task->p_arg);
+
+    // the AVR32 port leaves no return address on a new task's stack either
+    sim_log("task returned (prio %u)", OSTCBCur->OSTCBPrio);
+    abort();
+}
+
+sim_task_t *sim_task_create(void (*fn)(void *p_arg), void *p_arg)
+{
+    sim_task_t *task = malloc(sizeof(*task));
+    pthread_t thread;
+
+    task->task = fn;
+    task->p_arg = p_arg;
+    if (sim_thread_create(&thread, sim_task_thread, task) < 0)
+    {
+        sim_log("can't create a task thread");
+        abort();
+    }
+    return task;
+}
+
+void sim_task_switch(void)
+{
+    // OSTCBCur has been moved on.  Hand over the CPU and wait to get it back
+    pthread_cond_broadcast(&s_switch);
+    while (!sim_task_is_current(t_task))
+        pthread_cond_wait(&s_switch, &s_cpu);
+}
+
+void sim_task_start(void)
+{
+    // the boot context is never resumed
+    pthread_cond_broadcast(&s_switch);
+    for (;;)
+        pthread_cond_wait(&s_switch, &s_cpu);
+}
+
+/*---------------------------------------------------------------------------
+ * Bring-up
+ *---------------------------------------------------------------------------*/
+
+void sim_cpu_init(void)
+{
+    pthread_condattr_t attr;
+
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_bus_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // keep every malloc() on the brk heap, below 4G, whichever thread asks
+    mallopt(M_ARENA_MAX, 1);
+    mallopt(M_MMAP_MAX, 0);
+
+    // block the signals before the models start threads: only main takes them
+    sigemptyset(&s_signals);
+    sigaddset(&s_signals, SIGINT);
+    sigaddset(&s_signals, SIGTERM);
+    sigaddset(&s_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &s_signals, NULL);
+}
+
+static void *sim_boot_thread(void *arg)
+{
+    int (*entry)(void) = arg;
+
+    // out of reset: interrupts masked, the firmware enables them
+    pthread_mutex_lock(&s_cpu);
+    entry();
+
+    sim_log("firmware main() returned");
+    sim_usart_shutdown();
+    exit(1);
+}
+
+void sim_cpu_run(int (*entry)(void))
+{
+    pthread_t thread;
+    int sig;
+
+    if (sim_thread_create(&thread, sim_boot_thread, (void *)entry) < 0)
+    {
+        sim_log("can't create the boot thread");
+        exit(1);
+    }
+
+    sigwait(&s_signals, &sig);
+    sim_usart_shutdown();
+    exit(0);
+}
@@ -0,0 +1,166 @@
+/**
+ *	@file	sim_flash.c
+ *
+ *	@brief	vanet-sim - FLASHC user page, codeplug journal and event recordings, backed by the codeplug file
+ *
+ *	The user page is placed by sim.ld so the firmware's .userpage and
+ *	.userpage_xsum sections land at their offsets on the part.  The codeplug
+ *	journal and the event recordings below it are mapped at their addresses
+ *	in main flash.  Every write through flashc_memcpy() saves all three, the
+ *	page, the journal then the recordings, so they survive a restart of the
+ *	simulator the way they survive a power cycle.  A write without erase can
+ *	only clear bits, as on the part.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <sys/mman.h>
+
+#include <asf.h>
+#include "codeplug.h"
+#include "rec_task.h"
+#include "sim.h"
+
+// the factory calibration page - sti_cmds.c reads it at its address on the part
+#define SIM_FLASH_FACTORY_PAGE      0x80800000UL
+#define SIM_FLASH_FACTORY_SIZE      4096
+
+// the codeplug journal in main flash
+#define SIM_FLASH_JOURNAL           ((uintptr_t)BSP_CP_JOURNAL_ADDRESS)
+#define SIM_FLASH_JOURNAL_SIZE      (2 * BSP_CP_BANK_SIZE)
+
+// the event recordings, right below it - one mapping for both
+#define SIM_FLASH_REC               ((uintptr_t)APP_REC_FLASH_ADDRESS)
+#define SIM_FLASH_REC_SIZE          APP_REC_FLASH_SIZE
+#define SIM_FLASH_MAIN_MAP          (SIM_FLASH_REC & ~0xfffUL)
+#define SIM_FLASH_MAIN_MAP_SIZE     (((SIM_FLASH_JOURNAL + SIM_FLASH_JOURNAL_SIZE + 0xfffUL) & ~0xfffUL) - SIM_FLASH_MAIN_MAP)
+
+/// Write the whole page back to the codeplug file
+static void sim_flash_save(void)
+{
+    FILE *f = fopen(g_sim.codeplug, "wb");
+
+    if (!f)
+    {
+        sim_log("can't save the user page to %s", g_sim.codeplug);
+        return;
+    }
+
+    fwrite(sim_flash_user_page, 1, AVR32_FLASHC_USER_PAGE_SIZE, f);
+    fwrite((void *)SIM_FLASH_JOURNAL, 1, SIM_FLASH_JOURNAL_SIZE, f);
+    fwrite((void *)SIM_FLASH_REC, 1, SIM_FLASH_REC_SIZE, f);
+    fclose(f);
+}
+
+static bool sim_flash_in(volatile void *dst, size_t nbytes, uint8_t *area, size_t size)
+{
+    uint8_t *p = (uint8_t *)dst;
+
+    return p >= area && p + nbytes <= area + size;
+}
+
+static bool sim_flash_writable(volatile void *dst, size_t nbytes)
+{
+    return sim_flash_in(dst, nbytes, sim_flash_user_page, AVR32_FLASHC_USER_PAGE_SIZE) ||
+           sim_flash_in(dst, nbytes, (uint8_t *)SIM_FLASH_JOURNAL, SIM_FLASH_JOURNAL_SIZE) ||
+           sim_flash_in(dst, nbytes, (uint8_t *)SIM_FLASH_REC, SIM_FLASH_REC_SIZE);
+}
+
+void sim_flash_init(void)
+{
+    uint8_t page[AVR32_FLASHC_USER_PAGE_SIZE];
+    FILE *f = fopen(g_sim.codeplug, "rb");
+
+    if (f && fread(page, 1, sizeof(page), f) == sizeof(page))
+    {
+        memcpy(sim_flash_user_page, page, sizeof(page));
+    }
+    else
+    {
+        // blank part: erased flash, the codeplug checksum fails and the
+        // firmware writes its defaults
+        memset(sim_flash_user_page, 0xff, AVR32_FLASHC_USER_PAGE_SIZE);
+    }
+
+    // the journal then the recordings follow - a file from before there were
+    // any leaves them erased.  They aren't host page aligned
+    if (mmap((void *)SIM_FLASH_MAIN_MAP, SIM_FLASH_MAIN_MAP_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == (void *)SIM_FLASH_MAIN_MAP)
+    {
+        memset((void *)SIM_FLASH_JOURNAL, 0xff, SIM_FLASH_JOURNAL_SIZE);
+        memset((void *)SIM_FLASH_REC, 0xff, SIM_FLASH_REC_SIZE);
+        if (f && fread((void *)SIM_FLASH_JOURNAL, 1, SIM_FLASH_JOURNAL_SIZE, f) != SIM_FLASH_JOURNAL_SIZE)
+            memset((void *)SIM_FLASH_JOURNAL, 0xff, SIM_FLASH_JOURNAL_SIZE);
+        else if (f && fread((void *)SIM_FLASH_REC, 1, SIM_FLASH_REC_SIZE, f) != SIM_FLASH_REC_SIZE)
+            memset((void *)SIM_FLASH_REC, 0xff, SIM_FLASH_REC_SIZE);
+    }
+    else
+    {
+        sim_log("can't map the codeplug journal and recordings");
+    }
+
+    if (f)
+        fclose(f);
+
+    // blank calibration, read only
+    if (mmap((void *)SIM_FLASH_FACTORY_PAGE, SIM_FLASH_FACTORY_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == (void *)SIM_FLASH_FACTORY_PAGE)
+    {
+        memset((void *)SIM_FLASH_FACTORY_PAGE, 0xff, SIM_FLASH_FACTORY_SIZE);
+        mprotect((void *)SIM_FLASH_FACTORY_PAGE, SIM_FLASH_FACTORY_SIZE, PROT_READ);
+    }
+    else
+    {
+        sim_log("can't map the factory page");
+    }
+}
+
+volatile void *flashc_memcpy(volatile void *dst, const void *src, size_t nbytes, bool erase)
+{
+    uint8_t *p = (uint8_t *)dst;
+    const uint8_t *s = src;
+
+    if (!sim_flash_writable(dst, nbytes))
+    {
+        sim_log("flashc_memcpy outside the user page / codeplug journal / recordings (%p)", dst);
+        return dst;
+    }
+
+    // the rest of an erased page is written back from the page buffer
+    if (erase)
+        memmove((void *)dst, src, nbytes);
+    else
+        for (size_t i = 0; i < nbytes; i++)
+            p[i] &= s[i];
+    sim_flash_save();
+    return dst;
+}
+
+volatile void *flashc_memset8(volatile void *dst, uint8_t src, size_t nbytes, bool erase)
+{
+    uint8_t *p = (uint8_t *)dst;
+
+    if (!sim_flash_writable(dst, nbytes))
+    {
+        sim_log("flashc_memset8 outside the user page / codeplug journal / recordings (%p)", dst);
+        return dst;
+    }
+
+    if (erase)
+        memset((void *)dst, src, nbytes);
+    else
+        for (size_t i = 0; i < nbytes; i++)
+            p[i] &= src;
+    sim_flash_save();
+    return dst;
+}
@@ -0,0 +1,327 @@
+/**
+ *	@file	sim_gpio.c
+ *
+ *	@brief	vanet-sim - GPIO model and the GPS 1PPS
+ *
+ *	A pin reads back what the part drives, else what a model drives from
+ *	outside (sim_gpio_drive), else its pull-up.  Edges on the resulting level
+ *	set the interrupt flags the same way the GPIO module does.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <time.h>
+
+#include <asf.h>
+#include "sim.h"
+
+#define SIM_PPS_WIDTH_NS            100000000       // 100ms, like the u-blox default
+
+volatile avr32_gpio_t sim_gpio;
+
+static uint32_t s_ext_drive[AVR32_GPIO_PORT_COUNT];    ///< pins driven from outside
+static uint32_t s_ext_level[AVR32_GPIO_PORT_COUNT];
+static uint32_t s_level[AVR32_GPIO_PORT_COUNT];        ///< for the edge detector
+
+/*---------------------------------------------------------------------------
+ * Model (bus lock held)
+ *---------------------------------------------------------------------------*/
+
+static void sim_gpio_update(int port)
+{
+    volatile avr32_gpio_port_t *p = &sim_gpio.port[port];
+    uint32_t pvr, changed, fire;
+
+    pvr = (p->oder & p->ovr) | (~p->oder & s_ext_drive[port] & s_ext_level[port]) |
+          (~p->oder & ~s_ext_drive[port] & p->puer);
+
+    // imr1:imr0 - 00 pin change, 01 rising, 10 falling
+    changed = pvr ^ s_level[port];
+    fire = (changed & ~p->imr1 & ~p->imr0) |
+           (changed & pvr & ~p->imr1 & p->imr0) |
+           (changed & ~pvr & p->imr1 & ~p->imr0);
+
+    p->pvr = pvr;
+    s_level[port] = pvr;
+
+    if (fire & p->ier)
+    {
+        p->ifr |= fire & p->ier;
+        sim_bus_kick();
+    }
+}
+
+void sim_gpio_drive(uint32_t pin, bool level)
+{
+    uint32_t port = pin >> 5;
+    uint32_t mask = 1 << (pin & 0x1f);
+
+    s_ext_drive[port] |= mask;
+    if (level)
+        s_ext_level[port] |= mask;
+    else
+        s_ext_level[port] &= ~mask;
+    sim_gpio_update(port);
+}
+
+static bool sim_gpio_pending(uint32_t irq)
+{
+    uint32_t line = irq - AVR32_GPIO_IRQ_0;
+    volatile avr32_gpio_port_t *p = &sim_gpio.port[line / 4];
+
+    return (p->ier & p->ifr & (0xff << ((line % 4) * 8))) != 0;
+}
+
+static sim_model_t s_gpio_model =
+{
+    .name = "gpio",
+    .irq_first = AVR32_GPIO_IRQ_0,
+    .irq_count = 16,
+    .pending = sim_gpio_pending,
+};
+
+/*---------------------------------------------------------------------------
+ * 1PPS on the GPS timepulse pin, on the host's second boundaries
+ *---------------------------------------------------------------------------*/
+
+static void *sim_pps_thread(void *arg)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    for (;;)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec = 0;
+        clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL);
+
+        sim_bus_lock();
+        sim_gpio_drive(GPS_TIMEPULSE_PIN, true);
+        sim_bus_unlock();
+
+        ts.tv_nsec = SIM_PPS_WIDTH_NS;
+        clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL);
+
+        sim_bus_lock();
+        sim_gpio_drive(GPS_TIMEPULSE_PIN, false);
+        sim_bus_unlock();
+    }
+    return NULL;
+}
+
+void sim_gpio_init(void)
+{
+    pthread_t thread;
+
+    sim_model_register(&s_gpio_model);
+
+    if (g_sim.pps)
+    {
+        sim_gpio_drive(GPS_TIMEPULSE_PIN, false);
+        pthread_create(&thread, NULL, sim_pps_thread, NULL);
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * ASF driver
+ *---------------------------------------------------------------------------*/
+
+#define SIM_GPIO_PORT(pin)      (&sim_gpio.port[(pin) >> 5])
+#define SIM_GPIO_MASK(pin)      (1UL << ((pin) & 0x1f))
+
+// pins past PD31 are the peripheral functions in avr32/io.h - nothing to do
+#define SIM_GPIO_CHECK(pin, ret)    do { if ((pin) >= 32 * AVR32_GPIO_PORT_COUNT) return ret; } while (0)
+
+int gpio_enable_module(const gpio_map_t gpiomap, uint32_t size)
+{
+    return GPIO_SUCCESS;
+}
+
+int gpio_enable_module_pin(uint32_t pin, uint32_t function)
+{
+    return GPIO_SUCCESS;
+}
+
+void gpio_enable_gpio_pin(uint32_t pin)
+{
+    SIM_GPIO_CHECK(pin, );
+    sim_bus_lock();
+    SIM_GPIO_PORT(pin)->gper |= SIM_GPIO_MASK(pin);
+    sim_bus_unlock();
+}
+
+static void sim_gpio_modify(uint32_t pin, size_t reg, bool set)
+{
+    volatile uint32_t *r;
+
+    SIM_GPIO_CHECK(pin, );
+    sim_bus_lock();
+    r = (volatile uint32_t *)((volatile uint8_t *)SIM_GPIO_PORT(pin) + reg);
+    if (set)
+        *r |= SIM_GPIO_MASK(pin);
+    else
+        *r &= ~SIM_GPIO_MASK(pin);
+    sim_gpio_update(pin >> 5);
+    sim_bus_unlock();
+}
+
+void gpio_enable_pin_pull_up(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, puer), true);
+}
+
+void gpio_disable_pin_pull_up(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, puer), false);
+}
+
+void gpio_enable_pin_pull_down(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, pder), true);
+}
+
+void gpio_disable_pin_pull_down(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, pder), false);
+}
+
+void gpio_enable_pin_glitch_filter(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, gfer), true);
+}
+
+void gpio_disable_pin_glitch_filter(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, gfer), false);
+}
+
+void gpio_set_gpio_pin(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ovr), true);
+}
+
+void gpio_set_pin_high(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ovr), true);
+}
+
+void gpio_clr_gpio_pin(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ovr), false);
+}
+
+void gpio_set_pin_low(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ovr), false);
+}
+
+void gpio_tgl_gpio_pin(uint32_t pin)
+{
+    SIM_GPIO_CHECK(pin, );
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ovr), !(SIM_GPIO_PORT(pin)->ovr & SIM_GPIO_MASK(pin)));
+}
+
+void gpio_toggle_pin(uint32_t pin)
+{
+    gpio_tgl_gpio_pin(pin);
+}
+
+void gpio_configure_pin(uint32_t pin, uint32_t flags)
+{
+    volatile avr32_gpio_port_t *p;
+    uint32_t mask = SIM_GPIO_MASK(pin);
+
+    SIM_GPIO_CHECK(pin, );
+    p = SIM_GPIO_PORT(pin);
+
+    sim_bus_lock();
+    p->gper |= mask;
+
+    if (flags & GPIO_PULL_UP)
+        p->puer |= mask;
+    else
+        p->puer &= ~mask;
+
+    if (flags & GPIO_DIR_OUTPUT)
+    {
+        if (flags & GPIO_INIT_HIGH)
+            p->ovr |= mask;
+        else
+            p->ovr &= ~mask;
+        p->oder |= mask;
+    }
+    else
+    {
+        p->oder &= ~mask;
+    }
+
+    if (flags & GPIO_INTERRUPT)
+    {
+        // GPIO_BOTHEDGES / GPIO_RISING / GPIO_FALLING -> imr 00 / 01 / 10
+        uint32_t mode = ((flags >> 8) & 3) - 1;
+
+        p->imr0 = (mode & 1) ? (p->imr0 | mask) : (p->imr0 & ~mask);
+        p->imr1 = (mode & 2) ? (p->imr1 | mask) : (p->imr1 & ~mask);
+        p->ier |= mask;
+    }
+
+    sim_gpio_update(pin >> 5);
+    sim_bus_unlock();
+}
+
+int gpio_get_pin_value(uint32_t pin)
+{
+    SIM_GPIO_CHECK(pin, 0);
+    return (SIM_GPIO_PORT(pin)->pvr & SIM_GPIO_MASK(pin)) != 0;
+}
+
+int gpio_get_gpio_pin_output_value(uint32_t pin)
+{
+    SIM_GPIO_CHECK(pin, 0);
+    return (SIM_GPIO_PORT(pin)->ovr & SIM_GPIO_MASK(pin)) != 0;
+}
+
+int gpio_enable_pin_interrupt(uint32_t pin, uint32_t mode)
+{
+    volatile avr32_gpio_port_t *p;
+    uint32_t mask = SIM_GPIO_MASK(pin);
+
+    SIM_GPIO_CHECK(pin, GPIO_INVALID_ARGUMENT);
+    if (mode > GPIO_FALLING_EDGE)
+        return GPIO_INVALID_ARGUMENT;
+
+    p = SIM_GPIO_PORT(pin);
+    sim_bus_lock();
+    p->imr0 = (mode & 1) ? (p->imr0 | mask) : (p->imr0 & ~mask);
+    p->imr1 = (mode & 2) ? (p->imr1 | mask) : (p->imr1 & ~mask);
+    p->ier |= mask;
+    sim_bus_unlock();
+
+    return GPIO_SUCCESS;
+}
+
+void gpio_disable_pin_interrupt(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ier), false);
+}
+
+int gpio_get_pin_interrupt_flag(uint32_t pin)
+{
+    SIM_GPIO_CHECK(pin, 0);
+    return (SIM_GPIO_PORT(pin)->ifr & SIM_GPIO_MASK(pin)) != 0;
+}
+
+void gpio_clear_pin_interrupt_flag(uint32_t pin)
+{
+    sim_gpio_modify(pin, offsetof(avr32_gpio_port_t, ifr), false);
+}
@@ -0,0 +1,109 @@
+/**
+ *	@file	sim_main.c
+ *
+ *	@brief	vanet-sim - Command line and bring-up
+ *
+ *	vanet-sim [-d dir] [-f codeplug] [-D] [-P]
+ *
+ *	The USARTs come up as ptys linked from <dir> (gps, misc, mux, debug), so
+ *	the mainboard tools can be pointed straight at them, e.g.
+ *
+ *	  muxd -d /tmp/vanet-sim/mux -s /tmp/vanet-sim
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "sim.h"
+
+#define SIM_DEFAULT_DIR             "/tmp/vanet-sim"
+
+/// The firmware's main() (pdg/src/main.c, renamed by the Makefile)
+extern int vanet_main(void);
+
+sim_config_t g_sim =
+{
+    .dir = SIM_DEFAULT_DIR,
+    .console = true,
+    .pps = true,
+};
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-d dir] [-f codeplug] [-D] [-P] [-S]\n"
+            "  -d dir       pty links and the lcd file go here (%s)\n"
+            "  -f codeplug  user page and codeplug journal backing file (<dir>/codeplug.bin)\n"
+            "  -D           debug USART on a pty too, not this terminal\n"
+            "  -P           no 1PPS from the GPS\n"
+            "  -S           the cycle counter stops while the CPU sleeps\n",
+            name, SIM_DEFAULT_DIR);
+}
+
+int main(int argc, char **argv)
+{
+    static char codeplug[256];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:f:DPSh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                g_sim.dir = optarg;
+                break;
+            case 'f':
+                g_sim.codeplug = optarg;
+                break;
+            case 'D':
+                g_sim.console = false;
+                break;
+            case 'P':
+                g_sim.pps = false;
+                break;
+            case 'S':
+                g_sim.count_stops = true;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (mkdir(g_sim.dir, 0755) < 0 && errno != EEXIST)
+    {
+        perror(g_sim.dir);
+        return 1;
+    }
+
+    if (!g_sim.codeplug)
+    {
+        snprintf(codeplug, sizeof(codeplug), "%s/codeplug.bin", g_sim.dir);
+        g_sim.codeplug = codeplug;
+    }
+
+    sim_cpu_init();
+    sim_reset_init(argv);
+    sim_flash_init();
+    sim_gpio_init();
+    sim_usart_init();
+    sim_ast_init();
+    sim_tc_init();
+    sim_twim_init();
+
+    sim_cpu_run(vanet_main);
+}
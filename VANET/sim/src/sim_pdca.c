@@ -0,0 +1,133 @@
+/**
+ *	@file	sim_pdca.c
+ *
+ *	@brief	vanet-sim - Peripheral DMA controller model
+ *
+ *	Byte transfers only, and no interrupts of its own: a peripheral model
+ *	moves its bytes through sim_pdca_move() when it has them, and the channel
+ *	takes up its reload address and count when the first runs out.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <asf.h>
+#include "sim.h"
+
+volatile avr32_pdca_channel_t sim_pdca[AVR32_PDCA_CHANNEL_LENGTH];
+
+static volatile avr32_pdca_channel_t *sim_pdca_channel(uint32_t pid)
+{
+    for (int i = 0; i < AVR32_PDCA_CHANNEL_LENGTH; i++)
+    {
+        if ((sim_pdca[i].sr & AVR32_PDCA_TEN_MASK) && sim_pdca[i].psr == pid)
+            return &sim_pdca[i];
+    }
+    return NULL;
+}
+
+uint32_t sim_pdca_ready(uint32_t pid)
+{
+    volatile avr32_pdca_channel_t *ch = sim_pdca_channel(pid);
+
+    return ch ? ch->tcr + ch->tcrr : 0;
+}
+
+uint32_t sim_pdca_move(uint32_t pid, uint8_t *buf, uint32_t len, bool to_memory)
+{
+    volatile avr32_pdca_channel_t *ch = sim_pdca_channel(pid);
+    uint32_t n = 0;
+
+    while (ch && n < len)
+    {
+        if (!ch->tcr)
+        {
+            if (!ch->tcrr)
+                break;
+            ch->mar = ch->marr;
+            ch->tcr = ch->tcrr;
+            ch->tcrr = 0;
+        }
+        if (to_memory)
+            *(uint8_t *) ch->mar = buf[n];
+        else
+            buf[n] = *(uint8_t *) ch->mar;
+        ch->mar++;
+        ch->tcr--;
+        n++;
+    }
+    return n;
+}
+
+/*---------------------------------------------------------------------------
+ * ASF driver
+ *---------------------------------------------------------------------------*/
+
+volatile avr32_pdca_channel_t *pdca_get_handler(unsigned int pdca_ch_number)
+{
+    return pdca_ch_number < AVR32_PDCA_CHANNEL_LENGTH ? &sim_pdca[pdca_ch_number] : NULL;
+}
+
+int pdca_init_channel(unsigned int pdca_ch_number, const pdca_channel_options_t *opt)
+{
+    volatile avr32_pdca_channel_t *ch = pdca_get_handler(pdca_ch_number);
+
+    if (!ch)
+        return PDCA_INVALID_ARGUMENT;
+
+    sim_bus_lock();
+    ch->mar = (uint32_t) opt->addr;
+    ch->tcr = opt->size;
+    ch->marr = (uint32_t) opt->r_addr;
+    ch->tcrr = opt->r_size;
+    ch->psr = opt->pid;
+    ch->mr = opt->transfer_size;
+    sim_bus_unlock();
+    return PDCA_SUCCESS;
+}
+
+void pdca_disable(unsigned int pdca_ch_number)
+{
+    sim_pdca[pdca_ch_number].sr &= ~AVR32_PDCA_TEN_MASK;
+}
+
+void pdca_enable(unsigned int pdca_ch_number)
+{
+    sim_pdca[pdca_ch_number].sr |= AVR32_PDCA_TEN_MASK;
+}
+
+unsigned int pdca_get_load_size(unsigned int pdca_ch_number)
+{
+    return sim_pdca[pdca_ch_number].tcr;
+}
+
+void pdca_load_channel(unsigned int pdca_ch_number, volatile void *addr, unsigned int size)
+{
+    sim_pdca[pdca_ch_number].mar = (uint32_t) addr;
+    sim_pdca[pdca_ch_number].tcr = size;
+}
+
+unsigned int pdca_get_reload_size(unsigned int pdca_ch_number)
+{
+    return sim_pdca[pdca_ch_number].tcrr;
+}
+
+void pdca_reload_channel(unsigned int pdca_ch_number, volatile void *addr, unsigned int size)
+{
+    sim_pdca[pdca_ch_number].marr = (uint32_t) addr;
+    sim_pdca[pdca_ch_number].tcrr = size;
+}
+
+void pdca_set_peripheral_select(unsigned int pdca_ch_number, unsigned int pid)
+{
+    sim_pdca[pdca_ch_number].psr = pid;
+}
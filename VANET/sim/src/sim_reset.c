@@ -0,0 +1,118 @@
+/**
+ *	@file	sim_reset.c
+ *
+ *	@brief	vanet-sim - Reset controller, SCIF GPLP registers and the PWM
+ *
+ *	A soft reset re-executes the simulator with its original arguments.  The
+ *	reset cause and the two GPLP words (which hold the exception record over
+ *	a reset, see reset.c) are handed to the new image in the environment.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <unistd.h>
+
+#include <asf.h>
+#include "sim.h"
+
+#define SIM_ENV_RESET               "VANET_SIM_RESET"
+#define SIM_ENV_GPLP                "VANET_SIM_GPLP"
+#define SIM_GPLP_COUNT              2
+
+volatile avr32_pwm_t sim_pwm;
+
+static unsigned long s_gplp[SIM_GPLP_COUNT];
+static char **s_argv;
+
+void sim_reset_init(char **argv)
+{
+    const char *gplp = getenv(SIM_ENV_GPLP);
+
+    s_argv = argv;
+    if (gplp)
+        sscanf(gplp, "%lx,%lx", &s_gplp[0], &s_gplp[1]);
+}
+
+/*---------------------------------------------------------------------------
+ * Reset
+ *---------------------------------------------------------------------------*/
+
+reset_cause_t reset_cause_get_causes(void)
+{
+    return getenv(SIM_ENV_RESET) ? RESET_CAUSE_SOFT : RESET_CAUSE_POR;
+}
+
+void reset_do_soft_reset(void)
+{
+    char gplp[32];
+
+    snprintf(gplp, sizeof(gplp), "%lx,%lx", s_gplp[0], s_gplp[1]);
+    setenv(SIM_ENV_GPLP, gplp, 1);
+    setenv(SIM_ENV_RESET, "soft", 1);
+
+    sim_log("soft reset");
+    sim_usart_shutdown();
+    execv("/proc/self/exe", s_argv);
+
+    sim_log("soft reset failed");
+    _exit(1);
+}
+
+/*---------------------------------------------------------------------------
+ * SCIF
+ *---------------------------------------------------------------------------*/
+
+unsigned long scif_read_gplp(unsigned long gplp)
+{
+    return gplp < SIM_GPLP_COUNT ? s_gplp[gplp] : 0;
+}
+
+void scif_write_gplp(int gplp, unsigned long value)
+{
+    if (gplp >= 0 && gplp < SIM_GPLP_COUNT)
+        s_gplp[gplp] = value & 0xffffffff;
+}
+
+/*---------------------------------------------------------------------------
+ * PWM - accepted and ignored, nothing is attached to the outputs
+ *---------------------------------------------------------------------------*/
+
+int pwm_init(const pwm_opt_t *opt)
+{
+    return PWM_SUCCESS;
+}
+
+int pwm_channel_init(unsigned int channel_id, const avr32_pwm_channel_t *pwm_channel)
+{
+    return PWM_SUCCESS;
+}
+
+int pwm_start_channels(unsigned long channels_bitmask)
+{
+    return PWM_SUCCESS;
+}
+
+int pwm_stop_channels(unsigned long channels_bitmask)
+{
+    return PWM_SUCCESS;
+}
+
+int pwm_update_channel(unsigned int channel_id, const avr32_pwm_channel_t *pwm_channel)
+{
+    return PWM_SUCCESS;
+}
+
+int pwm_update_period_value(unsigned int value)
+{
+    return PWM_SUCCESS;
+}
@@ -0,0 +1,274 @@
+/**
+ *	@file	sim_tc.c
+ *
+ *	@brief	vanet-sim - Timer/counter model (waveform mode, RC compare)
+ *
+ *	Only what the buzzer uses: up counting with an RC trigger, the CPCS flag
+ *	and its interrupt, and cpcstop.  The TIOA/TIOB outputs go nowhere.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <time.h>
+
+#include <asf.h>
+#include "sim.h"
+
+#define SIM_TC_COUNT                2
+#define SIM_TC_CHANNELS             3
+#define SIM_TC_IDLE_NS              1000000000ULL
+
+#define SIM_TC_SR_CPCS              0x00000010
+#define SIM_TC_SR_CLKSTA            0x00010000
+
+volatile avr32_tc_t sim_tc[SIM_TC_COUNT];
+
+typedef struct
+{
+    bool        running;
+    bool        cpcstop;
+    uint32_t    clock_hz;
+    uint64_t    start_ns;           ///< host time the counter last left 0
+} sim_tc_state_t;
+
+static sim_tc_state_t s_tc[SIM_TC_COUNT][SIM_TC_CHANNELS];
+
+/*---------------------------------------------------------------------------
+ * Model (bus lock held)
+ *---------------------------------------------------------------------------*/
+
+static sim_tc_state_t *sim_tc_state(volatile avr32_tc_t *tc, unsigned int channel)
+{
+    return &s_tc[tc - sim_tc][channel];
+}
+
+/// Host time of the next RC compare
+static uint64_t sim_tc_deadline(volatile avr32_tc_channel_t *ch, sim_tc_state_t *st)
+{
+    uint32_t rc = ch->rc ? ch->rc : 0x10000;
+
+    return st->start_ns + (uint64_t)rc * 1000000000ULL / st->clock_hz;
+}
+
+static bool sim_tc_pending(uint32_t irq)
+{
+    volatile avr32_tc_channel_t *ch = &sim_tc[0].channel[irq - AVR32_TC0_IRQ0];
+
+    return (ch->sr & ch->imr & SIM_TC_SR_CPCS) != 0;
+}
+
+static sim_model_t s_tc_model =
+{
+    .name = "tc",
+    .irq_first = AVR32_TC0_IRQ0,
+    .irq_count = SIM_TC_CHANNELS,
+    .pending = sim_tc_pending,
+};
+
+static void *sim_tc_thread(void *arg)
+{
+    struct timespec ts;
+
+    sim_bus_lock();
+    for (;;)
+    {
+        uint64_t now = sim_now_ns();
+        uint64_t wake = now + SIM_TC_IDLE_NS;
+
+        for (int t = 0; t < SIM_TC_COUNT; t++)
+        {
+            for (int c = 0; c < SIM_TC_CHANNELS; c++)
+            {
+                volatile avr32_tc_channel_t *ch = &sim_tc[t].channel[c];
+                sim_tc_state_t *st = &s_tc[t][c];
+                uint64_t deadline;
+
+                if (!st->running || !st->clock_hz)
+                    continue;
+
+                deadline = sim_tc_deadline(ch, st);
+                if (now >= deadline)
+                {
+                    ch->sr |= SIM_TC_SR_CPCS;
+                    if (st->cpcstop)
+                    {
+                        st->running = false;
+                        ch->sr &= ~SIM_TC_SR_CLKSTA;
+                        ch->cv = 0;
+                    }
+                    else
+                    {
+                        st->start_ns = deadline;
+                        if (now >= sim_tc_deadline(ch, st))
+                            st->start_ns = now;
+                    }
+                    sim_bus_kick();
+                }
+
+                if (st->running)
+                    wake = Min(wake, sim_tc_deadline(ch, st));
+            }
+        }
+
+        sim_abstime(&ts, wake - now);
+        sim_bus_wait(&ts);
+    }
+    return NULL;
+}
+
+void sim_tc_init(void)
+{
+    pthread_t thread;
+
+    sim_model_register(&s_tc_model);
+    pthread_create(&thread, NULL, sim_tc_thread, NULL);
+}
+
+/*---------------------------------------------------------------------------
+ * ASF driver
+ *---------------------------------------------------------------------------*/
+
+#define SIM_TC_CHECK(channel)       do { if ((channel) >= SIM_TC_CHANNELS) return TC_INVALID_ARGUMENT; } while (0)
+
+int tc_init_waveform(volatile avr32_tc_t *tc, const tc_waveform_opt_t *opt)
+{
+    static const uint32_t clock_hz[] =
+    {
+        32768, SIM_SYSCLK_HZ / 2, SIM_SYSCLK_HZ / 8, SIM_SYSCLK_HZ / 32, SIM_SYSCLK_HZ / 128, 0, 0, 0
+    };
+    sim_tc_state_t *st;
+
+    SIM_TC_CHECK(opt->channel);
+
+    sim_bus_lock();
+    st = sim_tc_state(tc, opt->channel);
+    st->running = false;
+    st->cpcstop = opt->cpcstop;
+    st->clock_hz = clock_hz[opt->tcclks & 7];
+    tc->channel[opt->channel].cmr = opt->tcclks | (opt->wavsel << 13) | (1 << 15);
+    sim_bus_unlock();
+
+    return 0;
+}
+
+int tc_configure_interrupts(volatile avr32_tc_t *tc, unsigned int channel, const tc_interrupt_t *bitfield)
+{
+    SIM_TC_CHECK(channel);
+
+    sim_bus_lock();
+    tc->channel[channel].imr = bitfield->cpcs ? SIM_TC_SR_CPCS : 0;
+    sim_bus_kick();
+    sim_bus_unlock();
+
+    return 0;
+}
+
+int tc_start(volatile avr32_tc_t *tc, unsigned int channel)
+{
+    sim_tc_state_t *st;
+
+    SIM_TC_CHECK(channel);
+
+    sim_bus_lock();
+    st = sim_tc_state(tc, channel);
+    st->running = true;
+    st->start_ns = sim_now_ns();
+    tc->channel[channel].sr |= SIM_TC_SR_CLKSTA;
+    sim_bus_kick();
+    sim_bus_unlock();
+
+    return 0;
+}
+
+int tc_stop(volatile avr32_tc_t *tc, unsigned int channel)
+{
+    SIM_TC_CHECK(channel);
+
+    sim_bus_lock();
+    sim_tc_state(tc, channel)->running = false;
+    tc->channel[channel].sr &= ~SIM_TC_SR_CLKSTA;
+    sim_bus_unlock();
+
+    return 0;
+}
+
+int tc_software_trigger(volatile avr32_tc_t *tc, unsigned int channel)
+{
+    SIM_TC_CHECK(channel);
+
+    sim_bus_lock();
+    sim_tc_state(tc, channel)->start_ns = sim_now_ns();
+    sim_bus_kick();
+    sim_bus_unlock();
+
+    return 0;
+}
+
+int tc_read_sr(volatile avr32_tc_t *tc, unsigned int channel)
+{
+    int sr;
+
+    SIM_TC_CHECK(channel);
+
+    // reading sr clears the event flags
+    sim_bus_lock();
+    sr = tc->channel[channel].sr;
+    tc->channel[channel].sr &= SIM_TC_SR_CLKSTA;
+    sim_bus_unlock();
+
+    return sr;
+}
+
+int tc_read_tc(volatile avr32_tc_t *tc, unsigned int channel)
+{
+    sim_tc_state_t *st;
+    int cv = 0;
+
+    SIM_TC_CHECK(channel);
+
+    sim_bus_lock();
+    st = sim_tc_state(tc, channel);
+    if (st->running && st->clock_hz)
+        cv = (int)((sim_now_ns() - st->start_ns) * st->clock_hz / 1000000000ULL) & 0xffff;
+    sim_bus_unlock();
+
+    return cv;
+}
+
+static int sim_tc_write(volatile uint32_t *reg, unsigned short value)
+{
+    sim_bus_lock();
+    *reg = value;
+    sim_bus_kick();
+    sim_bus_unlock();
+
+    return value;
+}
+
+int tc_write_ra(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value)
+{
+    SIM_TC_CHECK(channel);
+    return sim_tc_write(&tc->channel[channel].ra, value);
+}
+
+int tc_write_rb(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value)
+{
+    SIM_TC_CHECK(channel);
+    return sim_tc_write(&tc->channel[channel].rb, value);
+}
+
+int tc_write_rc(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value)
+{
+    SIM_TC_CHECK(channel);
+    return sim_tc_write(&tc->channel[channel].rc, value);
+}
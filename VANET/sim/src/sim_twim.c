@@ -0,0 +1,866 @@
+/**
+ *	@file	sim_twim.c
+ *
+ *	@brief	vanet-sim - TWIM master and the parts on the daughterboard's bus
+ *
+ *	TWIM0 at the register level: a command runs as soon as the model sees it
+ *	and its data is there - the bus takes no time - with the bytes through
+ *	the PDCA.  A write is handed to its slave in one piece at the STOP or the
+ *	repeated start after it; the slaves below only see bytes.
+ *
+ *	  - the accelerometer: LIS3DSH (REVB) or MPU-6050 (REVA), at rest on a
+ *	    level bench - 1g on Z plus a little noise.  The LIS3DSH's FIFO fills
+ *	    at the output data rate and raises INT1 at the watermark; the
+ *	    MPU-6050's fills at its sample rate, with data ready on INT
+ *	  - the HD44780 LCD behind a PCF8574 backpack, rendered to <dir>/lcd
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include <asf.h>
+#include "sim.h"
+
+#define SIM_TWIM_COUNT              3
+
+volatile avr32_twim_t sim_twim[SIM_TWIM_COUNT];
+
+typedef struct sim_i2c_slave
+{
+    uint8_t     addr;
+    void        (*write)(struct sim_i2c_slave *slave, const uint8_t *buf, uint32_t len);
+    void        (*read)(struct sim_i2c_slave *slave, uint8_t *buf, uint32_t len);
+} sim_i2c_slave_t;
+
+/// A small noise source so the accelerometer doesn't read back constants
+static int16_t sim_noise(int16_t amplitude)
+{
+    static uint32_t seed = 0x5eed;
+
+    seed = seed * 1103515245 + 12345;
+    return (int16_t)((seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+/*---------------------------------------------------------------------------
+ * Accelerometer - a register file with an auto-incrementing pointer
+ *---------------------------------------------------------------------------*/
+
+#define SIM_ACCEL_FIFO_DEPTH        32
+#define SIM_ACCEL_POLL_NS           5000000ULL      // INT1 can be this late - well inside the watermark
+
+typedef struct
+{
+    sim_i2c_slave_t slave;
+    uint8_t         ptr;
+    uint8_t         regs[256];
+    int16_t         fifo[SIM_ACCEL_FIFO_DEPTH][3];
+    uint8_t         fifo_count;
+    bool            overrun;
+    uint64_t        next_ns;        ///< when the next sample is due
+} sim_accel_t;
+
+static void sim_accel_written(sim_accel_t *accel);
+
+static void sim_accel_write(sim_i2c_slave_t *slave, const uint8_t *buf, uint32_t len)
+{
+    sim_accel_t *accel = (sim_accel_t *)slave;
+
+    if (len == 0)
+        return;
+
+    accel->ptr = *buf++;
+    if (len == 1)
+        return;
+    while (--len)
+        accel->regs[accel->ptr++] = *buf++;
+    sim_accel_written(accel);
+}
+
+#if HARDWARE == HW_VANET_DAUGHTER_REVB
+
+#define LIS3DSH_WHO_AM_I            0x0f
+#define LIS3DSH_INFO1               0x0d
+#define LIS3DSH_OUT_T               0x0c
+#define LIS3DSH_CTRL_REG4           0x20
+#define LIS3DSH_CTRL_REG3           0x23
+#define LIS3DSH_CTRL_REG5           0x24
+#define LIS3DSH_CTRL_REG6           0x25
+#define LIS3DSH_STATUS              0x27
+#define LIS3DSH_OUT_X               0x28
+#define LIS3DSH_OUT_Z_H             0x2d
+#define LIS3DSH_FIFO_CTRL           0x2e
+#define LIS3DSH_FIFO_SRC            0x2f
+
+#define LIS3DSH_CTRL_REG3_INT1_EN   0x08
+#define LIS3DSH_CTRL_REG6_FIFO_EN   0x40
+#define LIS3DSH_CTRL_REG6_ADD_INC   0x10
+#define LIS3DSH_CTRL_REG6_P1_WTM    0x04
+
+static void sim_lis3dsh_xyz(sim_accel_t *accel, int16_t xyz[3])
+{
+    // FSCALE 2/4/6/8/16g in CTRL_REG5 bits 5:3
+    static const uint8_t fscale_g[8] = { 2, 4, 6, 8, 16, 16, 16, 16 };
+    int16_t one_g = 32768 / fscale_g[(accel->regs[LIS3DSH_CTRL_REG5] >> 3) & 7];
+
+    xyz[0] = sim_noise(40);
+    xyz[1] = sim_noise(40);
+    xyz[2] = one_g + sim_noise(40);
+}
+
+static void sim_lis3dsh_out(sim_accel_t *accel, const int16_t xyz[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        accel->regs[LIS3DSH_OUT_X + 2 * i] = xyz[i] & 0xff;
+        accel->regs[LIS3DSH_OUT_X + 2 * i + 1] = xyz[i] >> 8;
+    }
+}
+
+static void sim_lis3dsh_sample(sim_accel_t *accel)
+{
+    int16_t xyz[3];
+
+    sim_lis3dsh_xyz(accel, xyz);
+    sim_lis3dsh_out(accel, xyz);
+    accel->regs[LIS3DSH_OUT_T] = 0;                 // 25C
+    accel->regs[LIS3DSH_STATUS] = 0xff;             // a new sample is always ready
+}
+
+static bool sim_lis3dsh_fifo_on(sim_accel_t *accel)
+{
+    // bypass mode, or the FIFO off, reads the output registers directly
+    return (accel->regs[LIS3DSH_CTRL_REG6] & LIS3DSH_CTRL_REG6_FIFO_EN) && (accel->regs[LIS3DSH_FIFO_CTRL] >> 5) != 0;
+}
+
+/// FIFO_SRC, and INT1 from it (active high, the way the driver sets IEA)
+static void sim_lis3dsh_fifo_status(sim_accel_t *accel)
+{
+    uint8_t wtm = accel->regs[LIS3DSH_FIFO_CTRL] & 0x1f;
+    uint8_t src = (accel->fifo_count < SIM_ACCEL_FIFO_DEPTH ? accel->fifo_count : SIM_ACCEL_FIFO_DEPTH - 1);
+
+    if (accel->fifo_count >= wtm && wtm)
+        src |= 0x80;
+    if (accel->overrun)
+        src |= 0x40;
+    if (accel->fifo_count == 0)
+        src |= 0x20;
+    accel->regs[LIS3DSH_FIFO_SRC] = src;
+
+    sim_gpio_drive(BSP_ACCEL_INT_PIN, (src & 0x80) &&
+                   (accel->regs[LIS3DSH_CTRL_REG6] & LIS3DSH_CTRL_REG6_P1_WTM) &&
+                   (accel->regs[LIS3DSH_CTRL_REG3] & LIS3DSH_CTRL_REG3_INT1_EN));
+}
+
+/// Take the samples due since we last looked, at the ODR in CTRL_REG4
+static void sim_lis3dsh_fifo_fill(sim_accel_t *accel)
+{
+    static const uint16_t odr_hz[16] = { 0, 3, 6, 12, 25, 50, 100, 400, 800, 1600 };
+    uint16_t hz = odr_hz[accel->regs[LIS3DSH_CTRL_REG4] >> 4];
+    uint64_t now = sim_now_ns();
+
+    if (!sim_lis3dsh_fifo_on(accel) || !hz)
+    {
+        accel->fifo_count = 0;
+        accel->overrun = false;
+        accel->next_ns = 0;
+        return;
+    }
+
+    if (!accel->next_ns)
+        accel->next_ns = now + 1000000000ULL / hz;
+
+    for (; accel->next_ns <= now; accel->next_ns += 1000000000ULL / hz)
+    {
+        // stream mode drops the oldest, FIFO mode stops
+        if (accel->fifo_count == SIM_ACCEL_FIFO_DEPTH)
+        {
+            accel->overrun = true;
+            if ((accel->regs[LIS3DSH_FIFO_CTRL] >> 5) != 2)
+                continue;
+            memmove(accel->fifo[0], accel->fifo[1], sizeof(accel->fifo[0]) * (SIM_ACCEL_FIFO_DEPTH - 1));
+            accel->fifo_count--;
+        }
+        sim_lis3dsh_xyz(accel, accel->fifo[accel->fifo_count++]);
+    }
+    sim_lis3dsh_fifo_status(accel);
+}
+
+static void sim_accel_written(sim_accel_t *accel)
+{
+    // bypass empties the FIFO
+    sim_lis3dsh_fifo_fill(accel);
+    if (!sim_lis3dsh_fifo_on(accel))
+        sim_lis3dsh_fifo_status(accel);
+}
+
+/// OUT_X read: the next sample moves up (the last one stays when it's empty)
+static void sim_lis3dsh_fifo_pop(sim_accel_t *accel)
+{
+    if (accel->fifo_count == 0)
+        return;
+
+    sim_lis3dsh_out(accel, accel->fifo[0]);
+    memmove(accel->fifo[0], accel->fifo[1], sizeof(accel->fifo[0]) * (SIM_ACCEL_FIFO_DEPTH - 1));
+    accel->fifo_count--;
+    accel->overrun = false;
+}
+
+static void sim_accel_read(sim_i2c_slave_t *slave, uint8_t *buf, uint32_t len)
+{
+    sim_accel_t *accel = (sim_accel_t *)slave;
+    bool fifo;
+
+    sim_lis3dsh_fifo_fill(accel);
+    fifo = sim_lis3dsh_fifo_on(accel);
+
+    if (!fifo && (accel->ptr == LIS3DSH_OUT_X || accel->ptr == LIS3DSH_STATUS))
+        sim_lis3dsh_sample(accel);
+
+    while (len--)
+    {
+        if (fifo && accel->ptr == LIS3DSH_OUT_X)
+            sim_lis3dsh_fifo_pop(accel);
+        *buf++ = accel->regs[accel->ptr];
+
+        // with ADD_INC the pointer goes round OUT_X..OUT_Z, a sample at a time
+        if (fifo && accel->ptr == LIS3DSH_OUT_Z_H && (accel->regs[LIS3DSH_CTRL_REG6] & LIS3DSH_CTRL_REG6_ADD_INC))
+            accel->ptr = LIS3DSH_OUT_X;
+        else
+            accel->ptr++;
+    }
+
+    if (fifo)
+        sim_lis3dsh_fifo_status(accel);
+}
+
+static sim_accel_t s_accel =
+{
+    .slave = { .addr = BSP_ACCEL_I2C_ADDR, .write = sim_accel_write, .read = sim_accel_read },
+    .regs =
+    {
+        [LIS3DSH_INFO1] = 0x21,
+        [LIS3DSH_WHO_AM_I] = 0x3f,
+    },
+};
+
+/// The FIFO fills whether or not anyone reads it, and INT1 goes with it
+static void *sim_accel_thread(void *arg)
+{
+    struct timespec ts;
+
+    sim_bus_lock();
+    for (;;)
+    {
+        sim_lis3dsh_fifo_fill(&s_accel);
+
+        sim_bus_unlock();
+        ts.tv_sec = 0;
+        ts.tv_nsec = SIM_ACCEL_POLL_NS;
+        nanosleep(&ts, NULL);
+        sim_bus_lock();
+    }
+    return NULL;
+}
+
+static void sim_accel_start(void)
+{
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, sim_accel_thread, NULL);
+}
+
+#else
+
+#define MPU6050_SMPLRT_DIV          0x19
+#define MPU6050_CONFIG              0x1a
+#define MPU6050_ACCEL_CONFIG        0x1c
+#define MPU6050_FIFO_EN             0x23
+#define MPU6050_INT_PIN_CFG         0x37
+#define MPU6050_INT_ENABLE          0x38
+#define MPU6050_INT_STATUS          0x3a
+#define MPU6050_ACCEL_XOUT_H        0x3b
+#define MPU6050_USER_CTRL           0x6a
+#define MPU6050_PWR_MGMT_1          0x6b
+#define MPU6050_FIFO_COUNTH         0x72
+#define MPU6050_FIFO_R_W            0x74
+#define MPU6050_WHO_AM_I            0x75
+
+#define MPU6050_FIFO_SIZE           1024
+#define MPU6050_INT_PIN_CFG_LATCH   0x20
+#define MPU6050_INT_PIN_CFG_RD_CLR  0x10
+#define MPU6050_INT_DATA_RDY        0x01
+#define MPU6050_INT_FIFO_OFLOW      0x10
+#define MPU6050_USER_CTRL_FIFO_EN   0x40
+#define MPU6050_USER_CTRL_FIFO_RST  0x04
+#define MPU6050_PWR_MGMT_1_RESET    0x80
+#define MPU6050_PWR_MGMT_1_SLEEP    0x40
+
+/// The FIFO is bytes - what goes in a sample depends on FIFO_EN
+static uint8_t s_mpu_fifo[MPU6050_FIFO_SIZE];
+static uint16_t s_mpu_fifo_count;
+
+static void sim_mpu6050_sample(sim_accel_t *accel)
+{
+    // AFS_SEL 2/4/8/16g in ACCEL_CONFIG bits 4:3
+    int16_t one_g = 16384 >> ((accel->regs[MPU6050_ACCEL_CONFIG] >> 3) & 3);
+    int16_t xyz[3] = { sim_noise(20), sim_noise(20), one_g + sim_noise(20) };
+
+    // big endian, then temperature (36.53C) and the gyro (still, give or take)
+    for (int i = 0; i < 3; i++)
+    {
+        accel->regs[MPU6050_ACCEL_XOUT_H + 2 * i] = xyz[i] >> 8;
+        accel->regs[MPU6050_ACCEL_XOUT_H + 2 * i + 1] = xyz[i] & 0xff;
+    }
+    accel->regs[MPU6050_ACCEL_XOUT_H + 6] = 0;
+    accel->regs[MPU6050_ACCEL_XOUT_H + 7] = 0;
+    for (int i = 8; i < 14; i += 2)
+    {
+        int16_t g = sim_noise(4);
+
+        accel->regs[MPU6050_ACCEL_XOUT_H + i] = g >> 8;
+        accel->regs[MPU6050_ACCEL_XOUT_H + i + 1] = g & 0xff;
+    }
+}
+
+/// INT follows the status: held while latched, a pulse otherwise
+static void sim_mpu6050_int(sim_accel_t *accel)
+{
+    bool level = (accel->regs[MPU6050_INT_STATUS] & accel->regs[MPU6050_INT_ENABLE]) != 0;
+
+    if (level && !(accel->regs[MPU6050_INT_PIN_CFG] & MPU6050_INT_PIN_CFG_LATCH))
+    {
+        sim_gpio_drive(BSP_ACCEL_INT_PIN, true);
+        level = false;
+    }
+    sim_gpio_drive(BSP_ACCEL_INT_PIN, level);
+}
+
+/// A sample into the FIFO, register order: accel, temperature, gyro X, Y, Z
+static void sim_mpu6050_fifo_push(sim_accel_t *accel)
+{
+    static const struct { uint8_t bit, reg, len; } fields[] =
+    {
+        { 0x08, MPU6050_ACCEL_XOUT_H, 6 },
+        { 0x80, MPU6050_ACCEL_XOUT_H + 6, 2 },
+        { 0x40, MPU6050_ACCEL_XOUT_H + 8, 2 },
+        { 0x20, MPU6050_ACCEL_XOUT_H + 10, 2 },
+        { 0x10, MPU6050_ACCEL_XOUT_H + 12, 2 },
+    };
+
+    if (!(accel->regs[MPU6050_USER_CTRL] & MPU6050_USER_CTRL_FIFO_EN))
+        return;
+
+    for (int f = 0; f < (int)(sizeof(fields) / sizeof(fields[0])); f++)
+    {
+        if (!(accel->regs[MPU6050_FIFO_EN] & fields[f].bit))
+            continue;
+        for (int i = 0; i < fields[f].len; i++)
+        {
+            // full, it writes over the oldest a byte at a time
+            if (s_mpu_fifo_count == MPU6050_FIFO_SIZE)
+            {
+                memmove(s_mpu_fifo, s_mpu_fifo + 1, MPU6050_FIFO_SIZE - 1);
+                s_mpu_fifo_count--;
+                accel->regs[MPU6050_INT_STATUS] |= MPU6050_INT_FIFO_OFLOW;
+            }
+            s_mpu_fifo[s_mpu_fifo_count++] = accel->regs[fields[f].reg + i];
+        }
+    }
+}
+
+/// Take the samples due since we last looked, at SMPLRT_DIV and the DLPF's rate
+static void sim_mpu6050_fill(sim_accel_t *accel)
+{
+    uint8_t dlpf = accel->regs[MPU6050_CONFIG] & 7;
+    uint64_t period = 1000000ULL * (1 + accel->regs[MPU6050_SMPLRT_DIV]) / (dlpf == 0 || dlpf == 7 ? 8 : 1);
+    uint64_t now = sim_now_ns();
+    bool sampled = false;
+
+    if (accel->regs[MPU6050_PWR_MGMT_1] & MPU6050_PWR_MGMT_1_SLEEP)
+    {
+        accel->next_ns = 0;
+        return;
+    }
+
+    if (!accel->next_ns)
+        accel->next_ns = now + period;
+
+    for (; accel->next_ns <= now; accel->next_ns += period)
+    {
+        sim_mpu6050_sample(accel);
+        sim_mpu6050_fifo_push(accel);
+        accel->regs[MPU6050_INT_STATUS] |= MPU6050_INT_DATA_RDY;
+        sampled = true;
+    }
+    if (sampled)
+        sim_mpu6050_int(accel);
+}
+
+static void sim_mpu6050_reset(sim_accel_t *accel)
+{
+    memset(accel->regs, 0, sizeof(accel->regs));
+    accel->regs[MPU6050_PWR_MGMT_1] = MPU6050_PWR_MGMT_1_SLEEP;
+    accel->regs[MPU6050_WHO_AM_I] = 0x68;
+    accel->next_ns = 0;
+    s_mpu_fifo_count = 0;
+}
+
+static void sim_accel_written(sim_accel_t *accel)
+{
+    if (accel->regs[MPU6050_PWR_MGMT_1] & MPU6050_PWR_MGMT_1_RESET)
+        sim_mpu6050_reset(accel);
+
+    if (accel->regs[MPU6050_USER_CTRL] & MPU6050_USER_CTRL_FIFO_RST)
+    {
+        accel->regs[MPU6050_USER_CTRL] &= ~MPU6050_USER_CTRL_FIFO_RST;
+        s_mpu_fifo_count = 0;
+    }
+    sim_mpu6050_int(accel);
+}
+
+static void sim_accel_read(sim_i2c_slave_t *slave, uint8_t *buf, uint32_t len)
+{
+    sim_accel_t *accel = (sim_accel_t *)slave;
+    bool clear = accel->ptr == MPU6050_INT_STATUS || (accel->regs[MPU6050_INT_PIN_CFG] & MPU6050_INT_PIN_CFG_RD_CLR);
+
+    sim_mpu6050_fill(accel);
+    accel->regs[MPU6050_FIFO_COUNTH] = s_mpu_fifo_count >> 8;
+    accel->regs[MPU6050_FIFO_COUNTH + 1] = s_mpu_fifo_count & 0xff;
+
+    while (len--)
+    {
+        // FIFO_R_W doesn't move the pointer on - every byte comes out of the FIFO
+        if (accel->ptr == MPU6050_FIFO_R_W)
+        {
+            *buf++ = s_mpu_fifo_count ? s_mpu_fifo[0] : 0;
+            if (s_mpu_fifo_count)
+                memmove(s_mpu_fifo, s_mpu_fifo + 1, --s_mpu_fifo_count);
+            continue;
+        }
+        *buf++ = accel->regs[accel->ptr++];
+    }
+
+    if (clear)
+    {
+        accel->regs[MPU6050_INT_STATUS] = 0;
+        sim_mpu6050_int(accel);
+    }
+}
+
+static sim_accel_t s_accel =
+{
+    .slave = { .addr = BSP_ACCEL_I2C_ADDR, .write = sim_accel_write, .read = sim_accel_read },
+    .regs =
+    {
+        [MPU6050_PWR_MGMT_1] = MPU6050_PWR_MGMT_1_SLEEP,    // asleep out of reset
+        [MPU6050_WHO_AM_I] = 0x68,
+    },
+};
+
+/// Samples come whether or not anyone reads them, and INT with them
+static void *sim_accel_thread(void *arg)
+{
+    struct timespec ts;
+
+    sim_bus_lock();
+    for (;;)
+    {
+        sim_mpu6050_fill(&s_accel);
+
+        sim_bus_unlock();
+        ts.tv_sec = 0;
+        ts.tv_nsec = SIM_ACCEL_POLL_NS;
+        nanosleep(&ts, NULL);
+        sim_bus_lock();
+    }
+    return NULL;
+}
+
+static void sim_accel_start(void)
+{
+    pthread_t thread;
+
+    pthread_create(&thread, NULL, sim_accel_thread, NULL);
+}
+
+#endif
+
+/*---------------------------------------------------------------------------
+ * HD44780 behind a PCF8574 - the PDG's wiring (pdg_task.c)
+ *---------------------------------------------------------------------------*/
+
+#define SIM_LCD_I2C_ADDR            0x3e
+#define SIM_LCD_RS                  0x01
+#define SIM_LCD_EN                  0x04
+#define SIM_LCD_BL                  0x08
+#define SIM_LCD_ROWS                4
+#define SIM_LCD_COLS                20
+#define SIM_LCD_RENDER_NS           100000000ULL    // 10 Hz
+
+typedef struct
+{
+    sim_i2c_slave_t slave;
+    uint8_t         port;           ///< last byte written to the PCF8574
+    bool            four_bit;
+    bool            have_high;      ///< first nibble of a 4-bit transfer is in
+    uint8_t         high;
+    bool            cgram;          ///< data goes to the character generator
+    bool            display_on;
+    int8_t          incr;           ///< entry mode I/D
+    uint8_t         ddram_addr;
+    uint8_t         ddram[128];
+    bool            dirty;
+} sim_lcd_t;
+
+static void sim_lcd_write_port(sim_i2c_slave_t *slave, const uint8_t *buf, uint32_t len);
+
+static sim_lcd_t s_lcd =
+{
+    .slave = { .addr = SIM_LCD_I2C_ADDR, .write = sim_lcd_write_port },
+    .incr = 1,
+};
+
+static void sim_lcd_command(sim_lcd_t *lcd, uint8_t cmd)
+{
+    if (cmd & 0x80)                                 // set DDRAM address
+    {
+        lcd->ddram_addr = cmd & 0x7f;
+        lcd->cgram = false;
+    }
+    else if (cmd & 0x40)                            // set CGRAM address
+    {
+        lcd->cgram = true;
+    }
+    else if (cmd & 0x20)                            // function set
+    {
+        lcd->four_bit = !(cmd & 0x10);
+    }
+    else if (cmd & 0x10)                            // cursor / display shift
+    {
+        if (!(cmd & 0x08))
+            lcd->ddram_addr = (lcd->ddram_addr + ((cmd & 0x04) ? 1 : -1)) & 0x7f;
+    }
+    else if (cmd & 0x08)                            // display on/off
+    {
+        lcd->display_on = (cmd & 0x04) != 0;
+        lcd->dirty = true;
+    }
+    else if (cmd & 0x04)                            // entry mode
+    {
+        lcd->incr = (cmd & 0x02) ? 1 : -1;
+    }
+    else if (cmd & 0x02)                            // return home
+    {
+        lcd->ddram_addr = 0;
+    }
+    else if (cmd & 0x01)                            // clear
+    {
+        memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+        lcd->ddram_addr = 0;
+        lcd->incr = 1;
+        lcd->dirty = true;
+    }
+}
+
+static void sim_lcd_data(sim_lcd_t *lcd, uint8_t data)
+{
+    if (lcd->cgram)
+        return;
+
+    lcd->ddram[lcd->ddram_addr] = data;
+    lcd->ddram_addr = (lcd->ddram_addr + lcd->incr) & 0x7f;
+    lcd->dirty = true;
+}
+
+/// EN fell: the HD44780 takes D7-D4
+static void sim_lcd_latch(sim_lcd_t *lcd, uint8_t port)
+{
+    uint8_t nibble = port >> 4;
+    uint8_t value;
+
+    if (!lcd->four_bit)
+    {
+        // 8-bit mode with D3-D0 not wired: only commands make sense
+        sim_lcd_command(lcd, nibble << 4);
+        return;
+    }
+
+    if (!lcd->have_high)
+    {
+        lcd->high = nibble;
+        lcd->have_high = true;
+        return;
+    }
+
+    lcd->have_high = false;
+    value = (lcd->high << 4) | nibble;
+    if (port & SIM_LCD_RS)
+        sim_lcd_data(lcd, value);
+    else
+        sim_lcd_command(lcd, value);
+}
+
+static void sim_lcd_write_port(sim_i2c_slave_t *slave, const uint8_t *buf, uint32_t len)
+{
+    sim_lcd_t *lcd = (sim_lcd_t *)slave;
+
+    while (len--)
+    {
+        uint8_t port = *buf++;
+
+        if ((lcd->port & SIM_LCD_EN) && !(port & SIM_LCD_EN))
+            sim_lcd_latch(lcd, lcd->port);
+        if ((lcd->port ^ port) & SIM_LCD_BL)
+            lcd->dirty = true;
+        lcd->port = port;
+    }
+}
+
+static void sim_lcd_render(sim_lcd_t *lcd, FILE *f)
+{
+    static const uint8_t row_addr[SIM_LCD_ROWS] = { 0x00, 0x40, 0x14, 0x54 };
+
+    fprintf(f, "+--------------------+ %s\n", (lcd->port & SIM_LCD_BL) ? "backlight" : "");
+    for (int r = 0; r < SIM_LCD_ROWS; r++)
+    {
+        fputc('|', f);
+        for (int c = 0; c < SIM_LCD_COLS; c++)
+        {
+            uint8_t ch = lcd->ddram[row_addr[r] + c];
+            fputc(lcd->display_on && ch >= 0x20 && ch < 0x7f ? ch : ' ', f);
+        }
+        fputs("|\n", f);
+    }
+    fputs("+--------------------+\n", f);
+}
+
+static void *sim_lcd_thread(void *arg)
+{
+    char path[256], tmp[260];
+    struct timespec ts;
+
+    snprintf(path, sizeof(path), "%s/lcd", g_sim.dir);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    sim_bus_lock();
+    for (;;)
+    {
+        if (s_lcd.dirty)
+        {
+            FILE *f = fopen(tmp, "w");
+
+            s_lcd.dirty = false;
+            if (f)
+            {
+                sim_lcd_render(&s_lcd, f);
+                fclose(f);
+                rename(tmp, path);
+            }
+        }
+
+        sim_bus_unlock();
+        ts.tv_sec = 0;
+        ts.tv_nsec = SIM_LCD_RENDER_NS;
+        nanosleep(&ts, NULL);
+        sim_bus_lock();
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Bus
+ *---------------------------------------------------------------------------*/
+
+static sim_i2c_slave_t *s_slaves[] =
+{
+    &s_accel.slave,
+    &s_lcd.slave,
+};
+
+static sim_i2c_slave_t *sim_i2c_slave(uint32_t addr)
+{
+    for (int i = 0; i < sizeof(s_slaves) / sizeof(s_slaves[0]); i++)
+    {
+        if (s_slaves[i]->addr == addr)
+            return s_slaves[i];
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * TWIM0
+ *---------------------------------------------------------------------------*/
+
+#define SIM_TWIM_WRITE_MAX          1024
+#define SIM_TWIM_SR_DONE            (AVR32_TWIM_SR_ANAK_MASK | AVR32_TWIM_SR_DNAK_MASK | AVR32_TWIM_SR_ARBLST_MASK)
+#define SIM_TWIM_SR_IRQ             (AVR32_TWIM_SR_CRDY_MASK | AVR32_TWIM_SR_CCOMP_MASK | SIM_TWIM_SR_DONE)
+
+static struct
+{
+    sim_i2c_slave_t *slave;             ///< addressed since the last START, until the STOP
+    uint8_t         write[SIM_TWIM_WRITE_MAX];
+    uint32_t        write_len;
+} s_twim;
+
+static void sim_twim_flush(void)
+{
+    if (s_twim.slave && s_twim.write_len)
+        s_twim.slave->write(s_twim.slave, s_twim.write, s_twim.write_len);
+    s_twim.write_len = 0;
+}
+
+/// Run the command in cmdr, false if it has to wait for the PDCA
+static bool sim_twim_command(volatile avr32_twim_t *twim)
+{
+    uint32_t cmd = twim->cmdr;
+    uint32_t n = (cmd & AVR32_TWIM_CMDR_NBYTES_MASK) >> AVR32_TWIM_CMDR_NBYTES_OFFSET;
+    bool read = cmd & AVR32_TWIM_CMDR_READ_MASK;
+    uint8_t buf[256];
+
+    if (sim_pdca_ready(read ? AVR32_PDCA_PID_TWIM0_RX : AVR32_PDCA_PID_TWIM0_TX) < n)
+        return false;
+
+    if (cmd & AVR32_TWIM_CMDR_START_MASK)
+    {
+        sim_twim_flush();
+        s_twim.slave = sim_i2c_slave((cmd & AVR32_TWIM_CMDR_SADR_MASK) >> AVR32_TWIM_CMDR_SADR_OFFSET);
+    }
+    if (!s_twim.slave || (read && !s_twim.slave->read))
+    {
+        // nobody acknowledged the address: the TWIM stops and drops what's queued
+        s_twim.slave = NULL;
+        s_twim.write_len = 0;
+        twim->cmdr = 0;
+        twim->ncmdr = 0;
+        twim->sr |= AVR32_TWIM_SR_ANAK_MASK;
+        return true;
+    }
+
+    if (read)
+    {
+        sim_twim_flush();
+        s_twim.slave->read(s_twim.slave, buf, n);
+        sim_pdca_move(AVR32_PDCA_PID_TWIM0_RX, buf, n, true);
+    }
+    else
+    {
+        sim_pdca_move(AVR32_PDCA_PID_TWIM0_TX, buf, n, false);
+        if (s_twim.write_len + n <= SIM_TWIM_WRITE_MAX)
+        {
+            memcpy(s_twim.write + s_twim.write_len, buf, n);
+            s_twim.write_len += n;
+        }
+        else
+            sim_log("twim: %02x write of more than %d bytes dropped\n", s_twim.slave->addr, SIM_TWIM_WRITE_MAX);
+    }
+
+    if (cmd & AVR32_TWIM_CMDR_STOP_MASK)
+    {
+        sim_twim_flush();
+        s_twim.slave = NULL;
+    }
+    twim->cmdr = twim->ncmdr;
+    twim->ncmdr = 0;
+    twim->sr |= AVR32_TWIM_SR_CCOMP_MASK;
+    return true;
+}
+
+static void sim_twim_sync(void)
+{
+    volatile avr32_twim_t *twim = &sim_twim[0];
+
+    // both since the last sync is a disable all then an enable - not the other way round
+    if (twim->ier || twim->idr)
+    {
+        twim->imr = (twim->imr & ~twim->idr) | twim->ier;
+        twim->ier = 0;
+        twim->idr = 0;
+    }
+    if (twim->scr)
+    {
+        twim->sr &= ~twim->scr;
+        twim->scr = 0;
+    }
+
+    if (twim->cr & AVR32_TWIM_CR_SWRST_MASK)
+    {
+        twim->cmdr = 0;
+        twim->ncmdr = 0;
+        twim->sr = 0;
+        twim->imr = 0;
+        s_twim.slave = NULL;
+        s_twim.write_len = 0;
+    }
+    if (twim->cr & AVR32_TWIM_CR_MEN_MASK)
+        twim->sr |= AVR32_TWIM_SR_MENB_MASK;
+    if (twim->cr & AVR32_TWIM_CR_MDIS_MASK)
+        twim->sr &= ~AVR32_TWIM_SR_MENB_MASK;
+    twim->cr = 0;
+
+    if (!(twim->cmdr & AVR32_TWIM_CMDR_VALID_MASK) && (twim->ncmdr & AVR32_TWIM_CMDR_VALID_MASK))
+    {
+        twim->cmdr = twim->ncmdr;
+        twim->ncmdr = 0;
+    }
+    while ((twim->sr & AVR32_TWIM_SR_MENB_MASK) && (twim->cmdr & AVR32_TWIM_CMDR_VALID_MASK))
+    {
+        if (!sim_twim_command(twim))
+            break;
+    }
+
+    twim->sr &= ~(AVR32_TWIM_SR_CRDY_MASK | AVR32_TWIM_SR_IDLE_MASK | AVR32_TWIM_SR_BUSFREE_MASK);
+    if (!(twim->ncmdr & AVR32_TWIM_CMDR_VALID_MASK))
+        twim->sr |= AVR32_TWIM_SR_CRDY_MASK;
+    if (!(twim->cmdr & AVR32_TWIM_CMDR_VALID_MASK))
+        twim->sr |= AVR32_TWIM_SR_IDLE_MASK | AVR32_TWIM_SR_BUSFREE_MASK;
+}
+
+static bool sim_twim_pending(uint32_t irq)
+{
+    return (sim_twim[0].imr & sim_twim[0].sr & SIM_TWIM_SR_IRQ) != 0;
+}
+
+static sim_model_t s_twim_model =
+{
+    .name = "twim",
+    .irq_first = AVR32_TWIM0_IRQ,
+    .irq_count = 1,
+    .sync = sim_twim_sync,
+    .pending = sim_twim_pending,
+};
+
+void sim_twim_init(void)
+{
+    pthread_t thread;
+
+    memset(s_lcd.ddram, ' ', sizeof(s_lcd.ddram));
+    s_lcd.dirty = true;
+    pthread_create(&thread, NULL, sim_lcd_thread, NULL);
+
+    sim_accel_start();
+    sim_model_register(&s_twim_model);
+}
+
+/*---------------------------------------------------------------------------
+ * ASF driver
+ *---------------------------------------------------------------------------*/
+
+status_code_t twim_set_speed(volatile avr32_twim_t *twim, uint32_t speed, uint32_t pba_hz)
+{
+    if (!speed || pba_hz / speed / 2 > 0xff << 7)
+        return ERR_INVALID_ARG;
+    twim->cwgr = pba_hz / speed / 2;
+    return STATUS_OK;
+}
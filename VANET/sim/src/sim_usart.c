@@ -0,0 +1,500 @@
+/**
+ *	@file	sim_usart.c
+ *
+ *	@brief	vanet-sim - USART model
+ *
+ *	Each USART the board uses is a pseudo terminal, linked as <dir>/gps,
+ *	<dir>/misc, <dir>/mux and <dir>/debug (or the debug port is the console).
+ *	Bytes move at the configured baud rate in both directions, so the firmware
+ *	sees the same interrupt load it would on the wire.  Receive applies back
+ *	pressure instead of overrunning; transmit with nobody reading the pty is
+ *	dropped, as it would be on an unplugged cable.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <asf.h>
+#include "sim.h"
+
+#define SIM_USART_FIFO_SIZE         64
+#define SIM_USART_THR_EMPTY         0xffffffff      // never a valid THR write
+#define SIM_USART_MIN_POLL_MS       1
+
+typedef struct
+{
+    uint8_t     buf[SIM_USART_FIFO_SIZE];
+    uint16_t    head;
+    uint16_t    count;
+} sim_fifo_t;
+
+typedef struct
+{
+    const char  *name;                  ///< link name, NULL for unused USARTs
+    int         fd_in;
+    int         fd_out;
+    int         slave;                  ///< our own hold on the pty slave side
+    sim_fifo_t  rx;
+    sim_fifo_t  tx;
+    uint32_t    baud;
+    double      rx_credit;              ///< bytes the wire may carry right now
+    double      tx_credit;
+    uint64_t    credit_ns;
+    int         wake[2];
+    pthread_t   thread;
+} sim_usart_t;
+
+volatile avr32_usart_t sim_usart[SIM_USART_COUNT];
+
+static sim_usart_t s_usart[SIM_USART_COUNT];
+static struct termios s_console_termios;
+static bool s_console_raw;
+
+/*---------------------------------------------------------------------------
+ * FIFOs
+ *---------------------------------------------------------------------------*/
+
+static inline uint16_t sim_fifo_room(const sim_fifo_t *f)
+{
+    return SIM_USART_FIFO_SIZE - f->count;
+}
+
+static void sim_fifo_put(sim_fifo_t *f, uint8_t c)
+{
+    f->buf[(f->head + f->count) % SIM_USART_FIFO_SIZE] = c;
+    f->count++;
+}
+
+static uint8_t sim_fifo_get(sim_fifo_t *f)
+{
+    uint8_t c = f->buf[f->head];
+
+    f->head = (f->head + 1) % SIM_USART_FIFO_SIZE;
+    f->count--;
+    return c;
+}
+
+/*---------------------------------------------------------------------------
+ * Registers (bus lock held)
+ *---------------------------------------------------------------------------*/
+
+static inline int sim_usart_index(volatile avr32_usart_t *usart)
+{
+    return usart - sim_usart;
+}
+
+static void sim_usart_update_csr(int i)
+{
+    uint32_t csr = sim_usart[i].csr & ~(AVR32_USART_CSR_RXRDY_MASK | AVR32_USART_CSR_TXRDY_MASK |
+                                        AVR32_USART_CSR_TXEMPTY_MASK);
+
+    if (s_usart[i].rx.count)
+        csr |= AVR32_USART_CSR_RXRDY_MASK;
+    if (sim_fifo_room(&s_usart[i].tx))
+        csr |= AVR32_USART_CSR_TXRDY_MASK;
+    if (!s_usart[i].tx.count)
+        csr |= AVR32_USART_CSR_TXEMPTY_MASK;
+
+    sim_usart[i].csr = csr;
+}
+
+static void sim_usart_wake(int i)
+{
+    char c = 0;
+
+    if (s_usart[i].name && write(s_usart[i].wake[1], &c, 1) < 0) {}
+}
+
+static void sim_usart_tx(int i, uint8_t c)
+{
+    if (!s_usart[i].tx.count)
+        sim_usart_wake(i);
+    sim_fifo_put(&s_usart[i].tx, c);
+    sim_usart_update_csr(i);
+}
+
+static void sim_usart_sync(void)
+{
+    for (int i = 0; i < SIM_USART_COUNT; i++)
+    {
+        volatile avr32_usart_t *usart = &sim_usart[i];
+
+        if (usart->ier || usart->idr)
+        {
+            usart->imr = (usart->imr | usart->ier) & ~usart->idr;
+            usart->ier = 0;
+            usart->idr = 0;
+        }
+
+        if (usart->thr != SIM_USART_THR_EMPTY)
+        {
+            if (sim_fifo_room(&s_usart[i].tx))
+                sim_usart_tx(i, usart->thr & 0xff);
+            usart->thr = SIM_USART_THR_EMPTY;
+        }
+    }
+}
+
+static bool sim_usart_pending(uint32_t irq)
+{
+    volatile avr32_usart_t *usart = &sim_usart[irq - AVR32_USART0_IRQ];
+
+    return (usart->imr & usart->csr & (AVR32_USART_CSR_RXRDY_MASK | AVR32_USART_CSR_TXRDY_MASK)) != 0;
+}
+
+static sim_model_t s_usart_model =
+{
+    .name = "usart",
+    .irq_first = AVR32_USART0_IRQ,
+    .irq_count = SIM_USART_COUNT,
+    .sync = sim_usart_sync,
+    .pending = sim_usart_pending,
+};
+
+/*---------------------------------------------------------------------------
+ * The wire
+ *---------------------------------------------------------------------------*/
+
+static void sim_usart_credit(sim_usart_t *u)
+{
+    uint64_t now = sim_now_ns();
+    double bytes = (double)(now - u->credit_ns) * u->baud / 10 / 1e9;
+
+    u->credit_ns = now;
+    u->rx_credit = Min(u->rx_credit + bytes, SIM_USART_FIFO_SIZE);
+    u->tx_credit = Min(u->tx_credit + bytes, SIM_USART_FIFO_SIZE);
+}
+
+static void *sim_usart_thread(void *arg)
+{
+    sim_usart_t *u = arg;
+    int i = u - s_usart;
+    uint8_t buf[SIM_USART_FIFO_SIZE];
+    struct pollfd pfd[3] = { { 0 } };
+    bool rx_open = true;
+
+    for (;;)
+    {
+        int rx_want, tx_want, timeout = -1, n = 1, rx_fd = 0;
+        double per_ms;
+
+        sim_bus_lock();
+        sim_usart_credit(u);
+        rx_want = rx_open ? Min(sim_fifo_room(&u->rx), (int)u->rx_credit) : 0;
+        tx_want = Min(u->tx.count, (int)u->tx_credit);
+        per_ms = u->baud / 10000.0;
+        if ((rx_open && sim_fifo_room(&u->rx) && !rx_want) || (u->tx.count && !tx_want))
+            timeout = Max(SIM_USART_MIN_POLL_MS, (int)(1 / per_ms + 1));
+        sim_bus_unlock();
+
+        pfd[0].fd = u->wake[0];
+        pfd[0].events = POLLIN;
+        if (rx_want)
+        {
+            rx_fd = n;
+            pfd[n].fd = u->fd_in;
+            pfd[n++].events = POLLIN;
+        }
+        if (tx_want)
+        {
+            pfd[n].fd = u->fd_out;
+            pfd[n++].events = POLLOUT;
+        }
+
+        if (poll(pfd, n, timeout) < 0 && errno != EINTR)
+            break;
+
+        if (pfd[0].revents & POLLIN)
+        {
+            while (read(u->wake[0], buf, sizeof(buf)) > 0) {}
+        }
+
+        // receive
+        if (rx_fd && (pfd[rx_fd].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            ssize_t got = read(u->fd_in, buf, rx_want);
+
+            if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                // the console went away - the port just goes quiet
+                rx_open = false;
+            }
+            else if (got > 0)
+            {
+                sim_bus_lock();
+                for (ssize_t k = 0; k < got; k++)
+                    sim_fifo_put(&u->rx, buf[k]);
+                u->rx_credit -= got;
+                sim_usart_update_csr(i);
+                sim_bus_kick();
+                sim_bus_unlock();
+            }
+        }
+
+        // transmit
+        if (tx_want)
+        {
+            int count;
+
+            sim_bus_lock();
+            sim_usart_credit(u);
+            count = Min(u->tx.count, (int)u->tx_credit);
+            for (int k = 0; k < count; k++)
+                buf[k] = sim_fifo_get(&u->tx);
+            u->tx_credit -= count;
+            sim_usart_update_csr(i);
+            sim_bus_kick();
+            sim_bus_unlock();
+
+            // EAGAIN on a pty nobody reads: the bytes are gone, like on the wire
+            for (int off = 0; off < count; )
+            {
+                ssize_t put = write(u->fd_out, buf + off, count - off);
+
+                if (put < 0 && errno == EINTR)
+                    continue;
+                if (put <= 0)
+                    break;
+                off += put;
+            }
+        }
+    }
+
+    sim_log("%s: io thread stopped", u->name);
+    return NULL;
+}
+
+static void sim_usart_open_pty(sim_usart_t *u)
+{
+    struct termios t;
+    char link[256];
+    const char *path;
+    int fd;
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0 || !(path = ptsname(fd)))
+    {
+        sim_log("%s: can't open a pty", u->name);
+        exit(1);
+    }
+
+    // hold the slave open so the master never sees a hangup between clients
+    u->slave = open(path, O_RDWR | O_NOCTTY);
+    if (u->slave >= 0 && tcgetattr(u->slave, &t) == 0)
+    {
+        cfmakeraw(&t);
+        tcsetattr(u->slave, TCSANOW, &t);
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    u->fd_in = fd;
+    u->fd_out = fd;
+
+    snprintf(link, sizeof(link), "%s/%s", g_sim.dir, u->name);
+    unlink(link);
+    if (symlink(path, link) < 0)
+        sim_log("%s: can't link %s", u->name, link);
+
+    sim_log("%-6s %s -> %s", u->name, link, path);
+}
+
+static void sim_usart_open_console(sim_usart_t *u)
+{
+    struct termios t;
+
+    if (isatty(0) && tcgetattr(0, &s_console_termios) == 0)
+    {
+        // raw, but ^C still stops the simulator
+        t = s_console_termios;
+        cfmakeraw(&t);
+        t.c_lflag |= ISIG;
+        t.c_oflag |= OPOST;
+        tcsetattr(0, TCSANOW, &t);
+        s_console_raw = true;
+    }
+
+    u->fd_in = 0;
+    u->fd_out = 1;
+}
+
+void sim_usart_init(void)
+{
+    static const struct
+    {
+        volatile avr32_usart_t  *usart;
+        const char              *name;
+    } ports[] =
+    {
+        { GPS_USART,    "gps" },
+        { MISC_USART,   "misc" },
+        { MUX_USART,    "mux" },
+        { DBG_USART,    "debug" },
+    };
+
+    for (int i = 0; i < SIM_USART_COUNT; i++)
+    {
+        sim_usart[i].thr = SIM_USART_THR_EMPTY;
+        s_usart[i].fd_in = -1;
+        s_usart[i].fd_out = -1;
+        s_usart[i].slave = -1;
+    }
+
+    for (size_t p = 0; p < sizeof(ports) / sizeof(ports[0]); p++)
+    {
+        sim_usart_t *u = &s_usart[sim_usart_index(ports[p].usart)];
+
+        u->name = ports[p].name;
+        if (ports[p].usart == DBG_USART && g_sim.console)
+            sim_usart_open_console(u);
+        else
+            sim_usart_open_pty(u);
+
+        if (pipe2(u->wake, O_NONBLOCK) < 0 || pthread_create(&u->thread, NULL, sim_usart_thread, u) != 0)
+        {
+            sim_log("%s: can't start", u->name);
+            exit(1);
+        }
+    }
+
+    sim_model_register(&s_usart_model);
+}
+
+void sim_usart_shutdown(void)
+{
+    char link[256];
+
+    if (s_console_raw)
+        tcsetattr(0, TCSANOW, &s_console_termios);
+
+    for (int i = 0; i < SIM_USART_COUNT; i++)
+    {
+        if (s_usart[i].name && s_usart[i].slave >= 0)
+        {
+            snprintf(link, sizeof(link), "%s/%s", g_sim.dir, s_usart[i].name);
+            unlink(link);
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------
+ * ASF driver
+ *---------------------------------------------------------------------------*/
+
+void usart_reset(volatile avr32_usart_t *usart)
+{
+    sim_bus_lock();
+    usart->mr = 0;
+    usart->imr = 0;
+    usart->ier = 0;
+    usart->idr = 0;
+    usart->thr = SIM_USART_THR_EMPTY;
+    sim_bus_unlock();
+}
+
+int usart_init_rs232(volatile avr32_usart_t *usart, const usart_options_t *opt, long pba_hz)
+{
+    int i = sim_usart_index(usart);
+
+    if (!opt || !opt->baudrate)
+        return USART_INVALID_INPUT;
+
+    usart_reset(usart);
+
+    sim_bus_lock();
+    usart->mr = 0x000008c0 | ((opt->charlength - 5) << 6);     // normal mode, MCK, CHRL
+    usart->brgr = pba_hz / (16 * opt->baudrate);
+    s_usart[i].baud = opt->baudrate;
+    s_usart[i].credit_ns = sim_now_ns();
+    sim_usart_update_csr(i);
+    sim_bus_unlock();
+
+    return USART_SUCCESS;
+}
+
+int usart_write_char(volatile avr32_usart_t *usart, int c)
+{
+    int i = sim_usart_index(usart);
+    int ret = USART_TX_BUSY;
+
+    sim_bus_lock();
+    if (sim_fifo_room(&s_usart[i].tx))
+    {
+        sim_usart_tx(i, c);
+        ret = USART_SUCCESS;
+    }
+    sim_bus_unlock();
+
+    return ret;
+}
+
+int usart_putchar(volatile avr32_usart_t *usart, int c)
+{
+    int i = sim_usart_index(usart);
+
+    if (!s_usart[i].name || !s_usart[i].baud)
+        return USART_FAILURE;
+
+    sim_bus_lock();
+    while (!sim_fifo_room(&s_usart[i].tx))
+        sim_bus_wait(NULL);
+    sim_usart_tx(i, c);
+    sim_bus_unlock();
+
+    return USART_SUCCESS;
+}
+
+int usart_read_char(volatile avr32_usart_t *usart, int *c)
+{
+    int i = sim_usart_index(usart);
+    int ret = USART_RX_EMPTY;
+
+    sim_bus_lock();
+    if (s_usart[i].rx.count)
+    {
+        if (!sim_fifo_room(&s_usart[i].rx))
+            sim_usart_wake(i);
+        *c = sim_fifo_get(&s_usart[i].rx);
+        sim_usart_update_csr(i);
+        ret = USART_SUCCESS;
+    }
+    sim_bus_unlock();
+
+    return ret;
+}
+
+int usart_getchar(volatile avr32_usart_t *usart)
+{
+    int i = sim_usart_index(usart);
+    int c;
+
+    sim_bus_lock();
+    while (!s_usart[i].rx.count)
+        sim_bus_wait(NULL);
+    sim_bus_unlock();
+
+    usart_read_char(usart, &c);
+    return c;
+}
+
+void usart_write_line(volatile avr32_usart_t *usart, const char *string)
+{
+    while (*string != '\0')
+        usart_putchar(usart, *string++);
+}
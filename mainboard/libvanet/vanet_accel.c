@@ -0,0 +1,194 @@
+/**
+ *	@file	vanet_accel.c
+ *
+ *	@brief	Raw accelerometer stream (Mainboard Side)
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "vanet_accel.h"
+
+static uint16_t get_be16(const uint8_t* p)
+{
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static uint32_t get_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int vanet_accel_request(uint8_t* out, uint16_t rate_hz, uint8_t batch)
+{
+    out[0] = VANET_API_ACCEL_STREAM_REQUEST;
+    out[1] = rate_hz >> 8;
+    out[2] = rate_hz;
+    out[3] = batch;
+
+    return VANET_API_ACCEL_REQUEST_SIZE;
+}
+
+int vanet_accel_feature_request(uint8_t* out, uint16_t rate_hz, uint16_t feature_hz, uint8_t batch, uint8_t flags)
+{
+    out[0] = VANET_API_ACCEL_FEATURE_REQUEST;
+    out[1] = rate_hz >> 8;
+    out[2] = rate_hz;
+    out[3] = feature_hz >> 8;
+    out[4] = feature_hz;
+    out[5] = batch;
+    out[6] = flags;
+
+    return VANET_API_ACCEL_FEATURE_REQUEST_SIZE;
+}
+
+void vanet_accel_parser_init(vanet_accel_parser_t* p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+static int hdr_ok(const uint8_t* hdr)
+{
+    switch (hdr[0])
+    {
+        case VANET_API_ACCEL_CONFIG:
+            return hdr[1] == VANET_API_ACCEL_CONFIG_SIZE - 2;
+        case VANET_API_ACCEL_BATCH:
+            return hdr[1] >= VANET_API_ACCEL_BATCH_HDR_SIZE - 2 + 6 &&
+                   hdr[1] <= VANET_API_ACCEL_BATCH_HDR_SIZE - 2 + 6 * VANET_API_ACCEL_BATCH_MAX &&
+                   (hdr[1] - (VANET_API_ACCEL_BATCH_HDR_SIZE - 2)) % 6 == 0;
+        case VANET_API_ACCEL_FEATURES:
+            return hdr[1] >= VANET_API_ACCEL_BATCH_HDR_SIZE - 2 + VANET_API_ACCEL_FEATURE_SIZE &&
+                   hdr[1] <= VANET_API_ACCEL_BATCH_HDR_SIZE - 2 + VANET_API_ACCEL_FEATURE_SIZE * VANET_API_ACCEL_FEATURE_MAX &&
+                   (hdr[1] - (VANET_API_ACCEL_BATCH_HDR_SIZE - 2)) % VANET_API_ACCEL_FEATURE_SIZE == 0;
+        default:
+            return 0;
+    }
+}
+
+static int rec_decode(vanet_accel_parser_t* p, vanet_accel_rec_t* rec)
+{
+    const uint8_t* b = p->buf;
+    int size;
+
+    memset(rec, 0, offsetof(vanet_accel_rec_t, xyz));
+    rec->type = b[0];
+
+    if (rec->type == VANET_API_ACCEL_CONFIG)
+    {
+        rec->rate_hz = get_be16(&b[2]);
+        rec->count = b[4];
+        rec->range = b[5];
+        return 1;
+    }
+
+    // batches and features share the header but for bytes 6-7
+    rec->count = b[2];
+    size = rec->type == VANET_API_ACCEL_FEATURES ? VANET_API_ACCEL_FEATURE_SIZE : 6;
+    if (rec->count != (b[1] - (VANET_API_ACCEL_BATCH_HDR_SIZE - 2)) / size)
+        return 0;
+    rec->flags = b[3];
+    rec->rate_hz = get_be16(&b[4]);
+    rec->seq = get_be32(&b[8]);
+    rec->time_us = ((uint64_t)get_be32(&b[12]) << 32) | get_be32(&b[16]);
+
+    if (rec->type == VANET_API_ACCEL_FEATURES)
+    {
+        rec->decimation = get_be16(&b[6]);
+        b += VANET_API_ACCEL_BATCH_HDR_SIZE;
+        for (int i=0; i<rec->count; i++, b += VANET_API_ACCEL_FEATURE_SIZE)
+        {
+            rec->feature[i].x = (int16_t)get_be16(&b[0]);
+            rec->feature[i].y = (int16_t)get_be16(&b[2]);
+            rec->feature[i].z = (int16_t)get_be16(&b[4]);
+            rec->feature[i].mag = get_be16(&b[6]);
+            rec->feature[i].jerk = get_be16(&b[8]);
+        }
+    }
+    else
+    {
+        rec->range = b[6];
+        b += VANET_API_ACCEL_BATCH_HDR_SIZE;
+        for (int i=0; i<rec->count; i++, b += 6)
+        {
+            rec->xyz[i].x = (int16_t)get_be16(&b[0]);
+            rec->xyz[i].y = (int16_t)get_be16(&b[2]);
+            rec->xyz[i].z = (int16_t)get_be16(&b[4]);
+        }
+    }
+
+    // a new request starts the count again
+    if (rec->seq > p->next_seq)
+        p->lost += rec->seq - p->next_seq;
+    p->next_seq = rec->seq + rec->count;
+    return 1;
+}
+
+int vanet_accel_parse(vanet_accel_parser_t* p, const uint8_t* buf, size_t len, vanet_accel_rec_cb_t cb, void* ctx)
+{
+    vanet_accel_rec_t rec;
+    uint32_t need, n;
+    int delivered = 0;
+
+    while (len > 0)
+    {
+        need = 2;
+        if (p->have >= 2)
+            need += p->buf[1];
+
+        n = need - p->have;
+        if (n > len) n = len;
+        memcpy(&p->buf[p->have], buf, n);
+        p->have += n;
+        buf += n;
+        len -= n;
+
+        if (p->have < 2)
+            continue;
+
+        if (p->have == 2 && !hdr_ok(p->buf))
+        {
+            // resync: drop the first byte and look again
+            p->skipped++;
+            memmove(p->buf, p->buf + 1, --p->have);
+            continue;
+        }
+
+        if (p->have == 2u + p->buf[1])
+        {
+            p->have = 0;
+            if (rec_decode(p, &rec))
+            {
+                if (rec.type == VANET_API_ACCEL_CONFIG)
+                    p->next_seq = 0;
+                p->records++;
+                delivered++;
+                if (cb) cb(ctx, &rec);
+            }
+            else
+            {
+                p->skipped += 2u + p->buf[1];
+            }
+        }
+    }
+
+    return delivered;
+}
+
+uint64_t vanet_accel_time_us(const vanet_accel_rec_t* rec, int i)
+{
+    // the daughterboard steps by whole us a sample, and features are a decimation factor of samples apart
+    uint64_t step = rec->type == VANET_API_ACCEL_FEATURES ? rec->decimation : 1;
+
+    return rec->rate_hz ? rec->time_us + i * step * (1000000 / rec->rate_hz) : rec->time_us;
+}
@@ -0,0 +1,125 @@
+/**
+ *	@file	vanet_accel.h
+ *
+ *	@brief	Raw accelerometer stream (Mainboard Side)
+ *
+ *	A stream request switches the raw accelerometer mux channel from its once
+ *	a second text line to batches of every sample, and a feature request to
+ *	batches of filtered, decimated features.  The record formats are in
+ *	vanet_api.h.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef VANET_ACCEL_H
+#define VANET_ACCEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vanet_api.h"
+
+/// Largest record: type, length and up to 255 bytes
+#define VANET_ACCEL_MAX_RECORD          257
+
+typedef struct
+{
+    int16_t         x;
+    int16_t         y;
+    int16_t         z;
+} vanet_accel_xyz_t;
+
+/// One feature - filtered and decimated, in mg
+typedef struct
+{
+    int16_t         x;
+    int16_t         y;
+    int16_t         z;
+    uint16_t        mag;            ///< Magnitude of x, y, z
+    uint16_t        jerk;           ///< Change in acceleration since the feature before, 0.1 G/s
+} vanet_accel_feature_t;
+
+/// A decoded record.  Only valid during the callback
+typedef struct
+{
+    uint8_t         type;           ///< VANET_API_ACCEL_CONFIG, VANET_API_ACCEL_BATCH or VANET_API_ACCEL_FEATURES
+    uint8_t         count;          ///< Batch: samples in xyz[].  Features: in feature[].  Config: per batch
+    uint8_t         flags;          ///< Batch, features: VANET_API_ACCEL_xxx
+    uint8_t         range;          ///< Batch, config: full scale, +/- G
+    uint16_t        rate_hz;        ///< Output data rate
+    uint16_t        decimation;     ///< Features: samples per feature
+    uint32_t        seq;            ///< Batch, features: sequence number of the first
+    uint64_t        time_us;        ///< Batch, features: time of the first, us since 1970 UTC
+    vanet_accel_xyz_t xyz[VANET_API_ACCEL_BATCH_MAX];
+    vanet_accel_feature_t feature[VANET_API_ACCEL_FEATURE_MAX];
+} vanet_accel_rec_t;
+
+/// Record callback
+typedef void (*vanet_accel_rec_cb_t)(void* ctx, const vanet_accel_rec_t* rec);
+
+/// Incremental record parser state
+typedef struct
+{
+    uint32_t        have;           ///< Bytes of the current record in buf
+    uint8_t         buf[VANET_ACCEL_MAX_RECORD];
+
+    uint32_t        records;        ///< Records delivered
+    uint32_t        skipped;        ///< Bytes skipped looking for a record - text lines from before the request, say
+    uint32_t        lost;           ///< Samples missing between batches, by sequence number
+    uint32_t        next_seq;       ///< Sequence number expected next
+} vanet_accel_parser_t;
+
+/**
+ *  Encode a stream request
+ *
+ *  @param out      Output buffer, VANET_API_ACCEL_REQUEST_SIZE bytes
+ *  @param rate_hz  Output data rate, 0 to keep the current one
+ *  @param batch    Samples per batch (1 .. VANET_API_ACCEL_BATCH_MAX), 0 for the text lines again
+ *
+ *  @return The number of bytes written to out
+ */
+extern int vanet_accel_request(uint8_t* out, uint16_t rate_hz, uint8_t batch);
+
+/**
+ *  Encode a feature request
+ *
+ *  @param out          Output buffer, VANET_API_ACCEL_FEATURE_REQUEST_SIZE bytes
+ *  @param rate_hz      Output data rate, 0 to keep the current one
+ *  @param feature_hz   Features per second
+ *  @param batch        Features per batch (1 .. VANET_API_ACCEL_FEATURE_MAX), 0 for the text lines again
+ *  @param flags        VANET_API_ACCEL_FEATURE_xxx
+ *
+ *  @return The number of bytes written to out
+ */
+extern int vanet_accel_feature_request(uint8_t* out, uint16_t rate_hz, uint16_t feature_hz, uint8_t batch, uint8_t flags);
+
+/// Initialize a parser
+extern void vanet_accel_parser_init(vanet_accel_parser_t* p);
+
+/**
+ *  Feed stream bytes to the parser.  cb is called for every record.  Bytes
+ *  that don't start a good record are counted and skipped one at a time.
+ *
+ *  @return The number of records delivered
+ */
+extern int vanet_accel_parse(vanet_accel_parser_t* p, const uint8_t* buf, size_t len, vanet_accel_rec_cb_t cb, void* ctx);
+
+/// Time of sample i of a batch, or feature i of a features record, us since 1970 UTC
+extern uint64_t vanet_accel_time_us(const vanet_accel_rec_t* rec, int i);
+
+/// Raw counts to milli-G at a range
+static inline int32_t vanet_accel_mg(int16_t raw, uint8_t range)
+{
+    return (int32_t)raw * range * 1000 / 32768;
+}
+
+#endif // VANET_ACCEL_H
@@ -0,0 +1,108 @@
+/**
+ *	@file	vanet_capture.c
+ *
+ *	@brief	Termios capture records (Mainboard Side)
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "vanet_capture.h"
+
+int vanet_capture_encode(uint8_t* out, uint8_t type, uint8_t port, uint32_t delta_us, const uint8_t* data, uint16_t len)
+{
+    out[0] = type;
+    out[1] = port;
+    out[2] = len >> 8;
+    out[3] = len;
+    out[4] = delta_us >> 24;
+    out[5] = delta_us >> 16;
+    out[6] = delta_us >> 8;
+    out[7] = delta_us;
+    if (len) memcpy(&out[VANET_CAPTURE_HDR_SIZE], data, len);
+
+    return VANET_CAPTURE_HDR_SIZE + len;
+}
+
+void vanet_capture_parser_init(vanet_capture_parser_t* p)
+{
+    p->have = 0;
+    p->records = 0;
+    p->bad = 0;
+}
+
+static uint16_t hdr_len(const uint8_t* hdr)
+{
+    return ((uint16_t)hdr[2] << 8) | hdr[3];
+}
+
+static int hdr_ok(const uint8_t* hdr)
+{
+    switch (hdr[0])
+    {
+        case VANET_CAPTURE_VERSION:
+        case VANET_CAPTURE_NAME:
+        case VANET_CAPTURE_DATA:
+        case VANET_CAPTURE_END:
+            return hdr_len(hdr) <= VANET_CAPTURE_MAX_DATA;
+        default:
+            return 0;
+    }
+}
+
+int vanet_capture_parse(vanet_capture_parser_t* p, const uint8_t* buf, size_t len, vanet_capture_rec_cb_t cb, void* ctx)
+{
+    vanet_capture_rec_t rec;
+    uint32_t need, n;
+    int delivered = 0;
+
+    while (len > 0)
+    {
+        need = VANET_CAPTURE_HDR_SIZE;
+        if (p->have >= VANET_CAPTURE_HDR_SIZE)
+            need += hdr_len(p->buf);
+
+        n = need - p->have;
+        if (n > len) n = len;
+        memcpy(&p->buf[p->have], buf, n);
+        p->have += n;
+        buf += n;
+        len -= n;
+
+        if (p->have < VANET_CAPTURE_HDR_SIZE)
+            continue;
+
+        if (p->have == VANET_CAPTURE_HDR_SIZE && !hdr_ok(p->buf))
+        {
+            // resync: drop the first byte and look again
+            p->bad++;
+            memmove(p->buf, p->buf + 1, --p->have);
+            continue;
+        }
+
+        if (p->have == VANET_CAPTURE_HDR_SIZE + hdr_len(p->buf))
+        {
+            rec.type = p->buf[0];
+            rec.port = p->buf[1];
+            rec.len = hdr_len(p->buf);
+            rec.delta_us = ((uint32_t)p->buf[4] << 24) | ((uint32_t)p->buf[5] << 16) | ((uint32_t)p->buf[6] << 8) | p->buf[7];
+            rec.data = &p->buf[VANET_CAPTURE_HDR_SIZE];
+            p->have = 0;
+            p->records++;
+            delivered++;
+            if (cb) cb(ctx, &rec);
+        }
+    }
+
+    return delivered;
+}
@@ -0,0 +1,93 @@
+/**
+ *	@file	vanet_capture.h
+ *
+ *	@brief	Termios capture records (Mainboard Side)
+ *
+ *	The daughterboard's "capture" command sends these on the capture mux
+ *	channel and its "replay" command takes them back.  The layout is
+ *	documented in the daughterboard's termios_capture.h - the two must match.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef VANET_CAPTURE_H
+#define VANET_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// Record types
+enum
+{
+    VANET_CAPTURE_VERSION   = 'V',  ///< Data is the format version (1 byte)
+    VANET_CAPTURE_NAME      = 'N',  ///< Data is the port's termios name
+    VANET_CAPTURE_DATA      = 'D',  ///< Data is bytes received on the port
+    VANET_CAPTURE_END       = 'E',  ///< No data, end of the stream
+};
+
+/// Format version
+#define VANET_CAPTURE_FORMAT            1
+
+/// Record header: type, port, 16 bit length, 32 bit microseconds since the previous record
+#define VANET_CAPTURE_HDR_SIZE          8
+
+/// Largest record the daughterboard sends or takes in one piece (one mux frame)
+#define VANET_CAPTURE_MAX_RECORD        64
+
+/// Largest data the parser will assemble
+#define VANET_CAPTURE_MAX_DATA          1024
+
+/// A decoded record.  data points into the parser and is only valid during the callback
+typedef struct
+{
+    uint8_t         type;           ///< Record type
+    uint8_t         port;           ///< The port's number on the recording side
+    uint16_t        len;            ///< Data length
+    uint32_t        delta_us;       ///< Microseconds since the previous record
+    const uint8_t*  data;           ///< Data
+} vanet_capture_rec_t;
+
+/// Record callback
+typedef void (*vanet_capture_rec_cb_t)(void* ctx, const vanet_capture_rec_t* rec);
+
+/// Incremental record parser state
+typedef struct
+{
+    uint32_t        have;           ///< Bytes of the current record in buf
+    uint8_t         buf[VANET_CAPTURE_HDR_SIZE + VANET_CAPTURE_MAX_DATA];
+
+    uint32_t        records;        ///< Records delivered
+    uint32_t        bad;            ///< Records with an unknown type or too long to assemble
+} vanet_capture_parser_t;
+
+/**
+ *  Encode a record
+ *
+ *  @param out      Output buffer, needs len + VANET_CAPTURE_HDR_SIZE bytes
+ *
+ *  @return The number of bytes written to out
+ */
+extern int vanet_capture_encode(uint8_t* out, uint8_t type, uint8_t port, uint32_t delta_us, const uint8_t* data, uint16_t len);
+
+/// Initialize a parser
+extern void vanet_capture_parser_init(vanet_capture_parser_t* p);
+
+/**
+ *  Feed stream bytes to the parser.  cb is called for every record.  A bad
+ *  header is counted and skipped a byte at a time until a good one lines up.
+ *
+ *  @return The number of records delivered
+ */
+extern int vanet_capture_parse(vanet_capture_parser_t* p, const uint8_t* buf, size_t len, vanet_capture_rec_cb_t cb, void* ctx);
+
+#endif // VANET_CAPTURE_H
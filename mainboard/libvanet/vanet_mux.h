@@ -0,0 +1,108 @@
+/**
+ *	@file	vanet_mux.h
+ *
+ *	@brief	GSM 27.010 Basic Option Framing (Mainboard Side)
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef VANET_MUX_H
+#define VANET_MUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// Basic option boundary flag
+#define VANET_MUX_FLAG                  0xf9
+
+/// Frame types (control field without the P/F bit)
+enum
+{
+    VANET_MUX_SABM  = 0x2f,         ///< Set Asynchronous Balanced Mode
+    VANET_MUX_UA    = 0x63,         ///< Unnumbered Acknowledgement
+    VANET_MUX_DM    = 0x0f,         ///< Disconnected Mode
+    VANET_MUX_DISC  = 0x43,         ///< Disconnect
+    VANET_MUX_UIH   = 0xef,         ///< Unnumbered Information w/ Header Check
+    VANET_MUX_UI    = 0x03,         ///< Unnumbered Information
+};
+
+#define VANET_MUX_EA                    0x01    ///< Extended address / length bit
+#define VANET_MUX_CR                    0x02    ///< Command / Response bit
+#define VANET_MUX_PF                    0x10    ///< Poll / Final bit
+
+/// The daughterboard only has room for a one byte length field (see mux_p.h) -
+/// the most muxd will send, as well as the default
+#define VANET_MUX_DEFAULT_INFO          127
+
+/// Largest information field the parser will assemble
+#define VANET_MUX_MAX_INFO              2048
+
+/// Worst case framing overhead (flag, addr, control, 2 byte length, fcs, flag)
+#define VANET_MUX_OVERHEAD              7
+
+/// A decoded frame.  data points into the parser and is only valid during the callback
+typedef struct
+{
+    uint8_t         dlci;           ///< Data link connection identifier
+    uint8_t         control;        ///< Control field (including P/F)
+    uint16_t        len;            ///< Information length
+    const uint8_t*  data;           ///< Information octets
+} vanet_mux_frame_t;
+
+/// Frame callback
+typedef void (*vanet_mux_frame_cb_t)(void* ctx, const vanet_mux_frame_t* frame);
+
+/// Incremental frame parser state
+typedef struct
+{
+    uint8_t         state;          ///< Parser state (internal)
+    uint8_t         hdr[4];         ///< addr, control, len1, len2 (for the FCS)
+    uint8_t         hdr_len;        ///< Bytes of hdr in use
+    uint8_t         fcs;            ///< Received FCS
+    uint16_t        info_len;       ///< Length of the information field
+    uint16_t        count;          ///< Information octets received so far
+    uint16_t        max_info;       ///< Largest frame we will accept
+    uint8_t         info[VANET_MUX_MAX_INFO];
+
+    uint32_t        frames;         ///< Good frames delivered
+    uint32_t        bad_fcs;        ///< Frames dropped for FCS errors
+    uint32_t        bad_framing;    ///< Frames dropped for missing close flag or oversize
+} vanet_mux_parser_t;
+
+/// Calculate the FCS over len bytes
+extern uint8_t vanet_mux_calc_fcs(const uint8_t* buf, int len, uint8_t fcs);
+
+/**
+ *  Encode a frame
+ *
+ *  @param out      Output buffer, needs len + VANET_MUX_OVERHEAD bytes
+ *  @param dlci     The channel
+ *  @param control  Frame type (and P/F bit)
+ *  @param data     Information octets (may be 0 if len is 0)
+ *  @param len      Information length
+ *
+ *  @return The number of bytes written to out
+ */
+extern int vanet_mux_encode(uint8_t* out, uint8_t dlci, uint8_t control, const uint8_t* data, uint16_t len);
+
+/// Initialize a parser.  max_info is clamped to VANET_MUX_MAX_INFO
+extern void vanet_mux_parser_init(vanet_mux_parser_t* p, uint16_t max_info);
+
+/**
+ *  Feed bytes from the link to the parser.  cb is called for every valid frame.
+ *
+ *  @return The number of frames delivered
+ */
+extern int vanet_mux_parse(vanet_mux_parser_t* p, const uint8_t* buf, size_t len, vanet_mux_frame_cb_t cb, void* ctx);
+
+#endif // VANET_MUX_H
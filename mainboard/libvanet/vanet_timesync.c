@@ -0,0 +1,88 @@
+/**
+ *	@file	vanet_timesync.c
+ *
+ *	@brief	Time sync exchanges and sample filter (Mainboard Side)
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "vanet_api.h"
+#include "vanet_timesync.h"
+
+static uint32_t get_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int vanet_timesync_request(uint8_t* out, int64_t t1)
+{
+    out[0] = VANET_API_TIME_REQUEST;
+    memcpy(&out[1], &t1, sizeof(t1));       // only ever compared by us
+
+    return VANET_TIMESYNC_REQUEST_SIZE;
+}
+
+int vanet_timesync_reply(const uint8_t* in, size_t len, int64_t t1, int64_t t4, vanet_timesync_sample_t* s)
+{
+    if (len != VANET_TIMESYNC_REPLY_SIZE)
+        return VANET_TIMESYNC_BAD_LENGTH;
+    if (memcmp(in, &t1, sizeof(t1)) != 0)
+        return VANET_TIMESYNC_BAD_ORIGIN;
+
+    s->t1 = t1;
+    s->t2 = (int64_t)get_be32(&in[8]) * 1000000000 + get_be32(&in[12]);
+    s->status = get_be32(&in[16]);
+    s->t3 = (int64_t)get_be32(&in[20]) * 1000000000 + get_be32(&in[24]);
+    s->t4 = t4;
+    vanet_timesync_compute(s);
+
+    return VANET_TIMESYNC_OK;
+}
+
+void vanet_timesync_compute(vanet_timesync_sample_t* s)
+{
+    s->offset_ns = ((s->t2 - s->t1) + (s->t3 - s->t4)) / 2;
+    s->delay_ns = (s->t4 - s->t1) - (s->t3 - s->t2);
+}
+
+void vanet_timesync_filter_init(vanet_timesync_filter_t* f, uint32_t window)
+{
+    memset(f, 0, sizeof(*f));
+    if (window < 1) window = 1;
+    if (window > VANET_TIMESYNC_MAX_WINDOW) window = VANET_TIMESYNC_MAX_WINDOW;
+    f->window = window;
+}
+
+const vanet_timesync_sample_t* vanet_timesync_filter_add(vanet_timesync_filter_t* f, const vanet_timesync_sample_t* s)
+{
+    uint32_t i, best = f->next;
+
+    f->samples[f->next] = *s;
+    f->seq[f->next] = f->added++;
+    f->next = (f->next + 1) % f->window;
+    if (f->count < f->window) f->count++;
+
+    for (i = 0; i < f->count; i++)
+    {
+        if (f->samples[i].delay_ns < f->samples[best].delay_ns)
+            best = i;
+    }
+
+    // the one we used last time, or older - that would only repeat stale news
+    if (f->seq[best] < f->used)
+        return NULL;
+
+    f->used = f->seq[best] + 1;
+    return &f->samples[best];
+}
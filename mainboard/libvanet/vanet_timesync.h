@@ -0,0 +1,107 @@
+/**
+ *	@file	vanet_timesync.h
+ *
+ *	@brief	Time sync exchanges and sample filter (Mainboard Side)
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef VANET_TIMESYNC_H
+#define VANET_TIMESYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// Request: VANET_API_TIME_REQUEST then the originate time (see vanet_api.h)
+#define VANET_TIMESYNC_REQUEST_SIZE     9
+
+/// API 6 response
+#define VANET_TIMESYNC_REPLY_SIZE       28
+
+/// Largest filter window
+#define VANET_TIMESYNC_MAX_WINDOW       32
+
+/// Decode errors
+enum
+{
+    VANET_TIMESYNC_OK               = 0,
+    VANET_TIMESYNC_BAD_LENGTH       = -1,   ///< Not an API 6 response (an old daughterboard?)
+    VANET_TIMESYNC_BAD_ORIGIN       = -2,   ///< A response to some other request
+};
+
+/// One exchange.  Times are ns since 1970, t1/t4 on the local clock, t2/t3 on the daughterboard's
+typedef struct
+{
+    int64_t         t1;             ///< Request sent
+    int64_t         t2;             ///< Request received
+    int64_t         t3;             ///< Response sent
+    int64_t         t4;             ///< Response received
+    uint32_t        status;         ///< VANET_API_TIME_xxx
+    int64_t         offset_ns;      ///< Daughterboard time minus local time
+    int64_t         delay_ns;       ///< Round trip, less the daughterboard's turnaround
+} vanet_timesync_sample_t;
+
+/**
+ *  Minimum delay filter
+ *
+ *  Queueing on either side of the link only ever adds delay, and makes the
+ *  offset wrong by up to half of what it adds.  So of the last window samples
+ *  the one with the least delay has the best offset; each is used at most once.
+ */
+typedef struct
+{
+    vanet_timesync_sample_t samples[VANET_TIMESYNC_MAX_WINDOW];
+    uint32_t        seq[VANET_TIMESYNC_MAX_WINDOW];
+    uint32_t        window;         ///< Samples compared
+    uint32_t        count;          ///< Samples held (up to window)
+    uint32_t        next;           ///< Where the next sample goes
+    uint32_t        added;          ///< Samples added so far
+    uint32_t        used;           ///< seq of the last sample selected, + 1
+} vanet_timesync_filter_t;
+
+/**
+ *  Encode a request
+ *
+ *  @param out      Output buffer, VANET_TIMESYNC_REQUEST_SIZE bytes
+ *  @param t1       Originate time - echoed in the response
+ *
+ *  @return The number of bytes written to out
+ */
+extern int vanet_timesync_request(uint8_t* out, int64_t t1);
+
+/**
+ *  Decode a response and work out the offset and delay
+ *
+ *  @param t1       Originate time of the outstanding request
+ *  @param t4       When the response arrived
+ *
+ *  @return VANET_TIMESYNC_OK, or a VANET_TIMESYNC_BAD_xxx error
+ */
+extern int vanet_timesync_reply(const uint8_t* in, size_t len, int64_t t1, int64_t t4, vanet_timesync_sample_t* s);
+
+/// Work out the offset and delay again, after correcting the times
+extern void vanet_timesync_compute(vanet_timesync_sample_t* s);
+
+/// Reset a filter to compare window samples (1 .. VANET_TIMESYNC_MAX_WINDOW)
+extern void vanet_timesync_filter_init(vanet_timesync_filter_t* f, uint32_t window);
+
+/**
+ *  Add a sample to the filter
+ *
+ *  @return The least delay sample of the window, or NULL if that has already
+ *          been returned.  It points into the filter and is valid until the
+ *          next call.
+ */
+extern const vanet_timesync_sample_t* vanet_timesync_filter_add(vanet_timesync_filter_t* f, const vanet_timesync_sample_t* s);
+
+#endif
@@ -0,0 +1,704 @@
+/**
+ *	@file	muxd.c
+ *
+ *	@brief	Mainboard GSM 27.010 Mux Daemon
+ *
+ *	Drives the serial link to the daughterboard and exposes each DLCI as a
+ *	unix socket (or a pty).  Message channels (timesync, unified) are
+ *	SOCK_SEQPACKET so one packet is one frame; the raw channels are
+ *	SOCK_STREAM.  Everything is non-blocking and runs from a single epoll
+ *	loop.  Serial reads are taken in large blocks and all frames queued during
+ *	one pass of the loop go out in a single write(), so the syscall cost per
+ *	frame drops as the link gets busier.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include "muxd.h"
+
+/// Outstanding frames in the tx batch (for latency accounting)
+#define TXQ_LEN                         256
+
+/// Max epoll events per wakeup
+#define MAX_EVENTS                      32
+
+typedef struct
+{
+    uint32_t    end;                ///< Offset just past this frame in s_tx_buf
+    uint64_t    t_enq;              ///< When the data arrived from the client
+    uint8_t     dlci;
+} tx_meta_t;
+
+muxd_config_t g_muxd_cfg =
+{
+    .device = MUXD_DEFAULT_DEVICE,
+    .baud = MUXD_DEFAULT_BAUD,
+    .sockdir = MUXD_DEFAULT_SOCKDIR,
+    .max_info = VANET_MUX_DEFAULT_INFO,
+    .stats_sec = 60,
+};
+
+muxd_chan_t g_muxd_chan[VANET_MUXCH_MAX] =
+{
+    { .dlci = 0,                                .name = "control",  .enabled = true },
+    { .dlci = VANET_MUXCH_TIMESYNC,             .name = "timesync", .enabled = true },
+    { .dlci = VANET_MUXCH_UNIFIED,              .name = "unified",  .enabled = true },
+    { .dlci = VANET_MUXCH_ACCELEROMETER_RAW,    .name = "accel",    .enabled = true, .stream = true },
+    { .dlci = VANET_MUXCH_GPS_RAW,              .name = "gps",      .enabled = true, .stream = true },
+    { .dlci = VANET_MUXCH_ECHO,                 .name = "echo",     .enabled = true, .stream = true },
+    { .dlci = VANET_MUXCH_CAPTURE,              .name = "capture",  .enabled = true, .stream = true },
+};
+
+int g_muxd_epoll = -1;
+
+static muxd_ev_t s_link;
+static int s_link_pty_slave = -1;
+static vanet_mux_parser_t s_parser;
+
+static uint8_t s_tx_buf[MUXD_TX_BUF_SIZE];
+static uint32_t s_tx_len;
+static tx_meta_t s_txq[TXQ_LEN];
+static int s_txq_head, s_txq_count;
+static bool s_tx_waiting;
+
+/// Link level counters - these show how well the batching is working
+static struct
+{
+    uint64_t reads, writes, rx_bytes, tx_bytes;
+} s_link_stats, s_link_total;
+static uint64_t s_stats_start_us;          ///< When the stats interval being counted began
+
+static uint64_t s_rx_batch_us;
+static uint32_t s_rx_batch[VANET_MUXCH_MAX];
+
+static volatile sig_atomic_t s_quit, s_report;
+
+uint64_t muxd_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void muxd_log(int prio, const char* fmt, ...)
+{
+    va_list va;
+
+    if (prio == LOG_DEBUG && g_muxd_cfg.verbose < 2) return;
+    if (prio == LOG_INFO && !g_muxd_cfg.verbose) return;
+
+    va_start(va, fmt);
+    if (g_muxd_cfg.daemonize)
+    {
+        vsyslog(prio, fmt, va);
+    }
+    else
+    {
+        vfprintf(stderr, fmt, va);
+        fputc('\n', stderr);
+    }
+    va_end(va);
+}
+
+void muxd_latency_add(muxd_latency_t* l, uint32_t us)
+{
+    if (l->count == 0 || us < l->min) l->min = us;
+    if (us > l->max) l->max = us;
+    l->sum += us;
+    l->count++;
+}
+
+int muxd_ev_add(muxd_ev_t* ev, uint32_t events)
+{
+    struct epoll_event e = { .events = events, .data.ptr = ev };
+    return epoll_ctl(g_muxd_epoll, EPOLL_CTL_ADD, ev->fd, &e);
+}
+
+int muxd_ev_mod(muxd_ev_t* ev, uint32_t events)
+{
+    struct epoll_event e = { .events = events, .data.ptr = ev };
+    return epoll_ctl(g_muxd_epoll, EPOLL_CTL_MOD, ev->fd, &e);
+}
+
+void muxd_ev_del(muxd_ev_t* ev)
+{
+    epoll_ctl(g_muxd_epoll, EPOLL_CTL_DEL, ev->fd, 0);
+}
+
+/*
+ *  Transmit
+ */
+
+bool muxd_link_tx_full(void)
+{
+    return s_tx_len > MUXD_TX_HIGH_WATER || s_txq_count == TXQ_LEN;
+}
+
+bool muxd_link_send(uint8_t dlci, uint8_t control, const uint8_t* data, uint16_t len, uint64_t t_enq)
+{
+    tx_meta_t* m;
+
+    if (s_tx_len + len + VANET_MUX_OVERHEAD > MUXD_TX_BUF_SIZE || s_txq_count == TXQ_LEN)
+        return false;
+
+    s_tx_len += vanet_mux_encode(s_tx_buf + s_tx_len, dlci, control, data, len);
+
+    m = &s_txq[(s_txq_head + s_txq_count++) % TXQ_LEN];
+    m->end = s_tx_len;
+    m->t_enq = t_enq;
+    m->dlci = dlci;
+
+    if (dlci < VANET_MUXCH_MAX)
+    {
+        g_muxd_chan[dlci].stats.tx_frames++;
+        g_muxd_chan[dlci].stats.tx_bytes += len;
+    }
+
+    if (muxd_link_tx_full()) muxd_chan_pause(true);
+    return true;
+}
+
+bool muxd_link_send_data(uint8_t dlci, const uint8_t* data, int len, uint64_t t_enq)
+{
+    while (len > 0)
+    {
+        uint16_t n = len > g_muxd_cfg.max_info ? g_muxd_cfg.max_info : len;
+        if (!muxd_link_send(dlci, VANET_MUX_UIH, data, n, t_enq))
+        {
+            muxd_log(LOG_WARNING, "dlci %d: tx overrun, dropped %d bytes", dlci, len);
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void link_flush(void)
+{
+    ssize_t n;
+    uint64_t now;
+
+    if (s_tx_len == 0) return;
+
+    n = write(s_link.fd, s_tx_buf, s_tx_len);
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+            muxd_log(LOG_ERR, "link write: %s", strerror(errno));
+        n = 0;
+    }
+    else
+    {
+        s_link_stats.writes++;
+        s_link_stats.tx_bytes += n;
+    }
+
+    // retire the frames that made it out
+    now = muxd_now_us();
+    while (s_txq_count && s_txq[s_txq_head].end <= (uint32_t)n)
+    {
+        tx_meta_t* m = &s_txq[s_txq_head];
+        if (m->dlci < VANET_MUXCH_MAX)
+            muxd_latency_add(&g_muxd_chan[m->dlci].stats.tx_lat, (uint32_t)(now - m->t_enq));
+        s_txq_head = (s_txq_head + 1) % TXQ_LEN;
+        s_txq_count--;
+    }
+
+    if (n > 0)
+    {
+        int i;
+        s_tx_len -= n;
+        memmove(s_tx_buf, s_tx_buf + n, s_tx_len);
+        for (i = 0; i < s_txq_count; i++)
+            s_txq[(s_txq_head + i) % TXQ_LEN].end -= n;
+    }
+
+    // wait for the uart to drain if we couldn't get it all out
+    if ((s_tx_len > 0) != s_tx_waiting)
+    {
+        s_tx_waiting = s_tx_len > 0;
+        muxd_ev_mod(&s_link, EPOLLIN | (s_tx_waiting ? EPOLLOUT : 0));
+    }
+
+    if (s_tx_len < MUXD_TX_HIGH_WATER / 2 && s_txq_count < TXQ_LEN / 2)
+        muxd_chan_pause(false);
+}
+
+/*
+ *  Receive
+ */
+
+static void link_frame(void* ctx, const vanet_mux_frame_t* f)
+{
+    uint8_t type = f->control & ~VANET_MUX_PF;
+    muxd_chan_t* chan;
+    uint64_t now = *(uint64_t*)ctx;
+
+    if (f->dlci >= VANET_MUXCH_MAX || !g_muxd_chan[f->dlci].enabled)
+    {
+        if (type == VANET_MUX_SABM || type == VANET_MUX_UIH)
+            muxd_link_send(f->dlci, VANET_MUX_DM | VANET_MUX_PF, 0, 0, now);
+        return;
+    }
+
+    chan = &g_muxd_chan[f->dlci];
+
+    switch (type)
+    {
+        case VANET_MUX_SABM:
+            // passive side (or the daughterboard re-opening) - same rules as mux_p.c
+            if (f->dlci == 0 || g_muxd_chan[0].state == MUXD_OPENED)
+            {
+                muxd_link_send(f->dlci, VANET_MUX_UA | VANET_MUX_PF, 0, 0, now);
+                if (chan->state != MUXD_OPENED) muxd_log(LOG_INFO, "dlci %d: opened by peer", f->dlci);
+                chan->state = MUXD_OPENED;
+            }
+            else
+            {
+                muxd_link_send(f->dlci, VANET_MUX_DM | VANET_MUX_PF, 0, 0, now);
+            }
+            break;
+
+        case VANET_MUX_DISC:
+            muxd_link_send(f->dlci, VANET_MUX_UA | VANET_MUX_PF, 0, 0, now);
+            chan->state = MUXD_CLOSED;
+            chan->retry_us = now + MUXD_RETRY_MS * 1000;
+            muxd_log(LOG_INFO, "dlci %d: closed by peer", f->dlci);
+            break;
+
+        case VANET_MUX_UA:
+            if (chan->state == MUXD_OPEN_PENDING)
+            {
+                chan->state = MUXD_OPENED;
+                muxd_log(LOG_INFO, "dlci %d (%s): opened", f->dlci, chan->name);
+
+                // control channel is up - open everything else right away
+                if (f->dlci == 0)
+                {
+                    int i;
+                    for (i = 1; i < VANET_MUXCH_MAX; i++) g_muxd_chan[i].retry_us = 0;
+                }
+            }
+            break;
+
+        case VANET_MUX_DM:
+            if (chan->state == MUXD_OPENED) muxd_log(LOG_WARNING, "dlci %d: peer reports disconnected", f->dlci);
+            chan->state = MUXD_CLOSED;
+            chan->retry_us = now + MUXD_RETRY_MS * 1000;
+
+            // the daughterboard probably reset - it won't accept anything until DLCI 0 is re-opened
+            if (f->dlci != 0 && g_muxd_chan[0].state == MUXD_OPENED && !g_muxd_cfg.passive)
+            {
+                g_muxd_chan[0].state = MUXD_CLOSED;
+                g_muxd_chan[0].retry_us = 0;
+            }
+            break;
+
+        case VANET_MUX_UIH:
+            if (chan->state != MUXD_OPENED)
+            {
+                if (g_muxd_cfg.passive) muxd_link_send(f->dlci, VANET_MUX_DM | VANET_MUX_PF, 0, 0, now);
+                break;
+            }
+            chan->stats.rx_frames++;
+            chan->stats.rx_bytes += f->len;
+            if (muxd_chan_deliver(chan, f->data, f->len))
+                s_rx_batch[f->dlci]++;
+            else
+                chan->stats.rx_drops++;
+            break;
+    }
+}
+
+static void link_handler(muxd_ev_t* ev, uint32_t events)
+{
+    uint8_t buf[MUXD_RX_BUF_SIZE];
+    ssize_t n;
+    int i;
+
+    if (events & EPOLLOUT)
+        link_flush();
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        return;
+
+    n = read(ev->fd, buf, sizeof(buf));
+    if (n <= 0)
+    {
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        if (n < 0 && errno == EIO && s_link_pty_slave >= 0) return;
+        muxd_log(LOG_ERR, "link read: %s", n ? strerror(errno) : "EOF");
+        s_quit = 1;
+        return;
+    }
+
+    s_rx_batch_us = muxd_now_us();
+    s_link_stats.reads++;
+    s_link_stats.rx_bytes += n;
+    vanet_mux_parse(&s_parser, buf, n, link_frame, &s_rx_batch_us);
+
+    // one timestamp for the whole batch - latency is from read() return to the last send()
+    n = muxd_now_us() - s_rx_batch_us;
+    for (i = 0; i < VANET_MUXCH_MAX; i++)
+    {
+        if (s_rx_batch[i])
+        {
+            muxd_latency_add(&g_muxd_chan[i].stats.rx_lat, (uint32_t)n);
+            s_rx_batch[i] = 0;
+        }
+    }
+}
+
+/*
+ *  Setup
+ */
+
+static speed_t baud_to_speed(int baud)
+{
+    switch (baud)
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 921600:    return B921600;
+        default:        return 0;
+    }
+}
+
+static void set_raw(int fd, speed_t speed)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) < 0) return;
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (speed)
+    {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+static int link_open(void)
+{
+    int fd;
+
+    if (g_muxd_cfg.link_pty)
+    {
+        // loopback testing: we own the "uart", a peer muxd (or a simulator) opens the other end
+        const char* slave;
+
+        fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0 || !(slave = ptsname(fd)))
+        {
+            muxd_log(LOG_ERR, "link pty: %s", strerror(errno));
+            return -1;
+        }
+        s_link_pty_slave = open(slave, O_RDWR | O_NOCTTY);
+        set_raw(s_link_pty_slave, 0);
+        unlink(g_muxd_cfg.link_pty);
+        if (symlink(slave, g_muxd_cfg.link_pty) < 0)
+            muxd_log(LOG_ERR, "%s: %s", g_muxd_cfg.link_pty, strerror(errno));
+        muxd_log(LOG_NOTICE, "link is %s -> %s", g_muxd_cfg.link_pty, slave);
+    }
+    else
+    {
+        fd = open(g_muxd_cfg.device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fd < 0)
+        {
+            muxd_log(LOG_ERR, "%s: %s", g_muxd_cfg.device, strerror(errno));
+            return -1;
+        }
+        set_raw(fd, baud_to_speed(g_muxd_cfg.baud));
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    s_link.fd = fd;
+    s_link.handler = link_handler;
+    return muxd_ev_add(&s_link, EPOLLIN);
+}
+
+/// Active side - (re)send SABM on anything not open.  Returns ms until we need to run again
+static int link_open_channels(uint64_t now)
+{
+    uint64_t next = now + MUXD_RETRY_MS * 1000;
+    int i;
+
+    if (g_muxd_cfg.passive) return -1;
+
+    for (i = 0; i < VANET_MUXCH_MAX; i++)
+    {
+        muxd_chan_t* chan = &g_muxd_chan[i];
+
+        if (!chan->enabled || chan->state == MUXD_OPENED) continue;
+        if (i != 0 && g_muxd_chan[0].state != MUXD_OPENED) break;
+
+        if (now >= chan->retry_us)
+        {
+            muxd_link_send(chan->dlci, VANET_MUX_SABM | VANET_MUX_PF, 0, 0, now);
+            chan->state = MUXD_OPEN_PENDING;
+            chan->retry_us = now + MUXD_RETRY_MS * 1000;
+        }
+        if (chan->retry_us < next) next = chan->retry_us;
+    }
+
+    return (int)((next - now + 999) / 1000);
+}
+
+/*
+ *  Statistics
+ */
+
+static void add_latency(muxd_latency_t* to, const muxd_latency_t* from)
+{
+    if (!from->count) return;
+    if (to->count == 0 || from->min < to->min) to->min = from->min;
+    if (from->max > to->max) to->max = from->max;
+    to->sum += from->sum;
+    to->count += from->count;
+}
+
+static void print_latency(char* out, size_t size, const muxd_latency_t* l)
+{
+    if (l->count)
+        snprintf(out, size, "%u/%u/%u", l->min, (unsigned)(l->sum / l->count), l->max);
+    else
+        snprintf(out, size, "-/-/-");
+}
+
+void muxd_stats_report(bool totals)
+{
+    uint64_t now = muxd_now_us();
+    uint64_t elapsed = totals ? 0 : now - s_stats_start_us;
+    char rxl[40], txl[40];
+    int i;
+
+    // machine-readable: one line per DLCI, key=value pairs, latency as min/avg/max us
+    for (i = 0; i < VANET_MUXCH_MAX; i++)
+    {
+        muxd_chan_t* chan = &g_muxd_chan[i];
+        muxd_stats_t* s;
+
+        if (!chan->enabled) continue;
+
+        chan->total.rx_frames += chan->stats.rx_frames;
+        chan->total.rx_bytes += chan->stats.rx_bytes;
+        chan->total.rx_drops += chan->stats.rx_drops;
+        chan->total.tx_frames += chan->stats.tx_frames;
+        chan->total.tx_bytes += chan->stats.tx_bytes;
+        add_latency(&chan->total.rx_lat, &chan->stats.rx_lat);
+        add_latency(&chan->total.tx_lat, &chan->stats.tx_lat);
+
+        s = totals ? &chan->total : &chan->stats;
+        print_latency(rxl, sizeof(rxl), &s->rx_lat);
+        print_latency(txl, sizeof(txl), &s->tx_lat);
+
+        muxd_log(LOG_NOTICE, "%s dlci=%d name=%s state=%d rx_frames=%llu rx_bytes=%llu rx_Bps=%llu rx_drops=%llu "
+                 "tx_frames=%llu tx_bytes=%llu tx_Bps=%llu rx_lat_us=%s tx_lat_us=%s",
+                 totals ? "total" : "stats", chan->dlci, chan->name, chan->state,
+                 (unsigned long long)s->rx_frames, (unsigned long long)s->rx_bytes,
+                 (unsigned long long)(elapsed ? s->rx_bytes * 1000000 / elapsed : 0),
+                 (unsigned long long)s->rx_drops,
+                 (unsigned long long)s->tx_frames, (unsigned long long)s->tx_bytes,
+                 (unsigned long long)(elapsed ? s->tx_bytes * 1000000 / elapsed : 0),
+                 rxl, txl);
+
+        memset(&chan->stats, 0, sizeof(chan->stats));
+    }
+
+    s_link_total.reads += s_link_stats.reads;
+    s_link_total.writes += s_link_stats.writes;
+    s_link_total.rx_bytes += s_link_stats.rx_bytes;
+    s_link_total.tx_bytes += s_link_stats.tx_bytes;
+
+    muxd_log(LOG_NOTICE, "%s link reads=%llu writes=%llu rx_bytes=%llu tx_bytes=%llu frames=%u bad_fcs=%u bad_framing=%u",
+             totals ? "total" : "stats",
+             (unsigned long long)(totals ? s_link_total.reads : s_link_stats.reads),
+             (unsigned long long)(totals ? s_link_total.writes : s_link_stats.writes),
+             (unsigned long long)(totals ? s_link_total.rx_bytes : s_link_stats.rx_bytes),
+             (unsigned long long)(totals ? s_link_total.tx_bytes : s_link_stats.tx_bytes),
+             s_parser.frames, s_parser.bad_fcs, s_parser.bad_framing);
+
+    memset(&s_link_stats, 0, sizeof(s_link_stats));
+    s_stats_start_us = now;
+}
+
+/*
+ *  Main
+ */
+
+static void signal_handler(int sig)
+{
+    if (sig == SIGUSR1)
+        s_report = 1;
+    else
+        s_quit = 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: muxd [options]\n"
+        "  -d <dev>     serial device (default " MUXD_DEFAULT_DEVICE ")\n"
+        "  -b <baud>    baud rate (default %d)\n"
+        "  -s <dir>     socket directory (default " MUXD_DEFAULT_SOCKDIR ")\n"
+        "  -t <dlci>    expose <dlci> as a pty instead of a socket (repeatable)\n"
+        "  -x <dlci>    disable <dlci>\n"
+        "  -m <n>       largest information field to send, 1..%d (default %d)\n"
+        "  -i <sec>     stats interval, 0 = SIGUSR1 only (default 60)\n"
+        "  -L <path>    create the link as a pty symlinked at <path> (loopback testing)\n"
+        "  -P           passive - answer SABM (act as the daughterboard)\n"
+        "  -D           daemonize and log to syslog\n"
+        "  -v           verbose (repeat for debug)\n",
+        MUXD_DEFAULT_BAUD, VANET_MUX_DEFAULT_INFO, VANET_MUX_DEFAULT_INFO);
+}
+
+int main(int argc, char** argv)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct sigaction sa;
+    uint64_t next_stats = 0;
+    int opt, dlci, i, n, timeout;
+
+    while ((opt = getopt(argc, argv, "d:b:s:t:x:m:i:L:PDvh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': g_muxd_cfg.device = optarg; break;
+            case 'b': g_muxd_cfg.baud = atoi(optarg); break;
+            case 's': g_muxd_cfg.sockdir = optarg; break;
+            case 'm': g_muxd_cfg.max_info = atoi(optarg); break;
+            case 'i': g_muxd_cfg.stats_sec = atoi(optarg); break;
+            case 'L': g_muxd_cfg.link_pty = optarg; break;
+            case 'P': g_muxd_cfg.passive = true; break;
+            case 'D': g_muxd_cfg.daemonize = true; break;
+            case 'v': g_muxd_cfg.verbose++; break;
+            case 't':
+            case 'x':
+                dlci = atoi(optarg);
+                if (dlci <= 0 || dlci >= VANET_MUXCH_MAX) { usage(); return 1; }
+                if (opt == 't') g_muxd_chan[dlci].use_pty = true;
+                else g_muxd_chan[dlci].enabled = false;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (!baud_to_speed(g_muxd_cfg.baud) || g_muxd_cfg.max_info == 0 || g_muxd_cfg.max_info > VANET_MUX_DEFAULT_INFO)
+    {
+        usage();
+        return 1;
+    }
+
+    if (g_muxd_cfg.daemonize)
+    {
+        openlog("muxd", LOG_PID, LOG_DAEMON);
+        if (daemon(0, 0) < 0) return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;         // no SA_RESTART - we want epoll_wait to return
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    sigaction(SIGUSR1, &sa, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    vanet_mux_parser_init(&s_parser, VANET_MUX_MAX_INFO);
+
+    g_muxd_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (g_muxd_epoll < 0 || link_open() < 0 || muxd_chan_init() < 0)
+    {
+        muxd_chan_cleanup();
+        return 1;
+    }
+
+    // the first interval's rates are over the time since here, not since boot
+    s_stats_start_us = muxd_now_us();
+    while (!s_quit)
+    {
+        uint64_t now = muxd_now_us();
+
+        timeout = link_open_channels(now);
+        if (g_muxd_cfg.stats_sec)
+        {
+            if (!next_stats) next_stats = now + g_muxd_cfg.stats_sec * 1000000ULL;
+            if (now >= next_stats)
+            {
+                muxd_stats_report(false);
+                next_stats += g_muxd_cfg.stats_sec * 1000000ULL;
+            }
+            n = (int)((next_stats - now + 999) / 1000);
+            if (timeout < 0 || n < timeout) timeout = n;
+        }
+
+        // everything queued since the last pass goes out in one write
+        if (!s_tx_waiting) link_flush();
+
+        n = epoll_wait(g_muxd_epoll, events, MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR)
+        {
+            muxd_log(LOG_ERR, "epoll_wait: %s", strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            muxd_ev_t* ev = (muxd_ev_t*)events[i].data.ptr;
+            ev->handler(ev, events[i].events);
+        }
+
+        if (s_report)
+        {
+            s_report = 0;
+            muxd_stats_report(true);
+        }
+    }
+
+    // be polite - tell the daughterboard we're going away
+    if (!g_muxd_cfg.passive)
+    {
+        for (i = VANET_MUXCH_MAX - 1; i >= 0; i--)
+            if (g_muxd_chan[i].state == MUXD_OPENED)
+                muxd_link_send(i, VANET_MUX_DISC | VANET_MUX_PF, 0, 0, muxd_now_us());
+        link_flush();
+        tcdrain(s_link.fd);
+    }
+
+    muxd_stats_report(true);
+    muxd_chan_cleanup();
+    if (g_muxd_cfg.link_pty) unlink(g_muxd_cfg.link_pty);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ *	@file	muxd.h
+ *
+ *	@brief	Mainboard GSM 27.010 Mux Daemon
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#ifndef MUXD_H
+#define MUXD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <syslog.h>
+#include "vanet_api.h"
+#include "vanet_mux.h"
+
+/// Default locations
+#define MUXD_DEFAULT_DEVICE             "/dev/ttyS1"
+#define MUXD_DEFAULT_BAUD               115200
+#define MUXD_DEFAULT_SOCKDIR            "/var/run/vanet"
+
+/// Most clients attached to a single DLCI
+#define MUXD_MAX_CLIENTS                8
+
+/// Serial transmit batch buffer
+#define MUXD_TX_BUF_SIZE                8192
+
+/// Stop reading clients when the tx batch gets this full
+#define MUXD_TX_HIGH_WATER              (MUXD_TX_BUF_SIZE - 2 * (VANET_MUX_MAX_INFO + VANET_MUX_OVERHEAD))
+
+/// Serial receive batch size
+#define MUXD_RX_BUF_SIZE                4096
+
+/// How often to retry SABM on channels that aren't open (ms)
+#define MUXD_RETRY_MS                   1000
+
+/// Channel state
+typedef enum
+{
+    MUXD_CLOSED,
+    MUXD_OPEN_PENDING,
+    MUXD_OPENED,
+} muxd_state_t;
+
+/// Running min / avg / max of a latency in microseconds
+typedef struct
+{
+    uint32_t    count;
+    uint64_t    sum;
+    uint32_t    min;
+    uint32_t    max;
+} muxd_latency_t;
+
+/// Per-DLCI statistics
+typedef struct
+{
+    uint64_t        rx_frames;      ///< Frames from the daughterboard
+    uint64_t        rx_bytes;
+    uint64_t        rx_drops;       ///< Frames a slow (or absent) client didn't take
+    uint64_t        tx_frames;      ///< Frames to the daughterboard
+    uint64_t        tx_bytes;
+    muxd_latency_t  rx_lat;         ///< serial read -> client delivery
+    muxd_latency_t  tx_lat;         ///< client read -> serial write complete
+} muxd_stats_t;
+
+struct muxd_chan;
+
+/// epoll registration.  Every fd we watch has one of these as its epoll data
+typedef struct muxd_ev
+{
+    int fd;
+    void (*handler)(struct muxd_ev* ev, uint32_t events);
+} muxd_ev_t;
+
+/// A client connection on a DLCI socket
+typedef struct
+{
+    muxd_ev_t           ev;
+    struct muxd_chan*   chan;
+    uint16_t            pend_len;   ///< Bytes of a frame a byte stream client still has to take
+    uint16_t            pend_off;
+    uint8_t             pend[VANET_MUX_MAX_INFO];
+} muxd_client_t;
+
+/// A DLCI endpoint
+typedef struct muxd_chan
+{
+    uint8_t         dlci;
+    const char*     name;           ///< Socket / pty name
+    bool            enabled;
+    bool            stream;         ///< SOCK_STREAM (raw byte channels) instead of SOCK_SEQPACKET
+    bool            use_pty;        ///< Expose as a pty instead of a socket
+    muxd_state_t    state;
+    uint64_t        retry_us;       ///< Next time to send SABM
+
+    muxd_ev_t       listen;         ///< Listening socket or pty master
+    int             pty_slave;      ///< Held open so the master never sees HUP
+    muxd_client_t   clients[MUXD_MAX_CLIENTS];
+
+    muxd_stats_t    stats;          ///< Since the last report
+    muxd_stats_t    total;          ///< Since startup
+} muxd_chan_t;
+
+/// Daemon configuration
+typedef struct
+{
+    const char*     device;
+    int             baud;
+    const char*     sockdir;
+    const char*     link_pty;       ///< Create the link as a pty here (loopback testing)
+    uint16_t        max_info;       ///< Largest info field we send
+    int             stats_sec;      ///< Periodic stats interval (0 = only on SIGUSR1)
+    bool            passive;        ///< Act as the daughterboard (answer SABM instead of sending it)
+    bool            daemonize;
+    int             verbose;
+} muxd_config_t;
+
+extern muxd_config_t g_muxd_cfg;
+extern muxd_chan_t g_muxd_chan[VANET_MUXCH_MAX];
+extern int g_muxd_epoll;
+
+/// Monotonic clock in microseconds
+extern uint64_t muxd_now_us(void);
+
+/// Log to stderr or syslog
+extern void muxd_log(int prio, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/// Record a latency sample
+extern void muxd_latency_add(muxd_latency_t* l, uint32_t us);
+
+/// Add / change an epoll registration
+extern int muxd_ev_add(muxd_ev_t* ev, uint32_t events);
+extern int muxd_ev_mod(muxd_ev_t* ev, uint32_t events);
+extern void muxd_ev_del(muxd_ev_t* ev);
+
+/// Queue a frame for transmit.  Returns false if the batch buffer is full
+extern bool muxd_link_send(uint8_t dlci, uint8_t control, const uint8_t* data, uint16_t len, uint64_t t_enq);
+
+/// Queue data for transmit, split into frames no larger than max_info
+extern bool muxd_link_send_data(uint8_t dlci, const uint8_t* data, int len, uint64_t t_enq);
+
+/// True if the tx batch is too full to accept more client data
+extern bool muxd_link_tx_full(void);
+
+/// Create the per-DLCI endpoints
+extern int muxd_chan_init(void);
+
+/// Remove the per-DLCI endpoints
+extern void muxd_chan_cleanup(void);
+
+/// Deliver a received frame to a channel's clients.  Returns false if nobody took it
+extern bool muxd_chan_deliver(muxd_chan_t* chan, const uint8_t* data, uint16_t len);
+
+/// Stop / start reading client data (tx back-pressure)
+extern void muxd_chan_pause(bool pause);
+
+/// Report statistics
+extern void muxd_stats_report(bool totals);
+
+#endif // MUXD_H
@@ -0,0 +1,313 @@
+/**
+ *	@file	muxd_chan.c
+ *
+ *	@brief	Mux Daemon - Per-DLCI Sockets and PTYs
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "muxd.h"
+
+/// Client packets drained per wakeup before giving other fds a turn
+#define CLIENT_BATCH                    16
+
+/// Socket buffering per client - enough to ride out a slow reader for a second or so at full link rate
+#define CLIENT_SNDBUF                   (128 * 1024)
+
+static bool s_paused;
+
+static void chan_path(const muxd_chan_t* chan, char* path, size_t size)
+{
+    snprintf(path, size, "%s/%s.%s", g_muxd_cfg.sockdir, chan->name, chan->use_pty ? "pty" : "sock");
+}
+
+/// What a client's fd waits for - the rest of a frame holds it to EPOLLOUT
+static uint32_t client_events(const muxd_client_t* client)
+{
+    return (s_paused ? 0 : EPOLLIN) | (client->pend_len ? EPOLLOUT : 0);
+}
+
+/// Send what's left of a frame a byte stream client took part of.  False if it still hasn't all gone
+static bool client_flush(muxd_client_t* client)
+{
+    ssize_t n;
+
+    if (!client->pend_len) return true;
+
+    if (client->chan->use_pty)
+        n = write(client->ev.fd, client->pend + client->pend_off, client->pend_len);
+    else
+        n = send(client->ev.fd, client->pend + client->pend_off, client->pend_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n > 0)
+    {
+        client->pend_off += n;
+        client->pend_len -= n;
+        if (!client->pend_len) muxd_ev_mod(&client->ev, client_events(client));
+    }
+
+    return client->pend_len == 0;
+}
+
+static void client_close(muxd_client_t* client)
+{
+    muxd_log(LOG_INFO, "dlci %d: client %d disconnected", client->chan->dlci, client->ev.fd);
+    muxd_ev_del(&client->ev);
+    close(client->ev.fd);
+    client->ev.fd = -1;
+    client->pend_len = 0;
+}
+
+// Data from a client (or the pty) to be mux'd to the daughterboard
+static void client_handler(muxd_ev_t* ev, uint32_t events)
+{
+    muxd_client_t* client = (muxd_client_t*)ev;
+    muxd_chan_t* chan = client->chan;
+    uint8_t buf[VANET_MUX_MAX_INFO];
+    uint64_t now = muxd_now_us();
+    ssize_t n;
+    int i;
+
+    if (events & EPOLLOUT)
+        client_flush(client);
+
+    for (i = 0; i < CLIENT_BATCH && !muxd_link_tx_full(); i++)
+    {
+        n = read(ev->fd, buf, (chan->use_pty || chan->stream) ? g_muxd_cfg.max_info : sizeof(buf));
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR) return;
+            if (chan->use_pty && errno == EIO) return;      // slave side idle
+            client_close(client);
+            return;
+        }
+        if (n == 0)
+        {
+            if (!chan->use_pty) client_close(client);
+            return;
+        }
+
+        if (chan->state != MUXD_OPENED)
+        {
+            if (g_muxd_cfg.verbose) muxd_log(LOG_DEBUG, "dlci %d: not open, dropped %d bytes", chan->dlci, (int)n);
+            continue;
+        }
+
+        muxd_link_send_data(chan->dlci, buf, (int)n, now);
+    }
+}
+
+static void accept_handler(muxd_ev_t* ev, uint32_t events)
+{
+    muxd_chan_t* chan = (muxd_chan_t*)((char*)ev - offsetof(muxd_chan_t, listen));
+    int fd, i, sndbuf = CLIENT_SNDBUF;
+
+    fd = accept4(ev->fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    for (i = 0; i < MUXD_MAX_CLIENTS; i++)
+    {
+        muxd_client_t* client = &chan->clients[i];
+        if (client->ev.fd < 0)
+        {
+            client->ev.fd = fd;
+            client->ev.handler = client_handler;
+            client->chan = chan;
+            client->pend_len = 0;
+            muxd_ev_add(&client->ev, client_events(client));
+            muxd_log(LOG_INFO, "dlci %d: client %d connected", chan->dlci, fd);
+            return;
+        }
+    }
+
+    muxd_log(LOG_WARNING, "dlci %d: too many clients", chan->dlci);
+    close(fd);
+}
+
+static int open_socket(muxd_chan_t* chan)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    chan_path(chan, addr.sun_path, sizeof(addr.sun_path));
+    unlink(addr.sun_path);
+
+    // SEQPACKET keeps message boundaries - one packet in, one UIH frame out (and vice-versa).
+    // The kernel only queues a handful of packets per SEQPACKET socket though, so the raw
+    // byte channels use STREAM to let a burst coalesce in the socket buffer
+    fd = socket(AF_UNIX, (chan->stream ? SOCK_STREAM : SOCK_SEQPACKET) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0)
+    {
+        muxd_log(LOG_ERR, "%s: %s", addr.sun_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    chan->listen.fd = fd;
+    chan->listen.handler = accept_handler;
+    return muxd_ev_add(&chan->listen, EPOLLIN);
+}
+
+static int open_pty(muxd_chan_t* chan)
+{
+    char path[108];
+    struct termios tio;
+    const char* slave;
+    int fd;
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0 || !(slave = ptsname(fd)))
+    {
+        muxd_log(LOG_ERR, "dlci %d: pty: %s", chan->dlci, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // raw, and keep a slave open ourselves so the master doesn't HUP between users
+    chan->pty_slave = open(slave, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (chan->pty_slave >= 0 && tcgetattr(chan->pty_slave, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(chan->pty_slave, TCSANOW, &tio);
+    }
+
+    chan_path(chan, path, sizeof(path));
+    unlink(path);
+    if (symlink(slave, path) < 0)
+        muxd_log(LOG_WARNING, "%s: %s", path, strerror(errno));
+
+    // the master is the (only) client
+    chan->listen.fd = -1;
+    chan->clients[0].ev.fd = fd;
+    chan->clients[0].ev.handler = client_handler;
+    chan->clients[0].chan = chan;
+    return muxd_ev_add(&chan->clients[0].ev, EPOLLIN);
+}
+
+int muxd_chan_init(void)
+{
+    int i, j;
+
+    mkdir(g_muxd_cfg.sockdir, 0755);
+
+    for (i = 0; i < VANET_MUXCH_MAX; i++)
+    {
+        muxd_chan_t* chan = &g_muxd_chan[i];
+
+        chan->listen.fd = -1;
+        chan->pty_slave = -1;
+        for (j = 0; j < MUXD_MAX_CLIENTS; j++)
+            chan->clients[j].ev.fd = -1;
+
+        // DLCI 0 is the control channel - it has no endpoint
+        if (!chan->enabled || chan->dlci == 0) continue;
+
+        if ((chan->use_pty ? open_pty(chan) : open_socket(chan)) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+void muxd_chan_cleanup(void)
+{
+    char path[108];
+    int i, j;
+
+    for (i = 1; i < VANET_MUXCH_MAX; i++)
+    {
+        muxd_chan_t* chan = &g_muxd_chan[i];
+        if (!chan->enabled) continue;
+
+        for (j = 0; j < MUXD_MAX_CLIENTS; j++)
+            if (chan->clients[j].ev.fd >= 0) close(chan->clients[j].ev.fd);
+        if (chan->listen.fd >= 0) close(chan->listen.fd);
+        if (chan->pty_slave >= 0) close(chan->pty_slave);
+
+        chan_path(chan, path, sizeof(path));
+        unlink(path);
+    }
+}
+
+bool muxd_chan_deliver(muxd_chan_t* chan, const uint8_t* data, uint16_t len)
+{
+    bool taken = false;
+    int i;
+
+    for (i = 0; i < MUXD_MAX_CLIENTS; i++)
+    {
+        muxd_client_t* client = &chan->clients[i];
+        ssize_t n;
+
+        if (client->ev.fd < 0) continue;
+
+        // a byte stream client gets whole frames or none, or its framing is lost for good
+        if (!client_flush(client)) continue;
+
+        if (chan->use_pty)
+            n = write(client->ev.fd, data, len);
+        else
+            n = send(client->ev.fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (n == len)
+            taken = true;
+        else if (n > 0)
+        {
+            // stream socket nearly full - the rest goes on EPOLLOUT, ahead of anything newer
+            memcpy(client->pend, data + n, len - n);
+            client->pend_off = 0;
+            client->pend_len = len - n;
+            muxd_ev_mod(&client->ev, client_events(client));
+            taken = true;
+        }
+        else if (n < 0 && errno != EAGAIN && !chan->use_pty)
+            client_close(client);
+        // else a slow client - it just misses this frame rather than stalling the link
+    }
+
+    return taken;
+}
+
+void muxd_chan_pause(bool pause)
+{
+    int i, j;
+
+    if (pause == s_paused) return;
+    s_paused = pause;
+
+    for (i = 1; i < VANET_MUXCH_MAX; i++)
+    {
+        for (j = 0; j < MUXD_MAX_CLIENTS; j++)
+        {
+            muxd_client_t* client = &g_muxd_chan[i].clients[j];
+            if (client->ev.fd >= 0) muxd_ev_mod(&client->ev, client_events(client));
+        }
+    }
+}
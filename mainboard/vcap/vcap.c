@@ -0,0 +1,362 @@
+/**
+ *	@file	vcap.c
+ *
+ *	@brief	Record, replay and print daughterboard termios captures
+ *
+ *	rec takes what the daughterboard's "capture start" sends on the capture
+ *	channel and writes it to a file as-is.  play sends a file back down the
+ *	channel, at the recorded pace times -x, for "replay start" to feed into the
+ *	daughterboard's ports.  The link is the limit on play: the GPS at 9600 baud
+ *	replays at about 10x over a 115200 baud mux.  vanet-sim's "capture file"
+ *	and "replay file" use the same files without the link.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "vanet_capture.h"
+
+#define VCAP_DEFAULT_SOCKDIR            "/var/run/vanet"
+
+/// How far play runs ahead of the recorded pace, so the daughterboard never waits on the link
+#define VCAP_LEAD_US                    50000
+
+/// Ports a capture can name
+#define VCAP_MAX_PORTS                  8
+
+typedef struct
+{
+    FILE*           out;
+    bool            end;
+    uint64_t        t_us;           ///< Recorded time of the current record
+    uint64_t        bytes;
+    char            names[VCAP_MAX_PORTS][32];
+} vcap_ctx_t;
+
+static const char* s_sockdir = VCAP_DEFAULT_SOCKDIR;
+static double s_speed = 1.0;
+static volatile sig_atomic_t s_quit;
+
+static void signal_handler(int sig)
+{
+    s_quit = 1;
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int open_channel(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/capture.sock", s_sockdir);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "vcap: %s: %s\n", addr.sun_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static const char* port_name(vcap_ctx_t* ctx, uint8_t port)
+{
+    return port < VCAP_MAX_PORTS && ctx->names[port][0] ? ctx->names[port] : "?";
+}
+
+/// Keep the names and the clock - every command needs them
+static void track(vcap_ctx_t* ctx, const vanet_capture_rec_t* rec)
+{
+    ctx->t_us += rec->delta_us;
+
+    if (rec->type == VANET_CAPTURE_NAME && rec->port < VCAP_MAX_PORTS)
+    {
+        size_t n = rec->len < sizeof(ctx->names[0]) - 1 ? rec->len : sizeof(ctx->names[0]) - 1;
+        memcpy(ctx->names[rec->port], rec->data, n);
+        ctx->names[rec->port][n] = '\0';
+    }
+    else if (rec->type == VANET_CAPTURE_DATA)
+    {
+        ctx->bytes += rec->len;
+    }
+    else if (rec->type == VANET_CAPTURE_END)
+    {
+        ctx->end = true;
+    }
+}
+
+static void summary(vcap_ctx_t* ctx, vanet_capture_parser_t* p)
+{
+    fprintf(stderr, "vcap: records=%u bytes=%llu recorded_ms=%llu bad=%u end=%s ports=",
+        p->records, (unsigned long long)ctx->bytes, (unsigned long long)(ctx->t_us / 1000), p->bad,
+        ctx->end ? "yes" : "no");
+    for (int i = 0; i < VCAP_MAX_PORTS; i++)
+    {
+        if (ctx->names[i][0]) fprintf(stderr, "%s:%d ", ctx->names[i], i);
+    }
+    fprintf(stderr, "\n");
+}
+
+/* -----------
+ *  rec
+ * ----------*/
+static void rec_cb(void* arg, const vanet_capture_rec_t* rec)
+{
+    track((vcap_ctx_t*)arg, rec);
+}
+
+static int cmd_rec(const char* path)
+{
+    vanet_capture_parser_t parser;
+    vcap_ctx_t ctx;
+    uint8_t buf[4096];
+    ssize_t n;
+    int fd;
+
+    memset(&ctx, 0, sizeof(ctx));
+    vanet_capture_parser_init(&parser);
+
+    if ((fd = open_channel()) < 0)
+        return 1;
+    if (!(ctx.out = fopen(path, "wb")))
+    {
+        fprintf(stderr, "vcap: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    // until the daughterboard's "capture stop" ends the stream, or we're stopped
+    while (!s_quit && !ctx.end)
+    {
+        n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        fwrite(buf, 1, n, ctx.out);
+        vanet_capture_parse(&parser, buf, n, rec_cb, &ctx);
+    }
+
+    fclose(ctx.out);
+    close(fd);
+    summary(&ctx, &parser);
+    return 0;
+}
+
+/* -----------
+ *  play
+ * ----------*/
+typedef struct
+{
+    vcap_ctx_t      ctx;
+    int             fd;
+    uint64_t        start_us;
+    bool            failed;
+} play_ctx_t;
+
+static void play_cb(void* arg, const vanet_capture_rec_t* rec)
+{
+    play_ctx_t* play = (play_ctx_t*)arg;
+    uint8_t out[VANET_CAPTURE_HDR_SIZE + VANET_CAPTURE_MAX_DATA];
+    uint64_t due, now;
+    int len, off;
+    ssize_t n;
+
+    if (play->failed || play->ctx.end || s_quit)
+        return;
+
+    track(&play->ctx, rec);
+
+    if (!play->start_us)
+        play->start_us = now_us();
+
+    // at the recorded pace, a little ahead
+    if (s_speed > 0)
+    {
+        due = play->start_us + (uint64_t)(play->ctx.t_us / s_speed);
+        now = now_us();
+        if (due > now + VCAP_LEAD_US)
+            usleep(due - now - VCAP_LEAD_US);
+    }
+
+    len = vanet_capture_encode(out, rec->type, rec->port, rec->delta_us, rec->data, rec->len);
+    for (off = 0; off < len; off += n)
+    {
+        n = write(play->fd, out + off, len - off);
+        if (n < 0 && errno == EINTR) { n = 0; continue; }
+        if (n <= 0)
+        {
+            fprintf(stderr, "vcap: write: %s\n", strerror(errno));
+            play->failed = true;
+            return;
+        }
+    }
+}
+
+static int cmd_play(const char* path)
+{
+    vanet_capture_parser_t parser;
+    play_ctx_t play;
+    uint8_t buf[4096], end[VANET_CAPTURE_HDR_SIZE];
+    FILE* in;
+    size_t n;
+
+    memset(&play, 0, sizeof(play));
+    vanet_capture_parser_init(&parser);
+
+    if (!(in = fopen(path, "rb")))
+    {
+        fprintf(stderr, "vcap: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    if ((play.fd = open_channel()) < 0)
+        return 1;
+
+    while (!s_quit && !play.failed && !play.ctx.end && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        vanet_capture_parse(&parser, buf, n, play_cb, &play);
+    }
+
+    // a capture cut short still ends the replay
+    if (!play.ctx.end && !play.failed)
+    {
+        n = vanet_capture_encode(end, VANET_CAPTURE_END, 0, 0, NULL, 0);
+        if (write(play.fd, end, n) != (ssize_t)n)
+            play.failed = true;
+    }
+
+    fclose(in);
+    close(play.fd);
+    summary(&play.ctx, &parser);
+    return play.failed ? 1 : 0;
+}
+
+/* -----------
+ *  dump
+ * ----------*/
+static void dump_cb(void* arg, const vanet_capture_rec_t* rec)
+{
+    vcap_ctx_t* ctx = (vcap_ctx_t*)arg;
+
+    track(ctx, rec);
+
+    fprintf(ctx->out, "%llu.%06llu %c %-6s %4u ", (unsigned long long)(ctx->t_us / 1000000),
+        (unsigned long long)(ctx->t_us % 1000000), rec->type, port_name(ctx, rec->port), rec->len);
+    for (int i = 0; i < rec->len; i++)
+    {
+        uint8_t c = rec->data[i];
+        if (rec->type == VANET_CAPTURE_VERSION) fprintf(ctx->out, "%u", c);
+        else if (c == '\r') fputs("\\r", ctx->out);
+        else if (c == '\n') fputs("\\n", ctx->out);
+        else if (c >= 0x20 && c < 0x7f && c != '\\') fputc(c, ctx->out);
+        else fprintf(ctx->out, "\\x%02x", c);
+    }
+    fputc('\n', ctx->out);
+}
+
+static int cmd_dump(const char* path)
+{
+    vanet_capture_parser_t parser;
+    vcap_ctx_t ctx;
+    uint8_t buf[4096];
+    FILE* in;
+    size_t n;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.out = stdout;
+    vanet_capture_parser_init(&parser);
+
+    if (!(in = fopen(path, "rb")))
+    {
+        fprintf(stderr, "vcap: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        vanet_capture_parse(&parser, buf, n, dump_cb, &ctx);
+    }
+
+    fclose(in);
+    summary(&ctx, &parser);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: vcap [options] rec|play|dump <file>\n"
+        "  rec          write the capture channel to <file> until the capture stops\n"
+        "  play         send <file> down the capture channel (\"replay start\" on the board)\n"
+        "  dump         print <file> a record per line\n"
+        "  -s <dir>     muxd socket directory (default " VCAP_DEFAULT_SOCKDIR ")\n"
+        "  -x <speed>   play at <speed> times the recorded pace, 0 = as fast as the link (default 1)\n");
+}
+
+int main(int argc, char** argv)
+{
+    struct sigaction sa;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:x:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': s_sockdir = optarg; break;
+            case 'x': s_speed = atof(optarg); break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (argc - optind != 2 || s_speed < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;         // no SA_RESTART - read() returns on ^C
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!strcmp(argv[optind], "rec"))
+        return cmd_rec(argv[optind + 1]);
+    if (!strcmp(argv[optind], "play"))
+        return cmd_play(argv[optind + 1]);
+    if (!strcmp(argv[optind], "dump"))
+        return cmd_dump(argv[optind + 1]);
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,508 @@
+/**
+ *	@file	vtimed.c
+ *
+ *	@brief	Mainboard time sync daemon
+ *
+ *	Polls the daughterboard's GPS disciplined clock over the timesync channel,
+ *	keeps the least delay sample of the last few (see vanet_timesync.h) and
+ *	publishes its offset through the NTP shared memory refclock, for chrony or
+ *	ntpd to steer the system clock with:
+ *
+ *	    chrony:  refclock SHM 0 refid GPS poll 2 precision 1e-6
+ *	    ntpd:    server 127.127.28.0 minpoll 4 maxpoll 4
+ *	             fudge 127.127.28.0 refid GPS
+ *
+ *	Samples from a daughterboard that has no time pulse are not published, so
+ *	the refclock goes unreachable rather than following a free running clock.
+ */
+/*----------------------------------------------------------------------------
+ *
+ *  The initial developer of the original code is TK Labs, Inc. (tkLABS)
+ *
+ *  Contains unpublished trade secrets of TK Labs, Inc. Sunrise FL, USA
+ *
+ *  (C) Copyright 2014 TK Labs, Inc.
+ *
+ *             ALL RIGHTS RESERVED
+ *
+ *----------------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "vanet_api.h"
+#include "vanet_timesync.h"
+
+#define VTIMED_DEFAULT_SOCKDIR          "/var/run/vanet"
+#define VTIMED_DEFAULT_BAUD             115200
+
+/// ntpd's SHM refclock key for unit 0
+#define VTIMED_SHM_KEY                  0x4E545030
+
+/// The response frame: flag, address, control, one byte length, information, fcs, flag
+#define VTIMED_REPLY_FRAME              (VANET_TIMESYNC_REPLY_SIZE + 6)
+
+/// The NTP shared memory segment (ntpd refclock_shm.c)
+typedef struct
+{
+    int             mode;           ///< 1 - count is bumped either side of an update
+    volatile int    count;
+    time_t          clockTimeStampSec;
+    int             clockTimeStampUSec;
+    time_t          receiveTimeStampSec;
+    int             receiveTimeStampUSec;
+    int             leap;
+    int             precision;
+    int             nsamples;
+    volatile int    valid;
+    unsigned        clockTimeStampNSec;
+    unsigned        receiveTimeStampNSec;
+    int             dummy[8];
+} shm_time_t;
+
+typedef struct
+{
+    uint64_t        polls, samples, used, unsynced, timeouts, stale;
+    int64_t         offset_last;    ///< Of the last sample used
+    double          offset_sum;
+    int64_t         sample_last;    ///< Offset of the last sample, used or not
+    double          jitter_sum;     ///< Sum of the squared differences between successive samples' offsets
+    uint64_t        jitter_count;
+    int64_t         delay_min, delay_max;
+    double          delay_sum;
+} vtimed_stats_t;
+
+static struct
+{
+    const char*     sockdir;
+    int             poll_ms;
+    int             window;
+    int             unit;
+    int             baud;
+    int             stats_sec;
+    int             count;
+    bool            daemonize;
+    int             verbose;
+} s_cfg =
+{
+    .sockdir = VTIMED_DEFAULT_SOCKDIR,
+    .poll_ms = 1000,
+    .window = 8,
+    .baud = VTIMED_DEFAULT_BAUD,
+    .stats_sec = 60,
+};
+
+static vtimed_stats_t s_stats, s_total;
+static uint32_t s_status = VANET_API_TIME_UNSYNCED;
+static shm_time_t* s_shm;
+static volatile sig_atomic_t s_quit, s_report;
+
+static void vtimed_log(int prio, const char* fmt, ...)
+{
+    va_list va;
+
+    if (prio == LOG_DEBUG && s_cfg.verbose < 2) return;
+    if (prio == LOG_INFO && !s_cfg.verbose) return;
+
+    va_start(va, fmt);
+    if (s_cfg.daemonize)
+    {
+        vsyslog(prio, fmt, va);
+    }
+    else
+    {
+        vfprintf(stderr, fmt, va);
+        fputc('\n', stderr);
+    }
+    va_end(va);
+}
+
+static void signal_handler(int sig)
+{
+    if (sig == SIGUSR1)
+        s_report = 1;
+    else
+        s_quit = 1;
+}
+
+static int64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/// How long bytes characters take on the link
+static int64_t link_ns(int bytes)
+{
+    return s_cfg.baud ? (int64_t)bytes * 10 * 1000000000 / s_cfg.baud : 0;
+}
+
+static int open_channel(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/timesync.sock", s_cfg.sockdir);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ *  NTP shared memory
+ */
+
+static int shm_open_unit(int unit)
+{
+    // ntpd's convention: units 0 and 1 are root only, the rest anyone's
+    int id = shmget(VTIMED_SHM_KEY + unit, sizeof(shm_time_t), IPC_CREAT | (unit < 2 ? 0600 : 0666));
+    void* p;
+
+    if (id < 0)
+    {
+        vtimed_log(LOG_ERR, "shmget unit %d: %s", unit, strerror(errno));
+        return -1;
+    }
+    p = shmat(id, 0, 0);
+    if (p == (void*)-1)
+    {
+        vtimed_log(LOG_ERR, "shmat unit %d: %s", unit, strerror(errno));
+        return -1;
+    }
+    s_shm = p;
+    return 0;
+}
+
+/// Publish that the true time was local + offset at local
+static void shm_publish(int64_t local, int64_t offset)
+{
+    int64_t clk = local + offset;
+
+    s_shm->mode = 1;
+    s_shm->count++;
+    __sync_synchronize();
+    s_shm->valid = 0;
+    s_shm->clockTimeStampSec = clk / 1000000000;
+    s_shm->clockTimeStampUSec = clk % 1000000000 / 1000;
+    s_shm->clockTimeStampNSec = clk % 1000000000;
+    s_shm->receiveTimeStampSec = local / 1000000000;
+    s_shm->receiveTimeStampUSec = local % 1000000000 / 1000;
+    s_shm->receiveTimeStampNSec = local % 1000000000;
+    s_shm->leap = 0;
+    s_shm->precision = -20;         // ~1 us
+    s_shm->nsamples = 0;
+    __sync_synchronize();
+    s_shm->valid = 1;
+    s_shm->count++;
+}
+
+/*
+ *  Statistics
+ */
+
+static void stats_sample(vtimed_stats_t* st, const vanet_timesync_sample_t* s)
+{
+    if (st->samples == 0 || s->delay_ns < st->delay_min) st->delay_min = s->delay_ns;
+    if (st->samples == 0 || s->delay_ns > st->delay_max) st->delay_max = s->delay_ns;
+    st->delay_sum += s->delay_ns;
+
+    // from every sample - the used ones are few and far between, and tell
+    // nothing of the link's spread
+    if (st->samples)
+    {
+        double d = (double)(s->offset_ns - st->sample_last);
+        st->jitter_sum += d * d;
+        st->jitter_count++;
+    }
+    st->sample_last = s->offset_ns;
+    st->samples++;
+}
+
+static void stats_used(vtimed_stats_t* st, const vanet_timesync_sample_t* s)
+{
+    st->offset_last = s->offset_ns;
+    st->offset_sum += s->offset_ns;
+    st->used++;
+}
+
+static const char* status_name(uint32_t status)
+{
+    switch (status)
+    {
+        case VANET_API_TIME_LOCKED:     return "locked";
+        case VANET_API_TIME_HOLDOVER:   return "holdover";
+        default:                        return "unsynced";
+    }
+}
+
+static void stats_report(bool totals)
+{
+    vtimed_stats_t* st = totals ? &s_total : &s_stats;
+
+    // machine-readable like muxd: key=value pairs, times in us, delay as min/avg/max
+    vtimed_log(LOG_NOTICE, "%s timesync status=%s polls=%llu samples=%llu used=%llu unsynced=%llu timeouts=%llu stale=%llu "
+               "offset_us=%.1f mean_offset_us=%.1f jitter_us=%.1f delay_us=%.1f/%.1f/%.1f",
+               totals ? "total" : "stats", status_name(s_status),
+               (unsigned long long)st->polls, (unsigned long long)st->samples, (unsigned long long)st->used,
+               (unsigned long long)st->unsynced, (unsigned long long)st->timeouts, (unsigned long long)st->stale,
+               st->offset_last / 1e3,
+               st->used ? st->offset_sum / st->used / 1e3 : 0.0,
+               st->jitter_count ? sqrt(st->jitter_sum / st->jitter_count) / 1e3 : 0.0,
+               st->delay_min / 1e3, st->samples ? st->delay_sum / st->samples / 1e3 : 0.0, st->delay_max / 1e3);
+
+    if (!totals)
+        memset(&s_stats, 0, sizeof(s_stats));
+}
+
+/*
+ *  Polling
+ */
+
+/**
+ *  One exchange
+ *
+ *  @return 1 with a sample, 0 on a timeout or a reply to not use, -1 if the channel went away
+ */
+static int poll_once(int fd, int timeout_ms, vanet_timesync_sample_t* s)
+{
+    uint8_t req[VANET_TIMESYNC_REQUEST_SIZE], rsp[64];
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int64_t t1, t4, deadline;
+    ssize_t n;
+    int rc;
+
+    // drain anything left over from a request that timed out
+    while (recv(fd, rsp, sizeof(rsp), MSG_DONTWAIT) > 0)
+        s_stats.stale++, s_total.stale++;
+
+    t1 = clock_ns(CLOCK_REALTIME);
+    vanet_timesync_request(req, t1);
+    if (send(fd, req, sizeof(req), 0) < 0)
+    {
+        vtimed_log(LOG_WARNING, "timesync send: %s", strerror(errno));
+        return -1;
+    }
+
+    deadline = clock_ns(CLOCK_MONOTONIC) + (int64_t)timeout_ms * 1000000;
+    while (!s_quit)
+    {
+        int64_t left = deadline - clock_ns(CLOCK_MONOTONIC);
+
+        if (left <= 0 || poll(&pfd, 1, (int)((left + 999999) / 1000000)) == 0)
+        {
+            s_stats.timeouts++, s_total.timeouts++;
+            vtimed_log(LOG_INFO, "timesync: no reply");
+            return 0;
+        }
+
+        n = recv(fd, rsp, sizeof(rsp), 0);
+        t4 = clock_ns(CLOCK_REALTIME);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR) continue;
+            vtimed_log(LOG_WARNING, "timesync channel closed");
+            return -1;
+        }
+
+        rc = vanet_timesync_reply(rsp, n, t1, t4, s);
+        if (rc == VANET_TIMESYNC_BAD_ORIGIN)
+        {
+            s_stats.stale++, s_total.stale++;
+            continue;
+        }
+        if (rc == VANET_TIMESYNC_BAD_LENGTH)
+        {
+            vtimed_log(LOG_WARNING, "timesync: %d byte reply - daughterboard firmware too old (need API 6)", (int)n);
+            return 0;
+        }
+
+        /*
+         * T2 and T3 are both at the end of a start flag.  Ours are when the
+         * request was handed over and the whole response was in, so move T1 on
+         * one character and T4 back the rest of the response frame - a 1.4 ms
+         * offset error at 115200 otherwise.
+         */
+        s->t1 += link_ns(1);
+        s->t4 -= link_ns(VTIMED_REPLY_FRAME - 1);
+        vanet_timesync_compute(s);
+        return 1;
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: vtimed [options]\n"
+        "  -s <dir>     muxd socket directory (default " VTIMED_DEFAULT_SOCKDIR ")\n"
+        "  -p <ms>      poll interval (default 1000)\n"
+        "  -n <n>       filter window, samples (default 8, max %d)\n"
+        "  -u <unit>    NTP SHM refclock unit (default 0)\n"
+        "  -b <baud>    link baud rate, for the frame time correction (default %d, 0 = none)\n"
+        "  -c <n>       stop after n polls\n"
+        "  -i <sec>     stats interval, 0 = SIGUSR1 only (default 60)\n"
+        "  -D           daemonize and log to syslog\n"
+        "  -v           verbose (repeat for every sample)\n",
+        VANET_TIMESYNC_MAX_WINDOW, VTIMED_DEFAULT_BAUD);
+}
+
+int main(int argc, char** argv)
+{
+    vanet_timesync_filter_t filter;
+    vanet_timesync_sample_t s;
+    const vanet_timesync_sample_t* best;
+    struct sigaction sa;
+    struct timespec ts;
+    int64_t next_poll, next_stats = 0, now;
+    int opt, fd = -1, polls = 0;
+    bool complained = false;
+
+    while ((opt = getopt(argc, argv, "s:p:n:u:b:c:i:Dvh")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': s_cfg.sockdir = optarg; break;
+            case 'p': s_cfg.poll_ms = atoi(optarg); break;
+            case 'n': s_cfg.window = atoi(optarg); break;
+            case 'u': s_cfg.unit = atoi(optarg); break;
+            case 'b': s_cfg.baud = atoi(optarg); break;
+            case 'c': s_cfg.count = atoi(optarg); break;
+            case 'i': s_cfg.stats_sec = atoi(optarg); break;
+            case 'D': s_cfg.daemonize = true; break;
+            case 'v': s_cfg.verbose++; break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (s_cfg.poll_ms < 10 || s_cfg.window < 1 || s_cfg.window > VANET_TIMESYNC_MAX_WINDOW ||
+        s_cfg.unit < 0 || s_cfg.baud < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    if (s_cfg.daemonize)
+    {
+        openlog("vtimed", LOG_PID, LOG_DAEMON);
+        if (daemon(0, 0) < 0) return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;         // no SA_RESTART - we want the sleeps to return
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    sigaction(SIGUSR1, &sa, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (shm_open_unit(s_cfg.unit) < 0)
+        return 1;
+
+    vanet_timesync_filter_init(&filter, s_cfg.window);
+    next_poll = clock_ns(CLOCK_MONOTONIC);
+
+    while (!s_quit && (!s_cfg.count || polls < s_cfg.count))
+    {
+        if (fd < 0)
+        {
+            fd = open_channel();
+            if (fd < 0 && !complained)
+                vtimed_log(LOG_WARNING, "%s/timesync.sock: %s - retrying", s_cfg.sockdir, strerror(errno));
+            complained = fd < 0;
+        }
+
+        if (fd >= 0)
+        {
+            int rc = poll_once(fd, s_cfg.poll_ms, &s);
+
+            polls++;
+            s_stats.polls++, s_total.polls++;
+            if (rc < 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+            else if (rc > 0)
+            {
+                s_status = s.status;
+                vtimed_log(LOG_DEBUG, "sample offset_ns=%lld delay_ns=%lld status=%s",
+                           (long long)s.offset_ns, (long long)s.delay_ns, status_name(s.status));
+
+                if (s.status == VANET_API_TIME_UNSYNCED)
+                {
+                    // its clock means nothing, and neither does what's in the filter
+                    s_stats.unsynced++, s_total.unsynced++;
+                    vanet_timesync_filter_init(&filter, s_cfg.window);
+                }
+                else
+                {
+                    stats_sample(&s_stats, &s);
+                    stats_sample(&s_total, &s);
+                    best = vanet_timesync_filter_add(&filter, &s);
+                    if (best)
+                    {
+                        // the offset was measured at the best sample's receive time, which
+                        // may be a few polls back - pair it with that, not the latest
+                        shm_publish(best->t4, best->offset_ns);
+                        stats_used(&s_stats, best);
+                        stats_used(&s_total, best);
+                        vtimed_log(LOG_INFO, "offset_ns=%lld delay_ns=%lld", (long long)best->offset_ns, (long long)best->delay_ns);
+                    }
+                }
+            }
+        }
+
+        now = clock_ns(CLOCK_MONOTONIC);
+        if (s_cfg.stats_sec)
+        {
+            if (!next_stats) next_stats = now + s_cfg.stats_sec * 1000000000LL;
+            if (now >= next_stats)
+            {
+                stats_report(false);
+                next_stats += s_cfg.stats_sec * 1000000000LL;
+            }
+        }
+        if (s_report)
+        {
+            s_report = 0;
+            stats_report(true);
+        }
+
+        // on a fixed grid, so a slow reply doesn't push the polls back
+        next_poll += (int64_t)s_cfg.poll_ms * 1000000;
+        if (next_poll < now) next_poll = now;
+        ts.tv_sec = next_poll / 1000000000;
+        ts.tv_nsec = next_poll % 1000000000;
+        if (!s_quit) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+
+    stats_report(true);
+    if (fd >= 0) close(fd);
+    shmdt(s_shm);
+    return 0;
+}